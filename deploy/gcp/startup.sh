@@ -7,6 +7,8 @@ apt-get install -y cmake g++ make git nginx curl
 
 mkdir -p /mnt/data/sentineldb
 useradd -r -s /bin/false sentineldb 2>/dev/null || true
+# nginx reaches SentinelDB over its Unix socket (mode 0660, group sentineldb)
+usermod -aG sentineldb www-data
 
 mkdir -p /opt/sentineldb
 cd /opt/sentineldb
@@ -0,0 +1,126 @@
+#ifndef BLOB_STORE_H
+#define BLOB_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "status.h"
+#include "wal.h"
+
+// Where a large value lives: written once into a blob log and referenced from
+// the store, WAL records and snapshots by this small handle instead.
+struct BlobRef {
+    uint32_t file = 0;
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    uint32_t crc = 0;
+
+    // Text form used in memory and on disk: file:offset:length:crc(hex)
+    std::string toString() const;
+    static bool parse(const std::string& text, BlobRef& ref);
+};
+
+// Key-value separation for large values. Values at or above threshold are
+// appended to blob-NNNNNN.log files in one directory; a file is sealed once
+// it reaches fileBytes and a new one is started. Blobs are never rewritten,
+// so a WAL record or snapshot line costs a few dozen bytes however large the
+// value, and checkpoints and replays stop copying the same megabytes.
+//
+// Blob data is made durable by sync(), which the WAL runs before each
+// group-commit fsync: a SETREF record is never on disk ahead of its blob.
+// Each blob carries a CRC-32 that read() verifies.
+//
+// Files are reclaimed whole by the owning KVStore's mark-and-sweep
+// (KVStore::collectBlobGarbage()): a sealed file that no in-memory or
+// spilled version references any more is deleted. Log records and snapshot
+// lines pointing into a deleted file refer to versions retention or deletes
+// had already dropped; replay skips them (see available()).
+class BlobStore {
+public:
+    struct Options {
+        size_t threshold = 64u << 10;  // smallest value stored as a blob
+        uint64_t fileBytes = 64u << 20;  // seal the active file past this size
+    };
+
+    struct Stats {
+        size_t files = 0;
+        uint64_t diskBytes = 0;
+        uint64_t blobsWritten = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t filesReclaimed = 0;
+        uint64_t bytesReclaimed = 0;
+        uint64_t readErrors = 0;
+    };
+
+    BlobStore(const std::string& dir, const Options& options);
+    ~BlobStore();
+
+    BlobStore(const BlobStore&) = delete;
+    BlobStore& operator=(const BlobStore&) = delete;
+
+    // Create the directory, index existing files and start a new active file
+    Status initialize();
+    bool isEnabled() const { return activeFd_ >= 0; }
+    size_t threshold() const { return options_.threshold; }
+    const std::string& directory() const { return dir_; }
+
+    // Append value to the active file and describe it in ref. The blob counts
+    // as pending, which keeps its file from being collected, until the caller
+    // has published ref in the store and calls published(). Sets *sealed when
+    // the write filled the active file and a new one was started.
+    Status put(const std::string& value, std::string& ref, bool* sealed = nullptr);
+    void published(const std::string& ref);
+
+    // Read and verify a blob. False (and logged) if its file is gone, the
+    // read is short or the checksum does not match.
+    bool read(const std::string& ref, std::string& out) const;
+
+    // Whether ref points inside a file that still exists. Cheap; doesn't read.
+    bool available(const std::string& ref) const;
+
+    // fsync data appended since the last call
+    void sync();
+
+    // Sealed files with no pending blobs, candidates for collection
+    std::vector<uint32_t> collectable() const;
+    // Delete sealed files; returns the bytes freed
+    uint64_t remove(const std::vector<uint32_t>& files);
+
+    // Open every file for an online backup, as blobs/<name> sections
+    void pinFiles(std::vector<WALBackupPoint::File>& files) const;
+
+    size_t fileCount() const;
+    Stats stats() const;
+
+    static std::string fileName(uint32_t file);
+
+private:
+    struct File {
+        int fd = -1;
+        uint64_t bytes = 0;
+        size_t pending = 0;  // blobs written but not yet published
+    };
+
+    Status openActive(uint32_t id);
+
+    std::string dir_;
+    Options options_;
+    mutable std::mutex mutex_;
+    std::mutex syncMutex_;  // taken before mutex_
+    std::map<uint32_t, File> files_;
+    uint32_t activeId_ = 0;
+    int activeFd_ = -1;
+    // Files appended to since the last sync(), active one included
+    std::vector<uint32_t> unsynced_;
+
+    uint64_t blobsWritten_ = 0;
+    uint64_t bytesWritten_ = 0;
+    uint64_t filesReclaimed_ = 0;
+    uint64_t bytesReclaimed_ = 0;
+    mutable uint64_t readErrors_ = 0;
+};
+
+#endif // BLOB_STORE_H
@@ -0,0 +1,90 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// HTTP content codings the server can produce. Compression needs zlib at
+// build time (SENTINEL_HAVE_ZLIB); without it every response is IDENTITY.
+enum class ContentCoding {
+    IDENTITY,
+    GZIP,
+    DEFLATE
+};
+
+// Incremental compressor for one response body. Whole bodies call finish()
+// once; chunked responses call write()/flush() per chunk and finish() at the
+// end, so nothing is buffered beyond zlib's window.
+class StreamCompressor {
+public:
+    StreamCompressor(ContentCoding coding, int level);
+    ~StreamCompressor();
+
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    // Compress data, appending whatever output is ready to out
+    bool write(std::string_view data, std::string& out);
+    // Emit everything written so far (sync flush) so a chunk can be sent
+    bool flush(std::string& out);
+    // Compress the final piece and emit the stream trailer
+    bool finish(std::string_view data, std::string& out);
+
+    bool ok() const { return ok_; }
+
+private:
+    bool deflateInto(std::string_view data, int mode, std::string& out);
+
+    struct State;
+    std::unique_ptr<State> state_;
+    bool ok_ = false;
+};
+
+// Caps how many responses are compressed at once. When every slot is busy
+// the response goes out uncompressed rather than making the request thread
+// wait, so compression never starves request handling.
+class CompressionBudget {
+public:
+    explicit CompressionBudget(size_t slots);
+
+    bool tryAcquire();
+    void release();
+    size_t slots() const { return slots_; }
+
+private:
+    const size_t slots_;
+    std::atomic<size_t> inUse_{0};
+};
+
+// Compression settings and negotiation for HTTP responses
+class ResponseCompression {
+public:
+    ResponseCompression(size_t minBytes, int level, size_t maxConcurrent);
+
+    // Best coding the client accepts for a body of this size and type
+    ContentCoding negotiate(const std::string& acceptEncoding, size_t bodySize,
+                            const std::string& contentType) const;
+
+    // Compress body in place. Returns false (body untouched) when no budget
+    // slot is free or compression fails.
+    bool compressBody(ContentCoding coding, std::string& body);
+
+    int level() const { return level_; }
+    size_t minBytes() const { return minBytes_; }
+    CompressionBudget& budget() { return budget_; }
+
+    static bool available();
+    static bool isCompressible(const std::string& contentType);
+    static ContentCoding parseAcceptEncoding(const std::string& acceptEncoding);
+    static const char* codingName(ContentCoding coding);
+
+private:
+    size_t minBytes_;
+    int level_;
+    CompressionBudget budget_;
+};
+
+#endif // COMPRESSION_H
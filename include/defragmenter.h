@@ -0,0 +1,101 @@
+#ifndef DEFRAGMENTER_H
+#define DEFRAGMENTER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class KVStore;
+
+// Gives memory back after retention trims, prefix deletes and evictions.
+// Those free versions but leave the heap fragmented: trimmed chunks keep
+// their slack, the key index keeps its bucket array, and malloc keeps the
+// freed pages. RSS stays high and the next spike ends in an OOM kill.
+//
+// Every interval the defragmenter compares the process RSS with the bytes
+// malloc has handed out. When RSS / in-use reaches minFragmentation and at
+// least minWastedBytes are idle, it runs one pass:
+//
+//   1. walk the store a few keys at a time, compacting each version chain
+//      (trimmed chunks are rebuilt with freshly allocated values)
+//   2. rehash the key index and LRU map if they are mostly empty
+//   3. malloc_trim() free heap pages back to the kernel
+//
+// Step 1 holds the write lock for keysPerStep keys at a time and then
+// sleeps, so the pass uses at most maxCpuPercent of one core. A pass that
+// frees little doubles the wait before the next one (up to 32 intervals),
+// since the idle memory is then held by something a pass can't reach.
+// In-use bytes come from glibc's mallinfo2(); without glibc >= 2.33 passes
+// run only when forced via runPass().
+class Defragmenter {
+public:
+    struct Options {
+        std::chrono::milliseconds interval{10000};
+        double minFragmentation = 1.4;        // RSS / in-use bytes
+        uint64_t minWastedBytes = 64u << 20;  // RSS - in-use bytes
+        size_t keysPerStep = 128;
+        double maxCpuPercent = 10.0;
+    };
+
+    struct HeapStats {
+        uint64_t residentBytes = 0;   // process RSS
+        uint64_t allocatedBytes = 0;  // handed out by malloc
+        bool available = false;
+
+        double fragmentation() const {
+            return allocatedBytes > 0
+                ? static_cast<double>(residentBytes) / static_cast<double>(allocatedBytes) : 1.0;
+        }
+        uint64_t wastedBytes() const {
+            return residentBytes > allocatedBytes ? residentBytes - allocatedBytes : 0;
+        }
+    };
+
+    struct PassResult {
+        size_t keysVisited = 0;
+        size_t keysCompacted = 0;
+        uint64_t containerBytes = 0;  // released by compaction and rehashing
+        uint64_t rssBytes = 0;        // RSS drop over the pass
+        std::chrono::milliseconds duration{0};
+    };
+
+    Defragmenter(std::shared_ptr<KVStore> store, const Options& options);
+    ~Defragmenter();
+
+    Defragmenter(const Defragmenter&) = delete;
+    Defragmenter& operator=(const Defragmenter&) = delete;
+
+    void start();
+    void stop();
+
+    // Sample the heap and run a pass if it is fragmented enough
+    void tick();
+
+    // One full pass, regardless of fragmentation
+    PassResult runPass();
+
+    static HeapStats heapStats();
+
+private:
+    void run();
+    // Sleep for the given time unless stopped; false if stopped
+    bool pause(std::chrono::nanoseconds duration);
+
+    std::shared_ptr<KVStore> store_;
+    Options options_;
+    // Backoff after passes that freed little (touched by the thread only)
+    size_t backoffTicks_ = 1;
+    size_t ticksToSkip_ = 0;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+#endif // DEFRAGMENTER_H
@@ -0,0 +1,207 @@
+#ifndef HISTORY_EXPORT_H
+#define HISTORY_EXPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "version_chain.h"
+
+class KVStore;
+class IoScheduler;
+
+// Columnar export of version histories for analytics. An export holds every
+// version stamped in [from, through] of the keys under a prefix, as of the
+// moment it starts: later writes are stamped after `through` and left out.
+// Keys deleted while it runs may be missing from it.
+//
+// Rows are versions, sorted by key and then time, stored in row groups of
+// about rowsPerGroup rows that each cover a range of keys. All integers are
+// little-endian:
+//
+//   "SDBCOL01"
+//   row group 0 .. n-1, four column chunks each, back to back:
+//     keys    u32 count | u32 offsets[count + 1] | key bytes
+//             the group's distinct keys, sorted: the key dictionary
+//     runs    u32 rows[count], the rows of each dictionary key in turn: the
+//             key column as run-length encoded dictionary indexes
+//     times   zigzag varints: the first timestamp (ns since the epoch),
+//             then each row's difference to the row before
+//     values  u32 offsets[rows + 1] | value bytes
+//   footer
+//   u32 footer bytes | "SDBCOL01"
+//
+//   footer: u32 version | i64 from_ns | i64 through_ns | i64 created_ns |
+//           u32 length | prefix | u64 keys | u64 rows | u32 groups |
+//           per group: u64 offset | u32 keys | u32 rows | i64 min_ns |
+//                      i64 max_ns | 4 x (u64 bytes | u32 crc) |
+//                      u32 length | first key | u32 length | last key
+//           u32 crc of everything above
+//
+// Fixed-width offsets let a reader binary-search a mapped file for a key
+// without decoding anything but that key's group.
+class HistoryExport {
+public:
+    struct Options {
+        std::chrono::system_clock::time_point from{};     // default: the epoch
+        std::chrono::system_clock::time_point through{};  // default: when the export starts
+        std::string prefix;
+        size_t rowsPerGroup = 65536;
+        size_t keysPerBatch = 256;  // keys read per shared-lock hold
+        // Writes wait for this budget, like snapshots; nullptr = unpaced
+        std::shared_ptr<IoScheduler> io;
+    };
+
+    // Updated as the export runs; readable from other threads
+    struct Progress {
+        std::atomic<uint64_t> keysTotal{0};  // keys under the prefix
+        std::atomic<uint64_t> keys{0};       // keys read so far
+        std::atomic<uint64_t> rows{0};       // versions written
+        std::atomic<uint64_t> rowGroups{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    // Export store to path, through a temporary file renamed into place
+    // once complete. The store is read keysPerBatch keys per shared-lock
+    // hold and the file written at the rate io grants, so serving carries
+    // on. False with a message in error on failure.
+    static bool write(const KVStore& store, const std::string& path, const Options& options,
+                      Progress& progress, std::string& error);
+
+    static constexpr uint32_t kFormatVersion = 1;
+};
+
+// Read-only view of an export file, mapped into memory
+class HistoryFile {
+public:
+    struct Chunk {
+        uint64_t offset = 0;
+        uint64_t bytes = 0;
+        uint32_t crc = 0;
+    };
+
+    struct Group {
+        uint64_t offset = 0;
+        uint32_t keys = 0;
+        uint32_t rows = 0;
+        int64_t minNs = 0;
+        int64_t maxNs = 0;
+        Chunk chunks[4];  // keys, runs, times, values
+        std::string firstKey;
+        std::string lastKey;
+    };
+
+    HistoryFile() = default;
+    ~HistoryFile();
+
+    HistoryFile(const HistoryFile&) = delete;
+    HistoryFile& operator=(const HistoryFile&) = delete;
+
+    // Map path and parse its footer; the column chunks are not read
+    bool open(const std::string& path, std::string& error);
+
+    std::chrono::system_clock::time_point from() const { return from_; }
+    std::chrono::system_clock::time_point through() const { return through_; }
+    std::chrono::system_clock::time_point created() const { return created_; }
+    const std::string& prefix() const { return prefix_; }
+    uint64_t keys() const { return keys_; }
+    uint64_t rows() const { return rows_; }
+    const std::vector<Group>& groups() const { return groups_; }
+
+    // Check every column chunk against its CRC-32
+    bool verify(std::string& error) const;
+
+    // Where a key's rows are: its group, its index in that group's key
+    // dictionary and its rows in the group's row order
+    struct Position {
+        size_t group = 0;
+        uint32_t key = 0;
+        uint32_t firstRow = 0;
+        uint32_t rows = 0;
+    };
+
+    // Binary search the groups' key ranges, then the group's dictionary;
+    // false if the export doesn't hold key
+    bool find(const std::string& key, Position& position) const;
+
+    // Versions of key in time order; false if the export doesn't hold it
+    bool history(const std::string& key, std::vector<Version>& versions) const;
+
+    // Each key from start on, in order, with its versions, until fn
+    // returns false. Decodes one group's timestamps at a time.
+    void scan(const std::string& start,
+              const std::function<bool(const std::string& key, const std::vector<Version>& versions)>& fn) const;
+
+    // Every row of one group, in file order
+    void forEachRow(size_t group,
+                    const std::function<void(const std::string& key, const Version& version)>& fn) const;
+
+private:
+    // Key i of a group's dictionary, pointing into the mapping
+    std::string keyAt(const Group& group, uint32_t index) const;
+    // Index of the first dictionary key not before key
+    uint32_t lowerBound(const Group& group, const std::string& key) const;
+    // Timestamps of the first `rows` rows of a group
+    void decodeTimes(const Group& group, uint32_t rows, std::vector<int64_t>& times) const;
+    std::string valueAt(const Group& group, uint32_t row) const;
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::chrono::system_clock::time_point from_{};
+    std::chrono::system_clock::time_point through_{};
+    std::chrono::system_clock::time_point created_{};
+    std::string prefix_;
+    uint64_t keys_ = 0;
+    uint64_t rows_ = 0;
+    std::vector<Group> groups_;
+};
+
+// Runs one export at a time on a background thread (the HTTP frontend)
+class HistoryExportJob {
+public:
+    enum class State { IDLE, RUNNING, DONE, FAILED };
+
+    struct Status {
+        State state = State::IDLE;
+        std::string path;
+        std::chrono::system_clock::time_point from{};
+        std::chrono::system_clock::time_point through{};
+        std::string prefix;
+        uint64_t keysTotal = 0;
+        uint64_t keys = 0;
+        uint64_t rows = 0;
+        uint64_t rowGroups = 0;
+        uint64_t bytes = 0;
+        std::chrono::milliseconds elapsed{0};
+        std::string error;
+    };
+
+    explicit HistoryExportJob(std::shared_ptr<KVStore> store);
+    ~HistoryExportJob();
+
+    HistoryExportJob(const HistoryExportJob&) = delete;
+    HistoryExportJob& operator=(const HistoryExportJob&) = delete;
+
+    // Start exporting to path; false if an export is already running.
+    // options.through is fixed here if left unset.
+    bool start(const std::string& path, HistoryExport::Options options);
+
+    Status status() const;
+
+    static const char* stateName(State state);
+
+private:
+    std::shared_ptr<KVStore> store_;
+    mutable std::mutex mutex_;
+    std::thread thread_;
+    Status status_;  // guarded by mutex_, counters excepted
+    HistoryExport::Progress progress_;
+    std::chrono::steady_clock::time_point started_;
+};
+
+#endif // HISTORY_EXPORT_H
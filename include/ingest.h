@@ -0,0 +1,95 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "kvstore.h"
+
+// Bulk ingest of a newline-delimited stream of records (POST /ingest).
+// The body is fed in whatever pieces it arrives in. Lines are parsed on the
+// feeding thread into batches, and a second thread applies each full batch
+// with KVStore::setBatch() (one write lock, one WAL append) while the next
+// one is parsed. feed() waits while a batch is still being applied, so at
+// most two batches exist at once; with the cap on a partial line and on
+// the errors kept, memory doesn't depend on the size of the stream.
+class IngestStream {
+public:
+    struct Options {
+        size_t batchRecords = 1000;
+        size_t batchBytes = 8u << 20;     // values per batch
+        size_t maxLineBytes = 1100000;    // longer lines are skipped as errors
+        size_t maxErrors = 1000;          // errors kept; the rest are only counted
+    };
+
+    // A line that wasn't written; line numbers start at 1
+    struct Error {
+        uint64_t line = 0;
+        std::string key;
+        std::string message;
+    };
+
+    struct Result {
+        uint64_t records = 0;   // non-blank lines
+        uint64_t applied = 0;
+        uint64_t failed = 0;
+        uint64_t batches = 0;
+        std::vector<Error> errors;  // up to maxErrors failures, by line
+    };
+
+    // Turn one line (without its newline) into a write; false with error
+    // set if it is malformed or not allowed
+    using Parser = std::function<bool(const std::string& line, BatchWrite& write, std::string& error)>;
+
+    IngestStream(std::shared_ptr<KVStore> store, Parser parser, const Options& options);
+    ~IngestStream();
+
+    IngestStream(const IngestStream&) = delete;
+    IngestStream& operator=(const IngestStream&) = delete;
+
+    // The next bytes of the stream, split anywhere
+    void feed(const char* data, size_t length);
+    // Apply what is left, including a last line without a newline, and
+    // return the totals. Call once.
+    Result finish();
+
+private:
+    struct Batch {
+        std::vector<BatchWrite> writes;
+        std::vector<uint64_t> lines;
+        size_t bytes = 0;
+    };
+
+    void parseLine(const char* data, size_t length);
+    void submit();
+    void applyLoop();
+    void recordError(uint64_t line, const std::string& key, const std::string& message);
+
+    std::shared_ptr<KVStore> store_;
+    Parser parser_;
+    Options options_;
+
+    // Feeding thread only
+    std::string partial_;
+    bool skipping_ = false;  // inside a line longer than maxLineBytes
+    uint64_t line_ = 0;
+    Batch filling_;
+
+    // Handoff to the applier (guarded by mutex_)
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Batch queued_;
+    bool hasQueued_ = false;
+    bool applying_ = false;
+    bool done_ = false;
+    Result result_;
+    std::thread applier_;
+};
+
+#endif // INGEST_H
@@ -0,0 +1,130 @@
+#ifndef INVALIDATION_H
+#define INVALIDATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Server-assisted client-side caching. Clients identify themselves with a
+// stable id, and the server remembers which clients may hold which keys so it
+// can tell them when to drop a cached copy.
+//
+// The tracking table records which client read which key, hashed into one
+// of `slots` buckets. A write to a key invalidates it for the clients that
+// read that key and drops just those entries, so each client is told at
+// most once until it reads again; other keys in the bucket stay tracked.
+// Memory grows with the (client, key) pairs, up to maxEntries.
+//
+// Broadcast clients track no keys. They subscribe to prefixes and are told
+// about every write under them.
+//
+// Every structure is bounded. If the table exceeds maxEntries, whole slots
+// are evicted and their clients are told to flush, since their keys are no
+// longer tracked. If a client's queue overflows, it is collapsed into a
+// single flush. Clients that stop polling expire after clientTtl.
+class InvalidationTracker {
+public:
+    struct Options {
+        size_t slots = 1 << 16;
+        size_t maxEntries = 1 << 20;   // (client, key) pairs across all slots
+        size_t maxQueued = 1024;       // pending keys per client
+        size_t maxClients = 10000;
+        std::chrono::seconds clientTtl{300};
+    };
+
+    // What a client must drop. flush means "drop everything".
+    struct Batch {
+        std::vector<std::string> keys;
+        bool flush = false;
+    };
+
+    struct Stats {
+        size_t clients = 0;
+        size_t entries = 0;
+    };
+
+    explicit InvalidationTracker(const Options& options);
+
+    // Remember that clientId may cache key. Call before reading the value so
+    // a concurrent write cannot slip between the read and the tracking.
+    // False if the client table is full.
+    bool trackRead(const std::string& clientId, const std::string& key);
+
+    // Switch a client to broadcast mode for these prefixes (empty prefix =
+    // every key). False if the client table is full.
+    bool subscribePrefixes(const std::string& clientId, const std::vector<std::string>& prefixes);
+
+    // Called for every committed write or delete
+    void keyChanged(const std::string& key);
+
+    // Called for a prefix delete. The slot table cannot tell which tracked
+    // keys fall under a prefix, so every key-tracking client is flushed;
+    // broadcast clients only when one of their prefixes overlaps it.
+    void prefixChanged(const std::string& prefix);
+
+    // Wait up to timeout for invalidations. Returns false if nothing arrived.
+    // A client that was unknown (never tracked, or expired) gets a flush,
+    // since anything it cached may be stale.
+    bool poll(const std::string& clientId, std::chrono::milliseconds timeout, Batch& out);
+
+    Stats stats() const;
+
+    static uint32_t slotOf(const std::string& key, size_t slots);
+
+private:
+    struct Client {
+        uint32_t id = 0;
+        std::string name;
+        std::vector<std::string> prefixes;  // broadcast mode when non-empty
+        std::atomic<bool> broadcast{false};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::string> queue;
+        bool flush = false;
+        std::atomic<int64_t> lastSeenMs{0};
+        std::atomic<int> polling{0};
+    };
+
+    static constexpr size_t kStripes = 64;
+
+    // One client that may cache one key
+    struct Entry {
+        uint32_t client;
+        std::string key;
+    };
+
+    std::shared_ptr<Client> findOrCreate(const std::string& clientId, bool& created);
+    std::shared_ptr<Client> find(uint32_t id) const;
+    void enqueue(Client& client, const std::string& key);
+    void flushClient(Client& client);
+    void evictSlot();
+    void expireIdle(int64_t now);
+    static int64_t nowMs();
+
+    const Options options_;
+
+    // Slot table, guarded by stripe locks (slot % kStripes)
+    std::vector<std::vector<Entry>> slotEntries_;
+    std::array<std::mutex, kStripes> stripes_;
+    std::atomic<size_t> entries_{0};
+    std::atomic<size_t> evictCursor_{0};
+
+    mutable std::shared_mutex clientsMutex_;
+    std::unordered_map<std::string, uint32_t> clientIds_;
+    std::unordered_map<uint32_t, std::shared_ptr<Client>> clients_;
+    std::vector<std::shared_ptr<Client>> broadcastClients_;
+    uint32_t nextClientId_ = 1;
+    std::atomic<size_t> clientCount_{0};
+    std::atomic<int64_t> lastSweepMs_{0};
+};
+
+#endif // INVALIDATION_H
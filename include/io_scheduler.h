@@ -0,0 +1,85 @@
+#ifndef IO_SCHEDULER_H
+#define IO_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Shares disk bandwidth between foreground commits and background writers.
+// Snapshots, spill writes and compaction, and backups take tokens from one
+// bucket before each chunk they write or read; when the bucket is empty
+// they sleep. Foreground writes (WAL appends, blob puts) never wait here.
+//
+// The refill rate follows the WAL's group-commit fsync latency, which the
+// WAL reports after every fsync: while the smoothed latency stays under
+// the target the rate grows by a sixteenth of maxBytesPerSecond every
+// adjustment interval, and each interval it is over the target the rate
+// halves, down to minBytesPerSecond. Without commits there is nothing to
+// protect, so the rate also grows while no fsync has been reported for ten
+// intervals. A checkpoint on a shared disk therefore runs as fast as it can
+// without making commits wait on it.
+//
+// The target defaults to 3x the idle fsync latency, the minimum seen while
+// no background I/O was running (allowed to creep up only then), and is
+// never below 2ms so noise on fast devices doesn't throttle anything.
+class IoScheduler {
+public:
+    struct Options {
+        uint64_t maxBytesPerSecond = 256u << 20;
+        uint64_t minBytesPerSecond = 4u << 20;
+        std::chrono::microseconds latencyTarget{0};  // 0 = derive from the idle latency
+        std::chrono::milliseconds adjustInterval{100};
+        bool adaptive = true;  // false = fixed at maxBytesPerSecond
+    };
+
+    struct Stats {
+        uint64_t bytesPerSecond = 0;       // current refill rate
+        uint64_t syncLatencyUs = 0;        // smoothed WAL fsync latency
+        uint64_t latencyTargetUs = 0;
+        uint64_t bytes = 0;                // granted to background I/O
+        uint64_t throttledMicros = 0;      // spent waiting for tokens
+        uint64_t decreases = 0;            // rate cuts
+    };
+
+    explicit IoScheduler(const Options& options);
+
+    IoScheduler(const IoScheduler&) = delete;
+    IoScheduler& operator=(const IoScheduler&) = delete;
+
+    // Block until bytes of background I/O may proceed
+    void acquire(uint64_t bytes);
+
+    // Feed one WAL fsync duration; may adjust the rate
+    void recordSyncLatency(std::chrono::microseconds latency);
+
+    Stats stats() const;
+
+    // Start writeback of [offset, offset + bytes) of fd without waiting for
+    // it, so a long background write reaches the disk at the paced rate
+    // instead of as one burst at its final fsync. No-op off Linux.
+    static void startWriteback(int fd, uint64_t offset, uint64_t bytes);
+
+    // Largest single grant; bigger requests are paid in pieces
+    static constexpr uint64_t kMaxGrant = 1u << 20;
+
+private:
+    void refillLocked(std::chrono::steady_clock::time_point now);
+    std::chrono::microseconds targetLocked() const;
+    void increaseLocked();
+
+    Options options_;
+    mutable std::mutex mutex_;
+    double rate_;     // bytes per second
+    double tokens_;   // negative while callers sleep off a debt
+    std::chrono::steady_clock::time_point refilled_;
+    std::chrono::steady_clock::time_point adjusted_;
+    std::chrono::steady_clock::time_point sampled_;  // last fsync sample
+    std::chrono::steady_clock::time_point granted_;  // last background grant
+    double latencyUs_ = 0;    // smoothed
+    double baselineUs_ = 0;   // idle latency, 0 until the first sample
+    uint64_t bytes_ = 0;
+    uint64_t throttledMicros_ = 0;
+    uint64_t decreases_ = 0;
+};
+
+#endif // IO_SCHEDULER_H
@@ -0,0 +1,118 @@
+#ifndef KEYSPACE_STATS_H
+#define KEYSPACE_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Distinct-count sketch: 2^precision one-byte registers, about
+// 1.04 / sqrt(2^precision) relative error (1.6% at the default 12).
+// Two sketches of the same precision merge into the sketch of the union.
+class HyperLogLog {
+public:
+    explicit HyperLogLog(uint8_t precision = 12);
+
+    // hash must be well mixed, e.g. from KeyspaceStats::hashValue()
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+
+private:
+    uint8_t precision_;
+    std::vector<uint8_t> registers_;
+};
+
+// Quantile sketch (merging t-digest). Keeps about `compression` centroids,
+// small near the tails and large around the median, so extreme quantiles
+// stay accurate. Values are buffered and folded in when the buffer fills
+// or a quantile is asked for.
+class TDigest {
+public:
+    explicit TDigest(double compression = 100);
+
+    void add(double value, double weight = 1);
+    void merge(const TDigest& other);
+    // q in [0, 1]; 0 when empty
+    double quantile(double q) const;
+    double count() const { return total_; }
+    double max() const { return max_; }
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void flush() const;
+
+    double compression_;
+    mutable std::vector<Centroid> centroids_;
+    mutable std::vector<Centroid> buffer_;
+    double total_ = 0;
+    double min_ = 0;
+    double max_ = 0;
+};
+
+// Per-prefix keyspace statistics, kept up to date by KVStore as keys are
+// written, removed, spilled and reloaded, so reporting them never walks the
+// store. A key's prefix is everything before the first delimiter ("user"
+// for "user:42"); keys without one share the prefix "". Past maxPrefixes
+// distinct prefixes, new ones are counted under "(other)".
+//
+// Key counts are exact (resident + spilled). The sketches only ever grow,
+// since neither can forget a value: distinct values and value sizes cover
+// every version written under the prefix since startup, replay included,
+// and the history-length digest records a key's history length after each
+// write, i.e. the lengths of the chains that writes land on.
+class KeyspaceStats {
+public:
+    struct Options {
+        char delimiter = ':';
+        size_t maxPrefixes = 256;
+    };
+
+    struct Group {
+        uint64_t keys = 0;       // resident and spilled
+        uint64_t resident = 0;   // in memory
+        uint64_t writes = 0;
+        HyperLogLog distinctValues;
+        TDigest valueBytes;
+        TDigest historyLength;
+    };
+
+    static constexpr const char* kOtherPrefix = "(other)";
+
+    explicit KeyspaceStats(const Options& options);
+
+    static uint64_t hashValue(std::string_view value);
+    std::string prefixOf(std::string_view key) const;
+
+    // A version of valueBytes bytes was written to key, leaving length
+    // versions; added if the key didn't exist before
+    void recordWrite(std::string_view key, uint64_t valueHash, size_t valueBytes,
+                     size_t length, bool added);
+    // key moved to (resident = false) or back from the spill file
+    void recordResident(std::string_view key, bool resident);
+    // key is gone, from memory if resident and from the spill file otherwise
+    void recordRemoved(std::string_view key, bool resident);
+
+    // Copy of every group, by prefix
+    std::map<std::string, Group> snapshot() const;
+    // The groups of a snapshot merged into one
+    static Group total(const std::map<std::string, Group>& groups);
+    const Options& options() const { return options_; }
+
+private:
+    Group& groupLocked(std::string_view key);
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Group, std::less<>> groups_;
+};
+
+#endif // KEYSPACE_STATS_H
@@ -8,22 +8,16 @@
 #include <memory>
 #include <chrono>
 #include <list>
+#include <functional>
 #include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
 #include "status.h"
 #include "wal.h"
 #include "guard.h"
-
-// Represents a versioned value with timestamp
-struct Version {
-    std::chrono::system_clock::time_point timestamp;
-    std::string value;
-    
-    Version(const std::string& val) 
-        : timestamp(std::chrono::system_clock::now()), value(val) {}
-    
-    Version(std::chrono::system_clock::time_point ts, const std::string& val)
-        : timestamp(ts), value(val) {}
-};
+#include "version_chain.h"
 
 // Retention policy modes
 enum class RetentionMode {
@@ -57,9 +51,63 @@ struct ExplainResult {
     size_t totalVersions;
 };
 
+// A committed change delivered to key watchers
+struct KeyChange {
+    std::string key;
+    bool deleted;
+    std::string value;  // empty for deletes
+    std::chrono::system_clock::time_point timestamp;
+    bool prefix = false;  // change listeners only: every key under `key` was deleted
+};
+
+// Prefix delete that has been logged but not yet physically applied. Every
+// version of a matching key at or before timestamp is hidden from reads.
+struct RangeTombstone {
+    std::string prefix;
+    std::chrono::system_clock::time_point timestamp;
+};
+
+// A place in a merged timeline (KVStore::visitTimeline): versions are
+// ordered by timestamp, then key, then by ordinal, their position among
+// the key's versions with that same timestamp
+struct TimelinePosition {
+    std::chrono::system_clock::time_point timestamp;
+    std::string key;
+    size_t ordinal = 0;
+};
+
+using KeyWatcher = std::function<void(const KeyChange&)>;
+
+class SpillStore;
+class BlobStore;
+class KeyspaceStats;
+
+// Cumulative LRU eviction counters
+struct EvictionStats {
+    uint64_t evictedKeys = 0;      // all evictions
+    uint64_t passes = 0;           // background batches
+    uint64_t inlineEvictions = 0;  // keys evicted by a writer that outran the background
+};
+
+// One write of KVStore::setBatch(). status is OK once it is applied, or
+// INVALID_COMMAND with reason if a guard refused it.
+struct BatchWrite {
+    std::string key;
+    std::string value;
+    Status status = Status::OK;
+    std::string reason;
+};
+
+// Work done by KVStore::defragStep(), accumulated across steps
+struct DefragProgress {
+    size_t keysVisited = 0;
+    size_t keysCompacted = 0;    // keys that gave memory back
+    uint64_t bytesReclaimed = 0;  // container slack released
+};
+
 class KVStore {
 private:
-    std::unordered_map<std::string, std::vector<Version>> store;
+    std::unordered_map<std::string, VersionChain> store;
     std::shared_ptr<WAL> wal;
     bool walEnabled;
     RetentionPolicy retentionPolicy;
@@ -67,18 +115,104 @@ private:
     DecisionPolicy decisionPolicy;  // Active decision policy for guard violations
     mutable std::shared_mutex rwMutex_;
 
-    // Internal set implementation for already-locked callers
-    Status setInternal(const std::string& key, const std::string& value);
+    // Internal set implementation for already-locked callers; reports the
+    // version timestamp it assigned. With blobRef, value is already in the
+    // blob store and only the reference is logged and kept.
+    Status setInternal(const std::string& key, const std::string& value,
+                       std::chrono::system_clock::time_point& timestamp,
+                       const std::string* blobRef = nullptr);
+    // set()/commitSet(): blob write, locked set, then watchers
+    Status writeValue(const std::string& key, const std::string& value);
+    // A write timestamp after every prefix delete; callers hold the write lock
+    std::chrono::system_clock::time_point nextTimestampLocked() const;
+    // Add version to key's history (reloading it if spilled), then apply
+    // retention and LRU; callers hold the write lock and have logged it
+    void appendLocked(const std::string& key, Version version);
+
+    // One-shot key watchers, fired after the write lock is released
+    mutable std::mutex watchMutex_;
+    std::unordered_map<std::string, std::vector<std::pair<uint64_t, KeyWatcher>>> watchers_;
+    std::unordered_map<uint64_t, std::string> watchKeys_;
+    uint64_t nextWatchId_{1};
+    std::atomic<size_t> watcherCount_{0};
+    // Persistent listeners, registered before the store is shared
+    std::vector<KeyWatcher> listeners_;
+    void notifyWatchers(const std::string& key, bool deleted, const std::string& value,
+                        std::chrono::system_clock::time_point timestamp);
+    void notifyPrefixDeleted(const std::string& prefix,
+                             std::chrono::system_clock::time_point timestamp);
+
+    // Range tombstones awaiting reclamation, oldest first (guarded by
+    // rwMutex_). Writes are never stamped at or before the newest one, so a
+    // key re-created after a prefix delete stays visible.
+    std::vector<RangeTombstone> tombstones_;
+    std::chrono::system_clock::time_point lastTombstone_{};
+    // Index of the first version of key not covered by a tombstone (size()
+    // if none); callers hold rwMutex_
+    size_t firstVisible(const std::string& key, const VersionChain& versions) const;
+    // Newest tombstone covering key, or nullptr
+    const RangeTombstone* coveringTombstone(const std::string& key) const;
+    void dropHidden(const std::string& key, VersionChain& versions);
+    void eraseKeyInternal(const std::string& key);
+
+    // Background reclaimer for tombstones and LRU eviction, started the
+    // first time either has work
+    std::thread reclaimer_;
+    std::mutex reclaimMutex_;
+    std::mutex reclaimPassMutex_;
+    std::condition_variable reclaimCv_;
+    bool reclaimPending_{false};
+    bool evictPending_{false};
+    bool reclaimStop_{false};
+    std::atomic<bool> evictScheduled_{false};  // cheap check for writers
+    // Blob collection is coalesced to at most one pass per kBlobGcInterval
+    bool blobGcPending_{false};
+    std::atomic<bool> blobGcScheduled_{false};
+    std::chrono::steady_clock::time_point nextBlobGc_{};
+    void wakeReclaimer(bool tombstones);
+    void wakeBlobCollector();
+    void reclaimLoop();
 
     // Internal helper for already-locked callers
     std::vector<std::shared_ptr<Guard>> getGuardsForKeyInternal(const std::string& key) const;
 
-    // LRU eviction
+    // Disk tier for evicted keys; reads of a spilled key reload it
+    std::shared_ptr<SpillStore> spill_;
+    // Find key for a reader, reloading it from the spill tier if needed.
+    // May drop and re-take the shared lock.
+    std::unordered_map<std::string, VersionChain>::const_iterator
+    findLocked(const std::string& key, std::shared_lock<std::shared_mutex>& lock) const;
+    bool reloadSpilled(const std::string& key);
+    // Pull a spilled key back in before writing it; callers hold the write lock
+    void loadSpilledLocked(const std::string& key);
+
+    // Large values, by reference; reads resolve them under the shared lock
+    std::shared_ptr<BlobStore> blobs_;
+    std::optional<std::string> valueOf(const Version& version) const;
+    // Replace blob references with their values, dropping unreadable ones
+    void resolveBlobs(std::vector<Version>& versions) const;
+
+    // Per-prefix key counts and sketches, updated under the write lock
+    std::shared_ptr<KeyspaceStats> keyspace_;
+    // version was just written to key, leaving its chain length versions long
+    void recordWriteStats(const std::string& key, const Version& version, size_t length,
+                          bool added);
+
+    // LRU eviction between a high (maxKeys_) and low watermark
     size_t maxKeys_{100000};
+    size_t evictLowWatermark_{90000};
     std::list<std::string> lruOrder_;
     std::unordered_map<std::string, std::list<std::string>::iterator> lruMap_;
+    std::atomic<uint64_t> evictedKeys_{0};
+    std::atomic<uint64_t> evictionPasses_{0};
+    std::atomic<uint64_t> inlineEvictions_{0};
+    // Evictions not yet reported by the sampled log line
+    std::atomic<uint64_t> unloggedEvictions_{0};
+    std::chrono::steady_clock::time_point lastEvictionLog_{};
     void touchKey(const std::string& key);
     void evictIfNeeded();
+    size_t evictLruLocked(size_t count, std::string& sample);
+    void evictToLowWatermark();
     
     // Apply retention policy to a key's versions
     void applyRetention(const std::string& key);
@@ -92,6 +226,10 @@ private:
 public:
     // Constructor with optional WAL
     explicit KVStore(std::shared_ptr<WAL> walPtr = nullptr);
+    ~KVStore();
+
+    KVStore(const KVStore&) = delete;
+    KVStore& operator=(const KVStore&) = delete;
     
     // Set a key-value pair (creates version with current timestamp)
     Status set(const std::string& key, const std::string& value);
@@ -100,12 +238,69 @@ public:
     Status setAtTime(const std::string& key, const std::string& value,
                      std::chrono::system_clock::time_point timestamp);
     
+    // Replay a value held in the blob store (a SETREF record or snapshot
+    // line). NOT_FOUND, and nothing is stored, if the blob's file has been
+    // collected: the version was already unreachable when that happened.
+    Status setRefAtTime(const std::string& key, const std::string& ref,
+                        std::chrono::system_clock::time_point timestamp);
+    
+    // Keys of one snapshot partition, assembled by a loader thread without
+    // the store's lock: the index and LRU nodes are allocated and hashed
+    // there, so merging a batch in is mostly relinking nodes.
+    class LoadBatch {
+    public:
+        void reserve(size_t keys);
+        void add(std::string key, std::string value,
+                 std::chrono::system_clock::time_point timestamp);
+        size_t size() const { return chains_.size(); }
+
+    private:
+        friend class KVStore;
+        std::unordered_map<std::string, VersionChain> chains_;
+        std::list<std::string> order_;
+        std::unordered_map<std::string, std::list<std::string>::iterator> lru_;
+    };
+    
+    // Replay a batch, as setAtTime() would each of its values, and leave it
+    // empty. Keys already in the store, watched keys and keys under a
+    // pending prefix delete take the setAtTime() path.
+    void mergeLoadBatch(LoadBatch& batch);
+    
     // Get a value by key
     std::optional<std::string> get(const std::string& key);
     
+    // Latest values of many keys, in order, under one shared lock. Keys are
+    // probed `group` at a time: every key in a group is hashed and its
+    // bucket, node and version chain prefetched a stage before it is
+    // read, so the cache misses of a group overlap instead of stalling one
+    // after another. group = 1 probes key by key. Spilled keys are reloaded
+    // after the batch, as get() would.
+    static constexpr size_t kProbeGroup = 16;
+    std::vector<std::optional<std::string>> multiGet(const std::vector<std::string>& keys,
+                                                     size_t group = kProbeGroup);
+    
     // Delete a key
     Status del(const std::string& key);
     
+    // Delete every key starting with prefix. Logs one WAL record and hides
+    // the keys from all reads (including temporal ones) at once; their
+    // versions are freed later by a background thread. Keys written after
+    // the call are unaffected. INVALID_COMMAND for an empty prefix.
+    Status delPrefix(const std::string& prefix);
+    
+    // Apply a logged prefix delete (for replay - not logged, and applied
+    // immediately since nothing is reading yet)
+    Status delPrefixAtTime(const std::string& prefix,
+                           std::chrono::system_clock::time_point timestamp);
+    
+    // Physically remove everything covered by the current range tombstones.
+    // Runs in the background after delPrefix(); callable directly to finish
+    // the work synchronously. Returns the number of keys removed.
+    size_t reclaimTombstones();
+    
+    // Number of prefix deletes not yet reclaimed
+    size_t pendingTombstones() const;
+    
     // Get value at or before a specific timestamp
     std::optional<std::string> getAtTime(const std::string& key, 
                                           std::chrono::system_clock::time_point timestamp);
@@ -117,14 +312,73 @@ public:
     // Get all versions of a key
     std::vector<Version> getHistory(const std::string& key);
     
+    // Zero-copy read access. The visitor runs while the shared lock is held,
+    // so the referenced data is only valid inside the callback and the
+    // visitor must not call back into the store.
+    bool visitLatest(const std::string& key,
+                     const std::function<void(const std::string&)>& visitor) const;
+    bool visitAtTime(const std::string& key, std::chrono::system_clock::time_point timestamp,
+                     const std::function<void(const Version&)>& visitor) const;
+    size_t visitHistory(const std::string& key,
+                        const std::function<void(const Version&)>& visitor) const;
+    
+    // Call watcher once, on the next set or delete of key. It runs on the
+    // writing thread after the store lock is released, so it may read the
+    // store but should return quickly. Returns an id for unwatchKey().
+    uint64_t watchKey(const std::string& key, KeyWatcher watcher);
+    
+    // Cancel a pending watch; false if it already fired or never existed
+    bool unwatchKey(uint64_t id);
+    
+    // Call listener for every set and delete, like a watcher that never
+    // expires. Not thread-safe: register during setup, before other threads
+    // use the store.
+    void addChangeListener(KeyWatcher listener);
+    
     // Check if key exists
     bool exists(const std::string& key) const;
     
-    // Get the number of keys
+    // Get the number of keys, in memory and spilled. Keys hidden by a
+    // pending prefix delete are counted until they are reclaimed.
     size_t size() const;
     
-    // Get all data (for snapshot creation) - returns latest version of each key
-    std::unordered_map<std::string, std::string> getAllData() const;
+    // Keys currently held in memory (excludes spilled keys)
+    size_t residentKeys() const;
+    
+    // Get all data (for snapshot creation) - returns latest version of each key.
+    // With blobRefs, keys whose latest value is a blob go there as references
+    // instead of being read back. With lsn, the WAL's last LSN as of the copy:
+    // the store logs its writes under the write lock, so the data holds
+    // exactly the records up to it.
+    std::unordered_map<std::string, std::string> getAllData(
+        std::unordered_map<std::string, std::string>* blobRefs = nullptr,
+        uint64_t* lsn = nullptr) const;
+    
+    // Keys starting with prefix, in memory and spilled, copied under one
+    // shared lock so a background job can walk the store in batches
+    std::vector<std::string> listKeys(const std::string& prefix = "") const;
+    
+    // Visible versions of each key stamped in [from, through], in key order
+    // and then time order, under one shared lock. Spilled keys are read
+    // without being reloaded; blob values are resolved. visitor runs with
+    // the lock held. Returns the number of versions visited.
+    size_t visitVersions(const std::vector<std::string>& keys,
+                         std::chrono::system_clock::time_point from,
+                         std::chrono::system_clock::time_point through,
+                         const std::function<void(const std::string&, const Version&)>& visitor) const;
+    
+    // Up to limit visible versions of keys stamped in [from, through], all
+    // keys merged into one stream in TimelinePosition order, starting after
+    // `after` if given. Each key's chain is binary-searched to its first
+    // version in the window and a heap merges the chains, so memory grows
+    // with the number of keys, not with their histories (a spilled key's
+    // versions in the window are read in whole). Runs under one shared lock
+    // with the visitor, as visitVersions() does. Returns where to resume,
+    // or nullopt once the window is exhausted.
+    std::optional<TimelinePosition> visitTimeline(
+        std::vector<std::string> keys, std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point through, const TimelinePosition* after, size_t limit,
+        const std::function<void(const std::string&, const Version&)>& visitor) const;
     
     // Disable/enable WAL temporarily (for replay)
     void setWalEnabled(bool enabled);
@@ -135,9 +389,46 @@ public:
     // Get current retention policy
     const RetentionPolicy& getRetentionPolicy() const;
 
-    // Set/get maximum number of keys before LRU eviction
+    // Set/get maximum number of keys before LRU eviction. Crossing it wakes
+    // a background pass that evicts least recently written keys in batches
+    // down to the low watermark (90% of maxKeys unless set explicitly).
+    // Writers only evict inline if they outrun the background pass by more
+    // than high - low keys.
     void setMaxKeys(size_t maxKeys);
     size_t getMaxKeys() const;
+    void setEvictionWatermarks(size_t high, size_t low);
+    
+    // Spill evicted keys, with their full history, to disk instead of
+    // dropping them. Not thread-safe: call during setup, before replay.
+    void setSpillStore(std::shared_ptr<SpillStore> spill);
+    std::shared_ptr<SpillStore> getSpillStore() const;
+    size_t getEvictionLowWatermark() const;
+    
+    // Keep values of at least blobs->threshold() bytes in a blob store, by
+    // reference. Not thread-safe: call during setup, before replay.
+    void setBlobStore(std::shared_ptr<BlobStore> blobs);
+    std::shared_ptr<BlobStore> getBlobStore() const;
+    
+    // Maintain per-prefix keyspace statistics as keys come and go. Not
+    // thread-safe: call during setup, before replay.
+    void setKeyspaceStats(std::shared_ptr<KeyspaceStats> stats);
+    std::shared_ptr<KeyspaceStats> getKeyspaceStats() const;
+    
+    // Delete sealed blob files that no in-memory or spilled version refers
+    // to. Runs in the background after blob files fill up, deletes and
+    // evictions; callable directly. Returns the bytes freed.
+    uint64_t collectBlobGarbage();
+    EvictionStats evictionStats() const;
+    
+    // Incremental defragmentation for a background defragmenter. Compacts
+    // the version chains of keys in the index buckets from cursor on, up to
+    // maxKeys keys under one short write lock, and advances cursor. Returns
+    // false once the walk has passed the last bucket.
+    bool defragStep(size_t& cursor, size_t maxKeys, DefragProgress& progress);
+    
+    // Rehash the key index and LRU map down when deletes and evictions left
+    // most of their buckets empty. Returns the bucket bytes released.
+    uint64_t shrinkIndexes();
     
     // ========== Write Evaluation & Guard Management ==========
     
@@ -147,6 +438,12 @@ public:
     // Commit a write (after proposal accepted or user override)
     Status commitSet(const std::string& key, const std::string& value);
     
+    // Write many values at once, as set() would one by one, except that a
+    // write its guards don't accept outright is skipped and marked in its
+    // status. The batch takes the write lock once and is logged with one
+    // WAL append. Returns how many writes were applied.
+    size_t setBatch(std::vector<BatchWrite>& writes);
+    
     // Add a guard constraint
     void addGuard(std::shared_ptr<Guard> guard);
     
@@ -0,0 +1,102 @@
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class KVStore;
+
+// Watches the server's cgroup v2 memory limit (memory.max), usage
+// (memory.current) and PSI memory pressure (memory.pressure) and adapts
+// before the kernel OOM-kills the process:
+//
+//   NORMAL    watermarks drift back to their configured values, 10% a tick
+//   ELEVATED  the key limit shrinks 5% below the resident key count per
+//             tick, so cold keys spill; values over 64 KB are refused
+//   CRITICAL  the key limit shrinks 20% per tick; values over 4 KB are refused
+//
+// A level is entered on the first sample that crosses its thresholds and
+// left only after five calm samples in a row, so the server doesn't
+// oscillate around a threshold. Outside a cgroup (or under cgroup v1)
+// usage falls back to the process RSS, and the limit must be given.
+class MemoryMonitor {
+public:
+    enum class Level { NORMAL = 0, ELEVATED = 1, CRITICAL = 2 };
+
+    struct Options {
+        std::string cgroupDir;        // empty = discover from /proc/self/cgroup
+        uint64_t limitBytes = 0;      // 0 = read memory.max
+        std::chrono::milliseconds interval{1000};
+        double elevatedRatio = 0.75;  // usage / limit
+        double criticalRatio = 0.90;
+        double elevatedPsi = 10.0;    // "some" avg10, percent of time stalled
+        double criticalPsi = 25.0;
+        size_t minKeys = 1000;        // never shrink the key limit below this
+        size_t elevatedMaxValue = 64 * 1024;
+        size_t criticalMaxValue = 4 * 1024;
+    };
+
+    struct Sample {
+        uint64_t usage = 0;
+        uint64_t limit = 0;  // 0 = unlimited
+        double someAvg10 = 0.0;
+        double fullAvg10 = 0.0;
+        bool havePsi = false;
+    };
+
+    MemoryMonitor(std::shared_ptr<KVStore> store, const Options& options);
+    ~MemoryMonitor();
+
+    MemoryMonitor(const MemoryMonitor&) = delete;
+    MemoryMonitor& operator=(const MemoryMonitor&) = delete;
+
+    // Start sampling. False (and nothing started) if neither a cgroup limit
+    // nor a configured limit nor PSI is available.
+    bool start();
+    void stop();
+
+    // Take one sample and adapt; start() calls this every interval
+    void tick();
+
+    Level level() const { return static_cast<Level>(level_.load(std::memory_order_relaxed)); }
+
+    // False if a value of this size should be refused right now (counted)
+    bool admitWrite(size_t valueBytes);
+
+    const std::string& cgroupDir() const { return cgroupDir_; }
+
+    static const char* levelName(Level level);
+    static bool parsePressure(const std::string& text, double& someAvg10, double& fullAvg10);
+    // Resident set size of this process from /proc/self/statm (0 if unknown)
+    static uint64_t processRss();
+
+private:
+    bool readSample(Sample& sample) const;
+    Level classify(const Sample& sample) const;
+    void adapt(Level level);
+    void run();
+
+    std::shared_ptr<KVStore> store_;
+    Options options_;
+    std::string cgroupDir_;
+    size_t baseHigh_ = 0;
+    size_t baseLow_ = 0;
+
+    std::atomic<int> level_{0};
+    std::atomic<size_t> maxValueBytes_{0};  // 0 = unlimited
+    int calmSamples_ = 0;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+};
+
+#endif // MEMORY_MONITOR_H
@@ -6,8 +6,11 @@
 #include <sstream>
 #include <chrono>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include <mutex>
 #include <iomanip>
+#include <cmath>
 
 class Metrics {
 public:
@@ -37,6 +40,137 @@ public:
         activeKeys_.store(count, std::memory_order_relaxed);
     }
 
+    void recordCompression(size_t bytesIn, size_t bytesOut) {
+        compressedResponses_.fetch_add(1, std::memory_order_relaxed);
+        compressionBytesIn_.fetch_add(bytesIn, std::memory_order_relaxed);
+        compressionBytesOut_.fetch_add(bytesOut, std::memory_order_relaxed);
+    }
+
+    void recordCompressionSkipped() {
+        compressionSkipped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordInvalidations(size_t count) {
+        invalidationsSent_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void recordInvalidationFlush() {
+        invalidationFlushes_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void setTrackingState(size_t clients, size_t entries) {
+        trackingClients_.store(clients, std::memory_order_relaxed);
+        trackingEntries_.store(entries, std::memory_order_relaxed);
+    }
+
+    void setEvictionState(uint64_t evictedKeys, uint64_t passes, uint64_t inlineEvictions) {
+        evictedKeys_.store(evictedKeys, std::memory_order_relaxed);
+        evictionPasses_.store(passes, std::memory_order_relaxed);
+        inlineEvictions_.store(inlineEvictions, std::memory_order_relaxed);
+    }
+
+    void setSpillState(size_t keys, uint64_t fileBytes, uint64_t spilled, uint64_t reloaded) {
+        spillKeys_.store(keys, std::memory_order_relaxed);
+        spillFileBytes_.store(fileBytes, std::memory_order_relaxed);
+        spilledKeys_.store(spilled, std::memory_order_relaxed);
+        reloadedKeys_.store(reloaded, std::memory_order_relaxed);
+    }
+
+    void setBlobState(size_t files, uint64_t diskBytes, uint64_t writtenBytes,
+                      uint64_t reclaimedBytes, uint64_t readErrors) {
+        blobFiles_.store(files, std::memory_order_relaxed);
+        blobDiskBytes_.store(diskBytes, std::memory_order_relaxed);
+        blobWrittenBytes_.store(writtenBytes, std::memory_order_relaxed);
+        blobReclaimedBytes_.store(reclaimedBytes, std::memory_order_relaxed);
+        blobReadErrors_.store(readErrors, std::memory_order_relaxed);
+    }
+
+    void setIoState(uint64_t bytesPerSecond, uint64_t syncLatencyUs, uint64_t targetUs,
+                    uint64_t bytes, uint64_t throttledMicros, uint64_t decreases) {
+        ioRate_.store(bytesPerSecond, std::memory_order_relaxed);
+        walSyncLatencyUs_.store(syncLatencyUs, std::memory_order_relaxed);
+        ioLatencyTargetUs_.store(targetUs, std::memory_order_relaxed);
+        ioBytes_.store(bytes, std::memory_order_relaxed);
+        ioThrottledMicros_.store(throttledMicros, std::memory_order_relaxed);
+        ioRateDecreases_.store(decreases, std::memory_order_relaxed);
+        ioScheduled_.store(true, std::memory_order_relaxed);
+    }
+
+    void setMemoryState(uint64_t limitBytes, uint64_t usageBytes, double someAvg10,
+                        double fullAvg10, int level, size_t highWatermark) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        memoryLimitBytes_ = limitBytes;
+        memoryUsageBytes_ = usageBytes;
+        memoryPressureSome_ = someAvg10;
+        memoryPressureFull_ = fullAvg10;
+        memoryLevel_ = level;
+        evictionHighWatermark_ = highWatermark;
+        memoryMonitored_ = true;
+    }
+
+    void recordMemoryAdaptation(bool tightened) {
+        (tightened ? memoryTightened_ : memoryRelaxed_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void recordMemoryRejectedWrite() {
+        memoryRejectedWrites_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void setAllocatorState(uint64_t residentBytes, uint64_t allocatedBytes) {
+        residentBytes_.store(residentBytes, std::memory_order_relaxed);
+        allocatedBytes_.store(allocatedBytes, std::memory_order_relaxed);
+    }
+
+    void recordDefragPass(size_t keysCompacted, uint64_t containerBytes, uint64_t rssBytes) {
+        defragPasses_.fetch_add(1, std::memory_order_relaxed);
+        defragKeys_.fetch_add(keysCompacted, std::memory_order_relaxed);
+        defragContainerBytes_.fetch_add(containerBytes, std::memory_order_relaxed);
+        defragRssBytes_.fetch_add(rssBytes, std::memory_order_relaxed);
+    }
+
+    void recordReplicationTimeout() {
+        replicationTimeouts_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // One /ingest request's records and the batches they were applied in
+    void recordIngest(uint64_t applied, uint64_t failed, uint64_t batches) {
+        ingestApplied_.fetch_add(applied, std::memory_order_relaxed);
+        ingestFailed_.fetch_add(failed, std::memory_order_relaxed);
+        ingestBatches_.fetch_add(batches, std::memory_order_relaxed);
+    }
+
+    // A read whose min_lsn this replica didn't reach in time
+    void recordStaleRead(bool redirected) {
+        (redirected ? staleReadsRedirected_ : staleReadsRefused_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Per replica: address and the LSN it has acknowledged
+    void setReplicationState(size_t syncReplicas, bool semiSync, uint64_t lastLsn,
+                             const std::vector<std::pair<std::string, uint64_t>>& acked) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replicating_ = true;
+        syncReplicas_ = syncReplicas;
+        semiSync_ = semiSync;
+        replicationLastLsn_ = lastLsn;
+        replicaAckedLsn_ = acked;
+    }
+
+    // One prefix of the keyspace statistics; quantiles are p50, p90, p99
+    struct KeyspaceGauges {
+        std::string prefix;
+        uint64_t keys = 0;
+        uint64_t resident = 0;
+        uint64_t writes = 0;
+        double distinctValues = 0;
+        double valueBytes[3] = {};
+        double historyLength[3] = {};
+    };
+
+    void setKeyspaceState(std::vector<KeyspaceGauges> groups) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        keyspace_ = std::move(groups);
+    }
+
     std::string toPrometheusFormat() const {
         std::lock_guard<std::mutex> lock(mutex_);
         std::ostringstream ss;
@@ -71,6 +205,287 @@ public:
         ss << "sentineldb_active_keys_total "
            << activeKeys_.load(std::memory_order_relaxed) << "\n";
 
+        ss << "\n# HELP sentineldb_compressed_responses_total Responses sent with a content coding\n";
+        ss << "# TYPE sentineldb_compressed_responses_total counter\n";
+        ss << "sentineldb_compressed_responses_total "
+           << compressedResponses_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_compression_bytes_total Response bytes before and after compression\n";
+        ss << "# TYPE sentineldb_compression_bytes_total counter\n";
+        ss << "sentineldb_compression_bytes_total{stage=\"in\"} "
+           << compressionBytesIn_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_compression_bytes_total{stage=\"out\"} "
+           << compressionBytesOut_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_compression_skipped_total Responses sent uncompressed because the compression budget was exhausted\n";
+        ss << "# TYPE sentineldb_compression_skipped_total counter\n";
+        ss << "sentineldb_compression_skipped_total "
+           << compressionSkipped_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_tracking_clients Clients registered for cache invalidation\n";
+        ss << "# TYPE sentineldb_tracking_clients gauge\n";
+        ss << "sentineldb_tracking_clients "
+           << trackingClients_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_tracking_entries Client and key pairs held in the tracking table\n";
+        ss << "# TYPE sentineldb_tracking_entries gauge\n";
+        ss << "sentineldb_tracking_entries "
+           << trackingEntries_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_invalidations_total Key invalidations queued for clients\n";
+        ss << "# TYPE sentineldb_invalidations_total counter\n";
+        ss << "sentineldb_invalidations_total "
+           << invalidationsSent_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_invalidation_flushes_total Full cache flushes sent to clients (bound hit or unknown client)\n";
+        ss << "# TYPE sentineldb_invalidation_flushes_total counter\n";
+        ss << "sentineldb_invalidation_flushes_total "
+           << invalidationFlushes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_evicted_keys_total Keys dropped by LRU eviction\n";
+        ss << "# TYPE sentineldb_evicted_keys_total counter\n";
+        ss << "sentineldb_evicted_keys_total "
+           << evictedKeys_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_eviction_batches_total Background eviction batches run\n";
+        ss << "# TYPE sentineldb_eviction_batches_total counter\n";
+        ss << "sentineldb_eviction_batches_total "
+           << evictionPasses_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_inline_evictions_total Keys evicted by writers because background eviction fell behind\n";
+        ss << "# TYPE sentineldb_inline_evictions_total counter\n";
+        ss << "sentineldb_inline_evictions_total "
+           << inlineEvictions_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_spill_keys Keys currently held only in the spill file\n";
+        ss << "# TYPE sentineldb_spill_keys gauge\n";
+        ss << "sentineldb_spill_keys "
+           << spillKeys_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_spill_file_bytes Spill file size including dead records\n";
+        ss << "# TYPE sentineldb_spill_file_bytes gauge\n";
+        ss << "sentineldb_spill_file_bytes "
+           << spillFileBytes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_spill_transfers_total Keys moved between memory and the spill file\n";
+        ss << "# TYPE sentineldb_spill_transfers_total counter\n";
+        ss << "sentineldb_spill_transfers_total{direction=\"out\"} "
+           << spilledKeys_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_spill_transfers_total{direction=\"in\"} "
+           << reloadedKeys_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_blob_files Blob log files on disk\n";
+        ss << "# TYPE sentineldb_blob_files gauge\n";
+        ss << "sentineldb_blob_files "
+           << blobFiles_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_blob_disk_bytes Bytes in blob log files, live and dead\n";
+        ss << "# TYPE sentineldb_blob_disk_bytes gauge\n";
+        ss << "sentineldb_blob_disk_bytes "
+           << blobDiskBytes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_blob_written_bytes_total Value bytes written to blob logs\n";
+        ss << "# TYPE sentineldb_blob_written_bytes_total counter\n";
+        ss << "sentineldb_blob_written_bytes_total "
+           << blobWrittenBytes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_blob_reclaimed_bytes_total Bytes freed by deleting unreferenced blob logs\n";
+        ss << "# TYPE sentineldb_blob_reclaimed_bytes_total counter\n";
+        ss << "sentineldb_blob_reclaimed_bytes_total "
+           << blobReclaimedBytes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_blob_read_errors_total Blob reads that failed or failed their checksum\n";
+        ss << "# TYPE sentineldb_blob_read_errors_total counter\n";
+        ss << "sentineldb_blob_read_errors_total "
+           << blobReadErrors_.load(std::memory_order_relaxed) << "\n";
+
+        if (ioScheduled_.load(std::memory_order_relaxed)) {
+            ss << "\n# HELP sentineldb_io_rate_bytes_per_second Background I/O budget, set from WAL fsync latency\n";
+            ss << "# TYPE sentineldb_io_rate_bytes_per_second gauge\n";
+            ss << "sentineldb_io_rate_bytes_per_second "
+               << ioRate_.load(std::memory_order_relaxed) << "\n";
+
+            ss << "\n# HELP sentineldb_wal_fsync_latency_us Smoothed group-commit fsync latency\n";
+            ss << "# TYPE sentineldb_wal_fsync_latency_us gauge\n";
+            ss << "sentineldb_wal_fsync_latency_us "
+               << walSyncLatencyUs_.load(std::memory_order_relaxed) << "\n";
+
+            ss << "\n# HELP sentineldb_io_latency_target_us fsync latency above which background I/O slows down\n";
+            ss << "# TYPE sentineldb_io_latency_target_us gauge\n";
+            ss << "sentineldb_io_latency_target_us "
+               << ioLatencyTargetUs_.load(std::memory_order_relaxed) << "\n";
+
+            ss << "\n# HELP sentineldb_io_background_bytes_total Bytes of snapshot, spill and backup I/O granted\n";
+            ss << "# TYPE sentineldb_io_background_bytes_total counter\n";
+            ss << "sentineldb_io_background_bytes_total "
+               << ioBytes_.load(std::memory_order_relaxed) << "\n";
+
+            ss << "\n# HELP sentineldb_io_throttled_seconds_total Time background I/O waited for budget\n";
+            ss << "# TYPE sentineldb_io_throttled_seconds_total counter\n";
+            ss << "sentineldb_io_throttled_seconds_total "
+               << ioThrottledMicros_.load(std::memory_order_relaxed) / 1e6 << "\n";
+
+            ss << "\n# HELP sentineldb_io_rate_decreases_total Times slow fsyncs halved the background budget\n";
+            ss << "# TYPE sentineldb_io_rate_decreases_total counter\n";
+            ss << "sentineldb_io_rate_decreases_total "
+               << ioRateDecreases_.load(std::memory_order_relaxed) << "\n";
+        }
+
+        if (memoryMonitored_) {
+            ss << "\n# HELP sentineldb_memory_limit_bytes cgroup memory.max (0 = unlimited)\n";
+            ss << "# TYPE sentineldb_memory_limit_bytes gauge\n";
+            ss << "sentineldb_memory_limit_bytes " << memoryLimitBytes_ << "\n";
+
+            ss << "\n# HELP sentineldb_memory_usage_bytes cgroup memory.current (or RSS outside a cgroup)\n";
+            ss << "# TYPE sentineldb_memory_usage_bytes gauge\n";
+            ss << "sentineldb_memory_usage_bytes " << memoryUsageBytes_ << "\n";
+
+            ss << "\n# HELP sentineldb_memory_pressure_avg10 PSI memory stall percentage over 10s\n";
+            ss << "# TYPE sentineldb_memory_pressure_avg10 gauge\n";
+            ss << "sentineldb_memory_pressure_avg10{kind=\"some\"} " << std::fixed
+               << std::setprecision(2) << memoryPressureSome_ << "\n";
+            ss << "sentineldb_memory_pressure_avg10{kind=\"full\"} " << memoryPressureFull_ << "\n";
+
+            ss << "\n# HELP sentineldb_memory_pressure_level 0 normal, 1 elevated, 2 critical\n";
+            ss << "# TYPE sentineldb_memory_pressure_level gauge\n";
+            ss << "sentineldb_memory_pressure_level " << memoryLevel_ << "\n";
+
+            ss << "\n# HELP sentineldb_eviction_high_watermark Current LRU key limit\n";
+            ss << "# TYPE sentineldb_eviction_high_watermark gauge\n";
+            ss << "sentineldb_eviction_high_watermark " << evictionHighWatermark_ << "\n";
+        }
+
+        ss << "\n# HELP sentineldb_memory_adaptations_total Key limit changes made by the memory monitor\n";
+        ss << "# TYPE sentineldb_memory_adaptations_total counter\n";
+        ss << "sentineldb_memory_adaptations_total{action=\"tighten\"} "
+           << memoryTightened_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_memory_adaptations_total{action=\"relax\"} "
+           << memoryRelaxed_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_memory_rejected_writes_total Writes refused as too large under memory pressure\n";
+        ss << "# TYPE sentineldb_memory_rejected_writes_total counter\n";
+        ss << "sentineldb_memory_rejected_writes_total "
+           << memoryRejectedWrites_.load(std::memory_order_relaxed) << "\n";
+
+        uint64_t residentBytes = residentBytes_.load(std::memory_order_relaxed);
+        uint64_t allocatedBytes = allocatedBytes_.load(std::memory_order_relaxed);
+        if (residentBytes > 0) {
+            ss << "\n# HELP sentineldb_resident_bytes Process resident set size\n";
+            ss << "# TYPE sentineldb_resident_bytes gauge\n";
+            ss << "sentineldb_resident_bytes " << residentBytes << "\n";
+
+            ss << "\n# HELP sentineldb_allocator_allocated_bytes Heap bytes in use by the server\n";
+            ss << "# TYPE sentineldb_allocator_allocated_bytes gauge\n";
+            ss << "sentineldb_allocator_allocated_bytes " << allocatedBytes << "\n";
+
+            ss << "\n# HELP sentineldb_allocator_fragmentation_ratio Resident bytes per allocated byte\n";
+            ss << "# TYPE sentineldb_allocator_fragmentation_ratio gauge\n";
+            ss << "sentineldb_allocator_fragmentation_ratio " << std::fixed << std::setprecision(3)
+               << (allocatedBytes > 0 ? static_cast<double>(residentBytes) / allocatedBytes : 1.0)
+               << "\n";
+        }
+
+        ss << "\n# HELP sentineldb_defrag_passes_total Defragmentation passes run\n";
+        ss << "# TYPE sentineldb_defrag_passes_total counter\n";
+        ss << "sentineldb_defrag_passes_total "
+           << defragPasses_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_defrag_keys_total Keys whose version chains were compacted\n";
+        ss << "# TYPE sentineldb_defrag_keys_total counter\n";
+        ss << "sentineldb_defrag_keys_total "
+           << defragKeys_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_defrag_reclaimed_bytes_total Memory given back by defragmentation\n";
+        ss << "# TYPE sentineldb_defrag_reclaimed_bytes_total counter\n";
+        ss << "sentineldb_defrag_reclaimed_bytes_total{source=\"containers\"} "
+           << defragContainerBytes_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_defrag_reclaimed_bytes_total{source=\"rss\"} "
+           << defragRssBytes_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_replication_sync_timeouts_total Writes acknowledged without their replica quorum\n";
+        ss << "# TYPE sentineldb_replication_sync_timeouts_total counter\n";
+        ss << "sentineldb_replication_sync_timeouts_total "
+           << replicationTimeouts_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_replica_stale_reads_total Reads whose min_lsn the replica didn't reach in time\n";
+        ss << "# TYPE sentineldb_replica_stale_reads_total counter\n";
+        ss << "sentineldb_replica_stale_reads_total{outcome=\"redirected\"} "
+           << staleReadsRedirected_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_replica_stale_reads_total{outcome=\"refused\"} "
+           << staleReadsRefused_.load(std::memory_order_relaxed) << "\n";
+
+        if (replicating_) {
+            ss << "\n# HELP sentineldb_replication_semi_sync 1 while writes wait for replica acks, 0 async\n";
+            ss << "# TYPE sentineldb_replication_semi_sync gauge\n";
+            ss << "sentineldb_replication_semi_sync " << (semiSync_ ? 1 : 0) << "\n";
+
+            ss << "\n# HELP sentineldb_replication_sync_replicas Replica acks each write waits for\n";
+            ss << "# TYPE sentineldb_replication_sync_replicas gauge\n";
+            ss << "sentineldb_replication_sync_replicas " << syncReplicas_ << "\n";
+
+            ss << "\n# HELP sentineldb_replication_lag_records WAL records a replica has yet to acknowledge\n";
+            ss << "# TYPE sentineldb_replication_lag_records gauge\n";
+            for (const auto& [address, lsn] : replicaAckedLsn_) {
+                ss << "sentineldb_replication_lag_records{replica=\"" << address << "\"} "
+                   << (replicationLastLsn_ > lsn ? replicationLastLsn_ - lsn : 0) << "\n";
+            }
+        }
+
+        ss << "\n# HELP sentineldb_ingest_records_total Records received by /ingest\n";
+        ss << "# TYPE sentineldb_ingest_records_total counter\n";
+        ss << "sentineldb_ingest_records_total{outcome=\"applied\"} "
+           << ingestApplied_.load(std::memory_order_relaxed) << "\n";
+        ss << "sentineldb_ingest_records_total{outcome=\"failed\"} "
+           << ingestFailed_.load(std::memory_order_relaxed) << "\n";
+
+        ss << "\n# HELP sentineldb_ingest_batches_total Batches /ingest applied, each with one lock and one WAL append\n";
+        ss << "# TYPE sentineldb_ingest_batches_total counter\n";
+        ss << "sentineldb_ingest_batches_total " << ingestBatches_.load(std::memory_order_relaxed) << "\n";
+
+        if (!keyspace_.empty()) {
+            static const char* quantiles[] = {"0.5", "0.9", "0.99"};
+            ss << "\n# HELP sentineldb_keyspace_keys Keys by prefix, resident and spilled\n";
+            ss << "# TYPE sentineldb_keyspace_keys gauge\n";
+            for (const auto& group : keyspace_) {
+                ss << "sentineldb_keyspace_keys{prefix=\"" << escapeLabel(group.prefix) << "\"} "
+                   << group.keys << "\n";
+            }
+            ss << "\n# HELP sentineldb_keyspace_resident_keys Keys by prefix held in memory\n";
+            ss << "# TYPE sentineldb_keyspace_resident_keys gauge\n";
+            for (const auto& group : keyspace_) {
+                ss << "sentineldb_keyspace_resident_keys{prefix=\"" << escapeLabel(group.prefix)
+                   << "\"} " << group.resident << "\n";
+            }
+            ss << "\n# HELP sentineldb_keyspace_writes_total Versions written by prefix, replay included\n";
+            ss << "# TYPE sentineldb_keyspace_writes_total counter\n";
+            for (const auto& group : keyspace_) {
+                ss << "sentineldb_keyspace_writes_total{prefix=\"" << escapeLabel(group.prefix)
+                   << "\"} " << group.writes << "\n";
+            }
+            ss << "\n# HELP sentineldb_keyspace_distinct_values Estimated distinct values written by prefix\n";
+            ss << "# TYPE sentineldb_keyspace_distinct_values gauge\n";
+            for (const auto& group : keyspace_) {
+                ss << "sentineldb_keyspace_distinct_values{prefix=\"" << escapeLabel(group.prefix)
+                   << "\"} " << std::llround(group.distinctValues) << "\n";
+            }
+            ss << "\n# HELP sentineldb_keyspace_value_bytes Size quantiles of the values written by prefix\n";
+            ss << "# TYPE sentineldb_keyspace_value_bytes gauge\n";
+            for (const auto& group : keyspace_) {
+                for (int i = 0; i < 3; ++i) {
+                    ss << "sentineldb_keyspace_value_bytes{prefix=\"" << escapeLabel(group.prefix)
+                       << "\",quantile=\"" << quantiles[i] << "\"} " << group.valueBytes[i] << "\n";
+                }
+            }
+            ss << "\n# HELP sentineldb_keyspace_history_length Quantiles of the history length writes leave by prefix\n";
+            ss << "# TYPE sentineldb_keyspace_history_length gauge\n";
+            for (const auto& group : keyspace_) {
+                for (int i = 0; i < 3; ++i) {
+                    ss << "sentineldb_keyspace_history_length{prefix=\"" << escapeLabel(group.prefix)
+                       << "\",quantile=\"" << quantiles[i] << "\"} " << group.historyLength[i] << "\n";
+                }
+            }
+        }
+
         ss << "\n# HELP sentineldb_total_requests Total requests processed since startup\n";
         ss << "# TYPE sentineldb_total_requests counter\n";
         ss << "sentineldb_total_requests " << totalRequests_.load() << "\n";
@@ -83,6 +498,22 @@ private:
     Metrics(const Metrics&) = delete;
     Metrics& operator=(const Metrics&) = delete;
 
+    // Label values come from user keys
+    static std::string escapeLabel(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
     struct LatencyStats {
         uint64_t count = 0;
         double totalMs = 0.0;
@@ -94,6 +525,64 @@ private:
     std::atomic<size_t> walSizeBytes_;
     std::atomic<size_t> activeKeys_;
     std::atomic<uint64_t> totalRequests_;
+    std::atomic<uint64_t> compressedResponses_{0};
+    std::atomic<uint64_t> compressionBytesIn_{0};
+    std::atomic<uint64_t> compressionBytesOut_{0};
+    std::atomic<uint64_t> compressionSkipped_{0};
+    std::atomic<uint64_t> invalidationsSent_{0};
+    std::atomic<uint64_t> invalidationFlushes_{0};
+    std::atomic<size_t> trackingClients_{0};
+    std::atomic<size_t> trackingEntries_{0};
+    std::atomic<uint64_t> evictedKeys_{0};
+    std::atomic<uint64_t> evictionPasses_{0};
+    std::atomic<uint64_t> inlineEvictions_{0};
+    std::atomic<size_t> spillKeys_{0};
+    std::atomic<uint64_t> spillFileBytes_{0};
+    std::atomic<uint64_t> spilledKeys_{0};
+    std::atomic<uint64_t> reloadedKeys_{0};
+    std::atomic<size_t> blobFiles_{0};
+    std::atomic<uint64_t> blobDiskBytes_{0};
+    std::atomic<uint64_t> blobWrittenBytes_{0};
+    std::atomic<uint64_t> blobReclaimedBytes_{0};
+    std::atomic<uint64_t> blobReadErrors_{0};
+    std::atomic<bool> ioScheduled_{false};
+    std::atomic<uint64_t> ioRate_{0};
+    std::atomic<uint64_t> walSyncLatencyUs_{0};
+    std::atomic<uint64_t> ioLatencyTargetUs_{0};
+    std::atomic<uint64_t> ioBytes_{0};
+    std::atomic<uint64_t> ioThrottledMicros_{0};
+    std::atomic<uint64_t> ioRateDecreases_{0};
+    // Memory monitor state (guarded by mutex_)
+    bool memoryMonitored_ = false;
+    uint64_t memoryLimitBytes_ = 0;
+    uint64_t memoryUsageBytes_ = 0;
+    double memoryPressureSome_ = 0.0;
+    double memoryPressureFull_ = 0.0;
+    int memoryLevel_ = 0;
+    size_t evictionHighWatermark_ = 0;
+    std::atomic<uint64_t> memoryTightened_{0};
+    std::atomic<uint64_t> memoryRelaxed_{0};
+    std::atomic<uint64_t> memoryRejectedWrites_{0};
+    std::atomic<uint64_t> residentBytes_{0};
+    std::atomic<uint64_t> allocatedBytes_{0};
+    std::atomic<uint64_t> defragPasses_{0};
+    std::atomic<uint64_t> defragKeys_{0};
+    std::atomic<uint64_t> defragContainerBytes_{0};
+    std::atomic<uint64_t> defragRssBytes_{0};
+    std::atomic<uint64_t> replicationTimeouts_{0};
+    std::atomic<uint64_t> staleReadsRedirected_{0};
+    std::atomic<uint64_t> staleReadsRefused_{0};
+    std::atomic<uint64_t> ingestApplied_{0};
+    std::atomic<uint64_t> ingestFailed_{0};
+    std::atomic<uint64_t> ingestBatches_{0};
+    // Replication state (guarded by mutex_)
+    bool replicating_ = false;
+    size_t syncReplicas_ = 0;
+    bool semiSync_ = false;
+    uint64_t replicationLastLsn_ = 0;
+    std::vector<std::pair<std::string, uint64_t>> replicaAckedLsn_;
+    // Keyspace statistics by prefix (guarded by mutex_)
+    std::vector<KeyspaceGauges> keyspace_;
 };
 
 // RAII timer — records latency automatically on destruction
@@ -0,0 +1,42 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include "kvstore.h"
+#include "wal.h"
+
+// Rebuilds in-memory state from the snapshot and WAL on disk.
+// Shared by the CLI, the HTTP server and the embeddable library so that
+// every frontend restores exactly the same state.
+class Recovery {
+public:
+    // Replay snapshot first, then the WAL (policies and guards before data).
+    // WAL logging on the store is disabled for the duration of the replay.
+    // Returns the number of keys present after replay. Throws
+    // std::runtime_error if the snapshot manifest or any of its partitions
+    // fails its checksum; the caller must not serve (or checkpoint) the
+    // partial state.
+    static size_t replay(KVStore& store, WAL& wal);
+
+    // Apply one WAL record to the store without logging it (the store's
+    // WAL must be off, as it is during replay). NOT_FOUND for a SETREF whose
+    // blob was collected; INVALID_COMMAND for a record type it doesn't know.
+    static Status applyRecord(KVStore& store, const std::string& record);
+
+    // Build a guard from a "GUARD ADD <type> <name> <pattern> <params...>" record.
+    // Returns nullptr if the record is malformed or the type is unknown.
+    static std::shared_ptr<Guard> parseGuardRecord(const std::string& record);
+
+private:
+    // Load a partitioned snapshot: worker threads read, verify and parse
+    // one partition file each while this thread applies parsed ones to the
+    // store. Returns the number of references to collected blobs skipped.
+    static size_t loadSnapshotParts(KVStore& store, WAL& wal, const SnapshotManifest& manifest,
+                                    std::chrono::system_clock::time_point snapshotTime);
+    static void applyPolicyRecord(KVStore& store, const std::string& policyName);
+    static void applyGuardRecord(KVStore& store, const std::string& record);
+};
+
+#endif // RECOVERY_H
@@ -0,0 +1,162 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "status.h"
+
+class KVStore;
+class WAL;
+
+// Log shipping from a primary to read-only replicas over HTTP.
+//
+// Every record the primary's WAL appends is queued here with its LSN and
+// shipped, in order, to each replica's POST /replication/apply by one
+// thread per replica. A thread sends everything queued since its last
+// round trip as one batch, so under load one request carries many writes.
+// A replica appends the records to its own WAL as they are, applies them
+// and answers once its group-commit fsync covers them, with the LSN it has
+// reached; its LSNs are the primary's.
+//
+// With syncReplicas = K > 0 replication is semi-synchronous: a write is
+// acknowledged once it is in the local WAL and K replicas have it on disk
+// (waitReplicated()). If they don't answer within syncTimeout the write is
+// acknowledged anyway, the timeout is counted, and later writes stop
+// waiting until K replicas have caught up again, so a lost replica costs
+// one timeout rather than one per write.
+//
+// Records are kept until every replica has them, up to maxBufferBytes. A
+// replica that falls further behind, or that starts out behind what the
+// primary has queued since it started, can't be caught up from here: it
+// is reported as lost and must be seeded again from a /backup.
+class Replicator {
+public:
+    struct Options {
+        std::vector<std::string> replicas;  // host:port
+        size_t syncReplicas = 0;            // acks to wait for; 0 = asynchronous
+        std::chrono::milliseconds syncTimeout{1000};
+        size_t maxBatchBytes = 4u << 20;
+        size_t maxBufferBytes = 256u << 20;
+        std::chrono::milliseconds heartbeat{1000};  // probe idle or unreachable replicas
+        std::string apiKey;  // sent as X-API-Key
+    };
+
+    enum class Ack { ASYNC, REPLICATED, TIMED_OUT };
+
+    struct ReplicaStats {
+        std::string address;
+        uint64_t ackedLsn = 0;
+        bool connected = false;
+        bool lost = false;
+        uint64_t batches = 0;
+        uint64_t records = 0;
+    };
+
+    struct Stats {
+        uint64_t lastLsn = 0;
+        size_t syncReplicas = 0;
+        bool semiSync = false;  // false while fallen back to asynchronous
+        uint64_t syncWaits = 0;
+        uint64_t syncTimeouts = 0;
+        std::vector<ReplicaStats> replicas;
+    };
+
+    Replicator(std::shared_ptr<WAL> wal, std::shared_ptr<KVStore> store, Options options);
+    ~Replicator();
+
+    Replicator(const Replicator&) = delete;
+    Replicator& operator=(const Replicator&) = delete;
+
+    // Hook into the WAL and start shipping; records appended before this
+    // are not shipped
+    void start();
+    void stop();
+
+    // Wait until syncReplicas replicas hold every record up to lsn. ASYNC
+    // without waiting when replication is asynchronous or has fallen back.
+    Ack waitReplicated(uint64_t lsn);
+
+    size_t syncReplicas() const { return options_.syncReplicas; }
+    Stats stats() const;
+
+private:
+    struct Replica {
+        std::string address;
+        std::string host;
+        int port = 0;
+        std::thread thread;
+        uint64_t acked = 0;  // guarded by mutex_, like the rest
+        bool known = false;  // acked has been heard from the replica
+        bool connected = false;
+        bool lost = false;
+        uint64_t batches = 0;
+        uint64_t records = 0;
+    };
+
+    void append(uint64_t lsn, const std::string& record);
+    void ship(Replica& replica);
+    // SETREF records point into the primary's blob logs; replicas get the value
+    std::string resolve(const std::string& record) const;
+    // Highest LSN that syncReplicas replicas have
+    uint64_t quorumLsnLocked() const;
+    // Drop records every live replica has, and the oldest past maxBufferBytes
+    void trimLocked();
+
+    std::shared_ptr<WAL> wal_;
+    std::shared_ptr<KVStore> store_;
+    Options options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable recordsCV_;  // shippers wait for records
+    std::condition_variable ackCV_;      // writers wait for acks
+    std::deque<std::pair<uint64_t, std::string>> buffer_;
+    uint64_t bufferBytes_ = 0;
+    uint64_t firstLsn_ = 1;  // LSN of buffer_.front(), or of the next record
+    uint64_t lastLsn_ = 0;
+    bool degraded_ = false;
+    bool stopping_ = false;
+    bool started_ = false;
+    uint64_t syncWaits_ = 0;
+    uint64_t syncTimeouts_ = 0;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+};
+
+// The replica side: applies batches from POST /replication/apply. The
+// store's own WAL logging is turned off, so that the replica's WAL holds
+// the primary's records and nothing else and its LSNs stay the primary's;
+// the server refuses client writes in this mode.
+class ReplicaSink {
+public:
+    ReplicaSink(std::shared_ptr<WAL> wal, std::shared_ptr<KVStore> store);
+
+    // Apply records (one per line) whose first has LSN from, skipping any
+    // this replica already has, and wait for them to be durable. lsn is
+    // the replica's LSN afterwards. NOT_FOUND, with nothing applied, if
+    // from leaves a gap; ERROR if the fsync didn't come in time.
+    Status apply(uint64_t from, const std::string& records, uint64_t& lsn);
+
+    uint64_t lsn() const;
+
+    // Highest LSN that reads here can see; runs ahead of what is durable
+    // while a batch is being synced
+    uint64_t appliedLsn() const;
+    // Wait until appliedLsn() >= lsn; false on timeout
+    bool waitApplied(uint64_t lsn, std::chrono::milliseconds timeout);
+
+private:
+    std::shared_ptr<WAL> wal_;
+    std::shared_ptr<KVStore> store_;
+    std::mutex mutex_;  // one batch at a time, in order
+    uint64_t applied_ = 0;  // guarded by appliedMutex_
+    mutable std::mutex appliedMutex_;
+    std::condition_variable appliedCV_;
+};
+
+#endif // REPLICATION_H
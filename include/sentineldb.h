@@ -0,0 +1,170 @@
+#ifndef SENTINELDB_H
+#define SENTINELDB_H
+
+/*
+ * SentinelDB embeddable C API.
+ *
+ * Opens a data directory in-process (WAL + snapshot, same layout as
+ * http_server) and exposes the store without going through HTTP.
+ *
+ * ABI: only opaque handles, plain C types and function pointers cross this
+ * boundary. New functions may be added; existing signatures and enum values
+ * do not change within a major SENTINELDB_ABI_VERSION.
+ *
+ * Thread safety:
+ *   - All functions taking an sdb_db* may be called concurrently from any
+ *     number of threads, except sdb_close(), which must not race with any
+ *     other call on the same handle.
+ *   - Reads (get/get_at/history/propose) take a shared lock and run in
+ *     parallel; writes (set/del/guard changes) take an exclusive lock.
+ *   - Value pointers handed to visitor callbacks are zero-copy views into the
+ *     store. They are valid only until the callback returns, and the callback
+ *     must not call back into the same sdb_db (the store lock is held).
+ *   - Keys must not contain whitespace (WAL records are space-delimited);
+ *     such keys are rejected with SDB_INVALID_ARGUMENT.
+ *   - Completion (sdb_done_fn) and watch (sdb_watch_fn) callbacks run on an
+ *     internal thread — the WAL flusher or whichever thread made the write.
+ *     No store lock is held, so they may call back into the same sdb_db,
+ *     but they should return quickly. The views they receive are valid only
+ *     for the duration of the call.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#  define SDB_API __declspec(dllexport)
+#else
+#  define SDB_API __attribute__((visibility("default")))
+#endif
+
+#define SENTINELDB_ABI_VERSION 1
+
+typedef struct sdb_db sdb_db;
+
+typedef enum {
+    SDB_OK = 0,
+    SDB_NOT_FOUND = 1,
+    SDB_INVALID_ARGUMENT = 2,
+    SDB_ERROR = 3
+} sdb_status;
+
+typedef enum {
+    SDB_GUARD_ACCEPT = 0,
+    SDB_GUARD_REJECT = 1,
+    SDB_GUARD_COUNTER_OFFER = 2
+} sdb_guard_result;
+
+typedef enum {
+    SDB_POLICY_DEV_FRIENDLY = 0,
+    SDB_POLICY_SAFE_DEFAULT = 1,
+    SDB_POLICY_STRICT = 2
+} sdb_policy;
+
+/* Called with a borrowed view of a value; timestamp is epoch milliseconds. */
+typedef void (*sdb_value_fn)(void* ctx, const char* value, size_t value_len,
+                             int64_t timestamp_ms);
+
+/* Called once per alternative produced by a guard counter-offer. */
+typedef void (*sdb_alternative_fn)(void* ctx, const char* value, size_t value_len,
+                                   const char* explanation);
+
+/* Called once when an asynchronous operation completes. */
+typedef void (*sdb_done_fn)(void* ctx, sdb_status status);
+
+/* Called once with the change that fired a watch. value is NULL for deletes;
+ * timestamp is epoch milliseconds. */
+typedef void (*sdb_watch_fn)(void* ctx, const char* key, size_t key_len, int deleted,
+                             const char* value, size_t value_len, int64_t timestamp_ms);
+
+/* Returns SENTINELDB_ABI_VERSION of the loaded library. */
+SDB_API int sdb_abi_version(void);
+
+/* Human readable name of a status code (static storage). */
+SDB_API const char* sdb_status_string(sdb_status status);
+
+/* Open (creating if needed) a data directory and replay snapshot + WAL. */
+SDB_API sdb_status sdb_open(const char* data_dir, sdb_db** out_db);
+
+/* Flush the WAL and release the handle. Accepts NULL. */
+SDB_API void sdb_close(sdb_db* db);
+
+/* ---------- Data ---------- */
+
+SDB_API sdb_status sdb_set(sdb_db* db, const char* key, size_t key_len,
+                           const char* value, size_t value_len);
+
+/* Like sdb_set, but also calls done once the write has been fsynced by the
+ * WAL group commit (within a few milliseconds), without blocking the caller.
+ * If the write itself fails, done is not called and the error is returned;
+ * if the fsync fails, done is called with SDB_ERROR. */
+SDB_API sdb_status sdb_set_durable(sdb_db* db, const char* key, size_t key_len,
+                                   const char* value, size_t value_len,
+                                   sdb_done_fn done, void* ctx);
+
+SDB_API sdb_status sdb_del(sdb_db* db, const char* key, size_t key_len);
+
+/* Delete every key starting with prefix (at least one byte) as a single WAL
+ * record. The keys stop being readable immediately; their memory is freed
+ * in the background. */
+SDB_API sdb_status sdb_del_prefix(sdb_db* db, const char* prefix, size_t prefix_len);
+
+/* Call fn once, on the next set or delete of key. out_id (may be NULL)
+ * receives an id for sdb_unwatch. Watches still pending at sdb_close never
+ * fire. */
+SDB_API sdb_status sdb_watch(sdb_db* db, const char* key, size_t key_len,
+                             sdb_watch_fn fn, void* ctx, uint64_t* out_id);
+
+/* Cancel a pending watch. SDB_NOT_FOUND if it already fired. */
+SDB_API sdb_status sdb_unwatch(sdb_db* db, uint64_t id);
+
+/* Latest value of a key, passed to fn without copying. */
+SDB_API sdb_status sdb_get(sdb_db* db, const char* key, size_t key_len,
+                           sdb_value_fn fn, void* ctx);
+
+/* Value at or before timestamp_ms (epoch milliseconds). */
+SDB_API sdb_status sdb_get_at(sdb_db* db, const char* key, size_t key_len,
+                              int64_t timestamp_ms, sdb_value_fn fn, void* ctx);
+
+/* Every version of a key, oldest first. out_count may be NULL. */
+SDB_API sdb_status sdb_history(sdb_db* db, const char* key, size_t key_len,
+                               sdb_value_fn fn, void* ctx, size_t* out_count);
+
+/* Write a snapshot of the current state and truncate the WAL. */
+SDB_API sdb_status sdb_snapshot(sdb_db* db);
+
+/* Number of keys currently held. */
+SDB_API size_t sdb_size(sdb_db* db);
+
+/* ---------- Guards & negotiation ---------- */
+
+/* Evaluate a write without committing it. alt_fn may be NULL. */
+SDB_API sdb_status sdb_propose(sdb_db* db, const char* key, size_t key_len,
+                               const char* value, size_t value_len,
+                               sdb_guard_result* out_result,
+                               sdb_alternative_fn alt_fn, void* ctx);
+
+SDB_API sdb_status sdb_guard_add_range_int(sdb_db* db, const char* name,
+                                           const char* key_pattern, int min, int max);
+
+SDB_API sdb_status sdb_guard_add_length(sdb_db* db, const char* name,
+                                        const char* key_pattern, size_t min, size_t max);
+
+SDB_API sdb_status sdb_guard_add_enum(sdb_db* db, const char* name, const char* key_pattern,
+                                      const char* const* values, size_t value_count);
+
+SDB_API sdb_status sdb_guard_remove(sdb_db* db, const char* name);
+
+SDB_API sdb_status sdb_set_policy(sdb_db* db, sdb_policy policy);
+
+SDB_API sdb_policy sdb_get_policy(sdb_db* db);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* SENTINELDB_H */
@@ -0,0 +1,123 @@
+#ifndef SPILL_STORE_H
+#define SPILL_STORE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "kvstore.h"
+
+class IoScheduler;
+
+// Disk tier for keys evicted from KVStore. Each evicted key is appended with
+// its full version history to one file; an in-memory index maps key ->
+// record location, so RAM holds only keys and offsets for spilled data.
+// Reloading a key removes it from the index, and the bytes it leaves behind
+// are reclaimed by compactIfNeeded().
+//
+// Record layout (host byte order, CRC-32 over everything after the length):
+//
+//   u32 length | u32 key_len | key | u32 count |
+//   count x (i64 timestamp_ns | u32 value_len | value) | u32 crc
+//
+// The top bit of value_len marks a value that is a blob reference.
+//
+// The file is a cache of state that the WAL and snapshot already hold, so it
+// is truncated on open: after a restart, replay rebuilds it through eviction.
+class SpillStore {
+public:
+    struct Stats {
+        size_t keys = 0;
+        uint64_t liveBytes = 0;
+        uint64_t fileBytes = 0;
+        uint64_t spilled = 0;    // keys written out
+        uint64_t reloaded = 0;   // keys read back in
+    };
+
+    explicit SpillStore(const std::string& path);
+    ~SpillStore();
+
+    SpillStore(const SpillStore&) = delete;
+    SpillStore& operator=(const SpillStore&) = delete;
+
+    // Create or truncate the file
+    Status initialize();
+    bool isEnabled() const { return fd_ >= 0; }
+
+    // Append a batch of keys with their histories using a single write.
+    // A key already on disk is replaced.
+    Status put(const std::vector<std::pair<std::string, std::vector<Version>>>& batch);
+
+    // Read a key back and drop it from the index. False if it is not spilled
+    // or its record fails its checksum.
+    bool take(const std::string& key, std::vector<Version>& versions);
+
+    // Read a key without reloading it (exports); false as for take()
+    bool read(const std::string& key, std::vector<Version>& versions) const;
+
+    // Append the spilled keys starting with prefix to keys
+    void keys(const std::string& prefix, std::vector<std::string>& keys) const;
+
+    bool contains(const std::string& key) const;
+    bool remove(const std::string& key);
+
+    // Drop spilled keys under prefix whose newest version is at or before
+    // `through` (a range tombstone); returns how many were dropped and lists
+    // them in removed. Matching keys with newer versions are left alone and
+    // listed in survivors.
+    size_t removePrefix(const std::string& prefix, std::chrono::system_clock::time_point through,
+                        std::vector<std::string>* survivors = nullptr,
+                        std::vector<std::string>* removed = nullptr);
+
+    // Read every spilled key without reloading it (for snapshots)
+    void forEach(const std::function<void(const std::string&, const std::vector<Version>&)>& fn) const;
+
+    // Rewrite the file without dead records once they outweigh live ones and
+    // exceed minDeadBytes. Returns true if it compacted. The live records
+    // are copied without holding the index lock (and at the I/O scheduler's
+    // rate), so puts and reloads carry on meanwhile; only records appended
+    // during the copy are moved under the lock.
+    bool compactIfNeeded(uint64_t minDeadBytes = 16u << 20);
+
+    // Pace spill writes through io (set before the store is shared)
+    void setIoScheduler(std::shared_ptr<IoScheduler> io);
+
+    // Pay the I/O scheduler for the bytes appended since the last call and
+    // start their writeback. put() runs under the store's write lock and
+    // can't wait, so the background eviction pass calls this between
+    // batches instead; inline evictions are paid for by the next pass.
+    void throttle();
+
+    size_t size() const;
+    Stats stats() const;
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t length;  // whole record, including the length prefix
+        int64_t newestNs;
+    };
+
+    static void encode(const std::string& key, const std::vector<Version>& versions, std::string& out);
+    bool readRecord(const Entry& entry, std::string& key, std::vector<Version>& versions) const;
+    void dropEntry(std::unordered_map<std::string, Entry>::iterator it);
+
+    std::string path_;
+    int fd_ = -1;
+    mutable std::mutex mutex_;
+    std::mutex compactMutex_;  // compaction and throttle(); taken before mutex_
+    std::shared_ptr<IoScheduler> io_;
+    uint64_t unpaidFrom_ = 0;  // file offset throttle() has paid up to
+    std::unordered_map<std::string, Entry> index_;
+    uint64_t fileBytes_ = 0;
+    uint64_t liveBytes_ = 0;
+    uint64_t spilled_ = 0;
+    uint64_t reloaded_ = 0;
+};
+
+#endif // SPILL_STORE_H
@@ -0,0 +1,49 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Allocation-free, locale-free timestamp parsing and formatting shared by the
+// CLI and the HTTP server.
+//
+// Accepted input:
+//   1700000000000          epoch milliseconds
+//   1700000000000ms        epoch milliseconds (explicit)
+//   1700000000000000us     epoch microseconds
+//   2024-01-15 10:30:00[.fff]         local time
+//   2024-01-15T10:30:00[.ffffff]Z     RFC 3339, UTC
+//   2024-01-15T10:30:00+05:30         RFC 3339, explicit offset
+//
+// Output is local time "YYYY-MM-DD HH:MM:SS.mmm". The local UTC offset is
+// looked up at most once per second per thread (thread-safe localtime_r),
+// never through std::localtime / std::mktime.
+class TimestampCodec {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    // "YYYY-MM-DD HH:MM:SS.mmm" plus terminator
+    static constexpr size_t kFormattedSize = 24;
+
+    // Parse any accepted format. Returns nullopt on malformed input.
+    static std::optional<TimePoint> parse(std::string_view text);
+
+    // Write "YYYY-MM-DD HH:MM:SS.mmm" (local time) into buf, NUL-terminated.
+    // Returns the number of characters written, excluding the terminator.
+    static size_t format(TimePoint tp, char (&buf)[kFormattedSize]);
+
+    // Convenience wrapper for callers that need an owning string
+    static std::string format(TimePoint tp);
+
+    // Local UTC offset in seconds at the given UTC instant (cached per second)
+    static long utcOffsetSeconds(long long epochSeconds);
+
+private:
+    static std::optional<TimePoint> parseEpoch(std::string_view text);
+    static std::optional<TimePoint> parseCalendar(std::string_view text);
+};
+
+#endif // TIMESTAMP_H
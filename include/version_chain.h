@@ -0,0 +1,153 @@
+#ifndef VERSION_CHAIN_H
+#define VERSION_CHAIN_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Represents a versioned value with timestamp
+struct Version {
+    std::chrono::system_clock::time_point timestamp;
+    std::string value;
+    bool blob = false;  // value is a BlobStore reference, not the value itself
+
+    Version(const std::string& val)
+        : timestamp(std::chrono::system_clock::now()), value(val) {}
+
+    Version(std::chrono::system_clock::time_point ts, const std::string& val)
+        : timestamp(ts), value(val) {}
+
+    Version(std::chrono::system_clock::time_point ts, std::string&& val)
+        : timestamp(ts), value(std::move(val)) {}
+};
+
+// Ask the CPU to start loading the cache line at addr without waiting for
+// it. Only a hint: a no-op where the compiler has no prefetch builtin.
+inline void prefetchForRead(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr, 0, 3);
+#else
+    (void)addr;
+#endif
+}
+
+// A key's version history as an unrolled list: versions live in chunks of
+// kChunkSize that never move once allocated, and a small directory of chunk
+// pointers gives O(1) indexing. Appending to a key with 100k versions costs
+// the same as appending to a key with one; only the directory (one pointer
+// per chunk) ever grows by copying. The first chunk starts small and doubles
+// up to kChunkSize, so the many keys with a single version stay small.
+//
+// Each chunk records the min and max timestamp it holds, so temporal search
+// skips whole chunks before touching any Version. Trimming old versions
+// frees whole chunks and otherwise advances the first chunk's start offset.
+//
+// Versions are kept in append order, which callers keep chronological.
+// Every chunk except the last is full, counting from its start offset.
+class VersionChain {
+public:
+    static constexpr size_t kChunkSize = 64;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Version;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Version*;
+        using reference = const Version&;
+
+        const_iterator() = default;
+        reference operator*() const { return (*chain_)[index_]; }
+        pointer operator->() const { return &(*chain_)[index_]; }
+        const_iterator& operator++() { ++index_; return *this; }
+        const_iterator operator++(int) { auto copy = *this; ++index_; return copy; }
+        const_iterator& operator--() { --index_; return *this; }
+        const_iterator operator--(int) { auto copy = *this; --index_; return copy; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+        size_t index() const { return index_; }
+
+    private:
+        friend class VersionChain;
+        const_iterator(const VersionChain* chain, size_t index) : chain_(chain), index_(index) {}
+        const VersionChain* chain_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    VersionChain() = default;
+    explicit VersionChain(std::vector<Version>&& versions);
+
+    VersionChain(VersionChain&&) noexcept = default;
+    VersionChain& operator=(VersionChain&&) noexcept = default;
+    VersionChain(const VersionChain&) = delete;
+    VersionChain& operator=(const VersionChain&) = delete;
+
+    void append(std::chrono::system_clock::time_point timestamp, const std::string& value);
+    void append(Version&& version);
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t chunkCount() const { return chunks_.size(); }
+
+    const Version& operator[](size_t index) const;
+    const Version& front() const { return (*this)[0]; }
+    const Version& back() const;
+
+    // Warm the path to back() for batched lookups that touch many chains at
+    // once, one pointer hop per call and a batch stage apart: the chunk
+    // pointer, then the chunk, then its versions, then the value bytes.
+    // Each step reads only what the previous one prefetched. Empty chains
+    // and out-of-range steps are ignored.
+    void prefetchBack(int step) const;
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+    const_iterator at(size_t index) const { return const_iterator(this, index); }
+
+    // Index of the first version at or after `from` stamped after ts
+    // (size() if none), like std::upper_bound
+    size_t upperBound(std::chrono::system_clock::time_point ts, size_t from = 0) const;
+    // Index of the first version at or after `from` stamped at or after ts
+    size_t lowerBound(std::chrono::system_clock::time_point ts, size_t from = 0) const;
+
+    // Drop the oldest count versions
+    void dropFront(size_t count);
+    void clear();
+
+    // Give back memory left over by trimming: rebuild a trimmed first chunk
+    // into a right-sized one with freshly allocated values, shrink a mostly
+    // empty last chunk and the chunk directory. Touches at most two chunks.
+    // Returns the bytes released (container slack only).
+    uint64_t compact();
+
+    // Copy versions [from, size()) out, oldest first
+    std::vector<Version> copyOut(size_t from = 0) const;
+    // Move every version out and leave the chain empty
+    std::vector<Version> release();
+
+private:
+    struct Chunk {
+        std::chrono::system_clock::time_point minTs;
+        std::chrono::system_clock::time_point maxTs;
+        uint32_t start = 0;  // versions before it have been trimmed
+        std::vector<Version> versions;
+
+        size_t live() const { return versions.size() - start; }
+        void updateBounds();
+    };
+
+    Chunk& tailForAppend();
+    // Chunk and offset within it of a version index
+    void locate(size_t index, size_t& chunk, size_t& offset) const;
+    template <typename Before>
+    size_t partitionPoint(size_t from, Before before) const;
+
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
+
+#endif // VERSION_CHAIN_H
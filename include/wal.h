@@ -1,6 +1,7 @@
 #ifndef WAL_H
 #define WAL_H
 
+#include <optional>
 #include <string>
 #include <fstream>
 #include <vector>
@@ -8,9 +9,63 @@
 #include <chrono>
 #include <cstdint>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
 #include <condition_variable>
 #include "status.h"
 
+class IoScheduler;
+
+// Consistent on-disk state for an online backup: the snapshot plus the WAL
+// prefix holding every record up to lsn. The descriptors keep the files
+// readable even if a later snapshot replaces them; the caller closes them.
+struct WALBackupPoint {
+    // A data file outside the log that records refer to (blob logs)
+    struct File {
+        std::string name;  // relative to the data directory
+        int fd = -1;
+        uint64_t bytes = 0;
+    };
+
+    uint64_t lsn = 0;
+    int snapshotFd = -1;      // -1 when no snapshot exists yet
+    uint64_t snapshotBytes = 0;
+    int walFd = -1;
+    uint64_t walBytes = 0;
+    std::vector<File> files;
+};
+
+// A partitioned snapshot. snapshot.db is then a small manifest naming the
+// partition files next to it, each with its size, key count and CRC-32,
+// and the LSN they cover:
+//
+//   SNAPSHOT 1 <generation>
+//   LSN <n>
+//   POLICY SET <name>                          if a policy was set
+//   PART snapshot-000007-00.db <bytes> <keys> <crc>
+//   ...
+//   END <crc of the lines above>
+//
+// Partitions hold SET and SETREF lines, as a single-file snapshot does.
+// They are written and loaded in parallel; the manifest is renamed into
+// place last, so a crash mid-snapshot leaves the previous one intact.
+struct SnapshotManifest {
+    struct Part {
+        std::string name;  // relative to the data directory
+        uint64_t bytes = 0;
+        uint64_t keys = 0;
+        uint32_t crc = 0;
+    };
+
+    uint64_t generation = 0;
+    uint64_t lsn = 0;
+    std::string policy;
+    std::vector<Part> parts;
+};
+
 // Write-Ahead Log manager for persistence
 class WAL {
 private:
@@ -18,6 +73,9 @@ private:
     std::string snapshotPath;
     std::ofstream logFile;
     int logFd_{-1};
+    // Held by the flush thread across its fsync of logFd_, and by
+    // clearLog() while it replaces the descriptor
+    std::mutex logFdMutex_;
     bool enabled;
 
     // Group commit
@@ -28,6 +86,36 @@ private:
     bool pendingFlush_{false};
     void flushThreadFunc();
 
+    // Log sequence numbers: every appended record takes the next LSN.
+    // durableLsn_ trails lastLsn_ until the group-commit fsync covers it.
+    std::mutex appendMutex_;
+    std::atomic<uint64_t> lastLsn_{0};
+    std::atomic<uint64_t> durableLsn_{0};
+    // Continuations waiting for a durable LSN (guarded by flushMutex_)
+    std::multimap<uint64_t, std::function<void(bool)>> durableWaiters_;
+    // Set once an fsync fails: nothing after it can be made durable, so
+    // appends are refused and waiters are told so
+    std::atomic<bool> syncFailed_{false};
+    // Runs before every group-commit fsync (guarded by flushMutex_)
+    std::function<void()> preSync_;
+    // Told how long each group-commit fsync took; paces snapshot writes
+    // (guarded by flushMutex_)
+    std::shared_ptr<IoScheduler> io_;
+    // Bytes in the current log file (guarded by appendMutex_)
+    uint64_t logBytes_{0};
+    // Told of every record as it takes its LSN (guarded by appendMutex_)
+    std::function<void(uint64_t, const std::string&)> recordHook_;
+    // Held across snapshot + truncation so backups never see half of it
+    std::mutex snapshotMutex_;
+    // Files per snapshot, written by one thread each (guarded by snapshotMutex_)
+    size_t snapshotPartitions_;
+
+    // Serialize, checksum and append records, then wake the flush thread
+    Status appendRecord(const std::string& content);
+    Status appendRecords(const std::vector<std::string>& contents);
+    void runDurableWaiters(uint64_t durable, bool synced);
+    Status failAppend(int error);
+
 public:
     // Constructor with WAL file path
     explicit WAL(const std::string& path);
@@ -46,9 +134,17 @@ public:
     Status logSet(const std::string& key, const std::string& value,
                   std::chrono::system_clock::time_point timestamp);
     
+    // Log a SETREF command: a value stored in the blob store, by reference
+    Status logSetRef(const std::string& key, const std::string& ref,
+                     std::chrono::system_clock::time_point timestamp);
+    
     // Log a DEL command to WAL
     Status logDel(const std::string& key);
     
+    // Log a DELPREFIX command (one record for a whole range of keys)
+    Status logDelPrefix(const std::string& prefix,
+                        std::chrono::system_clock::time_point timestamp);
+    
     // Log a POLICY SET command to WAL
     Status logPolicy(const std::string& policyName);
     
@@ -56,15 +152,58 @@ public:
     Status logGuardAdd(const std::string& guardType, const std::string& guardName,
                        const std::string& keyPattern, const std::string& params);
     
-    // Read all commands from WAL file
-    std::vector<std::string> readLog();
+    // Append a record exactly as another WAL wrote it (a replica applying
+    // its primary's log); it takes the next LSN like any other
+    Status logRecord(const std::string& record);
+    
+    // The text of a SET record (SETREF with ref), as logSet() and
+    // logSetRef() would append it
+    static std::string setRecord(const std::string& key, const std::string& value,
+                                 std::chrono::system_clock::time_point timestamp, bool ref = false);
     
-    // Read snapshot file
+    // Append several records with one lock, one write to the kernel and one
+    // group-commit wake-up. Each takes the next LSN, in order.
+    Status logRecords(const std::vector<std::string>& records);
+    
+    // Read all commands from WAL file. If the log starts with a BASE header
+    // (written when it was last cleared, or when it was new), baseLsn is
+    // set to the LSN of the record before the first one returned.
+    std::vector<std::string> readLog(uint64_t* baseLsn = nullptr);
+    
+    // Read snapshot file; a partitioned snapshot's manifest and partitions
+    // come back as the lines of the equivalent single file
     std::vector<std::string> readSnapshot();
     
-    // Create snapshot from current state and clear WAL
+    // OK with the manifest if the snapshot is partitioned; NOT_FOUND if
+    // there is no snapshot or it is a single file; ERROR if the manifest
+    // is damaged
+    Status readSnapshotManifest(SnapshotManifest& manifest);
+    
+    // Read one partition whole into contents; false if it is missing or
+    // doesn't match its size and checksum in the manifest
+    bool readSnapshotPart(const SnapshotManifest::Part& part, std::string& contents);
+    
+    // Create snapshot from current state and clear WAL. Keys in blobRefs are
+    // written as SETREF lines holding the blob reference instead of a value.
+    // Keys are split over snapshotPartitions() files by hash and the files
+    // written in parallel. lsn is the LSN the data was read at (see
+    // KVStore::getAllData()); records after it stay in the WAL. Without it,
+    // lastLsn() is used, which is only right if nothing is being written.
     Status createSnapshot(const std::unordered_map<std::string, std::string>& data,
-                         const std::string& currentPolicy = "");
+                         const std::string& currentPolicy = "",
+                         const std::unordered_map<std::string, std::string>& blobRefs = {},
+                         std::optional<uint64_t> lsn = std::nullopt);
+    
+    // Number of partition files (and writer threads) per snapshot. 0 picks
+    // one per core, up to 8.
+    void setSnapshotPartitions(size_t partitions);
+    size_t snapshotPartitions();
+    static constexpr size_t kMaxSnapshotPartitions = 64;
+    
+    // Name of the partition file `index` of snapshot generation `generation`,
+    // and whether name is one
+    static std::string snapshotPartName(uint64_t generation, size_t index);
+    static bool isSnapshotPartName(const std::string& name);
     
     // Check if WAL is enabled and working
     bool isEnabled() const;
@@ -72,6 +211,43 @@ public:
     // Flush pending writes to disk
     void flush();
     
+    // LSN of the most recently appended record, and the highest LSN known
+    // to be on disk
+    uint64_t lastLsn() const;
+    uint64_t durableLsn() const;
+    
+    // An fsync of the log failed: appends are refused from then on
+    bool syncFailed() const;
+    
+    // Recovery: continue numbering after the records already on disk. An
+    // empty log gets a BASE header recording lsn.
+    void setBaseLsn(uint64_t lsn);
+    
+    // Run callback(true) once every record up to lsn has been fsynced, or
+    // callback(false) if an fsync failed first. Runs inline if that is
+    // already known, otherwise on the group-commit thread, so it must be
+    // short and must not block.
+    void onDurable(uint64_t lsn, std::function<void(bool durable)> callback);
+    
+    // Blocking convenience over onDurable(); false on timeout or fsync failure
+    bool waitDurable(uint64_t lsn, std::chrono::milliseconds timeout);
+    
+    // Make data that records depend on durable before the log itself (blob
+    // logs). Runs on the group-commit thread before each fsync.
+    void setPreSync(std::function<void()> hook);
+    
+    // Called with each record and its LSN as it is appended, in LSN order
+    // and under the append lock, so it must be short (replication queues
+    // the record and returns)
+    void setRecordHook(std::function<void(uint64_t lsn, const std::string& record)> hook);
+    
+    // Share disk bandwidth with background writers: report every fsync's
+    // latency to io and write snapshots at the rate it grants
+    void setIoScheduler(std::shared_ptr<IoScheduler> io);
+    
+    // Pin the current snapshot and WAL for an online backup
+    bool openBackupPoint(WALBackupPoint& point);
+    
 private:
     static uint32_t computeCRC32(const std::string& data);
 
@@ -81,8 +257,21 @@ private:
     // Check if file exists
     bool fileExists(const std::string& path);
     
-    // Clear the WAL log file
-    Status clearLog();
+    // Replace the WAL log file with a BASE header and only the records
+    // after keepAfter (none by default)
+    Status clearLog(uint64_t keepAfter = UINT64_MAX);
+    
+    // readLog(), optionally without reporting to stdout
+    std::vector<std::string> readLogRecords(bool report, uint64_t* baseLsn);
+    
+    // Path of a file in the directory holding the WAL
+    std::string dataPath(const std::string& name) const;
+    
+    static bool parseManifest(const std::string& text, SnapshotManifest& manifest);
+    
+    // Remove partition files no manifest refers to (earlier generations,
+    // or ones a crash left before their manifest was installed)
+    void removeStaleSnapshotParts(const SnapshotManifest& live);
 };
 
 #endif // WAL_H
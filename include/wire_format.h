@@ -0,0 +1,87 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Response encodings negotiated through the Accept header
+enum class WireFormat {
+    JSON,
+    MSGPACK
+};
+
+// Streaming response encoder. Values are appended straight into one output
+// buffer as the handler walks store data, so there is no intermediate
+// document and no per-field temporary strings.
+//
+// MessagePack needs container sizes up front, so beginObject/beginArray take
+// the element count; the JSON encoder ignores it.
+//
+// Strings that are not valid UTF-8 are written as MessagePack bin, so binary
+// values round-trip exactly. JSON escapes them byte-for-byte as before.
+class ResponseWriter {
+public:
+    explicit ResponseWriter(WireFormat format, size_t reserveBytes = 256);
+
+    void beginObject(size_t fields);
+    void endObject();
+    void beginArray(size_t elements);
+    void endArray();
+
+    // Array whose length is only known after visiting store data. MessagePack
+    // reserves a 32-bit length that endArrayUnsized() patches in place.
+    size_t beginArrayUnsized();
+    void endArrayUnsized(size_t token, size_t elements);
+
+    void key(std::string_view name);
+    void string(std::string_view value);
+    void integer(int64_t value);
+    void boolean(bool value);
+    void null();
+
+    // key + value shorthands
+    void field(std::string_view name, std::string_view value) { key(name); string(value); }
+    void field(std::string_view name, const char* value) { key(name); string(value); }
+    void field(std::string_view name, int64_t value) { key(name); integer(value); }
+    void field(std::string_view name, bool value) { key(name); boolean(value); }
+
+    WireFormat format() const { return format_; }
+    const char* contentType() const;
+    std::string& buffer() { return out_; }
+
+    static const char* contentType(WireFormat format);
+
+private:
+    void separator();
+    void writeJSONString(std::string_view value);
+    void writeMsgPackHeader(uint8_t fix, uint8_t fixLimit, uint8_t op16, uint8_t op32, size_t n);
+
+    WireFormat format_;
+    std::string out_;
+    // JSON only: whether the current container already has an element,
+    // and whether the next value follows a key
+    std::vector<bool> hasElement_;
+    bool afterKey_ = false;
+};
+
+// Decoding helpers for the HTTP frontend
+class WireCodec {
+public:
+    // Decode a flat MessagePack map (request bodies) into string parameters,
+    // mirroring what parseSimpleJSON produces for JSON bodies. Integer and
+    // boolean values are rendered as decimal / "true" / "false".
+    static bool parseMsgPackParams(std::string_view data,
+                                   std::unordered_map<std::string, std::string>& params);
+
+    // Re-encode a JSON document as MessagePack. Used for responses of
+    // endpoints that still build JSON by hand.
+    static bool jsonToMsgPack(std::string_view json, std::string& out);
+
+    static bool isValidUTF8(std::string_view s);
+};
+
+#endif // WIRE_FORMAT_H
@@ -1,5 +1,5 @@
 from .client import SentinelDB
-from .models import Version, ProposalResult, Alternative, Guard, HealthStatus
+from .models import Version, TimelineEvent, ProposalResult, Alternative, Guard, HealthStatus
 from .exceptions import (
     SentinelDBError, ConnectionError, KeyNotFoundError, GuardViolationError
 )
@@ -7,6 +7,6 @@ from .exceptions import (
 __version__ = "0.1.0"
 __all__ = [
     "SentinelDB",
-    "Version", "ProposalResult", "Alternative", "Guard", "HealthStatus",
+    "Version", "TimelineEvent", "ProposalResult", "Alternative", "Guard", "HealthStatus",
     "SentinelDBError", "ConnectionError", "KeyNotFoundError", "GuardViolationError"
 ]
@@ -1,9 +1,15 @@
+import json
+import threading
+import uuid
 import requests
-from typing import Optional, List
-from .models import Version, ProposalResult, Alternative, Guard, HealthStatus
+from typing import Optional, List, Union, Iterator
+from .models import Version, TimelineEvent, ProposalResult, Alternative, Guard, HealthStatus
 from .exceptions import (
     SentinelDBError, ConnectionError, KeyNotFoundError, GuardViolationError
 )
+from .unix_socket import UNIX_SCHEME, UNIX_BASE_URL, UnixSocketAdapter, parse_unix_url
+
+MSGPACK_CONTENT_TYPE = "application/msgpack"
 
 class SentinelDB:
     """
@@ -16,21 +22,138 @@ class SentinelDB:
         result = db.propose("score", "150")
         if result.has_alternatives:
             db.set("score", result.alternatives[0].value)
+
+    Co-located clients can skip loopback TCP by pointing at the server's
+    Unix domain socket (http_server --unix-socket <path>):
+        db = SentinelDB("unix:///run/sentineldb/sentineldb.sock")
+
+    encoding="msgpack" exchanges MessagePack instead of JSON (smaller and
+    cheaper to encode, and binary values round-trip as bytes). Requires the
+    optional dependency: pip install sentineldb-client[msgpack]
+
+    cache=True keeps values read with get() in process. The server tracks
+    which keys this client has read and a background thread long-polls
+    /invalidations, so cached values are dropped as soon as they change.
+    Pass cache_prefixes to be told about every write under those prefixes
+    instead of tracking individual keys.
+
+    read_url sends get/get_at/history to a replica (or a pool of them) while
+    writes go to url. Every write returns its commit LSN, and reads ask for
+    at least the latest one this client has seen, so it always reads its own
+    writes; a replica that lags waits briefly or redirects to the primary.
+        db = SentinelDB("http://primary:8080", read_url="http://replica:8080")
     """
 
-    def __init__(self, url: str, timeout: int = 10, api_key: str = None):
-        self.url = url.rstrip("/")
+    def __init__(self, url: str, timeout: int = 10, api_key: str = None,
+                 encoding: str = "json", cache: bool = False,
+                 cache_prefixes: Optional[List[str]] = None,
+                 read_url: Optional[str] = None):
+        if encoding not in ("json", "msgpack"):
+            raise ValueError("encoding must be 'json' or 'msgpack'")
         self.timeout = timeout
+        self.encoding = encoding
         self.session = requests.Session()
+        if url.startswith(UNIX_SCHEME):
+            self.socket_path = parse_unix_url(url)
+            self.url = UNIX_BASE_URL
+            self.session.mount(UNIX_BASE_URL + "/",
+                               UnixSocketAdapter(self.socket_path, timeout=timeout))
+        else:
+            self.socket_path = None
+            self.url = url.rstrip("/")
+        self.read_url = read_url.rstrip("/") if read_url else None
+        # Highest commit LSN returned to this client (session token for reads)
+        self.last_lsn = 0
         if api_key:
             self.session.headers["X-API-Key"] = api_key
-        self.session.headers["Content-Type"] = "application/json"
+        if encoding == "msgpack":
+            try:
+                import msgpack
+            except ImportError:
+                raise SentinelDBError(
+                    "encoding='msgpack' requires the msgpack package "
+                    "(pip install sentineldb-client[msgpack])")
+            self._msgpack = msgpack
+            self.session.headers["Content-Type"] = MSGPACK_CONTENT_TYPE
+            self.session.headers["Accept"] = MSGPACK_CONTENT_TYPE
+        else:
+            self._msgpack = None
+            self.session.headers["Content-Type"] = "application/json"
+
+        self._cache = None
+        if cache:
+            self._start_cache(cache_prefixes)
+
+    # ── Client-side cache ────────────────────────────────────────
+
+    def _start_cache(self, prefixes: Optional[List[str]]) -> None:
+        self.client_id = uuid.uuid4().hex
+        self.session.headers["X-Client-Id"] = self.client_id
+        self._cache = {}
+        self._cache_lock = threading.Lock()
+        # Bumped on every invalidation so a read racing one is not cached
+        self._cache_generation = 0
+        self._cache_stop = threading.Event()
+        if prefixes:
+            self._request("POST", "/tracking", json={"prefixes": ",".join(prefixes)})
+        # The poller gets its own session; requests.Session is not thread-safe
+        self._poll_session = requests.Session()
+        self._poll_session.headers.update(self.session.headers)
+        for prefix, adapter in self.session.adapters.items():
+            self._poll_session.mount(prefix, adapter)
+        self._poller = threading.Thread(target=self._poll_invalidations,
+                                        name="sentineldb-invalidations", daemon=True)
+        self._poller.start()
 
-    def _request(self, method: str, path: str, **kwargs) -> dict:
+    def _invalidate(self, keys, flush: bool) -> None:
+        with self._cache_lock:
+            self._cache_generation += 1
+            if flush:
+                self._cache.clear()
+            for key in keys:
+                self._cache.pop(key, None)
+
+    def _poll_invalidations(self) -> None:
+        while not self._cache_stop.is_set():
+            try:
+                resp = self._poll_session.get(f"{self.url}/invalidations",
+                                              params={"timeout_ms": 25000},
+                                              timeout=self.timeout + 30)
+                if resp.status_code == 204:
+                    continue
+                if not resp.ok:
+                    raise SentinelDBError(f"HTTP {resp.status_code}")
+                data = self._decode(resp)
+                self._invalidate(data.get("keys", []), data.get("flush", False))
+            except Exception:
+                # Invalidations may have been lost: start over from empty
+                self._invalidate([], True)
+                self._cache_stop.wait(1.0)
+
+    def close(self) -> None:
+        """Stop the invalidation poller (if any) and close the connection pool."""
+        if self._cache is not None:
+            self._cache_stop.set()
+            self._poll_session.close()
+        self.session.close()
+
+    def _decode(self, resp) -> dict:
+        if resp.headers.get("Content-Type", "").startswith(MSGPACK_CONTENT_TYPE):
+            return self._msgpack.unpackb(resp.content, raw=False)
+        return resp.json()
+
+    def _request(self, method: str, path: str, read: bool = False, **kwargs) -> dict:
+        if self._msgpack is not None and "json" in kwargs:
+            kwargs["data"] = self._msgpack.packb(kwargs.pop("json"), use_bin_type=True)
+        base = self.url
+        if read and self.read_url:
+            base = self.read_url
+            if self.last_lsn:
+                kwargs["headers"] = {"X-Sentinel-Min-LSN": str(self.last_lsn)}
         try:
             resp = self.session.request(
                 method,
-                f"{self.url}{path}",
+                f"{base}{path}",
                 timeout=self.timeout,
                 **kwargs
             )
@@ -40,24 +163,87 @@ class SentinelDB:
             raise SentinelDBError(f"Request timed out after {self.timeout}s")
 
         if resp.status_code == 404:
-            data = resp.json()
+            data = self._decode(resp)
             raise KeyNotFoundError(data.get("key", "unknown"))
 
         if not resp.ok:
-            raise SentinelDBError(f"HTTP {resp.status_code}: {resp.text}")
+            try:
+                detail = self._decode(resp).get("error", resp.text)
+            except Exception:
+                detail = resp.text
+            raise SentinelDBError(f"HTTP {resp.status_code}: {detail}")
 
-        return resp.json()
+        if method == "POST" and "X-Sentinel-LSN" in resp.headers:
+            self.last_lsn = max(self.last_lsn, int(resp.headers["X-Sentinel-LSN"]))
+        return self._decode(resp)
 
     # ── Core Operations ──────────────────────────────────────────
 
-    def set(self, key: str, value: str) -> None:
-        """Set a key-value pair. Bypasses guards."""
+    def set(self, key: str, value: Union[str, bytes]) -> None:
+        """Set a key-value pair. Bypasses guards. bytes values need encoding="msgpack"."""
+        if isinstance(value, bytes) and self._msgpack is None:
+            raise ValueError("binary values require encoding='msgpack'")
         self._request("POST", "/set", json={"key": key, "value": value})
 
-    def get(self, key: str) -> str:
-        """Get the current value of a key."""
-        data = self._request("GET", "/get", params={"key": key})
-        return data["value"]
+    def get(self, key: str) -> Union[str, bytes]:
+        """Get the current value of a key (bytes if it is not valid UTF-8, msgpack only)."""
+        if self._cache is None:
+            data = self._request("GET", "/get", read=True, params={"key": key})
+            return data["value"]
+        with self._cache_lock:
+            if key in self._cache:
+                return self._cache[key]
+            generation = self._cache_generation
+        # Tracked reads stay on url, whose invalidations this client polls
+        data = self._request("GET", "/get", params={"key": key, "track": "1"})
+        value = data["value"]
+        with self._cache_lock:
+            if generation == self._cache_generation:
+                self._cache[key] = value
+        return value
+
+    def ingest(self, records, batch: Optional[int] = None, durable: bool = False) -> dict:
+        """Write many keys in one streamed request (POST /ingest).
+
+        records is any iterable of (key, value) pairs; it is sent as it is
+        consumed, so a generator can load more data than fits in memory.
+        Returns the summary, with the failed records under "errors" as
+        {"line", "key", "error"}. Unlike set(), records go through the guards.
+        """
+        def lines():
+            for key, value in records:
+                yield (json.dumps({"key": key, "value": value}) + "\n").encode("utf-8")
+
+        params = {}
+        if batch is not None:
+            params["batch"] = batch
+        if durable:
+            params["durable"] = "1"
+        try:
+            resp = self.session.post(f"{self.url}/ingest", params=params, data=lines(),
+                                     headers={"Content-Type": "application/x-ndjson"},
+                                     timeout=self.timeout)
+        except requests.exceptions.ConnectionError as e:
+            raise ConnectionError(self.url, e)
+        except requests.exceptions.Timeout:
+            raise SentinelDBError(f"Request timed out after {self.timeout}s")
+        if not resp.ok:
+            try:
+                detail = resp.json().get("error", resp.text)
+            except Exception:
+                detail = resp.text
+            raise SentinelDBError(f"HTTP {resp.status_code}: {detail}")
+
+        rows = [json.loads(line) for line in resp.text.splitlines() if line.strip()]
+        summary = rows.pop() if rows else {}
+        summary["errors"] = rows
+        if "lsn" in summary:
+            self.last_lsn = max(self.last_lsn, int(summary["lsn"]))
+        return summary
+
+    def delete_prefix(self, prefix: str) -> None:
+        """Delete every key starting with prefix in one server-side operation."""
+        self._request("POST", "/deletePrefix", json={"prefix": prefix})
 
     def exists(self, key: str) -> bool:
         """Check if a key exists."""
@@ -71,7 +257,7 @@ class SentinelDB:
 
     def history(self, key: str) -> List[Version]:
         """Get full version history of a key."""
-        data = self._request("GET", "/history", params={"key": key})
+        data = self._request("GET", "/history", read=True, params={"key": key})
         return [
             Version(value=v["value"], timestamp=v["timestamp"])
             for v in data.get("versions", [])
@@ -80,12 +266,34 @@ class SentinelDB:
     def get_at(self, key: str, timestamp: str) -> Optional[str]:
         """Get value of key at a specific timestamp."""
         try:
-            data = self._request("GET", "/getAt",
+            data = self._request("GET", "/getAt", read=True,
                                  params={"key": key, "timestamp": timestamp})
             return data.get("value")
         except KeyNotFoundError:
             return None
 
+    def timeline(self, keys: Optional[List[str]] = None, prefix: Optional[str] = None,
+                 start: Optional[str] = None, through: Optional[str] = None,
+                 page_size: int = 1000) -> Iterator[TimelineEvent]:
+        """Every version of keys (or of the keys under prefix) stamped in
+        [start, through], in time order, fetched a page at a time."""
+        params = {"limit": page_size}
+        if keys is not None:
+            params["key"] = keys
+        if prefix is not None:
+            params["prefix"] = prefix
+        if start:
+            params["from"] = start
+        if through:
+            params["through"] = through
+        while True:
+            data = self._request("GET", "/timeline", read=True, params=params)
+            for e in data.get("events", []):
+                yield TimelineEvent(timestamp=e["timestamp"], key=e["key"], value=e["value"])
+            if not data.get("next_cursor"):
+                return
+            params["cursor"] = data["next_cursor"]
+
     # ── Guard & Proposal Operations ──────────────────────────────
 
     def propose(self, key: str, value: str) -> ProposalResult:
@@ -174,6 +382,13 @@ class SentinelDB:
             version=data.get("version", "unknown")
         )
 
+    def stats(self) -> dict:
+        """Key counts and value/history distributions by key prefix.
+
+        Returns the /stats document: {"delimiter", "prefixes": [...], "all": {...}}.
+        """
+        return self._request("GET", "/stats")
+
     def metrics(self) -> str:
         """Get Prometheus metrics as raw text."""
         resp = self.session.get(f"{self.url}/metrics", timeout=self.timeout)
@@ -185,7 +400,9 @@ class SentinelDB:
         return self
 
     def __exit__(self, *args):
-        self.session.close()
+        self.close()
 
     def __repr__(self):
+        if self.socket_path:
+            return f"SentinelDB(url={UNIX_SCHEME + self.socket_path!r})"
         return f"SentinelDB(url={self.url!r})"
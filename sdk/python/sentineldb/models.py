@@ -6,6 +6,12 @@ class Version:
     value: str
     timestamp: str
 
+@dataclass
+class TimelineEvent:
+    timestamp: str
+    key: str
+    value: str
+
 @dataclass
 class Alternative:
     value: str
@@ -0,0 +1,73 @@
+"""
+Unix domain socket transport for co-located clients.
+
+Lets the SDK talk to an http_server started with --unix-socket, skipping the
+loopback TCP stack:
+
+    db = SentinelDB("unix:///run/sentineldb/sentineldb.sock")
+"""
+import socket
+
+from requests.adapters import HTTPAdapter
+from urllib3.connection import HTTPConnection
+from urllib3.connectionpool import HTTPConnectionPool
+
+UNIX_SCHEME = "unix://"
+
+# Placeholder origin used for requests routed through the socket adapter
+UNIX_BASE_URL = "http://sentineldb.sock"
+
+
+class _UnixHTTPConnection(HTTPConnection):
+    def __init__(self, socket_path: str, timeout: float):
+        super().__init__("localhost", timeout=timeout)
+        self.socket_path = socket_path
+        self.socket_timeout = timeout
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(self.socket_timeout)
+        sock.connect(self.socket_path)
+        self.sock = sock
+
+
+class _UnixHTTPConnectionPool(HTTPConnectionPool):
+    def __init__(self, socket_path: str, timeout: float, maxsize: int):
+        super().__init__("localhost", maxsize=maxsize)
+        self.socket_path = socket_path
+        self.socket_timeout = timeout
+
+    def _new_conn(self):
+        return _UnixHTTPConnection(self.socket_path, self.socket_timeout)
+
+
+class UnixSocketAdapter(HTTPAdapter):
+    """requests transport adapter that sends every request over one Unix socket."""
+
+    def __init__(self, socket_path: str, timeout: float = 10, pool_maxsize: int = 10):
+        super().__init__()
+        self.socket_path = socket_path
+        self.socket_timeout = timeout
+        self._pool = _UnixHTTPConnectionPool(socket_path, timeout, pool_maxsize)
+
+    def get_connection(self, url, proxies=None):
+        return self._pool
+
+    # requests >= 2.32 resolves connections through this hook instead
+    def get_connection_with_tls_context(self, request, verify, proxies=None, cert=None):
+        return self._pool
+
+    def request_url(self, request, proxies):
+        return request.path_url
+
+    def close(self):
+        self._pool.close()
+        super().close()
+
+
+def parse_unix_url(url: str) -> str:
+    """Return the socket path of a unix:///path/to.sock URL."""
+    path = url[len(UNIX_SCHEME):]
+    if not path.startswith("/"):
+        raise ValueError(f"Unix socket URL must use an absolute path: {url!r}")
+    return path
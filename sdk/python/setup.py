@@ -8,6 +8,7 @@ setup(
     url="https://github.com/Brijesh-Thakkar/sentineldb",
     packages=find_packages(),
     install_requires=["requests>=2.28.0"],
+    extras_require={"msgpack": ["msgpack>=1.0"]},
     python_requires=">=3.8",
     classifiers=[
         "Development Status :: 3 - Alpha",
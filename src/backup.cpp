@@ -0,0 +1,437 @@
+#include "backup.h"
+#include "io_scheduler.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const kMagic = "SENTINELDB-BACKUP 1";
+const char* const kSectionNames[] = {"snapshot.db", "wal.log"};
+const char* const kBlobDir = "blobs";
+
+const std::array<uint32_t, 256>& crcTable() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+// pread until len bytes are read or EOF/error; returns bytes read
+ssize_t preadFull(int fd, char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+bool pwriteFull(int fd, const char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pwrite(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Blob logs travel with the snapshot and WAL that refer to them
+bool isBlobSection(const std::string& name) {
+    const std::string prefix = std::string(kBlobDir) + "/blob-";
+    return name.size() > prefix.size() + 4 && name.compare(0, prefix.size(), prefix) == 0 &&
+           name.compare(name.size() - 4, 4, ".log") == 0 &&
+           name.find_first_not_of("0123456789", prefix.size()) == name.size() - 4;
+}
+
+std::string joinPath(const std::string& dir, const std::string& name) {
+    if (!dir.empty() && dir.back() == '/') return dir + name;
+    return dir + "/" + name;
+}
+
+} // namespace
+
+uint32_t BackupRestore::crc32(const char* data, size_t len, uint32_t crc) {
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ---------- BackupStream ----------
+
+BackupStream::BackupStream(const WALBackupPoint& point, size_t chunkBytes, uint64_t bytesPerSecond,
+                           std::shared_ptr<IoScheduler> io)
+    : point_(point), chunkBytes_(std::max<size_t>(4096, chunkBytes)),
+      bytesPerSecond_(bytesPerSecond), io_(std::move(io)),
+      start_(std::chrono::steady_clock::now()) {
+    sections_.push_back({kSectionNames[0], point.snapshotFd,
+                         point.snapshotFd == -1 ? 0 : point.snapshotBytes, {}});
+    sections_.push_back({kSectionNames[1], point.walFd, point.walBytes, {}});
+    for (const auto& file : point.files) {
+        sections_.push_back({file.name, file.fd, file.bytes, {}});
+    }
+
+    auto createdMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::ostringstream header;
+    header << kMagic << "\n"
+           << "lsn " << point.lsn << "\n"
+           << "created_ms " << createdMs << "\n"
+           << "chunk_bytes " << chunkBytes_ << "\n";
+    for (const auto& section : sections_) {
+        header << "section " << section.name << " " << section.bytes << "\n";
+    }
+    header << "data\n";
+    header_ = header.str();
+}
+
+BackupStream::~BackupStream() {
+    if (point_.snapshotFd != -1) ::close(point_.snapshotFd);
+    if (point_.walFd != -1) ::close(point_.walFd);
+    for (const auto& file : point_.files) {
+        if (file.fd != -1) ::close(file.fd);
+    }
+}
+
+uint64_t BackupStream::totalBytes() const {
+    uint64_t total = header_.size();
+    for (const auto& section : sections_) {
+        total += section.bytes;
+    }
+    return total;
+}
+
+void BackupStream::pace(size_t bytes) {
+    sentBytes_ += bytes;
+    if (io_) {
+        io_->acquire(bytes);
+    }
+    if (bytesPerSecond_ == 0) return;
+    // Sleep until the average rate since the start is back under the limit
+    auto due = start_ + std::chrono::microseconds(sentBytes_ * 1000000 / bytesPerSecond_);
+    auto now = std::chrono::steady_clock::now();
+    if (due > now) {
+        std::this_thread::sleep_for(due - now);
+    }
+}
+
+bool BackupStream::next(std::string& out) {
+    out.clear();
+    if (done_) return false;
+
+    if (!headerSent_) {
+        headerSent_ = true;
+        out = header_;
+        return true;
+    }
+
+    while (section_ < sections_.size() && offset_ >= sections_[section_].bytes) {
+        ++section_;
+        offset_ = 0;
+    }
+
+    if (section_ < sections_.size()) {
+        Section& section = sections_[section_];
+        size_t len = static_cast<size_t>(std::min<uint64_t>(chunkBytes_, section.bytes - offset_));
+        out.resize(len);
+        ssize_t n = preadFull(section.fd, &out[0], len, offset_);
+        if (n != static_cast<ssize_t>(len)) {
+            // The pinned files never shrink, so a short read is an I/O error
+            ok_ = false;
+            done_ = true;
+            out.clear();
+            return false;
+        }
+        section.crcs.push_back(BackupRestore::crc32(out.data(), len));
+        offset_ += len;
+        pace(len);
+        return true;
+    }
+
+    // Trailer: per-chunk checksums, then the end marker
+    char hex[10];
+    for (const auto& section : sections_) {
+        out += "crc ";
+        out += section.name;
+        for (uint32_t crc : section.crcs) {
+            std::snprintf(hex, sizeof(hex), " %08x", crc);
+            out += hex;
+        }
+        out += "\n";
+    }
+    out += "end\n";
+    done_ = true;
+    return false;
+}
+
+// ---------- BackupRestore ----------
+
+bool BackupRestore::restore(const std::string& archivePath, const std::string& dataDir,
+                            unsigned threads, bool force, std::string& error,
+                            uint64_t* restoredLsn) {
+    int fd = ::open(archivePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        error = "cannot open " + archivePath + ": " + std::strerror(errno);
+        return false;
+    }
+    struct Closer {
+        int fd;
+        ~Closer() { ::close(fd); }
+    } closer{fd};
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        error = std::string("cannot stat archive: ") + std::strerror(errno);
+        return false;
+    }
+    const uint64_t archiveBytes = static_cast<uint64_t>(st.st_size);
+
+    // Header: short lines ending with "data", one per section
+    std::string head(std::min<uint64_t>(archiveBytes, 1u << 20), '\0');
+    if (preadFull(fd, &head[0], head.size(), 0) != static_cast<ssize_t>(head.size())) {
+        error = "cannot read archive header";
+        return false;
+    }
+    size_t dataMarker = head.find("\ndata\n");
+    if (head.compare(0, std::strlen(kMagic), kMagic) != 0 || dataMarker == std::string::npos) {
+        error = "not a SentinelDB backup archive";
+        return false;
+    }
+    const uint64_t dataOffset = dataMarker + 6;
+
+    struct Section {
+        std::string name;
+        uint64_t bytes = 0;
+        uint64_t offset = 0;  // within the archive
+        std::vector<uint32_t> crcs;
+        int outFd = -1;
+        std::string tmpPath;
+    };
+    std::vector<Section> sections;
+    uint64_t lsn = 0, chunkBytes = 0;
+    {
+        std::istringstream in(head.substr(0, dataMarker));
+        std::string line;
+        std::getline(in, line);  // magic
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag;
+            if (tag == "lsn") {
+                fields >> lsn;
+            } else if (tag == "chunk_bytes") {
+                fields >> chunkBytes;
+            } else if (tag == "section") {
+                Section section;
+                fields >> section.name >> section.bytes;
+                if (section.name != kSectionNames[0] && section.name != kSectionNames[1] &&
+                    !isBlobSection(section.name) && !WAL::isSnapshotPartName(section.name)) {
+                    error = "unknown section '" + section.name + "'";
+                    return false;
+                }
+                sections.push_back(std::move(section));
+            }
+        }
+    }
+    if (chunkBytes == 0 || sections.empty()) {
+        error = "malformed archive header";
+        return false;
+    }
+
+    uint64_t offset = dataOffset;
+    for (auto& section : sections) {
+        section.offset = offset;
+        offset += section.bytes;
+    }
+    if (offset > archiveBytes) {
+        error = "archive is truncated";
+        return false;
+    }
+
+    // Trailer: one crc line per section, then "end"
+    std::string trailer(archiveBytes - offset, '\0');
+    if (preadFull(fd, &trailer[0], trailer.size(), offset) != static_cast<ssize_t>(trailer.size())) {
+        error = "cannot read archive trailer";
+        return false;
+    }
+    {
+        std::istringstream in(trailer);
+        std::string line;
+        bool sawEnd = false;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string tag, name, hex;
+            fields >> tag;
+            if (tag == "end") {
+                sawEnd = true;
+                break;
+            }
+            if (tag != "crc") continue;
+            fields >> name;
+            for (auto& section : sections) {
+                if (section.name != name) continue;
+                while (fields >> hex) {
+                    section.crcs.push_back(static_cast<uint32_t>(std::strtoul(hex.c_str(), nullptr, 16)));
+                }
+            }
+        }
+        if (!sawEnd) {
+            error = "archive is truncated (no end marker)";
+            return false;
+        }
+    }
+    for (const auto& section : sections) {
+        if (section.crcs.size() != (section.bytes + chunkBytes - 1) / chunkBytes) {
+            error = "checksum count mismatch in section " + section.name;
+            return false;
+        }
+    }
+
+    // Refuse to clobber a live data directory unless asked to
+    ::mkdir(dataDir.c_str(), 0755);
+    for (const auto& section : sections) {
+        if (isBlobSection(section.name)) {
+            ::mkdir(joinPath(dataDir, kBlobDir).c_str(), 0755);
+            break;
+        }
+    }
+    for (auto& section : sections) {
+        std::string target = joinPath(dataDir, section.name);
+        struct stat existing;
+        if (!force && ::stat(target.c_str(), &existing) == 0 && existing.st_size > 0) {
+            error = target + " already exists (use --force to replace it)";
+            return false;
+        }
+    }
+
+    bool failed = false;
+    for (auto& section : sections) {
+        section.tmpPath = joinPath(dataDir, section.name + ".restore");
+        section.outFd = ::open(section.tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (section.outFd == -1 ||
+            ::ftruncate(section.outFd, static_cast<off_t>(section.bytes)) != 0) {
+            error = "cannot create " + section.tmpPath + ": " + std::strerror(errno);
+            failed = true;
+            break;
+        }
+    }
+
+    // Verify and copy chunks in parallel; workers claim chunks from a shared counter
+    if (!failed) {
+        struct Chunk {
+            Section* section;
+            size_t index;
+        };
+        std::vector<Chunk> chunks;
+        for (auto& section : sections) {
+            for (size_t i = 0; i < section.crcs.size(); ++i) {
+                chunks.push_back({&section, i});
+            }
+        }
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<bool> bad{false};
+        std::string badMessage;
+        std::mutex badMutex;
+        auto worker = [&]() {
+            std::string buf;
+            buf.resize(chunkBytes);
+            for (size_t i = nextChunk++; i < chunks.size() && !bad.load(); i = nextChunk++) {
+                const Chunk& chunk = chunks[i];
+                uint64_t start = chunk.index * chunkBytes;
+                size_t len = static_cast<size_t>(std::min<uint64_t>(chunkBytes,
+                                                                    chunk.section->bytes - start));
+                std::string message;
+                if (preadFull(fd, &buf[0], len, chunk.section->offset + start) !=
+                    static_cast<ssize_t>(len)) {
+                    message = "read error in section " + chunk.section->name;
+                } else if (crc32(buf.data(), len) != chunk.section->crcs[chunk.index]) {
+                    message = "checksum mismatch in section " + chunk.section->name +
+                              " chunk " + std::to_string(chunk.index);
+                } else if (!pwriteFull(chunk.section->outFd, buf.data(), len, start)) {
+                    message = "write error in " + chunk.section->tmpPath + ": " + std::strerror(errno);
+                }
+                if (!message.empty()) {
+                    std::lock_guard<std::mutex> lock(badMutex);
+                    if (!bad.exchange(true)) badMessage = message;
+                }
+            }
+        };
+        unsigned workers = std::max(1u, std::min<unsigned>(threads,
+                                                           static_cast<unsigned>(chunks.size())));
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < workers; ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : pool) {
+            t.join();
+        }
+        if (bad.load()) {
+            error = badMessage;
+            failed = true;
+        }
+    }
+
+    for (auto& section : sections) {
+        if (section.outFd == -1) continue;
+        if (!failed && ::fsync(section.outFd) != 0) {
+            error = "fsync failed for " + section.tmpPath;
+            failed = true;
+        }
+        ::close(section.outFd);
+    }
+
+    if (failed) {
+        for (const auto& section : sections) {
+            if (!section.tmpPath.empty()) ::unlink(section.tmpPath.c_str());
+        }
+        return false;
+    }
+
+    // Everything verified: move the files into place
+    for (const auto& section : sections) {
+        std::string target = joinPath(dataDir, section.name);
+        if (section.name == kSectionNames[0] && section.bytes == 0) {
+            // The server had no snapshot yet
+            ::unlink(section.tmpPath.c_str());
+            ::unlink(target.c_str());
+            continue;
+        }
+        if (::rename(section.tmpPath.c_str(), target.c_str()) != 0) {
+            error = "cannot install " + target + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+    if (restoredLsn != nullptr) *restoredLsn = lsn;
+    return true;
+}
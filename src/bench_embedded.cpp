@@ -0,0 +1,118 @@
+// In-process benchmark for the embeddable library.
+// Measures set/get/get_at/history through the C API with no HTTP in the path.
+//
+// Usage: bench_embedded [data_dir] [num_keys] [reader_threads]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+#include "sentineldb.h"
+
+namespace {
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+void report(const std::string& name, size_t ops, double seconds) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(12) << ops << " ops  "
+              << std::setw(10) << std::fixed << std::setprecision(3) << seconds << " s  "
+              << std::setw(12) << std::setprecision(0) << (ops / seconds) << " ops/s  "
+              << std::setw(8) << std::setprecision(3) << (seconds * 1e9 / ops) << " ns/op\n";
+}
+
+void countBytes(void* ctx, const char*, size_t len, int64_t) {
+    *static_cast<size_t*>(ctx) += len;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string dataDir = argc > 1 ? argv[1] : "bench_data";
+    size_t numKeys = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    unsigned readers = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3]))
+                                : std::max(1u, std::thread::hardware_concurrency());
+
+    sdb_db* db = nullptr;
+    if (sdb_open(dataDir.c_str(), &db) != SDB_OK) {
+        std::cerr << "Failed to open " << dataDir << "\n";
+        return 1;
+    }
+
+    std::vector<std::string> keys;
+    keys.reserve(numKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        keys.push_back("bench:" + std::to_string(i));
+    }
+    const std::string value(64, 'v');
+
+    std::cout << "=== SentinelDB embedded benchmark (" << numKeys << " keys, "
+              << readers << " reader threads) ===\n";
+
+    {
+        Timer t;
+        for (const auto& key : keys) {
+            sdb_set(db, key.data(), key.size(), value.data(), value.size());
+        }
+        report("set (WAL, 1 thread)", numKeys, t.seconds());
+    }
+
+    {
+        size_t bytes = 0;
+        Timer t;
+        for (const auto& key : keys) {
+            sdb_get(db, key.data(), key.size(), countBytes, &bytes);
+        }
+        report("get (zero-copy, 1 thread)", numKeys, t.seconds());
+    }
+
+    {
+        std::atomic<size_t> total{0};
+        Timer t;
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r]() {
+                size_t bytes = 0;
+                for (size_t i = r; i < keys.size(); i += readers) {
+                    sdb_get(db, keys[i].data(), keys[i].size(), countBytes, &bytes);
+                }
+                total += bytes;
+            });
+        }
+        for (auto& th : threads) th.join();
+        report("get (zero-copy, N threads)", numKeys, t.seconds());
+    }
+
+    {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        size_t bytes = 0;
+        Timer t;
+        for (const auto& key : keys) {
+            sdb_get_at(db, key.data(), key.size(), now, countBytes, &bytes);
+        }
+        report("get_at", numKeys, t.seconds());
+    }
+
+    {
+        size_t bytes = 0;
+        Timer t;
+        for (const auto& key : keys) {
+            sdb_history(db, key.data(), key.size(), countBytes, &bytes, nullptr);
+        }
+        report("history", numKeys, t.seconds());
+    }
+
+    sdb_close(db);
+    return 0;
+}
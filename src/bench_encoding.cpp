@@ -0,0 +1,115 @@
+// Compares response encodings for /history-shaped payloads: the legacy
+// stringstream JSON builder, the streaming JSON writer and MessagePack.
+// Reports payload size and encode time per response.
+//
+// Usage: bench_encoding [versions] [value_bytes] [iterations]
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "kvstore.h"
+#include "timestamp.h"
+#include "wire_format.h"
+
+namespace {
+
+std::string escapeJSON(const std::string& str) {
+    std::string result;
+    for (char c : str) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default: result += c; break;
+        }
+    }
+    return result;
+}
+
+std::string legacyJSON(const std::string& key, const std::vector<Version>& history) {
+    std::stringstream json;
+    json << "{\"key\":\"" << escapeJSON(key) << "\",\"versions\":[";
+    for (size_t i = 0; i < history.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"timestamp\":\"" << TimestampCodec::format(history[i].timestamp)
+             << "\",\"value\":\"" << escapeJSON(history[i].value) << "\"}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::string writerEncode(WireFormat format, const std::string& key,
+                         const std::vector<Version>& history) {
+    ResponseWriter out(format, 4096);
+    out.beginObject(2);
+    out.field("key", key);
+    out.key("versions");
+    out.beginArray(history.size());
+    char ts[TimestampCodec::kFormattedSize];
+    for (const auto& v : history) {
+        out.beginObject(2);
+        out.field("timestamp", std::string_view(ts, TimestampCodec::format(v.timestamp, ts)));
+        out.field("value", v.value);
+        out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+    return std::move(out.buffer());
+}
+
+template <typename Fn>
+void measure(const std::string& name, int iterations, Fn fn) {
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        bytes = fn().size();
+    }
+    double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / iterations;
+    std::cout << std::left << std::setw(22) << name
+              << std::right << std::setw(10) << bytes << " bytes  "
+              << std::setw(10) << std::fixed << std::setprecision(1) << us << " us/response\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t versions = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    size_t valueBytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    int iterations = argc > 3 ? std::atoi(argv[3]) : 200;
+
+    // Mix of plain text, text needing escapes and raw binary
+    std::vector<Version> history;
+    history.reserve(versions);
+    auto base = std::chrono::system_clock::now();
+    for (size_t i = 0; i < versions; ++i) {
+        std::string value(valueBytes, 'a' + static_cast<char>(i % 26));
+        if (i % 3 == 1 && valueBytes > 4) {
+            value[1] = '"';
+            value[3] = '\n';
+        } else if (i % 3 == 2) {
+            for (size_t b = 0; b < value.size(); ++b) {
+                value[b] = static_cast<char>((i * 31 + b * 7) & 0xff);
+            }
+        }
+        history.emplace_back(base + std::chrono::milliseconds(i), value);
+    }
+    const std::string key = "bench:history";
+
+    std::cout << "=== Encoding benchmark (" << versions << " versions x "
+              << valueBytes << " bytes, " << iterations << " iterations) ===\n";
+    measure("legacy JSON", iterations, [&]() { return legacyJSON(key, history); });
+    measure("streaming JSON", iterations, [&]() {
+        return writerEncode(WireFormat::JSON, key, history);
+    });
+    measure("MessagePack", iterations, [&]() {
+        return writerEncode(WireFormat::MSGPACK, key, history);
+    });
+    return 0;
+}
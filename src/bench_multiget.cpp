@@ -0,0 +1,88 @@
+// Batched lookup benchmark for KVStore::multiGet.
+// Loads num_keys keys into an in-memory store (no WAL), then reads them all
+// back in random order: key by key through get(), and in batches through
+// multiGet() with different probe group sizes. Random order keeps each
+// lookup a cache miss once the table is bigger than the caches.
+//
+// Usage: bench_multiget [num_keys] [batch_size]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdlib>
+#include <algorithm>
+#include "kvstore.h"
+
+namespace {
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+void report(const std::string& name, size_t ops, double seconds) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(12) << ops << " ops  "
+              << std::setw(10) << std::fixed << std::setprecision(3) << seconds << " s  "
+              << std::setw(12) << std::setprecision(0) << (ops / seconds) << " ops/s  "
+              << std::setw(8) << std::setprecision(3) << (seconds * 1e9 / ops) << " ns/op\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t batchSize = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+    if (numKeys == 0 || batchSize == 0) {
+        std::cerr << "Usage: bench_multiget [num_keys] [batch_size]\n";
+        return 1;
+    }
+
+    KVStore store;
+    store.setMaxKeys(numKeys);
+    const std::string value(64, 'v');
+    std::vector<std::string> keys;
+    keys.reserve(numKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        keys.push_back("bench:" + std::to_string(i));
+        store.set(keys.back(), value);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(42));
+
+    std::vector<std::vector<std::string>> batches;
+    for (size_t i = 0; i < numKeys; i += batchSize) {
+        batches.emplace_back(keys.begin() + i, keys.begin() + std::min(numKeys, i + batchSize));
+    }
+
+    std::cout << "=== SentinelDB batched lookup benchmark (" << numKeys << " keys, batches of "
+              << batchSize << ") ===\n";
+
+    size_t found = 0;
+    {
+        Timer t;
+        for (const auto& key : keys) {
+            found += store.get(key).has_value();
+        }
+        report("get (key by key)", numKeys, t.seconds());
+    }
+    for (size_t group : {size_t(1), size_t(4), size_t(8), size_t(16), size_t(32)}) {
+        Timer t;
+        for (const auto& batch : batches) {
+            for (const auto& v : store.multiGet(batch, group)) {
+                found += v.has_value();
+            }
+        }
+        report("multiGet group=" + std::to_string(group), numKeys, t.seconds());
+    }
+
+    if (found != numKeys * 6) {
+        std::cerr << "Lookups missed: " << (numKeys * 6 - found) << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Snapshot benchmark: checkpoint and restore time against partition count.
+// Fills an in-memory store with num_keys keys, then for each partition
+// count writes a snapshot into a scratch directory (unpaced) and loads it
+// back into a fresh store through Recovery::replay.
+//
+// Usage: bench_snapshot [num_keys] [value_bytes]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <cstdlib>
+#include <unistd.h>
+#include "kvstore.h"
+#include "recovery.h"
+#include "wal.h"
+
+namespace {
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+void report(const std::string& name, size_t keys, double seconds) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(12) << keys << " keys  "
+              << std::setw(10) << std::fixed << std::setprecision(3) << seconds << " s  "
+              << std::setw(12) << std::setprecision(0) << (keys / seconds) << " keys/s\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t numKeys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t valueBytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    if (numKeys == 0 || valueBytes == 0) {
+        std::cerr << "Usage: bench_snapshot [num_keys] [value_bytes]\n";
+        return 1;
+    }
+
+    char tmpl[] = "/tmp/sentinel_bench_snapshot_XXXXXX";
+    const std::string dir = ::mkdtemp(tmpl);
+
+    std::unordered_map<std::string, std::string> data;
+    data.reserve(numKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        data["bench:" + std::to_string(i)] = std::string(valueBytes, 'a' + i % 26);
+    }
+
+    std::cout << "=== SentinelDB snapshot benchmark (" << numKeys << " keys, " << valueBytes
+              << "-byte values, " << std::thread::hardware_concurrency() << " cores) ===\n";
+
+    bool ok = true;
+    for (size_t partitions : {size_t(1), size_t(2), size_t(4), size_t(8)}) {
+        {
+            WAL wal(dir + "/wal.log");
+            wal.initialize();
+            wal.setSnapshotPartitions(partitions);
+            Timer t;
+            ok = ok && wal.createSnapshot(data) == Status::OK;
+            report("write, " + std::to_string(partitions) + " partitions", numKeys, t.seconds());
+        }
+        {
+            auto wal = std::make_shared<WAL>(dir + "/wal.log");
+            wal->initialize();
+            KVStore store(wal);
+            store.setMaxKeys(numKeys);
+            Timer t;
+            size_t loaded = Recovery::replay(store, *wal);
+            report("load, " + std::to_string(partitions) + " partitions", numKeys, t.seconds());
+            ok = ok && loaded == numKeys;
+        }
+    }
+
+    std::string cleanup = "rm -rf " + dir;
+    if (std::system(cleanup.c_str()) != 0) {
+        std::cerr << "(could not remove " << dir << ")\n";
+    }
+    if (!ok) {
+        std::cerr << "Snapshot round trip lost keys\n";
+        return 1;
+    }
+    return 0;
+}
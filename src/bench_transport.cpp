@@ -0,0 +1,122 @@
+// Compares request throughput and latency of a running http_server over
+// loopback TCP and over its Unix domain socket listener.
+//
+// Usage: bench_transport <tcp_port> <unix_socket_path> [threads] [requests_per_thread]
+//
+// Start the server with both listeners first:
+//   ./build/http_server --port 8080 --unix-socket /tmp/sentineldb.sock
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <cstdlib>
+#include <sys/socket.h>
+#include "../include/external/httplib.h"
+
+namespace {
+
+struct Result {
+    size_t ok = 0;
+    size_t failed = 0;
+    double seconds = 0.0;
+    std::vector<double> latenciesUs;
+};
+
+std::unique_ptr<httplib::Client> makeClient(const std::string& target, bool unixSocket) {
+    std::unique_ptr<httplib::Client> cli;
+    if (unixSocket) {
+        cli = std::make_unique<httplib::Client>(target);
+        cli->set_address_family(AF_UNIX);
+    } else {
+        cli = std::make_unique<httplib::Client>("127.0.0.1", std::stoi(target));
+        cli->set_tcp_nodelay(true);
+    }
+    cli->set_keep_alive(true);
+    return cli;
+}
+
+Result run(const std::string& target, bool unixSocket, const std::string& op,
+           int threads, int requests) {
+    Result total;
+    std::vector<Result> perThread(threads);
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            auto cli = makeClient(target, unixSocket);
+            auto& r = perThread[t];
+            r.latenciesUs.reserve(requests);
+            for (int i = 0; i < requests; ++i) {
+                std::string key = "bench_" + std::to_string(t) + "_" + std::to_string(i % 1000);
+                auto begin = std::chrono::steady_clock::now();
+                httplib::Result res;
+                if (op == "set") {
+                    res = cli->Post("/set", "{\"key\":\"" + key + "\",\"value\":\"v" +
+                                    std::to_string(i) + "\"}", "application/json");
+                } else {
+                    res = cli->Get("/get?key=" + key);
+                }
+                auto end = std::chrono::steady_clock::now();
+                if (res && (res->status == 200 || res->status == 404)) {
+                    r.ok++;
+                } else {
+                    r.failed++;
+                }
+                r.latenciesUs.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (auto& r : perThread) {
+        total.ok += r.ok;
+        total.failed += r.failed;
+        total.latenciesUs.insert(total.latenciesUs.end(), r.latenciesUs.begin(), r.latenciesUs.end());
+    }
+    std::sort(total.latenciesUs.begin(), total.latenciesUs.end());
+    return total;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[idx];
+}
+
+void report(const std::string& name, const Result& r) {
+    std::cout << std::left << std::setw(16) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(0)
+              << (r.ok / r.seconds) << " req/s"
+              << "  p50 " << std::setw(8) << std::setprecision(1) << percentile(r.latenciesUs, 0.50) << " us"
+              << "  p99 " << std::setw(8) << percentile(r.latenciesUs, 0.99) << " us"
+              << "  failed " << r.failed << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <tcp_port> <unix_socket_path> [threads] [requests_per_thread]\n";
+        return 1;
+    }
+    std::string port = argv[1];
+    std::string socketPath = argv[2];
+    int threads = argc > 3 ? std::atoi(argv[3]) : 4;
+    int requests = argc > 4 ? std::atoi(argv[4]) : 5000;
+
+    std::cout << "=== Transport benchmark (" << threads << " threads x "
+              << requests << " requests) ===\n";
+    for (const std::string op : {"set", "get"}) {
+        report("tcp  " + op, run(port, false, op, threads, requests));
+        report("unix " + op, run(socketPath, true, op, threads, requests));
+    }
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "blob_store.h"
+#include "backup.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+bool pwriteFull(int fd, const char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pwrite(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool preadFull(int fd, char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// blob-000042.log -> 42
+bool parseFileName(const char* name, uint32_t& id) {
+    unsigned value;
+    int consumed = 0;
+    if (std::sscanf(name, "blob-%6u.log%n", &value, &consumed) != 1 ||
+        name[consumed] != '\0' || std::strlen(name) != 15) {
+        return false;
+    }
+    id = value;
+    return true;
+}
+
+} // namespace
+
+std::string BlobRef::toString() const {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%" PRIu32 ":%" PRIu64 ":%" PRIu32 ":%08" PRIx32,
+                  file, offset, length, crc);
+    return buf;
+}
+
+bool BlobRef::parse(const std::string& text, BlobRef& ref) {
+    int consumed = 0;
+    if (std::sscanf(text.c_str(), "%" SCNu32 ":%" SCNu64 ":%" SCNu32 ":%" SCNx32 "%n",
+                    &ref.file, &ref.offset, &ref.length, &ref.crc, &consumed) != 4) {
+        return false;
+    }
+    return static_cast<size_t>(consumed) == text.size();
+}
+
+BlobStore::BlobStore(const std::string& dir, const Options& options)
+    : dir_(dir), options_(options) {}
+
+BlobStore::~BlobStore() {
+    sync();
+    for (auto& entry : files_) {
+        if (entry.second.fd >= 0) ::close(entry.second.fd);
+    }
+}
+
+std::string BlobStore::fileName(uint32_t file) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "blob-%06" PRIu32 ".log", file);
+    return buf;
+}
+
+Status BlobStore::initialize() {
+    if (::mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        spdlog::error("Cannot create blob directory {}: {}", dir_, std::strerror(errno));
+        return Status::ERROR;
+    }
+    DIR* dir = ::opendir(dir_.c_str());
+    if (dir == nullptr) {
+        spdlog::error("Cannot read blob directory {}: {}", dir_, std::strerror(errno));
+        return Status::ERROR;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t next = 1;
+    while (struct dirent* entry = ::readdir(dir)) {
+        uint32_t id;
+        if (!parseFileName(entry->d_name, id)) {
+            continue;
+        }
+        // Files from earlier runs are sealed; records still point into them
+        File file;
+        std::string path = dir_ + "/" + entry->d_name;
+        file.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (file.fd < 0 || ::fstat(file.fd, &st) != 0) {
+            spdlog::error("Cannot open blob file {}: {}", path, std::strerror(errno));
+            if (file.fd >= 0) ::close(file.fd);
+            continue;
+        }
+        file.bytes = static_cast<uint64_t>(st.st_size);
+        files_[id] = file;
+        next = std::max(next, id + 1);
+    }
+    ::closedir(dir);
+    return openActive(next);
+}
+
+Status BlobStore::openActive(uint32_t id) {
+    // Called with mutex_ held
+    std::string path = dir_ + "/" + fileName(id);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        spdlog::error("Cannot create blob file {}: {}", path, std::strerror(errno));
+        activeFd_ = -1;
+        return Status::ERROR;
+    }
+    File file;
+    file.fd = fd;
+    files_[id] = file;
+    activeId_ = id;
+    activeFd_ = fd;
+    return Status::OK;
+}
+
+Status BlobStore::put(const std::string& value, std::string& ref, bool* sealed) {
+    if (sealed != nullptr) *sealed = false;
+    BlobRef blob;
+    blob.length = static_cast<uint32_t>(value.size());
+    blob.crc = BackupRestore::crc32(value.data(), value.size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (activeFd_ < 0 || value.size() > UINT32_MAX) {
+        return Status::ERROR;
+    }
+    File& file = files_[activeId_];
+    if (!pwriteFull(activeFd_, value.data(), value.size(), file.bytes)) {
+        // Nothing points past file.bytes, so the next put overwrites the tail
+        spdlog::error("Blob write to {} failed: {}", fileName(activeId_), std::strerror(errno));
+        return Status::ERROR;
+    }
+    blob.file = activeId_;
+    blob.offset = file.bytes;
+    file.bytes += value.size();
+    ++file.pending;
+    if (unsynced_.empty() || unsynced_.back() != activeId_) {
+        unsynced_.push_back(activeId_);
+    }
+    ++blobsWritten_;
+    bytesWritten_ += value.size();
+    ref = blob.toString();
+
+    if (file.bytes >= options_.fileBytes) {
+        // The sealed file keeps its descriptor for reads
+        if (openActive(activeId_ + 1) == Status::OK && sealed != nullptr) {
+            *sealed = true;
+        }
+    }
+    return Status::OK;
+}
+
+void BlobStore::published(const std::string& ref) {
+    BlobRef blob;
+    if (!BlobRef::parse(ref, blob)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(blob.file);
+    if (it != files_.end() && it->second.pending > 0) {
+        --it->second.pending;
+    }
+}
+
+bool BlobStore::read(const std::string& ref, std::string& out) const {
+    BlobRef blob;
+    if (!BlobRef::parse(ref, blob)) {
+        spdlog::error("Malformed blob reference '{}'", ref);
+        return false;
+    }
+    int fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(blob.file);
+        if (it != files_.end() && blob.offset + blob.length <= it->second.bytes) {
+            fd = it->second.fd;
+        }
+    }
+    // The owning store only collects files nothing references, so fd stays
+    // open for as long as a caller can still hold ref
+    out.resize(blob.length);
+    bool ok = fd >= 0 && preadFull(fd, &out[0], blob.length, blob.offset) &&
+              BackupRestore::crc32(out.data(), out.size()) == blob.crc;
+    if (!ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++readErrors_;
+        spdlog::error("Blob {} unreadable in {} (missing, short or checksum mismatch)",
+                      ref, fileName(blob.file));
+        out.clear();
+    }
+    return ok;
+}
+
+bool BlobStore::available(const std::string& ref) const {
+    BlobRef blob;
+    if (!BlobRef::parse(ref, blob)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(blob.file);
+    return it != files_.end() && blob.offset + blob.length <= it->second.bytes;
+}
+
+void BlobStore::sync() {
+    // Held across the fsyncs so remove() can't close a descriptor under them
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t id : unsynced_) {
+            auto it = files_.find(id);
+            if (it != files_.end()) {
+                fds.push_back(it->second.fd);
+            }
+        }
+        unsynced_.clear();
+    }
+    for (int fd : fds) {
+        ::fsync(fd);
+    }
+}
+
+std::vector<uint32_t> BlobStore::collectable() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<uint32_t> ids;
+    for (const auto& [id, file] : files_) {
+        if (id != activeId_ && file.pending == 0) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+uint64_t BlobStore::remove(const std::vector<uint32_t>& ids) {
+    std::lock_guard<std::mutex> syncLock(syncMutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t freed = 0;
+    for (uint32_t id : ids) {
+        auto it = files_.find(id);
+        if (it == files_.end() || id == activeId_ || it->second.pending > 0) {
+            continue;
+        }
+        std::string path = dir_ + "/" + fileName(id);
+        if (::unlink(path.c_str()) != 0) {
+            spdlog::warn("Cannot remove blob file {}: {}", path, std::strerror(errno));
+            continue;
+        }
+        ::close(it->second.fd);
+        freed += it->second.bytes;
+        bytesReclaimed_ += it->second.bytes;
+        ++filesReclaimed_;
+        files_.erase(it);
+    }
+    return freed;
+}
+
+void BlobStore::pinFiles(std::vector<WALBackupPoint::File>& files) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [id, file] : files_) {
+        WALBackupPoint::File pinned;
+        pinned.name = "blobs/" + fileName(id);
+        pinned.fd = ::open((dir_ + "/" + fileName(id)).c_str(), O_RDONLY | O_CLOEXEC);
+        pinned.bytes = file.bytes;  // later appends are past the backup's LSN
+        if (pinned.fd >= 0) {
+            files.push_back(pinned);
+        }
+    }
+}
+
+size_t BlobStore::fileCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_.size();
+}
+
+BlobStore::Stats BlobStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.files = files_.size();
+    for (const auto& entry : files_) {
+        stats.diskBytes += entry.second.bytes;
+    }
+    stats.blobsWritten = blobsWritten_;
+    stats.bytesWritten = bytesWritten_;
+    stats.filesReclaimed = filesReclaimed_;
+    stats.bytesReclaimed = bytesReclaimed_;
+    stats.readErrors = readErrors_;
+    return stats;
+}
@@ -88,6 +88,7 @@ CommandType CommandParser::getCommandType(const std::string& cmd) {
     if (upper == "SET") return CommandType::SET;
     if (upper == "GET") return CommandType::GET;
     if (upper == "DEL") return CommandType::DEL;
+    if (upper == "DELPREFIX") return CommandType::DELPREFIX;
     if (upper == "HISTORY") return CommandType::HISTORY;
     if (upper == "SNAPSHOT") return CommandType::SNAPSHOT;
     if (upper == "CONFIG") return CommandType::CONFIG;
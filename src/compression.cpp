@@ -0,0 +1,187 @@
+#include "compression.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#ifdef SENTINEL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ---------- StreamCompressor ----------
+
+#ifdef SENTINEL_HAVE_ZLIB
+
+struct StreamCompressor::State {
+    z_stream zs{};
+};
+
+StreamCompressor::StreamCompressor(ContentCoding coding, int level)
+    : state_(std::make_unique<State>()) {
+    if (coding == ContentCoding::IDENTITY) return;
+    // windowBits 15 + 16 selects the gzip wrapper, plain 15 is zlib (deflate)
+    int windowBits = coding == ContentCoding::GZIP ? 15 + 16 : 15;
+    ok_ = deflateInit2(&state_->zs, level, Z_DEFLATED, windowBits, 8,
+                       Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+StreamCompressor::~StreamCompressor() {
+    if (ok_) deflateEnd(&state_->zs);
+}
+
+bool StreamCompressor::deflateInto(std::string_view data, int mode, std::string& out) {
+    if (!ok_) return false;
+    auto& zs = state_->zs;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+
+    char buf[16384];
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = deflate(&zs, mode);
+        if (ret == Z_STREAM_ERROR) {
+            ok_ = false;
+            return false;
+        }
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (zs.avail_out == 0 || (mode == Z_FINISH && ret != Z_STREAM_END));
+    return true;
+}
+
+bool StreamCompressor::write(std::string_view data, std::string& out) {
+    return deflateInto(data, Z_NO_FLUSH, out);
+}
+
+bool StreamCompressor::flush(std::string& out) {
+    return deflateInto(std::string_view(), Z_SYNC_FLUSH, out);
+}
+
+bool StreamCompressor::finish(std::string_view data, std::string& out) {
+    return deflateInto(data, Z_FINISH, out);
+}
+
+#else
+
+struct StreamCompressor::State {};
+
+StreamCompressor::StreamCompressor(ContentCoding, int) {}
+StreamCompressor::~StreamCompressor() = default;
+bool StreamCompressor::deflateInto(std::string_view, int, std::string&) { return false; }
+bool StreamCompressor::write(std::string_view, std::string&) { return false; }
+bool StreamCompressor::flush(std::string&) { return false; }
+bool StreamCompressor::finish(std::string_view, std::string&) { return false; }
+
+#endif
+
+// ---------- CompressionBudget ----------
+
+CompressionBudget::CompressionBudget(size_t slots) : slots_(std::max<size_t>(1, slots)) {}
+
+bool CompressionBudget::tryAcquire() {
+    size_t current = inUse_.load(std::memory_order_relaxed);
+    while (current < slots_) {
+        if (inUse_.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CompressionBudget::release() {
+    inUse_.fetch_sub(1, std::memory_order_release);
+}
+
+// ---------- ResponseCompression ----------
+
+ResponseCompression::ResponseCompression(size_t minBytes, int level, size_t maxConcurrent)
+    : minBytes_(minBytes), level_(std::clamp(level, 1, 9)), budget_(maxConcurrent) {}
+
+bool ResponseCompression::available() {
+#ifdef SENTINEL_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* ResponseCompression::codingName(ContentCoding coding) {
+    switch (coding) {
+        case ContentCoding::GZIP: return "gzip";
+        case ContentCoding::DEFLATE: return "deflate";
+        case ContentCoding::IDENTITY: break;
+    }
+    return "identity";
+}
+
+bool ResponseCompression::isCompressible(const std::string& contentType) {
+    return contentType.rfind("application/json", 0) == 0 ||
+           contentType.rfind("application/msgpack", 0) == 0 ||
+           contentType.rfind("application/x-ndjson", 0) == 0 ||
+           contentType.rfind("text/", 0) == 0;
+}
+
+ContentCoding ResponseCompression::parseAcceptEncoding(const std::string& acceptEncoding) {
+    // Highest q wins; gzip is preferred over deflate on ties
+    double gzipQ = 0.0, deflateQ = 0.0, anyQ = -1.0;
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == std::string::npos) end = acceptEncoding.size();
+        std::string item = acceptEncoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semi = item.find(';');
+        std::string name = item.substr(0, semi);
+        if (semi != std::string::npos) {
+            size_t qpos = item.find("q=", semi);
+            if (qpos != std::string::npos) q = std::strtod(item.c_str() + qpos + 2, nullptr);
+        }
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        if (name == "gzip" || name == "x-gzip") gzipQ = q;
+        else if (name == "deflate") deflateQ = q;
+        else if (name == "*") anyQ = q;
+    }
+    if (gzipQ == 0.0 && anyQ > 0.0 && acceptEncoding.find("gzip") == std::string::npos) {
+        gzipQ = anyQ;
+    }
+    if (gzipQ > 0.0 && gzipQ >= deflateQ) return ContentCoding::GZIP;
+    if (deflateQ > 0.0) return ContentCoding::DEFLATE;
+    return ContentCoding::IDENTITY;
+}
+
+ContentCoding ResponseCompression::negotiate(const std::string& acceptEncoding, size_t bodySize,
+                                             const std::string& contentType) const {
+    if (!available() || acceptEncoding.empty() || bodySize < minBytes_ ||
+        !isCompressible(contentType)) {
+        return ContentCoding::IDENTITY;
+    }
+    return parseAcceptEncoding(acceptEncoding);
+}
+
+bool ResponseCompression::compressBody(ContentCoding coding, std::string& body) {
+    if (coding == ContentCoding::IDENTITY) return false;
+    if (!budget_.tryAcquire()) {
+        Metrics::instance().recordCompressionSkipped();
+        return false;
+    }
+
+    std::string compressed;
+    compressed.reserve(body.size() / 4 + 64);
+    bool ok;
+    {
+        StreamCompressor compressor(coding, level_);
+        ok = compressor.finish(body, compressed);
+    }
+    budget_.release();
+
+    if (!ok) return false;
+    Metrics::instance().recordCompression(body.size(), compressed.size());
+    body.swap(compressed);
+    return true;
+}
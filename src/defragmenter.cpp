@@ -0,0 +1,150 @@
+#include "defragmenter.h"
+#include "kvstore.h"
+#include "logger.h"
+#include "memory_monitor.h"
+#include "metrics.h"
+#include <algorithm>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define SENTINEL_HAVE_MALLINFO2 1
+#endif
+
+Defragmenter::Defragmenter(std::shared_ptr<KVStore> store, const Options& options)
+    : store_(std::move(store)), options_(options) {}
+
+Defragmenter::~Defragmenter() {
+    stop();
+}
+
+Defragmenter::HeapStats Defragmenter::heapStats() {
+    HeapStats stats;
+#ifdef SENTINEL_HAVE_MALLINFO2
+    // Summed over every arena; mmap'd chunks are in use by definition
+    struct mallinfo2 info = ::mallinfo2();
+    stats.allocatedBytes = info.uordblks + info.hblkhd;
+    stats.residentBytes = MemoryMonitor::processRss();
+    stats.available = stats.residentBytes > 0;
+#endif
+    return stats;
+}
+
+void Defragmenter::start() {
+    HeapStats heap = heapStats();
+    if (!heap.available) {
+        spdlog::info("Defragmenter: allocator statistics unavailable, automatic passes off");
+    }
+    spdlog::info("Defragmenter threshold={:.2f} min_waste_mb={} cpu_percent={:.0f}",
+                 options_.minFragmentation, options_.minWastedBytes >> 20,
+                 options_.maxCpuPercent);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = false;
+    thread_ = std::thread(&Defragmenter::run, this);
+}
+
+void Defragmenter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Defragmenter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        cv_.wait_for(lock, options_.interval, [this] { return stop_; });
+        if (stop_) {
+            break;
+        }
+        lock.unlock();
+        tick();
+        lock.lock();
+    }
+}
+
+bool Defragmenter::pause(std::chrono::nanoseconds duration) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, duration, [this] { return stop_; });
+}
+
+void Defragmenter::tick() {
+    HeapStats heap = heapStats();
+    if (!heap.available) {
+        return;
+    }
+    Metrics::instance().setAllocatorState(heap.residentBytes, heap.allocatedBytes);
+    if (heap.fragmentation() < options_.minFragmentation ||
+        heap.wastedBytes() < options_.minWastedBytes) {
+        backoffTicks_ = 1;
+        ticksToSkip_ = 0;
+        return;
+    }
+    if (ticksToSkip_ > 0) {
+        --ticksToSkip_;
+        return;
+    }
+    spdlog::info("Defragmenting: fragmentation={:.2f} wasted_mb={}", heap.fragmentation(),
+                 heap.wastedBytes() >> 20);
+    PassResult result = runPass();
+    if (result.rssBytes < heap.wastedBytes() / 8) {
+        // What is left isn't ours to free (or is still referenced); don't
+        // spend a pass on it every interval
+        ticksToSkip_ = backoffTicks_;
+        backoffTicks_ = std::min<size_t>(backoffTicks_ * 2, 32);
+    } else {
+        backoffTicks_ = 1;
+    }
+}
+
+Defragmenter::PassResult Defragmenter::runPass() {
+    PassResult result;
+    const auto started = std::chrono::steady_clock::now();
+    const uint64_t rssBefore = MemoryMonitor::processRss();
+
+    // Sleep after each step long enough to stay under the CPU budget
+    const double percent = std::clamp(options_.maxCpuPercent, 1.0, 100.0);
+    const double idlePerBusy = (100.0 - percent) / percent;
+
+    DefragProgress progress;
+    size_t cursor = 0;
+    bool more = true;
+    while (more) {
+        auto stepStart = std::chrono::steady_clock::now();
+        more = store_->defragStep(cursor, options_.keysPerStep, progress);
+        auto busy = std::chrono::steady_clock::now() - stepStart;
+        if (more && !pause(std::chrono::duration_cast<std::chrono::nanoseconds>(busy * idlePerBusy))) {
+            break;  // stopping
+        }
+    }
+    result.keysVisited = progress.keysVisited;
+    result.keysCompacted = progress.keysCompacted;
+    result.containerBytes = progress.bytesReclaimed + store_->shrinkIndexes();
+
+#if defined(__GLIBC__)
+    // Hand freed pages, including those in the middle of the heap, back
+    ::malloc_trim(0);
+#endif
+    const uint64_t rssAfter = MemoryMonitor::processRss();
+    result.rssBytes = rssBefore > rssAfter ? rssBefore - rssAfter : 0;
+    result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started);
+
+    HeapStats heap = heapStats();
+    auto& metrics = Metrics::instance();
+    metrics.recordDefragPass(result.keysCompacted, result.containerBytes, result.rssBytes);
+    if (heap.available) {
+        metrics.setAllocatorState(heap.residentBytes, heap.allocatedBytes);
+    }
+    spdlog::info("Defrag pass keys={} compacted={} container_kb={} rss_released_mb={} "
+                 "fragmentation={:.2f} duration_ms={}",
+                 result.keysVisited, result.keysCompacted, result.containerBytes >> 10,
+                 result.rssBytes >> 20, heap.fragmentation(), result.duration.count());
+    return result;
+}
@@ -0,0 +1,652 @@
+#include "history_export.h"
+#include "backup.h"
+#include "io_scheduler.h"
+#include "kvstore.h"
+#include "logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'S', 'D', 'B', 'C', 'O', 'L', '0', '1'};
+constexpr uint64_t kMaxGroupValueBytes = 256u << 20;  // u32 value offsets
+
+enum Column { KEYS, RUNS, TIMES, VALUES };
+
+int64_t toNs(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point fromNs(int64_t ns) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+void putU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void putU64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(v >> (8 * i)));
+}
+
+void putString(std::string& out, const std::string& s) {
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+uint64_t getU64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    return v;
+}
+
+// Bounds-checked cursor over the footer
+struct Cursor {
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    bool need(size_t n) {
+        ok = ok && static_cast<size_t>(end - p) >= n;
+        return ok;
+    }
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        p += 4;
+        return getU32(p - 4);
+    }
+    uint64_t u64() {
+        if (!need(8)) return 0;
+        p += 8;
+        return getU64(p - 8);
+    }
+    std::string str() {
+        uint32_t n = u32();
+        if (!need(n)) return {};
+        p += n;
+        return std::string(p - n, n);
+    }
+};
+
+// Rows of the row group being built
+class GroupBuilder {
+public:
+    bool empty() const { return times_.empty(); }
+    size_t rows() const { return times_.size(); }
+    uint64_t valueBytes() const { return values_.size(); }
+
+    void add(const std::string& key, std::chrono::system_clock::time_point timestamp,
+             const std::string& value) {
+        if (keys_.empty() || keys_.back() != key) {
+            keys_.push_back(key);
+            runs_.push_back(0);
+        }
+        ++runs_.back();
+        times_.push_back(toNs(timestamp));
+        valueOffsets_.push_back(static_cast<uint32_t>(values_.size()));
+        values_.append(value);
+    }
+
+    // Encode the four column chunks, appending to out, and describe them
+    void encode(std::string& out, uint64_t fileOffset, HistoryFile::Group& group) {
+        group.offset = fileOffset;
+        group.keys = static_cast<uint32_t>(keys_.size());
+        group.rows = static_cast<uint32_t>(times_.size());
+        group.minNs = *std::min_element(times_.begin(), times_.end());
+        group.maxNs = *std::max_element(times_.begin(), times_.end());
+        group.firstKey = keys_.front();
+        group.lastKey = keys_.back();
+
+        auto chunk = [&](Column column, size_t start) {
+            HistoryFile::Chunk& c = group.chunks[column];
+            c.offset = fileOffset + start;
+            c.bytes = out.size() - start;
+            c.crc = BackupRestore::crc32(out.data() + start, c.bytes);
+        };
+        const size_t base = out.size();
+        fileOffset -= base;
+
+        size_t start = out.size();
+        putU32(out, group.keys);
+        uint32_t offset = 0;
+        putU32(out, 0);
+        for (const auto& key : keys_) {
+            offset += static_cast<uint32_t>(key.size());
+            putU32(out, offset);
+        }
+        for (const auto& key : keys_) {
+            out.append(key);
+        }
+        chunk(KEYS, start);
+
+        start = out.size();
+        for (uint32_t run : runs_) {
+            putU32(out, run);
+        }
+        chunk(RUNS, start);
+
+        start = out.size();
+        int64_t previous = 0;
+        for (int64_t ns : times_) {
+            int64_t delta = ns - previous;
+            previous = ns;
+            putVarint(out, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+        }
+        chunk(TIMES, start);
+
+        start = out.size();
+        for (uint32_t valueOffset : valueOffsets_) {
+            putU32(out, valueOffset);
+        }
+        putU32(out, static_cast<uint32_t>(values_.size()));
+        out.append(values_);
+        chunk(VALUES, start);
+
+        keys_.clear();
+        runs_.clear();
+        times_.clear();
+        valueOffsets_.clear();
+        values_.clear();
+    }
+
+private:
+    std::vector<std::string> keys_;
+    std::vector<uint32_t> runs_;
+    std::vector<int64_t> times_;
+    std::vector<uint32_t> valueOffsets_;
+    std::string values_;
+};
+
+bool writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// ---------- HistoryExport ----------
+
+bool HistoryExport::write(const KVStore& store, const std::string& path, const Options& options,
+                          Progress& progress, std::string& error) {
+    const auto through = options.through == std::chrono::system_clock::time_point{}
+        ? std::chrono::system_clock::now() : options.through;
+    const size_t rowsPerGroup = std::max<size_t>(1, options.rowsPerGroup);
+    const size_t keysPerBatch = std::max<size_t>(1, options.keysPerBatch);
+
+    // Sorted, so groups cover disjoint key ranges a reader can search
+    std::vector<std::string> keys = store.listKeys(options.prefix);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    progress.keysTotal.store(keys.size());
+
+    const std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        error = "cannot create " + tmpPath + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // Everything goes out through here: paced, and its writeback started
+    // at once so the final fsync has little left to do
+    uint64_t written = 0;
+    bool ok = true;
+    auto emit = [&](const std::string& data) {
+        if (!ok || data.empty()) {
+            return;
+        }
+        if (options.io) {
+            options.io->acquire(data.size());
+        }
+        ok = writeAll(fd, data);
+        IoScheduler::startWriteback(fd, written, data.size());
+        written += data.size();
+        progress.bytes.store(written);
+    };
+
+    std::vector<HistoryFile::Group> groups;
+    GroupBuilder builder;
+    std::string encoded;
+    auto flushGroup = [&]() {
+        if (builder.empty()) {
+            return;
+        }
+        groups.emplace_back();
+        encoded.clear();
+        builder.encode(encoded, written, groups.back());
+        emit(encoded);
+        progress.rowGroups.store(groups.size());
+    };
+
+    emit(std::string(kMagic, sizeof(kMagic)));
+
+    // Versions are copied out under the shared lock a batch at a time and
+    // encoded and written after it is released
+    struct Row {
+        size_t key;  // index into keys
+        std::chrono::system_clock::time_point timestamp;
+        std::string value;
+    };
+    std::vector<Row> rows;
+    uint64_t totalRows = 0;
+    uint64_t keysWithRows = 0;
+    for (size_t begin = 0; begin < keys.size() && ok; begin += keysPerBatch) {
+        const size_t end = std::min(keys.size(), begin + keysPerBatch);
+        std::vector<std::string> batch(keys.begin() + begin, keys.begin() + end);
+        rows.clear();
+        size_t next = begin;
+        store.visitVersions(batch, options.from, through,
+                            [&](const std::string& key, const Version& version) {
+            while (keys[next] != key) ++next;
+            rows.push_back({next, version.timestamp, version.value});
+        });
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const bool newKey = i == 0 || rows[i].key != rows[i - 1].key;
+            // Groups end between keys, so each key's history is in one group
+            if (newKey && (builder.rows() >= rowsPerGroup ||
+                           builder.valueBytes() >= kMaxGroupValueBytes)) {
+                flushGroup();
+            }
+            keysWithRows += newKey ? 1 : 0;
+            builder.add(keys[rows[i].key], rows[i].timestamp, rows[i].value);
+        }
+        totalRows += rows.size();
+        progress.keys.store(end);
+        progress.rows.store(totalRows);
+    }
+    flushGroup();
+
+    std::string footer;
+    putU32(footer, kFormatVersion);
+    putU64(footer, static_cast<uint64_t>(toNs(options.from)));
+    putU64(footer, static_cast<uint64_t>(toNs(through)));
+    putU64(footer, static_cast<uint64_t>(toNs(std::chrono::system_clock::now())));
+    putString(footer, options.prefix);
+    putU64(footer, keysWithRows);
+    putU64(footer, totalRows);
+    putU32(footer, static_cast<uint32_t>(groups.size()));
+    for (const auto& group : groups) {
+        putU64(footer, group.offset);
+        putU32(footer, group.keys);
+        putU32(footer, group.rows);
+        putU64(footer, static_cast<uint64_t>(group.minNs));
+        putU64(footer, static_cast<uint64_t>(group.maxNs));
+        for (const auto& chunk : group.chunks) {
+            putU64(footer, chunk.bytes);
+            putU32(footer, chunk.crc);
+        }
+        putString(footer, group.firstKey);
+        putString(footer, group.lastKey);
+    }
+    putU32(footer, BackupRestore::crc32(footer.data(), footer.size()));
+    putU32(footer, static_cast<uint32_t>(footer.size()));
+    footer.append(kMagic, sizeof(kMagic));
+    emit(footer);
+
+    ok = ok && ::fsync(fd) == 0;
+    if (!ok) {
+        error = "cannot write " + tmpPath + ": " + std::strerror(errno);
+    }
+    ::close(fd);
+    if (ok && ::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        error = "cannot install " + path + ": " + std::strerror(errno);
+        ok = false;
+    }
+    if (!ok) {
+        ::unlink(tmpPath.c_str());
+    }
+    return ok;
+}
+
+// ---------- HistoryFile ----------
+
+HistoryFile::~HistoryFile() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+bool HistoryFile::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(2 * sizeof(kMagic) + 4)) {
+        ::close(fd);
+        error = path + " is too short to be a history export";
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        size_ = 0;
+        error = "cannot map " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    data_ = static_cast<const char*>(mapped);
+
+    const char* tail = data_ + size_ - sizeof(kMagic);
+    if (std::memcmp(data_, kMagic, sizeof(kMagic)) != 0 ||
+        std::memcmp(tail, kMagic, sizeof(kMagic)) != 0) {
+        error = path + " is not a history export (or is truncated)";
+        return false;
+    }
+    const uint32_t footerBytes = getU32(tail - 4);
+    if (footerBytes < 8 || footerBytes > size_ - 2 * sizeof(kMagic) - 4) {
+        error = "malformed footer in " + path;
+        return false;
+    }
+    const char* footer = tail - 4 - footerBytes;
+    if (BackupRestore::crc32(footer, footerBytes - 4) != getU32(footer + footerBytes - 4)) {
+        error = "footer checksum mismatch in " + path;
+        return false;
+    }
+
+    Cursor in{footer, footer + footerBytes - 4};
+    if (in.u32() != HistoryExport::kFormatVersion) {
+        error = "unsupported export format version in " + path;
+        return false;
+    }
+    from_ = fromNs(static_cast<int64_t>(in.u64()));
+    through_ = fromNs(static_cast<int64_t>(in.u64()));
+    created_ = fromNs(static_cast<int64_t>(in.u64()));
+    prefix_ = in.str();
+    keys_ = in.u64();
+    rows_ = in.u64();
+    const uint32_t count = in.u32();
+    for (uint32_t i = 0; i < count && in.ok; ++i) {
+        Group group;
+        group.offset = in.u64();
+        group.keys = in.u32();
+        group.rows = in.u32();
+        group.minNs = static_cast<int64_t>(in.u64());
+        group.maxNs = static_cast<int64_t>(in.u64());
+        uint64_t offset = group.offset;
+        for (auto& chunk : group.chunks) {
+            chunk.offset = offset;
+            chunk.bytes = in.u64();
+            chunk.crc = in.u32();
+            offset += chunk.bytes;
+        }
+        group.firstKey = in.str();
+        group.lastKey = in.str();
+        // Fixed-width parts must fit their chunks, or reads would run off them
+        const Chunk* c = group.chunks;
+        if (offset > static_cast<uint64_t>(footer - data_) ||
+            c[KEYS].bytes < 8 + 4ull * group.keys || c[RUNS].bytes != 4ull * group.keys ||
+            c[VALUES].bytes < 4ull * (group.rows + 1ull)) {
+            in.ok = false;
+        }
+        groups_.push_back(std::move(group));
+    }
+    if (!in.ok) {
+        error = "malformed footer in " + path;
+        groups_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool HistoryFile::verify(std::string& error) const {
+    static const char* const names[] = {"keys", "runs", "times", "values"};
+    for (size_t g = 0; g < groups_.size(); ++g) {
+        for (int column = KEYS; column <= VALUES; ++column) {
+            const Chunk& chunk = groups_[g].chunks[column];
+            if (BackupRestore::crc32(data_ + chunk.offset, chunk.bytes) != chunk.crc) {
+                error = std::string("checksum mismatch in the ") + names[column] +
+                        " column of row group " + std::to_string(g);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::string HistoryFile::keyAt(const Group& group, uint32_t index) const {
+    const char* chunk = data_ + group.chunks[KEYS].offset;
+    const char* offsets = chunk + 4;
+    uint32_t begin = getU32(offsets + 4 * index);
+    uint32_t end = getU32(offsets + 4 * (index + 1));
+    const uint64_t base = 4 + 4ull * (group.keys + 1);
+    if (begin > end || base + end > group.chunks[KEYS].bytes) {
+        return {};
+    }
+    return std::string(chunk + base + begin, end - begin);
+}
+
+void HistoryFile::decodeTimes(const Group& group, uint32_t rows, std::vector<int64_t>& times) const {
+    times.clear();
+    const char* p = data_ + group.chunks[TIMES].offset;
+    const char* end = p + group.chunks[TIMES].bytes;
+    int64_t previous = 0;
+    while (times.size() < rows && p < end) {
+        uint64_t v = 0;
+        int shift = 0;
+        while (p < end && shift < 64) {
+            unsigned char b = static_cast<unsigned char>(*p++);
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            shift += 7;
+            if ((b & 0x80) == 0) break;
+        }
+        previous += static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+        times.push_back(previous);
+    }
+}
+
+std::string HistoryFile::valueAt(const Group& group, uint32_t row) const {
+    const char* chunk = data_ + group.chunks[VALUES].offset;
+    uint32_t begin = getU32(chunk + 4 * row);
+    uint32_t end = getU32(chunk + 4 * (row + 1));
+    const uint64_t base = 4ull * (group.rows + 1);
+    if (begin > end || base + end > group.chunks[VALUES].bytes) {
+        return {};
+    }
+    return std::string(chunk + base + begin, end - begin);
+}
+
+uint32_t HistoryFile::lowerBound(const Group& group, const std::string& key) const {
+    uint32_t lo = 0, hi = group.keys;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (keyAt(group, mid) < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool HistoryFile::find(const std::string& key, Position& position) const {
+    // The first group whose last key is not before key
+    auto group = std::lower_bound(groups_.begin(), groups_.end(), key,
+                                  [](const Group& g, const std::string& k) { return g.lastKey < k; });
+    if (group == groups_.end() || key < group->firstKey) {
+        return false;
+    }
+    const uint32_t index = lowerBound(*group, key);
+    if (index == group->keys || keyAt(*group, index) != key) {
+        return false;
+    }
+    const char* runs = data_ + group->chunks[RUNS].offset;
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < index; ++i) {
+        first += getU32(runs + 4 * i);
+    }
+    const uint32_t count = getU32(runs + 4 * index);
+    if (first + count > group->rows) {
+        return false;
+    }
+    position.group = static_cast<size_t>(group - groups_.begin());
+    position.key = index;
+    position.firstRow = first;
+    position.rows = count;
+    return true;
+}
+
+bool HistoryFile::history(const std::string& key, std::vector<Version>& versions) const {
+    versions.clear();
+    Position position;
+    if (!find(key, position)) {
+        return false;
+    }
+    const Group& group = groups_[position.group];
+    std::vector<int64_t> times;
+    decodeTimes(group, position.firstRow + position.rows, times);
+    for (uint32_t row = position.firstRow; row < position.firstRow + position.rows && row < times.size(); ++row) {
+        versions.emplace_back(fromNs(times[row]), valueAt(group, row));
+    }
+    return true;
+}
+
+void HistoryFile::scan(const std::string& start,
+                       const std::function<bool(const std::string&, const std::vector<Version>&)>& fn) const {
+    auto group = std::lower_bound(groups_.begin(), groups_.end(), start,
+                                  [](const Group& g, const std::string& k) { return g.lastKey < k; });
+    std::vector<int64_t> times;
+    std::vector<Version> versions;
+    for (uint32_t index = group == groups_.end() ? 0 : lowerBound(*group, start);
+         group != groups_.end(); ++group, index = 0) {
+        decodeTimes(*group, group->rows, times);
+        const char* runs = data_ + group->chunks[RUNS].offset;
+        uint32_t row = 0;
+        for (uint32_t k = 0; k < index; ++k) {
+            row += getU32(runs + 4 * k);
+        }
+        for (uint32_t k = index; k < group->keys; ++k) {
+            const uint32_t count = getU32(runs + 4 * k);
+            versions.clear();
+            for (uint32_t i = 0; i < count && row < times.size(); ++i, ++row) {
+                versions.emplace_back(fromNs(times[row]), valueAt(*group, row));
+            }
+            if (!fn(keyAt(*group, k), versions)) {
+                return;
+            }
+        }
+    }
+}
+
+void HistoryFile::forEachRow(
+        size_t index, const std::function<void(const std::string&, const Version&)>& fn) const {
+    const Group& group = groups_.at(index);
+    std::vector<int64_t> times;
+    decodeTimes(group, group.rows, times);
+    const char* runs = data_ + group.chunks[RUNS].offset;
+    uint32_t row = 0;
+    for (uint32_t k = 0; k < group.keys; ++k) {
+        const std::string key = keyAt(group, k);
+        const uint32_t count = getU32(runs + 4 * k);
+        for (uint32_t i = 0; i < count && row < times.size(); ++i, ++row) {
+            fn(key, Version(fromNs(times[row]), valueAt(group, row)));
+        }
+    }
+}
+
+// ---------- HistoryExportJob ----------
+
+HistoryExportJob::HistoryExportJob(std::shared_ptr<KVStore> store) : store_(std::move(store)) {}
+
+HistoryExportJob::~HistoryExportJob() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool HistoryExportJob::start(const std::string& path, HistoryExport::Options options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (status_.state == State::RUNNING) {
+        return false;
+    }
+    if (thread_.joinable()) {
+        thread_.join();  // finished; only its exit is left
+    }
+    if (options.through == std::chrono::system_clock::time_point{}) {
+        options.through = std::chrono::system_clock::now();
+    }
+    status_ = Status{};
+    status_.state = State::RUNNING;
+    status_.path = path;
+    status_.from = options.from;
+    status_.through = options.through;
+    status_.prefix = options.prefix;
+    progress_.keysTotal.store(0);
+    progress_.keys.store(0);
+    progress_.rows.store(0);
+    progress_.rowGroups.store(0);
+    progress_.bytes.store(0);
+    started_ = std::chrono::steady_clock::now();
+
+    thread_ = std::thread([this, path, options]() {
+        spdlog::info("EXPORT started path={} prefix='{}'", path, options.prefix);
+        std::string error;
+        bool ok = HistoryExport::write(*store_, path, options, progress_, error);
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.state = ok ? State::DONE : State::FAILED;
+        status_.error = error;
+        status_.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_);
+        if (ok) {
+            spdlog::info("EXPORT complete path={} keys={} rows={} bytes={} ms={}", path,
+                         progress_.keys.load(), progress_.rows.load(), progress_.bytes.load(),
+                         status_.elapsed.count());
+        } else {
+            spdlog::error("EXPORT failed path={}: {}", path, error);
+        }
+    });
+    return true;
+}
+
+HistoryExportJob::Status HistoryExportJob::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Status status = status_;
+    status.keysTotal = progress_.keysTotal.load();
+    status.keys = progress_.keys.load();
+    status.rows = progress_.rows.load();
+    status.rowGroups = progress_.rowGroups.load();
+    status.bytes = progress_.bytes.load();
+    if (status.state == State::RUNNING) {
+        status.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - started_);
+    }
+    return status;
+}
+
+const char* HistoryExportJob::stateName(State state) {
+    switch (state) {
+        case State::IDLE: return "idle";
+        case State::RUNNING: return "running";
+        case State::DONE: return "done";
+        case State::FAILED: return "failed";
+    }
+    return "unknown";
+}
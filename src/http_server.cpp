@@ -1,25 +1,52 @@
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 #include <chrono>
 #include <algorithm>
 #include <atomic>
 #include <csignal>
 #include <thread>
+#include <functional>
 #include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "../include/external/httplib.h"
 #include "../include/kvstore.h"
 #include "../include/wal.h"
 #include "../include/guard.h"
+#include "../include/recovery.h"
 #include "../include/logger.h"
 #include "../include/metrics.h"
+#include "../include/timestamp.h"
+#include "../include/wire_format.h"
+#include "../include/compression.h"
+#include "../include/backup.h"
+#include "../include/invalidation.h"
+#include "../include/spill_store.h"
+#include "../include/blob_store.h"
+#include "../include/io_scheduler.h"
+#include "../include/memory_monitor.h"
+#include "../include/defragmenter.h"
+#include "../include/history_export.h"
+#include "../include/replication.h"
+#include "../include/keyspace_stats.h"
+#include "../include/ingest.h"
 
 // Global atomic flag for shutdown signal handling
 std::atomic<bool> shutdownRequested{false};
 
+// One online backup at a time across all listeners
+std::atomic<bool> backupInProgress{false};
+
 // Signal handler for SIGINT and SIGTERM
 void signalHandler(int signal) {
     if (signal == SIGINT || signal == SIGTERM) {
@@ -27,6 +54,15 @@ void signalHandler(int signal) {
     }
 }
 
+// Security limits
+const size_t MAX_KEY_SIZE = 256;      // 256 bytes max key
+const size_t MAX_VALUE_SIZE = 1048576; // 1MB max value
+const size_t MAX_BODY_SIZE = 1100000;  // slightly above value limit
+const size_t MAX_MGET_KEYS = 1000;     // keys per /mget request
+const size_t MAX_TIMELINE_KEYS = 100000;   // keys merged by one /timeline request
+const size_t MAX_TIMELINE_LIMIT = 10000;   // versions per /timeline page
+const size_t MAX_INGEST_BATCH = 10000;     // records per /ingest batch
+
 // Helper function to parse JSON manually (simple key-value pairs)
 std::unordered_map<std::string, std::string> parseSimpleJSON(const std::string& json) {
     std::unordered_map<std::string, std::string> result;
@@ -65,6 +101,16 @@ std::unordered_map<std::string, std::string> parseSimpleJSON(const std::string&
             } else if (inValue) {
                 value += c;
             }
+        } else if (!key.empty() && (std::isalnum(static_cast<unsigned char>(c)) ||
+                                    c == '-' || c == '.' || c == '+')) {
+            // Bare literal (true, false, null, numbers), kept as its text
+            inValue = true;
+            value += c;
+        } else if (inValue && (c == ',' || c == '}' || c == ' ' || c == '\n' || c == '\t')) {
+            result[key] = value;
+            key.clear();
+            value.clear();
+            inValue = false;
         }
         
         pos++;
@@ -91,318 +137,307 @@ std::string escapeJSON(const std::string& str) {
     return result;
 }
 
-// Helper function to format timestamp as ISO 8601
-std::string formatTimestamp(const std::chrono::system_clock::time_point& tp) {
-    auto time_t = std::chrono::system_clock::to_time_t(tp);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()) % 1000;
-    
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    ss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    return ss.str();
+// Pick the response encoding from the Accept header
+WireFormat negotiateFormat(const httplib::Request& req) {
+    const std::string& accept = req.get_header_value("Accept");
+    if (accept.find("application/msgpack") != std::string::npos ||
+        accept.find("application/x-msgpack") != std::string::npos) {
+        return WireFormat::MSGPACK;
+    }
+    return WireFormat::JSON;
 }
 
-// Helper function to parse ISO 8601 timestamp
-std::chrono::system_clock::time_point parseTimestamp(const std::string& timeStr) {
-    std::tm tm = {};
-    std::istringstream ss(timeStr);
-    
-    // Parse date and time
-    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-    
-    auto tp = std::chrono::system_clock::from_time_t(std::mktime(&tm));
-    
-    // Parse milliseconds if present
-    if (ss.peek() == '.') {
-        ss.ignore();
-        int ms;
-        ss >> ms;
-        tp += std::chrono::milliseconds(ms);
+// Parse a request body as MessagePack or JSON depending on Content-Type
+std::unordered_map<std::string, std::string> parseRequestBody(const httplib::Request& req) {
+    const std::string& contentType = req.get_header_value("Content-Type");
+    if (contentType.find("msgpack") != std::string::npos) {
+        std::unordered_map<std::string, std::string> params;
+        if (!WireCodec::parseMsgPackParams(req.body, params)) {
+            throw std::invalid_argument("malformed MessagePack body");
+        }
+        return params;
     }
-    
-    return tp;
+    return parseSimpleJSON(req.body);
 }
 
-int main(int argc, char* argv[]) {
-    // Parse command line arguments
-    int port = 8080;
-    std::string walPath = "data/wal.log";
-    // Security limits
-    const size_t MAX_KEY_SIZE = 256;      // 256 bytes max key
-    const size_t MAX_VALUE_SIZE = 1048576; // 1MB max value
-    const size_t MAX_BODY_SIZE = 1100000;  // slightly above value limit
-    SentinelDB::initLogger();
-    spdlog::info("SentinelDB starting up");
-    
-    for (int i = 1; i < argc; ++i) {
-        std::string arg = argv[i];
-        if (arg == "--port" && i + 1 < argc) {
-            port = std::stoi(argv[++i]);
-        } else if (arg == "--wal" && i + 1 < argc) {
-            walPath = argv[++i];
-        } else if (arg == "--help") {
-            spdlog::info(
-                "Usage: {} [OPTIONS]\n"
-                "Options:\n"
-                "  --port <num>    HTTP port (default: 8080)\n"
-                "  --wal <path>    WAL file path (default: data/wal.log)\n"
-                "  --help          Show this help",
-                argv[0]);
-            return 0;
+// Serve a chunked stream, compressing each chunk on the fly when the client
+// accepts it. `next` fills one chunk and returns false after the last one.
+// The compressor keeps one budget slot for the life of the stream; if none is
+// free the stream is sent uncompressed.
+void setChunkedContent(const httplib::Request& req, httplib::Response& res,
+                       const std::shared_ptr<ResponseCompression>& compression,
+                       const std::string& contentType,
+                       std::function<bool(std::string& chunk)> next) {
+    std::shared_ptr<StreamCompressor> compressor;
+    if (compression) {
+        res.set_header("Vary", "Accept-Encoding");
+        // Streams are assumed to be large, so the size threshold does not apply
+        ContentCoding coding = compression->negotiate(req.get_header_value("Accept-Encoding"),
+                                                      SIZE_MAX, contentType);
+        if (coding != ContentCoding::IDENTITY) {
+            if (compression->budget().tryAcquire()) {
+                compressor = std::make_shared<StreamCompressor>(coding, compression->level());
+                res.set_header("Content-Encoding", ResponseCompression::codingName(coding));
+            } else {
+                Metrics::instance().recordCompressionSkipped();
+            }
         }
     }
 
-    // Ensure WAL directory exists
-    {
-        size_t lastSlash = walPath.find_last_of("/\\");
-        if (lastSlash != std::string::npos) {
-            std::string dirPath = walPath.substr(0, lastSlash);
-            struct stat st;
-            if (stat(dirPath.c_str(), &st) != 0) {
-                mkdir(dirPath.c_str(), 0755);
+    auto bytes = std::make_shared<std::pair<size_t, size_t>>(0, 0);
+    res.set_chunked_content_provider(contentType,
+        [next, compressor, bytes](size_t, httplib::DataSink& sink) {
+            std::string chunk;
+            bool more = next(chunk);
+            if (compressor) {
+                std::string out;
+                bytes->first += chunk.size();
+                bool ok = more ? compressor->write(chunk, out) && compressor->flush(out)
+                               : compressor->finish(chunk, out);
+                if (!ok) return false;
+                bytes->second += out.size();
+                chunk.swap(out);
             }
-        }
+            if (!chunk.empty() && !sink.write(chunk.data(), chunk.size())) return false;
+            if (!more) sink.done();
+            return true;
+        },
+        [compression, compressor, bytes](bool) {
+            if (compressor) {
+                Metrics::instance().recordCompression(bytes->first, bytes->second);
+                compression->budget().release();
+            }
+        });
+}
+
+// Parse a timestamp query parameter; malformed input becomes a 400 via the
+// route's exception handler
+std::chrono::system_clock::time_point parseTimestamp(const std::string& timeStr) {
+    auto tp = TimestampCodec::parse(timeStr);
+    if (!tp) {
+        throw std::invalid_argument("unrecognized timestamp '" + timeStr + "'");
     }
-    
-    // Initialize KVStore with optional WAL
-    std::shared_ptr<WAL> wal;
-    if (!walPath.empty()) {
-        wal = std::make_shared<WAL>(walPath);
-        Status walStatus = wal->initialize();
-        spdlog::info("WAL initialized path={}", walPath);
-        spdlog::info("WAL enabled path={}", walPath);
-        
-        // Replay WAL if it exists
-        if (walStatus == Status::OK) {
-            std::vector<std::string> snapshotCommands = wal->readSnapshot();
-            std::vector<std::string> walCommands = wal->readLog();
-            
-            if (!snapshotCommands.empty() || !walCommands.empty()) {
-                spdlog::info("Replaying WAL and snapshot");
+    return *tp;
+}
+
+// Body of POST /export and GET /export
+std::string exportStatusJSON(const HistoryExportJob::Status& status) {
+    std::stringstream json;
+    json << "{\"state\":\"" << HistoryExportJob::stateName(status.state) << "\"";
+    if (status.state != HistoryExportJob::State::IDLE) {
+        json << ",\"path\":\"" << escapeJSON(status.path) << "\""
+             << ",\"from\":\"" << TimestampCodec::format(status.from) << "\""
+             << ",\"through\":\"" << TimestampCodec::format(status.through) << "\""
+             << ",\"prefix\":\"" << escapeJSON(status.prefix) << "\""
+             << ",\"keys_total\":" << status.keysTotal
+             << ",\"keys\":" << status.keys
+             << ",\"rows\":" << status.rows
+             << ",\"row_groups\":" << status.rowGroups
+             << ",\"bytes\":" << status.bytes
+             << ",\"elapsed_ms\":" << status.elapsed.count();
+    }
+    if (!status.error.empty()) {
+        json << ",\"error\":\"" << escapeJSON(status.error) << "\"";
+    }
+    json << "}";
+    return json.str();
+}
+
+// Bounds how many requests may be parked waiting: durable writes, /watch,
+// /invalidations and min_lsn reads on a replica. httplib handlers cannot
+// suspend, so every wait holds a worker thread until it is answered; past the
+// limit the request is refused with 503 instead of starving the pool for
+// ordinary reads and writes.
+class WaitSlots {
+public:
+    explicit WaitSlots(size_t limit) : limit_(std::max<size_t>(1, limit)) {}
+
+    bool tryAcquire() {
+        size_t current = inUse_.load(std::memory_order_relaxed);
+        while (current < limit_) {
+            if (inUse_.compare_exchange_weak(current, current + 1, std::memory_order_acquire)) {
+                return true;
             }
         }
+        return false;
     }
-    
-    auto kvstore = std::make_shared<KVStore>(wal);
-    
-    // Replay snapshot and WAL after creating kvstore
-    if (wal && wal->isEnabled()) {
-        kvstore->setWalEnabled(false);
-        
-        // Replay snapshot first
-        std::vector<std::string> snapshotCommands = wal->readSnapshot();
-        if (!snapshotCommands.empty()) {
-            for (const auto& cmdLine : snapshotCommands) {
-                std::istringstream iss(cmdLine);
-                std::string cmdType;
-                iss >> cmdType;
-                
-                if (cmdType == "POLICY") {
-                    std::string subCmd, policyName;
-                    iss >> subCmd >> policyName;
-                    if (subCmd == "SET") {
-                        if (policyName == "DEV_FRIENDLY") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::DEV_FRIENDLY);
-                        } else if (policyName == "SAFE_DEFAULT") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::SAFE_DEFAULT);
-                        } else if (policyName == "STRICT") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::STRICT);
-                        }
-                    }
-                } else if (cmdType == "GUARD") {
-                    std::string subCmd, guardType, name, keyPattern;
-                    iss >> subCmd >> guardType >> name >> keyPattern;
-                    
-                    if (subCmd == "ADD") {
-                        try {
-                            std::shared_ptr<Guard> guard;
-                            
-                            if (guardType == "RANGE_INT") {
-                                int min, max;
-                                iss >> min >> max;
-                                if (!kvstore->hasGuard(name)) {
-                                    guard = std::make_shared<RangeIntGuard>(name, keyPattern, min, max);
-                                    kvstore->addGuard(guard);
-                                    spdlog::info("[WAL Replay] Restored RANGE_INT guard: {}", name);
-                                } else {
-                                    spdlog::info("[WAL Replay] Skipped duplicate RANGE_INT guard: {}", name);
-                                }
-                                
-                            } else if (guardType == "ENUM") {
-                                std::vector<std::string> values;
-                                std::string value;
-                                while (iss >> value) {
-                                    values.push_back(value);
-                                }
-                                if (!values.empty()) {
-                                    if (!kvstore->hasGuard(name)) {
-                                        guard = std::make_shared<EnumGuard>(name, keyPattern, values);
-                                        kvstore->addGuard(guard);
-                                        spdlog::info("[WAL Replay] Restored ENUM guard: {} with {} values", name, values.size());
-                                    } else {
-                                        spdlog::info("[WAL Replay] Skipped duplicate ENUM guard: {}", name);
-                                    }
-                                }
-                                
-                            } else if (guardType == "LENGTH") {
-                                size_t min, max;
-                                iss >> min >> max;
-                                if (!kvstore->hasGuard(name)) {
-                                    guard = std::make_shared<LengthGuard>(name, keyPattern, min, max);
-                                    kvstore->addGuard(guard);
-                                    spdlog::info("[WAL Replay] Restored LENGTH guard: {}", name);
-                                } else {
-                                    spdlog::info("[WAL Replay] Skipped duplicate LENGTH guard: {}", name);
-                                }
-                            }
-                        } catch (const std::exception& e) {
-                            spdlog::warn("[WAL Replay] Failed to restore guard {}: {}", name, e.what());
-                        }
-                    }
-                } else if (cmdType == "SET") {
-                    std::string key, value;
-                    iss >> key >> value;
-                    kvstore->setAtTime(key, value, std::chrono::system_clock::now());
-                }
-            }
+    void release() { inUse_.fetch_sub(1, std::memory_order_release); }
+    size_t limit() const { return limit_; }
+
+private:
+    const size_t limit_;
+    std::atomic<size_t> inUse_{0};
+};
+
+// Releases a WaitSlots slot when the handler returns
+class WaitSlotGuard {
+public:
+    explicit WaitSlotGuard(WaitSlots& slots) : slots_(slots) {}
+    ~WaitSlotGuard() { slots_.release(); }
+    WaitSlotGuard(const WaitSlotGuard&) = delete;
+    WaitSlotGuard& operator=(const WaitSlotGuard&) = delete;
+private:
+    WaitSlots& slots_;
+};
+
+void rejectBusy(httplib::Response& res) {
+    res.status = 503;
+    res.set_header("Retry-After", "1");
+    res.set_content("{\"error\":\"Too many waiting requests\"}", "application/json");
+}
+
+// Client-side caching: a read with track=1 from a client that sent
+// X-Client-Id registers the key before it is read. Returns false (after
+// filling in a 503) only when the client table is full.
+bool trackRead(const std::shared_ptr<InvalidationTracker>& tracker,
+               const httplib::Request& req, const std::string& key, httplib::Response& res) {
+    if (!tracker || req.get_param_value("track") != "1") return true;
+    const std::string& clientId = req.get_header_value("X-Client-Id");
+    if (clientId.empty()) return true;
+    if (!tracker->trackRead(clientId, key)) {
+        rejectBusy(res);
+        return false;
+    }
+    return true;
+}
+
+// Session consistency across replicas: writes answer with their commit LSN
+// (X-Sentinel-LSN, and "lsn" in the body), and a read presenting one
+// (X-Sentinel-Min-LSN or min_lsn) is served only by a node that has applied
+// that far. A lagging replica waits up to `wait` for its primary's records,
+// then redirects the read to primaryUrl, or answers 503 if it has none.
+struct ReadConsistency {
+    std::chrono::milliseconds wait{100};
+    std::string primaryUrl;  // e.g. http://db-primary:8080
+};
+
+// Returns false, with the response filled in, when the read can't be served
+// here. Otherwise tags the response with the LSN the read sees. A malformed
+// min_lsn throws, for the route's 400.
+bool awaitMinLsn(const ReadConsistency& consistency, const std::shared_ptr<WAL>& wal,
+                 const std::shared_ptr<ReplicaSink>& replica, WaitSlots& waits,
+                 const httplib::Request& req, httplib::Response& res) {
+    if (!wal || !wal->isEnabled()) return true;
+    std::string minText = req.get_header_value("X-Sentinel-Min-LSN");
+    if (minText.empty()) minText = req.get_param_value("min_lsn");
+    uint64_t lsn = replica ? replica->appliedLsn() : wal->lastLsn();
+    const uint64_t minLsn = minText.empty() ? 0 : std::stoull(minText);
+    if (minLsn > lsn && !replica) {
+        // Every write acknowledged here is applied, so this token is from elsewhere
+        res.status = 400;
+        res.set_content("{\"error\":\"min_lsn is ahead of this server\",\"lsn\":" +
+                        std::to_string(lsn) + "}", "application/json");
+        return false;
+    }
+    if (minLsn > lsn) {
+        if (!waits.tryAcquire()) {
+            rejectBusy(res);
+            return false;
         }
-        
-        // Replay WAL commands
-        std::vector<std::string> commands = wal->readLog();
-        if (!commands.empty()) {
-            // Phase 1: Replay POLICY and GUARD commands
-            for (const auto& cmdLine : commands) {
-                std::istringstream iss(cmdLine);
-                std::string cmdType;
-                iss >> cmdType;
-                
-                if (cmdType == "POLICY") {
-                    std::string subCmd, policyName;
-                    iss >> subCmd >> policyName;
-                    if (subCmd == "SET") {
-                        if (policyName == "DEV_FRIENDLY") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::DEV_FRIENDLY);
-                        } else if (policyName == "SAFE_DEFAULT") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::SAFE_DEFAULT);
-                        } else if (policyName == "STRICT") {
-                            kvstore->setDecisionPolicy(DecisionPolicy::STRICT);
-                        }
-                    }
-                } else if (cmdType == "GUARD") {
-                    std::string subCmd, guardType, name, keyPattern;
-                    iss >> subCmd >> guardType >> name >> keyPattern;
-                    
-                    if (subCmd == "ADD") {
-                        try {
-                            std::shared_ptr<Guard> guard;
-                            
-                            if (guardType == "RANGE_INT") {
-                                int min, max;
-                                iss >> min >> max;
-                                if (!kvstore->hasGuard(name)) {
-                                    guard = std::make_shared<RangeIntGuard>(name, keyPattern, min, max);
-                                    kvstore->addGuard(guard);
-                                    spdlog::info("[WAL Replay] Restored RANGE_INT guard: {}", name);
-                                } else {
-                                    spdlog::info("[WAL Replay] Skipped duplicate RANGE_INT guard: {}", name);
-                                }
-                                
-                            } else if (guardType == "ENUM") {
-                                std::vector<std::string> values;
-                                std::string value;
-                                while (iss >> value) {
-                                    values.push_back(value);
-                                }
-                                if (!values.empty()) {
-                                    if (!kvstore->hasGuard(name)) {
-                                        guard = std::make_shared<EnumGuard>(name, keyPattern, values);
-                                        kvstore->addGuard(guard);
-                                        spdlog::info("[WAL Replay] Restored ENUM guard: {} with {} values", name, values.size());
-                                    } else {
-                                        spdlog::info("[WAL Replay] Skipped duplicate ENUM guard: {}", name);
-                                    }
-                                }
-                                
-                            } else if (guardType == "LENGTH") {
-                                size_t min, max;
-                                iss >> min >> max;
-                                if (!kvstore->hasGuard(name)) {
-                                    guard = std::make_shared<LengthGuard>(name, keyPattern, min, max);
-                                    kvstore->addGuard(guard);
-                                    spdlog::info("[WAL Replay] Restored LENGTH guard: {}", name);
-                                } else {
-                                    spdlog::info("[WAL Replay] Skipped duplicate LENGTH guard: {}", name);
-                                }
-                            }
-                        } catch (const std::exception& e) {
-                            spdlog::warn("[WAL Replay] Failed to restore guard {}: {}", name, e.what());
-                        }
-                    }
-                }
-            }
-            
-            // Phase 2: Replay data commands
-            for (const auto& cmdLine : commands) {
-                std::istringstream iss(cmdLine);
-                std::string cmdType;
-                iss >> cmdType;
-                
-                if (cmdType == "SET") {
-                    std::string key, value;
-                    long long timestampMs = 0;
-                    iss >> key >> value;
-                    
-                    if (iss >> timestampMs) {
-                        auto timestamp = std::chrono::system_clock::time_point(
-                            std::chrono::milliseconds(timestampMs));
-                        kvstore->setAtTime(key, value, timestamp);
-                    } else {
-                        kvstore->setAtTime(key, value, std::chrono::system_clock::now());
-                    }
-                } else if (cmdType == "DEL") {
-                    std::string key;
-                    iss >> key;
-                    if (!key.empty()) {
-                        kvstore->del(key);
-                    }
-                }
+        WaitSlotGuard slot(waits);
+        if (!replica->waitApplied(minLsn, consistency.wait)) {
+            Metrics::instance().recordStaleRead(!consistency.primaryUrl.empty());
+            lsn = replica->appliedLsn();
+            res.set_header("X-Sentinel-LSN", std::to_string(lsn));
+            if (!consistency.primaryUrl.empty()) {
+                res.set_redirect(consistency.primaryUrl + req.target, 307);
+                return false;
             }
+            res.status = 503;
+            res.set_header("Retry-After", "1");
+            res.set_content("{\"error\":\"Replica has not reached min_lsn\",\"lsn\":" +
+                            std::to_string(lsn) + ",\"min_lsn\":" + std::to_string(minLsn) + "}",
+                            "application/json");
+            return false;
         }
-        
-        kvstore->setWalEnabled(true);
+        lsn = replica->appliedLsn();
     }
-    
-    // Initialize HTTP server
-    httplib::Server svr;
-    
+    res.set_header("X-Sentinel-LSN", std::to_string(lsn));
+    return true;
+}
+
+// Register every endpoint on a server. Called once per listener (TCP and the
+// optional Unix domain socket) so both expose an identical API.
+void registerRoutes(httplib::Server& svr, std::shared_ptr<KVStore> kvstore,
+                    std::shared_ptr<WAL> wal, const std::string& walPath,
+                    const std::string& requiredApiKey,
+                    std::shared_ptr<ResponseCompression> compression,
+                    std::shared_ptr<WaitSlots> waits,
+                    uint64_t backupBytesPerSecond,
+                    std::shared_ptr<InvalidationTracker> tracker,
+                    std::shared_ptr<MemoryMonitor> memory,
+                    std::shared_ptr<IoScheduler> io,
+                    std::shared_ptr<HistoryExportJob> exporter,
+                    std::shared_ptr<Replicator> replicator,
+                    std::shared_ptr<ReplicaSink> replica,
+                    ReadConsistency consistency) {
     // CORS headers for all responses
     svr.set_default_headers({
         {"Access-Control-Allow-Origin", "*"},
         {"Access-Control-Allow-Methods", "GET, POST, OPTIONS"},
-        {"Access-Control-Allow-Headers", "Content-Type"}
+        {"Access-Control-Allow-Headers", "Content-Type, X-Sentinel-Min-LSN"},
+        {"Access-Control-Expose-Headers", "X-Sentinel-LSN"}
+    });
+    
+    // Finish every buffered response: endpoints that still build JSON by hand
+    // are re-encoded when the client asked for MessagePack (hot read paths
+    // encode natively instead), then the body is compressed if negotiated
+    svr.set_post_routing_handler([compression](const httplib::Request& req, httplib::Response& res) {
+        bool bodyChanged = false;
+        if (negotiateFormat(req) == WireFormat::MSGPACK) {
+            res.set_header("Vary", "Accept");
+            std::string packed;
+            if (res.get_header_value("Content-Type") == "application/json" && !res.body.empty() &&
+                WireCodec::jsonToMsgPack(res.body, packed)) {
+                res.set_content(std::move(packed), ResponseWriter::contentType(WireFormat::MSGPACK));
+                bodyChanged = true;
+            }
+        }
+        if (compression && !res.body.empty() && !res.has_header("Content-Encoding")) {
+            res.set_header("Vary", "Accept-Encoding");
+            ContentCoding coding = compression->negotiate(req.get_header_value("Accept-Encoding"),
+                                                          res.body.size(),
+                                                          res.get_header_value("Content-Type"));
+            if (compression->compressBody(coding, res.body)) {
+                res.set_header("Content-Encoding", ResponseCompression::codingName(coding));
+                bodyChanged = true;
+            }
+        }
+        if (bodyChanged) {
+            // httplib has already computed Content-Length from the original body
+            auto range = res.headers.equal_range("Content-Length");
+            res.headers.erase(range.first, range.second);
+            res.set_header("Content-Length", std::to_string(res.body.size()));
+        }
     });
 
-    // Optional API key auth — set API_KEY env var to enable
-    const char* apiKeyEnv = std::getenv("SENTINEL_API_KEY");
-    std::string requiredApiKey = apiKeyEnv ? std::string(apiKeyEnv) : "";
-
-    if (!requiredApiKey.empty()) {
-        svr.set_pre_routing_handler([requiredApiKey](const httplib::Request& req,
-                                                     httplib::Response& res) {
+    // Optional API key auth — set SENTINEL_API_KEY env var to enable.
+    // A replica also refuses client writes: its data comes from its primary.
+    if (!requiredApiKey.empty() || replica) {
+        svr.set_pre_routing_handler([requiredApiKey, replica](const httplib::Request& req,
+                                                              httplib::Response& res) {
             // Health check is always public
             if (req.path == "/health") return httplib::Server::HandlerResponse::Unhandled;
 
-            auto it = req.headers.find("X-API-Key");
-            if (it == req.headers.end() || it->second != requiredApiKey) {
-                res.status = 401;
-                res.set_content("{\"error\":\"Unauthorized\"}", "application/json");
+            if (!requiredApiKey.empty()) {
+                auto it = req.headers.find("X-API-Key");
+                if (it == req.headers.end() || it->second != requiredApiKey) {
+                    res.status = 401;
+                    res.set_content("{\"error\":\"Unauthorized\"}", "application/json");
+                    return httplib::Server::HandlerResponse::Handled;
+                }
+            }
+            if (replica && req.method == "POST" &&
+                (req.path == "/set" || req.path == "/ingest" || req.path == "/deletePrefix" ||
+                 req.path == "/guards" ||
+                 req.path == "/policy" || req.path == "/config/retention")) {
+                res.status = 403;
+                res.set_content("{\"error\":\"Read-only replica; write to the primary\"}",
+                                "application/json");
                 return httplib::Server::HandlerResponse::Handled;
             }
             return httplib::Server::HandlerResponse::Unhandled;
         });
-        spdlog::info("API key authentication enabled");
-    } else {
-        spdlog::warn("No API key set — server is publicly accessible. Set SENTINEL_API_KEY env var.");
     }
     
     // Health check endpoint
@@ -415,8 +450,11 @@ int main(int argc, char* argv[]) {
         res.set_content(healthJson, "application/json");
     });
     
-    // POST /set - Set a key-value pair
-    svr.Post("/set", [kvstore, walPath, MAX_BODY_SIZE, MAX_KEY_SIZE, MAX_VALUE_SIZE](const httplib::Request& req, httplib::Response& res) {
+    // POST /set - Set a key-value pair. With "durable": true the response is
+    // held until the group-commit fsync covers the write; with semi-sync
+    // replication, until the replica quorum has it too (or the sync timeout).
+    svr.Post("/set", [kvstore, wal, walPath, waits, memory, replicator](const httplib::Request& req,
+                                                                        httplib::Response& res) {
         RequestTimer timer("/set");
         // Input validation
         if (req.body.size() > MAX_BODY_SIZE) {
@@ -426,7 +464,7 @@ int main(int argc, char* argv[]) {
             return;
         }
         try {
-            auto params = parseSimpleJSON(req.body);
+            auto params = parseRequestBody(req);
             
             if (params.find("key") == params.end() || params.find("value") == params.end()) {
                 res.status = 400;
@@ -436,6 +474,11 @@ int main(int argc, char* argv[]) {
             
             std::string key = params["key"];
             std::string value = params["value"];
+            bool durable = params["durable"] == "true" || params["durable"] == "1" ||
+                           req.get_param_value("durable") == "1" ||
+                           req.get_param_value("durable") == "true";
+            durable = durable && wal && wal->isEnabled();
+            const bool semiSync = replicator && replicator->syncReplicas() > 0;
 
             if (key.size() > MAX_KEY_SIZE) {
                 Metrics::instance().recordRequest("/set", "error");
@@ -449,9 +492,52 @@ int main(int argc, char* argv[]) {
                 res.set_content("{\"error\":\"Value too large (max 1MB)\"}", "application/json");
                 return;
             }
+            if (memory && !memory->admitWrite(value.size())) {
+                Metrics::instance().recordRequest("/set", "error");
+                res.status = 503;
+                res.set_header("Retry-After", "5");
+                res.set_content("{\"error\":\"Value too large while memory is under pressure\"}",
+                                "application/json");
+                return;
+            }
             spdlog::debug("SET key={} value_size={}", key, value.size());
             
+            // Reserve the wait before writing so a refused request changes nothing
+            std::optional<WaitSlotGuard> waitSlot;
+            if (durable || semiSync) {
+                if (!waits->tryAcquire()) {
+                    Metrics::instance().recordRequest("/set", "error");
+                    rejectBusy(res);
+                    return;
+                }
+                waitSlot.emplace(*waits);
+            }
+            
             Status status = kvstore->set(key, value);
+            // At least our record's LSN; as a session token a later one does as well
+            const uint64_t lsn = wal && wal->isEnabled() ? wal->lastLsn() : 0;
+            
+            // Our record's LSN is at most lastLsn(), so waiting for that is enough
+            if (status == Status::OK && durable &&
+                !wal->waitDurable(lsn, std::chrono::seconds(5))) {
+                Metrics::instance().recordRequest("/set", "error");
+                if (wal->syncFailed()) {
+                    res.status = 500;
+                    spdlog::error("SET key={} not durable: WAL fsync failed", key);
+                    res.set_content("{\"error\":\"WAL fsync failed\"}", "application/json");
+                    return;
+                }
+                res.status = 504;
+                spdlog::warn("SET key={} durable wait timed out", key);
+                res.set_content("{\"error\":\"Timed out waiting for fsync\"}", "application/json");
+                return;
+            }
+            
+            // Past the timeout the write stands, acknowledged asynchronously
+            auto replicated = Replicator::Ack::ASYNC;
+            if (status == Status::OK && semiSync) {
+                replicated = replicator->waitReplicated(lsn);
+            }
             
             if (status == Status::OK) {
                 Metrics::instance().recordRequest("/set", "ok");
@@ -464,9 +550,22 @@ int main(int argc, char* argv[]) {
                     }
                 }
                 spdlog::info("SET key={} status=ok", key);
-                std::stringstream json;
-                json << "{\"status\":\"ok\",\"message\":\"Key '" << escapeJSON(key) << "' set successfully\"}";
-                res.set_content(json.str(), "application/json");
+                ResponseWriter out(negotiateFormat(req));
+                out.beginObject(2 + (lsn ? 1 : 0) + (durable ? 1 : 0) + (semiSync ? 1 : 0));
+                out.field("status", "ok");
+                out.field("message", "Key '" + key + "' set successfully");
+                if (lsn) {
+                    out.field("lsn", static_cast<int64_t>(lsn));
+                    res.set_header("X-Sentinel-LSN", std::to_string(lsn));
+                }
+                if (durable) {
+                    out.field("durable", true);
+                }
+                if (semiSync) {
+                    out.field("replicated", replicated == Replicator::Ack::REPLICATED);
+                }
+                out.endObject();
+                res.set_content(std::move(out.buffer()), out.contentType());
             } else {
                 res.status = 500;
                 Metrics::instance().recordRequest("/set", "error");
@@ -481,36 +580,479 @@ int main(int argc, char* argv[]) {
         }
     });
     
+    // POST /ingest - Bulk writes as newline-delimited JSON, one
+    // {"key":...,"value":...} per line, with no limit on the body. Lines are
+    // parsed as the body arrives and applied in batches (guards checked,
+    // one WAL append each) while the next batch is parsed. The response is
+    // NDJSON too: a line per failed record, then a summary line.
+    svr.Post("/ingest", [kvstore, wal, memory, replicator](const httplib::Request& req,
+                                                           httplib::Response& res,
+                                                           const httplib::ContentReader& content) {
+        RequestTimer timer("/ingest");
+        if (req.is_multipart_form_data()) {
+            Metrics::instance().recordRequest("/ingest", "error");
+            res.status = 400;
+            res.set_content("{\"error\":\"Send the records as the body, one JSON object per line\"}",
+                            "application/json");
+            return;
+        }
+        IngestStream::Options options;
+        try {
+            if (req.has_param("batch")) {
+                options.batchRecords = std::stoul(req.get_param_value("batch"));
+            }
+            if (req.has_param("max_errors")) {
+                options.maxErrors = std::stoul(req.get_param_value("max_errors"));
+            }
+        } catch (const std::exception&) {
+            Metrics::instance().recordRequest("/ingest", "error");
+            res.status = 400;
+            res.set_content("{\"error\":\"Invalid batch or max_errors\"}", "application/json");
+            return;
+        }
+        options.batchRecords = std::min(std::max<size_t>(1, options.batchRecords), MAX_INGEST_BATCH);
+        options.maxLineBytes = MAX_BODY_SIZE;
+        const bool durable = (req.get_param_value("durable") == "1" ||
+                              req.get_param_value("durable") == "true") && wal && wal->isEnabled();
+        const bool semiSync = replicator && replicator->syncReplicas() > 0;
+
+        // Same rules as /set, per line
+        auto parse = [memory](const std::string& line, BatchWrite& write, std::string& error) {
+            auto params = parseSimpleJSON(line);
+            auto key = params.find("key");
+            auto value = params.find("value");
+            if (key != params.end()) {
+                write.key = std::move(key->second);
+            }
+            if (key == params.end() || value == params.end()) {
+                error = "Missing 'key' or 'value'";
+                return false;
+            }
+            if (write.key.size() > MAX_KEY_SIZE) {
+                error = "Key too long (max 256 bytes)";
+                return false;
+            }
+            if (value->second.size() > MAX_VALUE_SIZE) {
+                error = "Value too large (max 1MB)";
+                return false;
+            }
+            if (memory && !memory->admitWrite(value->second.size())) {
+                error = "Value too large while memory is under pressure";
+                return false;
+            }
+            write.value = std::move(value->second);
+            return true;
+        };
+        IngestStream stream(kvstore, parse, options);
+        const bool received = content([&stream](const char* data, size_t length) {
+            stream.feed(data, length);
+            return true;
+        });
+        auto result = stream.finish();
+        Metrics::instance().recordIngest(result.applied, result.failed, result.batches);
+        Metrics::instance().setActiveKeys(kvstore->size());
+        if (!received) {
+            // The client went away; what arrived before that is applied
+            Metrics::instance().recordRequest("/ingest", "error");
+            spdlog::warn("INGEST aborted after records={} applied={}", result.records, result.applied);
+            return;
+        }
+
+        const uint64_t lsn = wal && wal->isEnabled() ? wal->lastLsn() : 0;
+        bool synced = true;
+        if (durable && result.applied > 0) {
+            synced = wal->waitDurable(lsn, std::chrono::seconds(5));
+        }
+        auto replicated = Replicator::Ack::ASYNC;
+        if (semiSync && result.applied > 0) {
+            replicated = replicator->waitReplicated(lsn);
+        }
+
+        std::stringstream body;
+        for (const auto& error : result.errors) {
+            body << "{\"line\":" << error.line << ",\"key\":\"" << escapeJSON(error.key)
+                 << "\",\"error\":\"" << escapeJSON(error.message) << "\"}\n";
+        }
+        body << "{\"status\":\"ok\",\"records\":" << result.records << ",\"applied\":" << result.applied
+             << ",\"failed\":" << result.failed << ",\"batches\":" << result.batches;
+        if (result.failed > result.errors.size()) {
+            body << ",\"errors_omitted\":" << result.failed - result.errors.size();
+        }
+        if (lsn) {
+            body << ",\"lsn\":" << lsn;
+            res.set_header("X-Sentinel-LSN", std::to_string(lsn));
+        }
+        if (durable) {
+            body << ",\"durable\":" << (synced ? "true" : "false");
+        }
+        if (semiSync) {
+            body << ",\"replicated\":" << (replicated == Replicator::Ack::REPLICATED ? "true" : "false");
+        }
+        body << "}\n";
+        spdlog::info("INGEST records={} applied={} failed={} batches={}", result.records,
+                     result.applied, result.failed, result.batches);
+        Metrics::instance().recordRequest("/ingest", "ok");
+        res.set_content(body.str(), "application/x-ndjson");
+    });
+    
+    // POST /deletePrefix - Delete every key under a prefix with one WAL
+    // record. Keys are hidden at once and reclaimed in the background.
+    svr.Post("/deletePrefix", [kvstore, wal](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/deletePrefix");
+        if (req.body.size() > MAX_BODY_SIZE) {
+            Metrics::instance().recordRequest("/deletePrefix", "error");
+            res.status = 413;
+            res.set_content("{\"error\":\"Request too large\"}", "application/json");
+            return;
+        }
+        try {
+            auto params = parseRequestBody(req);
+            std::string prefix = params["prefix"];
+            if (prefix.empty()) {
+                Metrics::instance().recordRequest("/deletePrefix", "error");
+                res.status = 400;
+                res.set_content("{\"error\":\"Missing 'prefix' parameter\"}", "application/json");
+                return;
+            }
+            if (prefix.size() > MAX_KEY_SIZE) {
+                Metrics::instance().recordRequest("/deletePrefix", "error");
+                res.status = 400;
+                res.set_content("{\"error\":\"Prefix too long (max 256 bytes)\"}", "application/json");
+                return;
+            }
+            
+            if (kvstore->delPrefix(prefix) != Status::OK) {
+                Metrics::instance().recordRequest("/deletePrefix", "error");
+                res.status = 500;
+                res.set_content("{\"error\":\"Failed to delete prefix\"}", "application/json");
+                return;
+            }
+            const uint64_t lsn = wal && wal->isEnabled() ? wal->lastLsn() : 0;
+            Metrics::instance().recordRequest("/deletePrefix", "ok");
+            spdlog::info("DELPREFIX prefix={} status=ok", prefix);
+            ResponseWriter out(negotiateFormat(req));
+            out.beginObject(lsn ? 3 : 2);
+            out.field("status", "ok");
+            out.field("prefix", prefix);
+            if (lsn) {
+                out.field("lsn", static_cast<int64_t>(lsn));
+                res.set_header("X-Sentinel-LSN", std::to_string(lsn));
+            }
+            out.endObject();
+            res.set_content(std::move(out.buffer()), out.contentType());
+        } catch (const std::exception& e) {
+            res.status = 400;
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+    
     // GET /get?key=<key> - Get current value
-    svr.Get("/get", [kvstore](const httplib::Request& req, httplib::Response& res) {
+    svr.Get("/get", [kvstore, tracker, wal, replica, waits, consistency](const httplib::Request& req,
+                                                                         httplib::Response& res) {
         RequestTimer timer("/get");
         try {
-            if (!req.has_param("key")) {
+            if (!awaitMinLsn(consistency, wal, replica, *waits, req, res)) {
+                Metrics::instance().recordRequest("/get", "error");
+                return;
+            }
+            if (!req.has_param("key")) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/get", "not_found");
+                res.set_content("{\"error\":\"Missing 'key' parameter\"}", "application/json");
+                return;
+            }
+            
+            std::string key = req.get_param_value("key");
+            if (!trackRead(tracker, req, key, res)) {
+                Metrics::instance().recordRequest("/get", "error");
+                return;
+            }
+            ResponseWriter out(negotiateFormat(req));
+            bool found = kvstore->visitLatest(key, [&](const std::string& value) {
+                out.buffer().reserve(key.size() + value.size() + 32);
+                out.beginObject(2);
+                out.field("key", key);
+                out.field("value", value);
+                out.endObject();
+            });
+            
+            if (found) {
+                Metrics::instance().recordRequest("/get", "ok");
+                res.set_content(std::move(out.buffer()), out.contentType());
+            } else {
+                res.status = 404;
+                Metrics::instance().recordRequest("/get", "not_found");
+                std::stringstream json;
+                json << "{\"error\":\"Key not found\",\"key\":\"" << escapeJSON(key) << "\"}";
+                res.set_content(json.str(), "application/json");
+            }
+        } catch (const std::exception& e) {
+            res.status = 400;
+            Metrics::instance().recordRequest("/get", "not_found");
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+    
+    // GET /mget?key=<k1>&key=<k2>... - Latest values of several keys in one
+    // batched lookup; missing keys come back with a null value
+    svr.Get("/mget", [kvstore, tracker, wal, replica, waits, consistency](const httplib::Request& req,
+                                                                          httplib::Response& res) {
+        RequestTimer timer("/mget");
+        try {
+            if (!awaitMinLsn(consistency, wal, replica, *waits, req, res)) {
+                Metrics::instance().recordRequest("/mget", "error");
+                return;
+            }
+            const size_t count = req.get_param_value_count("key");
+            if (count == 0 || count > MAX_MGET_KEYS) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/mget", "error");
+                std::stringstream json;
+                json << "{\"error\":\"Expected 1 to " << MAX_MGET_KEYS << " 'key' parameters\"}";
+                res.set_content(json.str(), "application/json");
+                return;
+            }
+            std::vector<std::string> keys;
+            keys.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                keys.push_back(req.get_param_value("key", i));
+                if (keys.back().size() > MAX_KEY_SIZE) {
+                    res.status = 400;
+                    Metrics::instance().recordRequest("/mget", "error");
+                    res.set_content("{\"error\":\"Key too long (max 256 bytes)\"}", "application/json");
+                    return;
+                }
+                if (!trackRead(tracker, req, keys.back(), res)) {
+                    Metrics::instance().recordRequest("/mget", "error");
+                    return;
+                }
+            }
+
+            auto values = kvstore->multiGet(keys);
+            size_t bytes = 32;
+            for (size_t i = 0; i < count; ++i) {
+                bytes += keys[i].size() + (values[i] ? values[i]->size() : 0) + 24;
+            }
+            ResponseWriter out(negotiateFormat(req), bytes);
+            out.beginObject(1);
+            out.key("values");
+            out.beginArray(count);
+            for (size_t i = 0; i < count; ++i) {
+                out.beginObject(2);
+                out.field("key", keys[i]);
+                out.key("value");
+                if (values[i]) {
+                    out.string(*values[i]);
+                } else {
+                    out.null();
+                }
+                out.endObject();
+            }
+            out.endArray();
+            out.endObject();
+            Metrics::instance().recordRequest("/mget", "ok");
+            res.set_content(std::move(out.buffer()), out.contentType());
+        } catch (const std::exception& e) {
+            res.status = 400;
+            Metrics::instance().recordRequest("/mget", "error");
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+    
+    // GET /watch?key=<key>[&since=<timestamp>][&timeout_ms=<ms>] - Long-poll for
+    // the next change to a key. Returns at once if the key already changed
+    // after `since`; 204 if nothing happens before the timeout.
+    svr.Get("/watch", [kvstore, waits](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/watch");
+        try {
+            if (!req.has_param("key")) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/watch", "error");
+                res.set_content("{\"error\":\"Missing 'key' parameter\"}", "application/json");
+                return;
+            }
+            std::string key = req.get_param_value("key");
+            std::optional<std::chrono::system_clock::time_point> since;
+            if (req.has_param("since")) {
+                since = parseTimestamp(req.get_param_value("since"));
+            }
+            long long timeoutMs = 30000;
+            if (req.has_param("timeout_ms")) {
+                timeoutMs = std::clamp(std::stoll(req.get_param_value("timeout_ms")), 0LL, 60000LL);
+            }
+
+            if (!waits->tryAcquire()) {
+                Metrics::instance().recordRequest("/watch", "error");
+                rejectBusy(res);
+                return;
+            }
+            WaitSlotGuard waitSlot(*waits);
+
+            // The watcher may fire on a writer thread after we time out, so its
+            // state is shared rather than living on this stack
+            struct Pending {
+                std::mutex mutex;
+                std::condition_variable cv;
+                std::optional<KeyChange> change;
+            };
+            auto pending = std::make_shared<Pending>();
+            uint64_t watchId = kvstore->watchKey(key, [pending](const KeyChange& change) {
+                std::lock_guard<std::mutex> lock(pending->mutex);
+                pending->change = change;
+                pending->cv.notify_all();
+            });
+
+            // Checked after registering so a write in between is not missed
+            std::optional<KeyChange> change;
+            if (since) {
+                kvstore->visitAtTime(key, std::chrono::system_clock::time_point::max(),
+                                     [&](const Version& v) {
+                    if (v.timestamp > *since) {
+                        change = KeyChange{key, false, v.value, v.timestamp};
+                    }
+                });
+            }
+            if (change) {
+                kvstore->unwatchKey(watchId);
+            } else {
+                std::unique_lock<std::mutex> lock(pending->mutex);
+                bool fired = pending->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                                  [&] { return pending->change.has_value(); });
+                if (!fired) {
+                    lock.unlock();
+                    if (!kvstore->unwatchKey(watchId)) {
+                        // Lost the race with a writer: the watcher is running now
+                        lock.lock();
+                        pending->cv.wait(lock, [&] { return pending->change.has_value(); });
+                    }
+                }
+                change = pending->change;
+            }
+
+            if (!change) {
+                res.status = 204;
+                Metrics::instance().recordRequest("/watch", "timeout");
+                return;
+            }
+            char ts[TimestampCodec::kFormattedSize];
+            ResponseWriter out(negotiateFormat(req), change->value.size() + key.size() + 96);
+            out.beginObject(4);
+            out.field("key", key);
+            out.field("deleted", change->deleted);
+            out.key("value");
+            if (change->deleted) {
+                out.null();
+            } else {
+                out.string(change->value);
+            }
+            out.field("timestamp", std::string_view(ts, TimestampCodec::format(change->timestamp, ts)));
+            out.endObject();
+            Metrics::instance().recordRequest("/watch", "ok");
+            res.set_content(std::move(out.buffer()), out.contentType());
+        } catch (const std::exception& e) {
+            res.status = 400;
+            Metrics::instance().recordRequest("/watch", "error");
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+    
+    // POST /tracking - Switch the calling client (X-Client-Id) to broadcast
+    // invalidation for comma-separated "prefixes" instead of per-key tracking
+    svr.Post("/tracking", [tracker](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/tracking");
+        try {
+            const std::string& clientId = req.get_header_value("X-Client-Id");
+            if (!tracker || clientId.empty() || clientId.size() > MAX_KEY_SIZE) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/tracking", "error");
+                res.set_content("{\"error\":\"Missing or invalid X-Client-Id header\"}", "application/json");
+                return;
+            }
+            auto params = parseRequestBody(req);
+            std::vector<std::string> prefixes;
+            std::stringstream list(params["prefixes"]);
+            std::string prefix;
+            while (std::getline(list, prefix, ',')) {
+                if (!prefix.empty()) prefixes.push_back(prefix);
+            }
+            if (!tracker->subscribePrefixes(clientId, prefixes)) {
+                Metrics::instance().recordRequest("/tracking", "error");
+                rejectBusy(res);
+                return;
+            }
+            ResponseWriter out(negotiateFormat(req));
+            out.beginObject(2);
+            out.field("status", "ok");
+            out.key("prefixes");
+            out.beginArray(prefixes.size());
+            for (const auto& p : prefixes) {
+                out.string(p);
+            }
+            out.endArray();
+            out.endObject();
+            Metrics::instance().recordRequest("/tracking", "ok");
+            res.set_content(std::move(out.buffer()), out.contentType());
+        } catch (const std::exception& e) {
+            res.status = 400;
+            Metrics::instance().recordRequest("/tracking", "error");
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+    
+    // GET /invalidations[?timeout_ms=<ms>] - Long-poll the invalidation queue
+    // of the calling client (X-Client-Id). 204 if nothing arrives in time.
+    svr.Get("/invalidations", [tracker, waits](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/invalidations");
+        try {
+            const std::string& clientId = req.get_header_value("X-Client-Id");
+            if (!tracker || clientId.empty() || clientId.size() > MAX_KEY_SIZE) {
                 res.status = 400;
-                Metrics::instance().recordRequest("/get", "not_found");
-                res.set_content("{\"error\":\"Missing 'key' parameter\"}", "application/json");
+                Metrics::instance().recordRequest("/invalidations", "error");
+                res.set_content("{\"error\":\"Missing or invalid X-Client-Id header\"}", "application/json");
                 return;
             }
-            
-            std::string key = req.get_param_value("key");
-            auto value = kvstore->get(key);
-            
-            if (value.has_value()) {
-                Metrics::instance().recordRequest("/get", "ok");
-                std::stringstream json;
-                json << "{\"key\":\"" << escapeJSON(key) << "\",\"value\":\"" 
-                     << escapeJSON(value.value()) << "\"}";
-                res.set_content(json.str(), "application/json");
-            } else {
-                res.status = 404;
-                Metrics::instance().recordRequest("/get", "not_found");
-                std::stringstream json;
-                json << "{\"error\":\"Key not found\",\"key\":\"" << escapeJSON(key) << "\"}";
-                res.set_content(json.str(), "application/json");
+            long long timeoutMs = 30000;
+            if (req.has_param("timeout_ms")) {
+                timeoutMs = std::clamp(std::stoll(req.get_param_value("timeout_ms")), 0LL, 60000LL);
+            }
+            if (!waits->tryAcquire()) {
+                Metrics::instance().recordRequest("/invalidations", "error");
+                rejectBusy(res);
+                return;
+            }
+            WaitSlotGuard waitSlot(*waits);
+
+            InvalidationTracker::Batch batch;
+            if (!tracker->poll(clientId, std::chrono::milliseconds(timeoutMs), batch)) {
+                res.status = 204;
+                Metrics::instance().recordRequest("/invalidations", "timeout");
+                return;
             }
+            ResponseWriter out(negotiateFormat(req), 64 + batch.keys.size() * 24);
+            out.beginObject(2);
+            out.field("flush", batch.flush);
+            out.key("keys");
+            out.beginArray(batch.keys.size());
+            for (const auto& key : batch.keys) {
+                out.string(key);
+            }
+            out.endArray();
+            out.endObject();
+            Metrics::instance().recordRequest("/invalidations", "ok");
+            res.set_content(std::move(out.buffer()), out.contentType());
         } catch (const std::exception& e) {
             res.status = 400;
-            Metrics::instance().recordRequest("/get", "not_found");
+            Metrics::instance().recordRequest("/invalidations", "error");
             std::stringstream json;
             json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
             res.set_content(json.str(), "application/json");
@@ -518,8 +1060,12 @@ int main(int argc, char* argv[]) {
     });
     
     // GET /getAt?key=<key>&timestamp=<timestamp> - Get value at specific time
-    svr.Get("/getAt", [kvstore](const httplib::Request& req, httplib::Response& res) {
+    svr.Get("/getAt", [kvstore, wal, replica, waits, consistency](const httplib::Request& req,
+                                                                  httplib::Response& res) {
         try {
+            if (!awaitMinLsn(consistency, wal, replica, *waits, req, res)) {
+                return;
+            }
             if (!req.has_param("key") || !req.has_param("timestamp")) {
                 res.status = 400;
                 res.set_content("{\"error\":\"Missing 'key' or 'timestamp' parameter\"}", "application/json");
@@ -530,14 +1076,17 @@ int main(int argc, char* argv[]) {
             std::string timestampStr = req.get_param_value("timestamp");
             
             auto timestamp = parseTimestamp(timestampStr);
-            auto value = kvstore->getAtTime(key, timestamp);
+            ResponseWriter out(negotiateFormat(req));
+            bool found = kvstore->visitAtTime(key, timestamp, [&](const Version& version) {
+                out.beginObject(3);
+                out.field("key", key);
+                out.field("value", version.value);
+                out.field("timestamp", timestampStr);
+                out.endObject();
+            });
             
-            if (value.has_value()) {
-                std::stringstream json;
-                json << "{\"key\":\"" << escapeJSON(key) << "\",\"value\":\"" 
-                     << escapeJSON(value.value()) << "\",\"timestamp\":\"" 
-                     << escapeJSON(timestampStr) << "\"}";
-                res.set_content(json.str(), "application/json");
+            if (found) {
+                res.set_content(std::move(out.buffer()), out.contentType());
             } else {
                 res.status = 404;
                 std::stringstream json;
@@ -554,8 +1103,12 @@ int main(int argc, char* argv[]) {
     });
     
     // GET /history?key=<key> - Get version history
-    svr.Get("/history", [kvstore](const httplib::Request& req, httplib::Response& res) {
+    svr.Get("/history", [kvstore, tracker, wal, replica, waits, consistency](const httplib::Request& req,
+                                                                            httplib::Response& res) {
         try {
+            if (!awaitMinLsn(consistency, wal, replica, *waits, req, res)) {
+                return;
+            }
             if (!req.has_param("key")) {
                 res.status = 400;
                 res.set_content("{\"error\":\"Missing 'key' parameter\"}", "application/json");
@@ -563,21 +1116,124 @@ int main(int argc, char* argv[]) {
             }
             
             std::string key = req.get_param_value("key");
-            auto history = kvstore->getHistory(key);
-            
-            std::stringstream json;
-            json << "{\"key\":\"" << escapeJSON(key) << "\",\"versions\":[";
-            
-            for (size_t i = 0; i < history.size(); ++i) {
-                if (i > 0) json << ",";
-                json << "{\"timestamp\":\"" << escapeJSON(formatTimestamp(history[i].timestamp)) 
-                     << "\",\"value\":\"" << escapeJSON(history[i].value) << "\"}";
+            if (!trackRead(tracker, req, key, res)) {
+                return;
             }
             
-            json << "]}";
+            // Encode straight from the version list under the read lock
+            ResponseWriter out(negotiateFormat(req), 4096);
+            out.beginObject(2);
+            out.field("key", key);
+            out.key("versions");
+            size_t versions = out.beginArrayUnsized();
+            char ts[TimestampCodec::kFormattedSize];
+            size_t count = kvstore->visitHistory(key, [&](const Version& version) {
+                out.beginObject(2);
+                out.field("timestamp", std::string_view(ts, TimestampCodec::format(version.timestamp, ts)));
+                out.field("value", version.value);
+                out.endObject();
+            });
+            out.endArrayUnsized(versions, count);
+            out.endObject();
+            res.set_content(std::move(out.buffer()), out.contentType());
+        } catch (const std::exception& e) {
+            res.status = 400;
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
             res.set_content(json.str(), "application/json");
+        }
+    });
+    
+    // GET /timeline?key=<k1>&key=<k2>...|prefix=<p>&from=<ts>&through=<ts>&limit=<n>&cursor=<c>
+    // Every version of the keys stamped in [from, through], merged into
+    // time order, a page at a time; next_cursor resumes after the page
+    svr.Get("/timeline", [kvstore, wal, replica, waits, consistency](const httplib::Request& req,
+                                                                     httplib::Response& res) {
+        RequestTimer timer("/timeline");
+        try {
+            if (!awaitMinLsn(consistency, wal, replica, *waits, req, res)) {
+                Metrics::instance().recordRequest("/timeline", "error");
+                return;
+            }
+            const size_t keyCount = req.get_param_value_count("key");
+            if ((keyCount == 0) == !req.has_param("prefix")) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/timeline", "error");
+                res.set_content("{\"error\":\"Give either 'key' parameters or a 'prefix'\"}",
+                                "application/json");
+                return;
+            }
+            std::vector<std::string> keys;
+            if (keyCount > 0) {
+                for (size_t i = 0; i < keyCount; ++i) {
+                    keys.push_back(req.get_param_value("key", i));
+                }
+            } else {
+                keys = kvstore->listKeys(req.get_param_value("prefix"));
+            }
+            if (keys.size() > MAX_TIMELINE_KEYS) {
+                res.status = 400;
+                Metrics::instance().recordRequest("/timeline", "error");
+                std::stringstream json;
+                json << "{\"error\":\"Timeline covers " << keys.size() << " keys (max "
+                     << MAX_TIMELINE_KEYS << "); narrow the prefix\"}";
+                res.set_content(json.str(), "application/json");
+                return;
+            }
+
+            auto from = std::chrono::system_clock::time_point::min();
+            auto through = std::chrono::system_clock::now();
+            if (req.has_param("from")) from = parseTimestamp(req.get_param_value("from"));
+            if (req.has_param("through")) through = parseTimestamp(req.get_param_value("through"));
+            size_t limit = req.has_param("limit") ? std::stoul(req.get_param_value("limit")) : 1000;
+            limit = std::max<size_t>(1, std::min(limit, MAX_TIMELINE_LIMIT));
+
+            // Cursor: <nanoseconds>:<ordinal>:<key> of the last version returned
+            std::optional<TimelinePosition> after;
+            if (req.has_param("cursor")) {
+                const std::string cursor = req.get_param_value("cursor");
+                size_t first = cursor.find(':');
+                size_t second = first == std::string::npos ? first : cursor.find(':', first + 1);
+                if (second == std::string::npos) {
+                    throw std::invalid_argument("malformed cursor");
+                }
+                after.emplace();
+                after->timestamp = std::chrono::system_clock::time_point(
+                    std::chrono::system_clock::duration(std::stoll(cursor.substr(0, first))));
+                after->ordinal = std::stoul(cursor.substr(first + 1, second - first - 1));
+                after->key = cursor.substr(second + 1);
+            }
+
+            ResponseWriter out(negotiateFormat(req), 4096);
+            out.beginObject(2);
+            out.key("events");
+            size_t events = out.beginArrayUnsized();
+            char ts[TimestampCodec::kFormattedSize];
+            size_t count = 0;
+            auto next = kvstore->visitTimeline(std::move(keys), from, through,
+                                               after ? &*after : nullptr, limit,
+                                               [&](const std::string& key, const Version& version) {
+                out.beginObject(3);
+                out.field("timestamp", std::string_view(ts, TimestampCodec::format(version.timestamp, ts)));
+                out.field("key", key);
+                out.field("value", version.value);
+                out.endObject();
+                ++count;
+            });
+            out.endArrayUnsized(events, count);
+            out.key("next_cursor");
+            if (next) {
+                out.string(std::to_string(next->timestamp.time_since_epoch().count()) + ":" +
+                           std::to_string(next->ordinal) + ":" + next->key);
+            } else {
+                out.null();
+            }
+            out.endObject();
+            Metrics::instance().recordRequest("/timeline", "ok");
+            res.set_content(std::move(out.buffer()), out.contentType());
         } catch (const std::exception& e) {
             res.status = 400;
+            Metrics::instance().recordRequest("/timeline", "error");
             std::stringstream json;
             json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
             res.set_content(json.str(), "application/json");
@@ -599,33 +1255,40 @@ int main(int argc, char* argv[]) {
             auto timestamp = parseTimestamp(timestampStr);
             auto result = kvstore->explainGetAtTime(key, timestamp);
             
-            std::stringstream json;
-            json << "{\"query\":{\"key\":\"" << escapeJSON(result.key) 
-                 << "\",\"timestamp\":\"" << escapeJSON(formatTimestamp(result.queryTimestamp)) << "\"},";
-            json << "\"found\":" << (result.found ? "true" : "false") << ",";
-            json << "\"totalVersions\":" << result.totalVersions << ",";
+            ResponseWriter out(negotiateFormat(req), 1024);
+            char ts[TimestampCodec::kFormattedSize];
+            out.beginObject(6);
+            out.key("query");
+            out.beginObject(2);
+            out.field("key", result.key);
+            out.field("timestamp", std::string_view(ts, TimestampCodec::format(result.queryTimestamp, ts)));
+            out.endObject();
+            out.field("found", result.found);
+            out.field("totalVersions", static_cast<int64_t>(result.totalVersions));
             
+            out.key("selectedVersion");
             if (result.found && result.selectedVersion.has_value()) {
                 const auto& selected = result.selectedVersion.value();
-                json << "\"selectedVersion\":{\"timestamp\":\"" 
-                     << escapeJSON(formatTimestamp(selected.timestamp))
-                     << "\",\"value\":\"" << escapeJSON(selected.value) << "\"},";
+                out.beginObject(2);
+                out.field("timestamp", std::string_view(ts, TimestampCodec::format(selected.timestamp, ts)));
+                out.field("value", selected.value);
+                out.endObject();
             } else {
-                json << "\"selectedVersion\":null,";
+                out.null();
             }
             
-            json << "\"reasoning\":\"" << escapeJSON(result.reasoning) << "\",";
-            json << "\"skippedVersions\":[";
-            
-            for (size_t i = 0; i < result.skippedVersions.size(); ++i) {
-                if (i > 0) json << ",";
-                const auto& version = result.skippedVersions[i];
-                json << "{\"timestamp\":\"" << escapeJSON(formatTimestamp(version.timestamp))
-                     << "\",\"value\":\"" << escapeJSON(version.value) << "\"}";
+            out.field("reasoning", result.reasoning);
+            out.key("skippedVersions");
+            out.beginArray(result.skippedVersions.size());
+            for (const auto& version : result.skippedVersions) {
+                out.beginObject(2);
+                out.field("timestamp", std::string_view(ts, TimestampCodec::format(version.timestamp, ts)));
+                out.field("value", version.value);
+                out.endObject();
             }
-            
-            json << "]}";
-            res.set_content(json.str(), "application/json");
+            out.endArray();
+            out.endObject();
+            res.set_content(std::move(out.buffer()), out.contentType());
         } catch (const std::exception& e) {
             res.status = 400;
             std::stringstream json;
@@ -637,7 +1300,7 @@ int main(int argc, char* argv[]) {
     // POST /propose - Propose a write and get evaluation
     svr.Post("/propose", [kvstore](const httplib::Request& req, httplib::Response& res) {
         try {
-            auto params = parseSimpleJSON(req.body);
+            auto params = parseRequestBody(req);
             
             if (params.find("key") == params.end() || params.find("value") == params.end()) {
                 res.status = 400;
@@ -740,7 +1403,7 @@ int main(int argc, char* argv[]) {
     // LENGTH:    {"type":"LENGTH","name":"guard_name","keyPattern":"key*","min":"1","max":"50"}
     svr.Post("/guards", [kvstore, wal](const httplib::Request& req, httplib::Response& res) {
         try {
-            auto params = parseSimpleJSON(req.body);
+            auto params = parseRequestBody(req);
             
             spdlog::info("[HTTP] POST /guards - Received guard registration request");
             
@@ -887,7 +1550,7 @@ int main(int argc, char* argv[]) {
     // POST /config/retention - Configure retention policy
     svr.Post("/config/retention", [kvstore](const httplib::Request& req, httplib::Response& res) {
         try {
-            auto params = parseSimpleJSON(req.body);
+            auto params = parseRequestBody(req);
             
             if (params.find("mode") == params.end()) {
                 res.status = 400;
@@ -1011,7 +1674,7 @@ int main(int argc, char* argv[]) {
     // POST /policy - Set decision policy
     svr.Post("/policy", [kvstore, wal](const httplib::Request& req, httplib::Response& res) {
         try {
-            auto params = parseSimpleJSON(req.body);
+            auto params = parseRequestBody(req);
             
             if (params.find("policy") == params.end()) {
                 res.status = 400;
@@ -1063,26 +1726,719 @@ int main(int argc, char* argv[]) {
         }
     });
     
+    // GET /backup - Stream a consistent archive of the snapshot, the WAL up
+    // to the current LSN and the blob logs (see backup.h), rate limited so
+    // foreground traffic keeps its disk bandwidth. Restore with sentinel_restore.
+    svr.Get("/backup", [kvstore, wal, compression, backupBytesPerSecond, io](
+                           const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/backup");
+        if (!wal || !wal->isEnabled()) {
+            res.status = 409;
+            Metrics::instance().recordRequest("/backup", "error");
+            res.set_content("{\"error\":\"Backups need the WAL enabled\"}", "application/json");
+            return;
+        }
+        if (backupInProgress.exchange(true)) {
+            Metrics::instance().recordRequest("/backup", "error");
+            rejectBusy(res);
+            return;
+        }
+        WALBackupPoint point;
+        if (!wal->openBackupPoint(point)) {
+            backupInProgress.store(false);
+            res.status = 500;
+            Metrics::instance().recordRequest("/backup", "error");
+            res.set_content("{\"error\":\"Failed to open data files\"}", "application/json");
+            return;
+        }
+        if (auto blobs = kvstore->getBlobStore()) {
+            // Appends after this point belong to records past the backup LSN
+            blobs->pinFiles(point.files);
+        }
+
+        // Owned by the chunk provider; clears the in-progress flag when the
+        // stream finishes or the client goes away
+        struct ActiveBackup {
+            BackupStream stream;
+            ActiveBackup(const WALBackupPoint& p, uint64_t rate, std::shared_ptr<IoScheduler> io)
+                : stream(p, 1 << 20, rate, std::move(io)) {}
+            ~ActiveBackup() { backupInProgress.store(false); }
+        };
+        auto backup = std::make_shared<ActiveBackup>(point, backupBytesPerSecond, io);
+        spdlog::info("BACKUP started lsn={} bytes={}", backup->stream.lsn(), backup->stream.totalBytes());
+
+        res.set_header("Content-Disposition", "attachment; filename=\"sentineldb-" +
+                       std::to_string(backup->stream.lsn()) + ".backup\"");
+        res.set_header("X-Backup-LSN", std::to_string(backup->stream.lsn()));
+        setChunkedContent(req, res, compression, "application/octet-stream",
+            [backup](std::string& chunk) {
+                bool more = backup->stream.next(chunk);
+                if (!more && !backup->stream.ok()) {
+                    // Ends without the trailer, which sentinel_restore rejects
+                    spdlog::error("BACKUP failed reading data files lsn={}", backup->stream.lsn());
+                } else if (!more) {
+                    spdlog::info("BACKUP complete lsn={}", backup->stream.lsn());
+                }
+                return more;
+            });
+        Metrics::instance().recordRequest("/backup", "ok");
+    });
+    
+    // POST /export?from=<ts>&through=<ts>&prefix=<p> - Start writing the
+    // versions of keys under prefix stamped in [from, through] to a columnar
+    // file (see history_export.h) in the background. as_of=<ts> is an alias
+    // for through; both default to now. One export runs at a time, paced
+    // like snapshots; poll GET /export, then fetch GET /export/file.
+    svr.Post("/export", [exporter, walPath, io](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/export");
+        try {
+            HistoryExport::Options options;
+            if (req.has_param("from")) {
+                options.from = parseTimestamp(req.get_param_value("from"));
+            }
+            if (req.has_param("through")) {
+                options.through = parseTimestamp(req.get_param_value("through"));
+            } else if (req.has_param("as_of")) {
+                options.through = parseTimestamp(req.get_param_value("as_of"));
+            } else {
+                options.through = std::chrono::system_clock::now();
+            }
+            if (options.through < options.from) {
+                throw std::invalid_argument("through is before from");
+            }
+            options.prefix = req.get_param_value("prefix");
+            options.io = io;
+
+            size_t lastSlash = walPath.find_last_of("/\\");
+            std::string dir = (lastSlash == std::string::npos ? std::string() :
+                               walPath.substr(0, lastSlash + 1)) + "exports";
+            mkdir(dir.c_str(), 0755);
+            auto throughMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                options.through.time_since_epoch()).count();
+            std::string path = dir + "/history-" + std::to_string(throughMs) + ".sdbcol";
+            if (!exporter->start(path, options)) {
+                Metrics::instance().recordRequest("/export", "error");
+                rejectBusy(res);
+                return;
+            }
+            res.status = 202;
+            res.set_content(exportStatusJSON(exporter->status()), "application/json");
+            Metrics::instance().recordRequest("/export", "ok");
+        } catch (const std::exception& e) {
+            res.status = 400;
+            Metrics::instance().recordRequest("/export", "error");
+            std::stringstream json;
+            json << "{\"error\":\"Invalid request: " << escapeJSON(e.what()) << "\"}";
+            res.set_content(json.str(), "application/json");
+        }
+    });
+
+    // GET /export - Progress of the running or most recent export
+    svr.Get("/export", [exporter](const httplib::Request&, httplib::Response& res) {
+        res.set_content(exportStatusJSON(exporter->status()), "application/json");
+    });
+
+    // GET /export/file - Download the most recent completed export
+    svr.Get("/export/file", [exporter, compression, io](const httplib::Request& req,
+                                                         httplib::Response& res) {
+        RequestTimer timer("/export/file");
+        auto status = exporter->status();
+        if (status.state != HistoryExportJob::State::DONE) {
+            res.status = 409;
+            Metrics::instance().recordRequest("/export/file", "error");
+            res.set_content(std::string("{\"error\":\"No completed export\",\"state\":\"") +
+                            HistoryExportJob::stateName(status.state) + "\"}", "application/json");
+            return;
+        }
+        auto file = std::make_shared<std::ifstream>(status.path, std::ios::binary);
+        if (!*file) {
+            res.status = 410;
+            Metrics::instance().recordRequest("/export/file", "error");
+            res.set_content("{\"error\":\"Export file is gone\"}", "application/json");
+            return;
+        }
+        size_t lastSlash = status.path.find_last_of('/');
+        res.set_header("Content-Disposition", "attachment; filename=\"" +
+                       status.path.substr(lastSlash + 1) + "\"");
+        setChunkedContent(req, res, compression, "application/octet-stream",
+            [file, io](std::string& chunk) {
+                chunk.resize(1 << 20);
+                file->read(&chunk[0], static_cast<std::streamsize>(chunk.size()));
+                chunk.resize(static_cast<size_t>(file->gcount()));
+                if (io && !chunk.empty()) {
+                    io->acquire(chunk.size());
+                }
+                return !file->eof() && file->good();
+            });
+        Metrics::instance().recordRequest("/export/file", "ok");
+    });
+    
+    // POST /replication/apply?from=<lsn> - WAL records from the primary, one
+    // per line, the first with LSN `from`. Answers {"lsn":n} once they are
+    // durable here; 409 with the replica's LSN if `from` leaves a gap.
+    svr.Post("/replication/apply", [replica](const httplib::Request& req, httplib::Response& res) {
+        RequestTimer timer("/replication/apply");
+        if (!replica) {
+            res.status = 409;
+            res.set_content("{\"error\":\"Not a replica (start with --replica)\"}", "application/json");
+            return;
+        }
+        uint64_t from = 0;
+        try {
+            from = std::stoull(req.get_param_value("from"));
+        } catch (const std::exception&) {
+            res.status = 400;
+            res.set_content("{\"error\":\"Missing or invalid 'from'\"}", "application/json");
+            return;
+        }
+        uint64_t lsn = 0;
+        Status status = replica->apply(from, req.body, lsn);
+        if (status == Status::ERROR) {
+            res.status = 500;
+            Metrics::instance().recordRequest("/replication/apply", "error");
+            res.set_content("{\"error\":\"WAL write or fsync failed\",\"lsn\":" +
+                            std::to_string(lsn) + "}", "application/json");
+            return;
+        }
+        res.status = status == Status::OK ? 200 : 409;
+        Metrics::instance().recordRequest("/replication/apply", status == Status::OK ? "ok" : "error");
+        res.set_content("{\"lsn\":" + std::to_string(lsn) + "}", "application/json");
+    });
+
+    // GET /replication - Role, LSN and, on a primary, each replica's progress
+    svr.Get("/replication", [wal, replicator, replica](const httplib::Request&, httplib::Response& res) {
+        std::stringstream json;
+        uint64_t lsn = wal ? wal->lastLsn() : 0;
+        if (replica) {
+            json << "{\"role\":\"replica\",\"lsn\":" << lsn << "}";
+        } else if (!replicator) {
+            json << "{\"role\":\"standalone\",\"lsn\":" << lsn << "}";
+        } else {
+            auto stats = replicator->stats();
+            json << "{\"role\":\"primary\",\"lsn\":" << lsn
+                 << ",\"sync_replicas\":" << stats.syncReplicas
+                 << ",\"semi_sync\":" << (stats.semiSync ? "true" : "false")
+                 << ",\"sync_waits\":" << stats.syncWaits
+                 << ",\"sync_timeouts\":" << stats.syncTimeouts << ",\"replicas\":[";
+            for (size_t i = 0; i < stats.replicas.size(); ++i) {
+                const auto& r = stats.replicas[i];
+                json << (i ? "," : "") << "{\"address\":\"" << escapeJSON(r.address) << "\""
+                     << ",\"acked_lsn\":" << r.ackedLsn
+                     << ",\"lag\":" << (stats.lastLsn > r.ackedLsn ? stats.lastLsn - r.ackedLsn : 0)
+                     << ",\"connected\":" << (r.connected ? "true" : "false")
+                     << ",\"lost\":" << (r.lost ? "true" : "false")
+                     << ",\"batches\":" << r.batches << ",\"records\":" << r.records << "}";
+            }
+            json << "]}";
+        }
+        res.set_content(json.str(), "application/json");
+    });
+    
+    // GET /stats - Per-prefix key counts and value/history distributions,
+    // kept up to date on every write, so this never walks the store
+    svr.Get("/stats", [kvstore](const httplib::Request&, httplib::Response& res) {
+        RequestTimer timer("/stats");
+        auto keyspace = kvstore->getKeyspaceStats();
+        if (!keyspace) {
+            res.status = 404;
+            res.set_content("{\"error\":\"Keyspace statistics are disabled\"}", "application/json");
+            Metrics::instance().recordRequest("/stats", "error");
+            return;
+        }
+        auto writeGroup = [](std::stringstream& json, const KeyspaceStats::Group& group) {
+            auto distribution = [&json](const TDigest& digest) {
+                json << "{\"p50\":" << digest.quantile(0.5) << ",\"p90\":" << digest.quantile(0.9)
+                     << ",\"p99\":" << digest.quantile(0.99) << ",\"max\":" << digest.max() << "}";
+            };
+            json << "\"keys\":" << group.keys << ",\"resident\":" << group.resident
+                 << ",\"writes\":" << group.writes
+                 << ",\"distinct_values\":" << std::llround(group.distinctValues.estimate())
+                 << ",\"value_bytes\":";
+            distribution(group.valueBytes);
+            json << ",\"history_length\":";
+            distribution(group.historyLength);
+        };
+        auto groups = keyspace->snapshot();
+        std::stringstream json;
+        json << "{\"delimiter\":\"" << escapeJSON(std::string(1, keyspace->options().delimiter))
+             << "\",\"prefixes\":[";
+        bool first = true;
+        for (const auto& [prefix, group] : groups) {
+            json << (first ? "" : ",") << "{\"prefix\":\"" << escapeJSON(prefix) << "\",";
+            writeGroup(json, group);
+            json << "}";
+            first = false;
+        }
+        json << "],\"all\":{";
+        writeGroup(json, KeyspaceStats::total(groups));
+        json << "}}";
+        res.set_content(json.str(), "application/json");
+        Metrics::instance().recordRequest("/stats", "ok");
+    });
+    
+    // Prometheus metrics endpoint
+    svr.Get("/metrics", [kvstore, tracker, io, replicator](const httplib::Request&, httplib::Response& res) {
+        RequestTimer timer("/metrics");
+        if (tracker) {
+            auto stats = tracker->stats();
+            Metrics::instance().setTrackingState(stats.clients, stats.entries);
+        }
+        auto eviction = kvstore->evictionStats();
+        Metrics::instance().setEvictionState(eviction.evictedKeys, eviction.passes,
+                                             eviction.inlineEvictions);
+        if (auto spill = kvstore->getSpillStore()) {
+            auto stats = spill->stats();
+            Metrics::instance().setSpillState(stats.keys, stats.fileBytes, stats.spilled,
+                                              stats.reloaded);
+        }
+        if (auto blobs = kvstore->getBlobStore()) {
+            auto stats = blobs->stats();
+            Metrics::instance().setBlobState(stats.files, stats.diskBytes, stats.bytesWritten,
+                                             stats.bytesReclaimed, stats.readErrors);
+        }
+        if (io) {
+            auto stats = io->stats();
+            Metrics::instance().setIoState(stats.bytesPerSecond, stats.syncLatencyUs,
+                                           stats.latencyTargetUs, stats.bytes,
+                                           stats.throttledMicros, stats.decreases);
+        }
+        if (replicator) {
+            auto stats = replicator->stats();
+            std::vector<std::pair<std::string, uint64_t>> acked;
+            for (const auto& replica : stats.replicas) {
+                acked.emplace_back(replica.address, replica.ackedLsn);
+            }
+            Metrics::instance().setReplicationState(stats.syncReplicas, stats.semiSync,
+                                                    stats.lastLsn, acked);
+        }
+        if (auto keyspace = kvstore->getKeyspaceStats()) {
+            std::vector<Metrics::KeyspaceGauges> gauges;
+            for (const auto& [prefix, group] : keyspace->snapshot()) {
+                Metrics::KeyspaceGauges g;
+                g.prefix = prefix;
+                g.keys = group.keys;
+                g.resident = group.resident;
+                g.writes = group.writes;
+                g.distinctValues = group.distinctValues.estimate();
+                const double quantiles[] = {0.5, 0.9, 0.99};
+                for (int i = 0; i < 3; ++i) {
+                    g.valueBytes[i] = group.valueBytes.quantile(quantiles[i]);
+                    g.historyLength[i] = group.historyLength.quantile(quantiles[i]);
+                }
+                gauges.push_back(std::move(g));
+            }
+            Metrics::instance().setKeyspaceState(std::move(gauges));
+        }
+        res.set_content(Metrics::instance().toPrometheusFormat(),
+                        "text/plain; version=0.0.4");
+        Metrics::instance().recordRequest("/metrics", "ok");
+    });
+}
+
+int main(int argc, char* argv[]) {
+    // Parse command line arguments
+    int port = 8080;
+    std::string walPath = "data/wal.log";
+    std::string unixSocketPath;
+    mode_t unixSocketMode = 0660;
+    bool compressionEnabled = true;
+    size_t compressMinBytes = 1024;
+    int compressLevel = 1;
+    size_t compressMaxConcurrent = std::max(1u, std::thread::hardware_concurrency() / 2);
+    size_t workerThreads = 0;  // 0 = httplib default
+    size_t maxInflightWaits = 0;  // 0 = half the worker pool
+    uint64_t backupRateMB = 64;  // 0 = unlimited
+    InvalidationTracker::Options trackingOptions;
+    size_t maxKeys = 100000;
+    size_t evictLowWatermark = 0;  // 0 = 90% of maxKeys
+    std::string spillPath;  // empty = next to the WAL
+    bool spillEnabled = true;
+    MemoryMonitor::Options memoryOptions;
+    bool memoryMonitorEnabled = true;
+    Defragmenter::Options defragOptions;
+    bool defragEnabled = true;
+    BlobStore::Options blobOptions;
+    bool blobsEnabled = true;
+    IoScheduler::Options ioOptions;
+    bool ioSchedulerEnabled = true;
+    Replicator::Options replicationOptions;
+    bool replicaMode = false;
+    ReadConsistency readConsistency;
+    KeyspaceStats::Options keyspaceOptions;
+    bool keyspaceStatsEnabled = true;
+    SentinelDB::initLogger();
+    spdlog::info("SentinelDB starting up");
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (arg == "--wal" && i + 1 < argc) {
+            walPath = argv[++i];
+        } else if (arg == "--unix-socket" && i + 1 < argc) {
+            unixSocketPath = argv[++i];
+        } else if (arg == "--unix-socket-mode" && i + 1 < argc) {
+            unixSocketMode = static_cast<mode_t>(std::stoul(argv[++i], nullptr, 8));
+        } else if (arg == "--no-compression") {
+            compressionEnabled = false;
+        } else if (arg == "--compress-min-bytes" && i + 1 < argc) {
+            compressMinBytes = std::stoul(argv[++i]);
+        } else if (arg == "--compress-level" && i + 1 < argc) {
+            compressLevel = std::stoi(argv[++i]);
+        } else if (arg == "--compress-max-concurrent" && i + 1 < argc) {
+            compressMaxConcurrent = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            workerThreads = std::stoul(argv[++i]);
+        } else if (arg == "--max-inflight-waits" && i + 1 < argc) {
+            maxInflightWaits = std::stoul(argv[++i]);
+        } else if (arg == "--backup-rate-mb" && i + 1 < argc) {
+            backupRateMB = std::stoull(argv[++i]);
+        } else if (arg == "--tracking-slots" && i + 1 < argc) {
+            trackingOptions.slots = std::stoul(argv[++i]);
+        } else if (arg == "--tracking-max-entries" && i + 1 < argc) {
+            trackingOptions.maxEntries = std::stoul(argv[++i]);
+        } else if (arg == "--tracking-max-clients" && i + 1 < argc) {
+            trackingOptions.maxClients = std::stoul(argv[++i]);
+        } else if (arg == "--max-keys" && i + 1 < argc) {
+            maxKeys = std::stoul(argv[++i]);
+        } else if (arg == "--evict-low-watermark" && i + 1 < argc) {
+            evictLowWatermark = std::stoul(argv[++i]);
+        } else if (arg == "--spill" && i + 1 < argc) {
+            spillPath = argv[++i];
+        } else if (arg == "--no-spill") {
+            spillEnabled = false;
+        } else if (arg == "--memory-limit-mb" && i + 1 < argc) {
+            memoryOptions.limitBytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--cgroup-dir" && i + 1 < argc) {
+            memoryOptions.cgroupDir = argv[++i];
+        } else if (arg == "--no-memory-monitor") {
+            memoryMonitorEnabled = false;
+        } else if (arg == "--defrag-threshold" && i + 1 < argc) {
+            defragOptions.minFragmentation = std::stod(argv[++i]);
+        } else if (arg == "--defrag-min-waste-mb" && i + 1 < argc) {
+            defragOptions.minWastedBytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--defrag-cpu-percent" && i + 1 < argc) {
+            defragOptions.maxCpuPercent = std::stod(argv[++i]);
+        } else if (arg == "--no-defrag") {
+            defragEnabled = false;
+        } else if (arg == "--blob-threshold" && i + 1 < argc) {
+            blobOptions.threshold = std::stoul(argv[++i]);
+        } else if (arg == "--blob-file-mb" && i + 1 < argc) {
+            blobOptions.fileBytes = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--no-blobs") {
+            blobsEnabled = false;
+        } else if (arg == "--io-rate-mb" && i + 1 < argc) {
+            ioOptions.maxBytesPerSecond = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--io-min-rate-mb" && i + 1 < argc) {
+            ioOptions.minBytesPerSecond = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--io-latency-target-ms" && i + 1 < argc) {
+            ioOptions.latencyTarget = std::chrono::microseconds(
+                static_cast<int64_t>(std::stod(argv[++i]) * 1000));
+        } else if (arg == "--no-io-adapt") {
+            ioOptions.adaptive = false;
+        } else if (arg == "--no-io-scheduler") {
+            ioSchedulerEnabled = false;
+        } else if (arg == "--replicas" && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            std::string address;
+            while (std::getline(list, address, ',')) {
+                if (!address.empty()) {
+                    replicationOptions.replicas.push_back(address);
+                }
+            }
+        } else if (arg == "--sync-replicas" && i + 1 < argc) {
+            replicationOptions.syncReplicas = std::stoul(argv[++i]);
+        } else if (arg == "--sync-timeout-ms" && i + 1 < argc) {
+            replicationOptions.syncTimeout = std::chrono::milliseconds(std::stoul(argv[++i]));
+        } else if (arg == "--replica") {
+            replicaMode = true;
+        } else if (arg == "--read-wait-ms" && i + 1 < argc) {
+            readConsistency.wait = std::chrono::milliseconds(std::stoul(argv[++i]));
+        } else if (arg == "--primary-url" && i + 1 < argc) {
+            readConsistency.primaryUrl = argv[++i];
+            while (!readConsistency.primaryUrl.empty() && readConsistency.primaryUrl.back() == '/') {
+                readConsistency.primaryUrl.pop_back();
+            }
+        } else if (arg == "--stats-delimiter" && i + 1 < argc) {
+            std::string delimiter = argv[++i];
+            if (delimiter.size() != 1) {
+                spdlog::error("--stats-delimiter must be a single character");
+                return 1;
+            }
+            keyspaceOptions.delimiter = delimiter[0];
+        } else if (arg == "--stats-max-prefixes" && i + 1 < argc) {
+            keyspaceOptions.maxPrefixes = std::stoul(argv[++i]);
+        } else if (arg == "--no-keyspace-stats") {
+            keyspaceStatsEnabled = false;
+        } else if (arg == "--help") {
+            spdlog::info(
+                "Usage: {} [OPTIONS]\n"
+                "Options:\n"
+                "  --port <num>    HTTP port (default: 8080)\n"
+                "  --wal <path>    WAL file path (default: data/wal.log)\n"
+                "  --unix-socket <path>       Also listen on a Unix domain socket\n"
+                "  --unix-socket-mode <octal> Socket file permissions (default: 0660)\n"
+                "  --no-compression           Never compress responses\n"
+                "  --compress-min-bytes <n>   Smallest body worth compressing (default: 1024)\n"
+                "  --compress-level <1-9>     gzip/deflate level (default: 1, fastest)\n"
+                "  --compress-max-concurrent <n> Responses compressed at once (default: cores/2)\n"
+                "  --threads <n>              HTTP worker threads per listener (default: httplib's)\n"
+                "  --max-inflight-waits <n>   Requests waiting on a worker at once (default: threads/2)\n"
+                "  --backup-rate-mb <n>       /backup read rate in MB/s, 0 = unlimited (default: 64)\n"
+                "  --tracking-slots <n>       Key-hash slots for cache invalidation (default: 65536)\n"
+                "  --tracking-max-entries <n> Tracked client/key pairs across all slots (default: 1048576)\n"
+                "  --tracking-max-clients <n> Clients registered for invalidation (default: 10000)\n"
+                "  --max-keys <n>             LRU eviction high watermark (default: 100000)\n"
+                "  --evict-low-watermark <n>  Background eviction target (default: 90% of max-keys)\n"
+                "  --spill <path>             Spill file for evicted keys (default: spill.dat next to the WAL)\n"
+                "  --no-spill                 Drop evicted keys instead of spilling them\n"
+                "  --memory-limit-mb <n>      Memory budget (default: cgroup memory.max)\n"
+                "  --cgroup-dir <path>        cgroup v2 directory (default: from /proc/self/cgroup)\n"
+                "  --no-memory-monitor        Don't adapt to memory limit or pressure\n"
+                "  --defrag-threshold <ratio> Heap/in-use ratio that starts defragmentation (default: 1.4)\n"
+                "  --defrag-min-waste-mb <n>  Idle heap needed before defragmenting (default: 64)\n"
+                "  --defrag-cpu-percent <n>   CPU budget of a defragmentation pass (default: 10)\n"
+                "  --no-defrag                Never defragment memory\n"
+                "  --blob-threshold <bytes>   Store values this large in blob logs (default: 65536)\n"
+                "  --blob-file-mb <n>         Size at which a blob log is sealed (default: 64)\n"
+                "  --no-blobs                 Keep every value inline in the WAL and snapshots\n"
+                "  --io-rate-mb <n>           Background I/O ceiling in MB/s (default: 256)\n"
+                "  --io-min-rate-mb <n>       Background I/O floor under fsync pressure (default: 4)\n"
+                "  --io-latency-target-ms <n> WAL fsync latency to protect (default: 3x idle, min 2)\n"
+                "  --no-io-adapt              Keep background I/O at --io-rate-mb regardless of fsyncs\n"
+                "  --no-io-scheduler          Don't pace snapshot, spill and backup I/O\n"
+                "  --replicas <h:p,...>       Ship the WAL to these replicas\n"
+                "  --sync-replicas <k>        Acknowledge a SET once k replicas have it (default: 0, async)\n"
+                "  --sync-timeout-ms <n>      Then fall back to async until they catch up (default: 1000)\n"
+                "  --replica                  Read-only; apply the WAL a primary ships here\n"
+                "  --read-wait-ms <n>         How long a read waits for its min_lsn (default: 100)\n"
+                "  --primary-url <url>        Then redirect it there instead of answering 503\n"
+                "  --stats-delimiter <c>      Keys are grouped in /stats by what precedes it (default: ':')\n"
+                "  --stats-max-prefixes <n>   Prefixes tracked before the rest share one group (default: 256)\n"
+                "  --no-keyspace-stats        Don't maintain per-prefix keyspace statistics\n"
+                "  --help          Show this help",
+                argv[0]);
+            return 0;
+        }
+    }
+
+    // Ensure WAL directory exists
+    {
+        size_t lastSlash = walPath.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+            std::string dirPath = walPath.substr(0, lastSlash);
+            struct stat st;
+            if (stat(dirPath.c_str(), &st) != 0) {
+                mkdir(dirPath.c_str(), 0755);
+            }
+        }
+    }
+    
+    // Initialize KVStore with optional WAL
+    std::shared_ptr<WAL> wal;
+    if (!walPath.empty()) {
+        wal = std::make_shared<WAL>(walPath);
+        wal->initialize();
+        spdlog::info("WAL initialized path={}", walPath);
+        spdlog::info("WAL enabled path={}", walPath);
+    }
+    
+    // One disk budget for snapshot, spill and backup I/O, set from WAL fsync latency
+    std::shared_ptr<IoScheduler> io;
+    if (ioSchedulerEnabled) {
+        io = std::make_shared<IoScheduler>(ioOptions);
+        if (wal) {
+            wal->setIoScheduler(io);
+        }
+        spdlog::info("Background I/O rate_mb={} min_rate_mb={} adaptive={}",
+                     ioOptions.maxBytesPerSecond >> 20, ioOptions.minBytesPerSecond >> 20,
+                     ioOptions.adaptive);
+    }
+    
+    auto kvstore = std::make_shared<KVStore>(wal);
+    if (evictLowWatermark == 0) {
+        kvstore->setMaxKeys(maxKeys);
+    } else {
+        kvstore->setEvictionWatermarks(maxKeys, evictLowWatermark);
+    }
+    spdlog::info("LRU eviction watermarks high={} low={}", kvstore->getMaxKeys(),
+                 kvstore->getEvictionLowWatermark());
+    if (spillEnabled) {
+        if (spillPath.empty()) {
+            size_t lastSlash = walPath.find_last_of("/\\");
+            spillPath = lastSlash == std::string::npos
+                ? "spill.dat" : walPath.substr(0, lastSlash + 1) + "spill.dat";
+        }
+        auto spill = std::make_shared<SpillStore>(spillPath);
+        spill->setIoScheduler(io);
+        if (spill->initialize() == Status::OK) {
+            kvstore->setSpillStore(spill);
+            spdlog::info("Evicted keys spill to {}", spillPath);
+        } else {
+            spdlog::warn("Spill file unavailable; evicted keys will be dropped");
+        }
+    }
+    if (blobsEnabled && wal && wal->isEnabled()) {
+        size_t lastSlash = walPath.find_last_of("/\\");
+        std::string blobDir = lastSlash == std::string::npos
+            ? "blobs" : walPath.substr(0, lastSlash + 1) + "blobs";
+        auto blobs = std::make_shared<BlobStore>(blobDir, blobOptions);
+        if (blobs->initialize() == Status::OK) {
+            kvstore->setBlobStore(blobs);
+            spdlog::info("Values of {}+ bytes stored in {}", blobOptions.threshold, blobDir);
+        } else {
+            spdlog::warn("Blob directory unavailable; large values stay inline");
+        }
+    }
+    
+    if (keyspaceStatsEnabled) {
+        // Before replay, so the statistics cover the recovered keys too
+        kvstore->setKeyspaceStats(std::make_shared<KeyspaceStats>(keyspaceOptions));
+        spdlog::info("Keyspace statistics by prefix delimiter='{}' max_prefixes={}",
+                     keyspaceOptions.delimiter, keyspaceOptions.maxPrefixes);
+    }
+    
+    // Replay snapshot and WAL after creating kvstore
+    if (wal && wal->isEnabled()) {
+        try {
+            Recovery::replay(*kvstore, *wal);
+        } catch (const std::exception& e) {
+            spdlog::error("Recovery failed: {}. Restore the data directory from a backup", e.what());
+            return 1;
+        }
+    }
+    
+    // Optional API key auth — set SENTINEL_API_KEY env var to enable
+    const char* apiKeyEnv = std::getenv("SENTINEL_API_KEY");
+    std::string requiredApiKey = apiKeyEnv ? std::string(apiKeyEnv) : "";
+    if (!requiredApiKey.empty()) {
+        spdlog::info("API key authentication enabled");
+    } else {
+        spdlog::warn("No API key set — server is publicly accessible. Set SENTINEL_API_KEY env var.");
+    }
+    
+    // Response compression (gzip/deflate via Accept-Encoding)
+    std::shared_ptr<ResponseCompression> compression;
+    if (compressionEnabled && ResponseCompression::available()) {
+        compression = std::make_shared<ResponseCompression>(compressMinBytes, compressLevel,
+                                                            compressMaxConcurrent);
+        spdlog::info("Response compression enabled min_bytes={} level={} max_concurrent={}",
+                     compressMinBytes, compression->level(), compression->budget().slots());
+    } else if (compressionEnabled) {
+        spdlog::warn("Built without zlib — response compression unavailable");
+    }
+    
+    // Worker pool. Waiting requests (see WaitSlots) each occupy a worker, so
+    // at most half the pool may wait by default.
+    if (workerThreads == 0) {
+        workerThreads = CPPHTTPLIB_THREAD_POOL_COUNT;
+    }
+    if (maxInflightWaits == 0) {
+        maxInflightWaits = std::max<size_t>(1, workerThreads / 2);
+    }
+    auto waits = std::make_shared<WaitSlots>(maxInflightWaits);
+    spdlog::info("HTTP workers threads={} max_inflight_waits={}", workerThreads, waits->limit());
+    
+    // Client-side cache invalidation, fed by every committed write
+    auto tracker = std::make_shared<InvalidationTracker>(trackingOptions);
+    kvstore->addChangeListener([tracker](const KeyChange& change) {
+        if (change.prefix) {
+            tracker->prefixChanged(change.key);
+        } else {
+            tracker->keyChanged(change.key);
+        }
+    });
+    
+    // Adapt to the cgroup memory limit and PSI pressure instead of meeting the OOM killer
+    std::shared_ptr<MemoryMonitor> memory;
+    if (memoryMonitorEnabled) {
+        memory = std::make_shared<MemoryMonitor>(kvstore, memoryOptions);
+        if (!memory->start()) {
+            memory.reset();
+        }
+    }
+    
+    // Give memory back after retention trims and mass deletes
+    std::unique_ptr<Defragmenter> defrag;
+    if (defragEnabled) {
+        defrag = std::make_unique<Defragmenter>(kvstore, defragOptions);
+        defrag->start();
+    }
+    
+    // Log shipping. A replica's LSNs are its primary's, so both must start
+    // from the same state (seed replicas from a /backup of the primary).
+    std::shared_ptr<Replicator> replicator;
+    std::shared_ptr<ReplicaSink> replica;
+    if (replicaMode) {
+        if (!wal || !wal->isEnabled() || !replicationOptions.replicas.empty()) {
+            spdlog::error("--replica needs the WAL and can't be combined with --replicas");
+            return 1;
+        }
+        replica = std::make_shared<ReplicaSink>(wal, kvstore);
+        spdlog::info("Read-only replica at lsn={}", replica->lsn());
+    } else if (!replicationOptions.replicas.empty()) {
+        if (!wal || !wal->isEnabled()) {
+            spdlog::error("--replicas needs the WAL");
+            return 1;
+        }
+        replicationOptions.apiKey = requiredApiKey;
+        replicator = std::make_shared<Replicator>(wal, kvstore, replicationOptions);
+        replicator->start();
+    }
+    
+    // Background columnar exports (POST /export), shared by both listeners
+    auto exporter = std::make_shared<HistoryExportJob>(kvstore);
+    
+    // Initialize HTTP server
+    httplib::Server svr;
+    svr.new_task_queue = [workerThreads] { return new httplib::ThreadPool(workerThreads); };
+    registerRoutes(svr, kvstore, wal, walPath, requiredApiKey, compression, waits,
+                   backupRateMB * 1024 * 1024, tracker, memory, io, exporter,
+                   replicator, replica, readConsistency);
+    // Small JSON responses otherwise sit behind Nagle + delayed ACK (~40ms)
+    svr.set_tcp_nodelay(true);
+    spdlog::info("Metrics endpoint registered path=/metrics");
+    
+    // Optional Unix domain socket listener for co-located clients (nginx, SDKs).
+    // Skips the loopback TCP stack entirely; access is controlled by file mode.
+    std::unique_ptr<httplib::Server> unixSvr;
+    if (!unixSocketPath.empty()) {
+        unixSvr = std::make_unique<httplib::Server>();
+        unixSvr->new_task_queue = [workerThreads] { return new httplib::ThreadPool(workerThreads); };
+        registerRoutes(*unixSvr, kvstore, wal, walPath, requiredApiKey, compression, waits,
+                       backupRateMB * 1024 * 1024, tracker, memory, io, exporter,
+                       replicator, replica, readConsistency);
+        unixSvr->set_address_family(AF_UNIX);
+        
+        // Remove a stale socket left behind by an unclean shutdown
+        ::unlink(unixSocketPath.c_str());
+        if (!unixSvr->bind_to_port(unixSocketPath, 80)) {
+            spdlog::error("Failed to bind Unix socket path={}", unixSocketPath);
+            return 1;
+        }
+        if (::chmod(unixSocketPath.c_str(), unixSocketMode) != 0) {
+            spdlog::warn("Failed to set Unix socket mode path={} mode={:o}", unixSocketPath, unixSocketMode);
+        }
+    }
+    
     // Register signal handlers
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
     
     // Start server in background thread
     spdlog::info("HTTP server listening port={}", port);
-    
-    // Start server in background thread
     std::thread serverThread([&svr, port]() {
-        // Prometheus metrics endpoint
-        svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
-            RequestTimer timer("/metrics");
-            res.set_content(Metrics::instance().toPrometheusFormat(),
-                            "text/plain; version=0.0.4");
-            Metrics::instance().recordRequest("/metrics", "ok");
-        });
-        spdlog::info("Metrics endpoint registered path=/metrics");
         svr.listen("0.0.0.0", port);
     });
     
+    std::thread unixServerThread;
+    if (unixSvr) {
+        spdlog::info("HTTP server listening unix_socket={} mode={:o}", unixSocketPath, unixSocketMode);
+        unixServerThread = std::thread([&unixSvr]() {
+            unixSvr->listen_after_bind();
+        });
+    }
+    
     // Keep main thread alive until shutdown signal
     while (!shutdownRequested.load()) {
         std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -1091,10 +2447,26 @@ int main(int argc, char* argv[]) {
     // Graceful shutdown
     spdlog::info("SentinelDB shutting down gracefully");
     svr.stop();
+    if (unixSvr) {
+        unixSvr->stop();
+    }
+    if (memory) {
+        memory->stop();
+    }
+    if (defrag) {
+        defrag->stop();
+    }
+    if (replicator) {
+        replicator->stop();
+    }
     
     if (serverThread.joinable()) {
         serverThread.join();
     }
+    if (unixServerThread.joinable()) {
+        unixServerThread.join();
+        ::unlink(unixSocketPath.c_str());
+    }
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,151 @@
+#include "ingest.h"
+#include <algorithm>
+#include <cstring>
+
+IngestStream::IngestStream(std::shared_ptr<KVStore> store, Parser parser, const Options& options)
+    : store_(std::move(store)), parser_(std::move(parser)), options_(options) {
+    options_.batchRecords = std::max<size_t>(1, options_.batchRecords);
+    filling_.writes.reserve(options_.batchRecords);
+    applier_ = std::thread(&IngestStream::applyLoop, this);
+}
+
+IngestStream::~IngestStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    cv_.notify_all();
+    if (applier_.joinable()) {
+        applier_.join();
+    }
+}
+
+void IngestStream::feed(const char* data, size_t length) {
+    while (length > 0) {
+        const char* newline = static_cast<const char*>(std::memchr(data, '\n', length));
+        const size_t segment = newline ? size_t(newline - data) : length;
+        if (!skipping_) {
+            if (newline && partial_.empty() && segment <= options_.maxLineBytes) {
+                // The whole line is in this piece: no copy
+                parseLine(data, segment);
+            } else {
+                partial_.append(data, segment);
+                if (partial_.size() > options_.maxLineBytes) {
+                    ++line_;
+                    recordError(line_, std::string(), "Line too long");
+                    partial_.clear();
+                    partial_.shrink_to_fit();
+                    skipping_ = true;
+                } else if (newline) {
+                    parseLine(partial_.data(), partial_.size());
+                    partial_.clear();
+                }
+            }
+        }
+        if (!newline) {
+            break;
+        }
+        // Whatever was skipped, the next line starts here
+        skipping_ = false;
+        data = newline + 1;
+        length -= segment + 1;
+    }
+}
+
+void IngestStream::parseLine(const char* data, size_t length) {
+    ++line_;
+    if (length > 0 && data[length - 1] == '\r') {
+        --length;
+    }
+    if (std::all_of(data, data + length, [](char c) { return c == ' ' || c == '\t'; })) {
+        return;
+    }
+    BatchWrite write;
+    std::string error;
+    if (!parser_(std::string(data, length), write, error)) {
+        recordError(line_, write.key, error);
+        return;
+    }
+    filling_.bytes += write.key.size() + write.value.size();
+    filling_.writes.push_back(std::move(write));
+    filling_.lines.push_back(line_);
+    if (filling_.writes.size() >= options_.batchRecords || filling_.bytes >= options_.batchBytes) {
+        submit();
+    }
+}
+
+void IngestStream::submit() {
+    if (filling_.writes.empty()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Parse ahead by one batch at most
+        cv_.wait(lock, [this] { return !hasQueued_ && !applying_; });
+        queued_ = std::move(filling_);
+        hasQueued_ = true;
+    }
+    cv_.notify_all();
+    filling_ = Batch();
+    filling_.writes.reserve(options_.batchRecords);
+}
+
+void IngestStream::applyLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return hasQueued_ || done_; });
+        if (!hasQueued_) {
+            return;
+        }
+        Batch batch = std::move(queued_);
+        hasQueued_ = false;
+        applying_ = true;
+        lock.unlock();
+
+        const size_t applied = store_->setBatch(batch.writes);
+
+        lock.lock();
+        result_.batches++;
+        result_.applied += applied;
+        for (size_t i = 0; i < batch.writes.size(); ++i) {
+            result_.records++;
+            if (batch.writes[i].status != Status::OK) {
+                result_.failed++;
+                if (result_.errors.size() < options_.maxErrors) {
+                    result_.errors.push_back(Error{batch.lines[i], batch.writes[i].key,
+                                                   batch.writes[i].reason});
+                }
+            }
+        }
+        applying_ = false;
+        cv_.notify_all();
+    }
+}
+
+void IngestStream::recordError(uint64_t line, const std::string& key, const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result_.records++;
+    result_.failed++;
+    if (result_.errors.size() < options_.maxErrors) {
+        result_.errors.push_back(Error{line, key, message});
+    }
+}
+
+IngestStream::Result IngestStream::finish() {
+    if (!skipping_ && !partial_.empty()) {
+        parseLine(partial_.data(), partial_.size());
+        partial_.clear();
+    }
+    submit();
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !hasQueued_ && !applying_; });
+        done_ = true;
+    }
+    cv_.notify_all();
+    applier_.join();
+    // Parse errors and guard refusals are recorded from different threads
+    std::sort(result_.errors.begin(), result_.errors.end(),
+              [](const Error& a, const Error& b) { return a.line < b.line; });
+    return std::move(result_);
+}
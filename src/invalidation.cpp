@@ -0,0 +1,277 @@
+#include "invalidation.h"
+#include "metrics.h"
+#include <algorithm>
+
+InvalidationTracker::InvalidationTracker(const Options& options)
+    : options_(options), slotEntries_(std::max<size_t>(1, options.slots)) {}
+
+int64_t InvalidationTracker::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t InvalidationTracker::slotOf(const std::string& key, size_t slots) {
+    // FNV-1a; clients never see slot numbers, so any stable hash works
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return static_cast<uint32_t>(hash % slots);
+}
+
+std::shared_ptr<InvalidationTracker::Client> InvalidationTracker::find(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+    auto it = clients_.find(id);
+    return it == clients_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<InvalidationTracker::Client>
+InvalidationTracker::findOrCreate(const std::string& clientId, bool& created) {
+    created = false;
+    int64_t now = nowMs();
+    int64_t lastSweep = lastSweepMs_.load(std::memory_order_relaxed);
+    int64_t sweepEvery = std::max<int64_t>(1000, options_.clientTtl.count() * 250);
+    if (now - lastSweep > sweepEvery &&
+        lastSweepMs_.compare_exchange_strong(lastSweep, now, std::memory_order_relaxed)) {
+        expireIdle(now);
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        auto it = clientIds_.find(clientId);
+        if (it != clientIds_.end()) {
+            auto& client = clients_.at(it->second);
+            client->lastSeenMs.store(now, std::memory_order_relaxed);
+            return client;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    auto it = clientIds_.find(clientId);
+    if (it != clientIds_.end()) {
+        return clients_.at(it->second);
+    }
+    if (clients_.size() >= options_.maxClients) {
+        return nullptr;
+    }
+    auto client = std::make_shared<Client>();
+    client->id = nextClientId_++;
+    client->name = clientId;
+    client->lastSeenMs.store(now, std::memory_order_relaxed);
+    clientIds_.emplace(clientId, client->id);
+    clients_.emplace(client->id, client);
+    clientCount_.store(clients_.size(), std::memory_order_relaxed);
+    created = true;
+    return client;
+}
+
+void InvalidationTracker::expireIdle(int64_t now) {
+    const int64_t cutoff = now - std::chrono::duration_cast<std::chrono::milliseconds>(
+        options_.clientTtl).count();
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        const auto& client = it->second;
+        if (client->polling.load() == 0 && client->lastSeenMs.load() < cutoff) {
+            // Its ids left in the slot table are skipped when they fire
+            clientIds_.erase(client->name);
+            broadcastClients_.erase(
+                std::remove(broadcastClients_.begin(), broadcastClients_.end(), client),
+                broadcastClients_.end());
+            it = clients_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    clientCount_.store(clients_.size(), std::memory_order_relaxed);
+}
+
+bool InvalidationTracker::trackRead(const std::string& clientId, const std::string& key) {
+    bool created;
+    auto client = findOrCreate(clientId, created);
+    if (!client) return false;
+    if (client->broadcast) return true;  // already hears about every matching write
+
+    uint32_t slot = slotOf(key, slotEntries_.size());
+    bool added = false;
+    {
+        std::lock_guard<std::mutex> lock(stripes_[slot % kStripes]);
+        auto& entries = slotEntries_[slot];
+        const uint32_t id = client->id;
+        if (std::none_of(entries.begin(), entries.end(),
+                         [&](const Entry& e) { return e.client == id && e.key == key; })) {
+            entries.push_back(Entry{id, key});
+            added = true;
+        }
+    }
+    if (added && entries_.fetch_add(1, std::memory_order_relaxed) + 1 > options_.maxEntries) {
+        evictSlot();
+    }
+    return true;
+}
+
+bool InvalidationTracker::subscribePrefixes(const std::string& clientId,
+                                            const std::vector<std::string>& prefixes) {
+    bool created;
+    auto client = findOrCreate(clientId, created);
+    if (!client) return false;
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    client->prefixes = prefixes.empty() ? std::vector<std::string>{""} : prefixes;
+    if (!client->broadcast.exchange(true)) {
+        broadcastClients_.push_back(client);
+    }
+    return true;
+}
+
+void InvalidationTracker::enqueue(Client& client, const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        if (client.flush) return;  // a pending flush already covers it
+        if (client.queue.size() >= options_.maxQueued) {
+            client.queue.clear();
+            client.flush = true;
+            Metrics::instance().recordInvalidationFlush();
+        } else {
+            client.queue.push_back(key);
+        }
+    }
+    client.cv.notify_all();
+}
+
+void InvalidationTracker::flushClient(Client& client) {
+    {
+        std::lock_guard<std::mutex> lock(client.mutex);
+        client.queue.clear();
+        client.flush = true;
+    }
+    Metrics::instance().recordInvalidationFlush();
+    client.cv.notify_all();
+}
+
+void InvalidationTracker::keyChanged(const std::string& key) {
+    // Fast path: nobody is caching
+    if (clientCount_.load(std::memory_order_relaxed) == 0) return;
+
+    uint32_t slot = slotOf(key, slotEntries_.size());
+    std::vector<uint32_t> ids;
+    {
+        // Only the readers of this key; others sharing the slot stay tracked
+        std::lock_guard<std::mutex> lock(stripes_[slot % kStripes]);
+        auto& entries = slotEntries_[slot];
+        auto kept = std::partition(entries.begin(), entries.end(),
+                                   [&](const Entry& e) { return e.key != key; });
+        for (auto it = kept; it != entries.end(); ++it) {
+            ids.push_back(it->client);
+        }
+        entries.erase(kept, entries.end());
+    }
+    size_t notified = 0;
+    if (!ids.empty()) {
+        entries_.fetch_sub(ids.size(), std::memory_order_relaxed);
+        for (uint32_t id : ids) {
+            if (auto client = find(id)) {
+                enqueue(*client, key);
+                ++notified;
+            }
+        }
+    }
+
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+    for (const auto& client : broadcastClients_) {
+        for (const auto& prefix : client->prefixes) {
+            if (key.compare(0, prefix.size(), prefix) == 0) {
+                enqueue(*client, key);
+                ++notified;
+                break;
+            }
+        }
+    }
+    if (notified > 0) {
+        Metrics::instance().recordInvalidations(notified);
+    }
+}
+
+void InvalidationTracker::prefixChanged(const std::string& prefix) {
+    if (clientCount_.load(std::memory_order_relaxed) == 0) return;
+
+    std::vector<std::shared_ptr<Client>> affected;
+    {
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        for (const auto& [id, client] : clients_) {
+            if (!client->broadcast) {
+                affected.push_back(client);
+                continue;
+            }
+            for (const auto& p : client->prefixes) {
+                size_t common = std::min(p.size(), prefix.size());
+                if (p.compare(0, common, prefix, 0, common) == 0) {
+                    affected.push_back(client);
+                    break;
+                }
+            }
+        }
+    }
+    for (const auto& client : affected) {
+        flushClient(*client);
+    }
+}
+
+void InvalidationTracker::evictSlot() {
+    // Walk forward from a rotating cursor to the next occupied slot
+    const size_t slots = slotEntries_.size();
+    for (size_t scanned = 0; scanned < slots; ++scanned) {
+        size_t slot = evictCursor_.fetch_add(1, std::memory_order_relaxed) % slots;
+        std::vector<Entry> entries;
+        {
+            std::lock_guard<std::mutex> lock(stripes_[slot % kStripes]);
+            entries.swap(slotEntries_[slot]);
+        }
+        if (entries.empty()) continue;
+        entries_.fetch_sub(entries.size(), std::memory_order_relaxed);
+        // Their keys are no longer tracked, so these clients drop everything
+        std::vector<uint32_t> ids;
+        for (const auto& entry : entries) {
+            ids.push_back(entry.client);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        for (uint32_t id : ids) {
+            if (auto client = find(id)) {
+                flushClient(*client);
+            }
+        }
+        return;
+    }
+}
+
+bool InvalidationTracker::poll(const std::string& clientId, std::chrono::milliseconds timeout,
+                               Batch& out) {
+    out = Batch{};
+    bool created;
+    auto client = findOrCreate(clientId, created);
+    if (!client) return false;
+    if (created) {
+        // Unknown or expired: whatever it cached is untracked
+        flushClient(*client);
+    }
+
+    client->polling.fetch_add(1);
+    {
+        std::unique_lock<std::mutex> lock(client->mutex);
+        client->cv.wait_for(lock, timeout,
+                            [&] { return client->flush || !client->queue.empty(); });
+        out.flush = client->flush;
+        out.keys.swap(client->queue);
+        client->flush = false;
+    }
+    client->polling.fetch_sub(1);
+    client->lastSeenMs.store(nowMs(), std::memory_order_relaxed);
+    return out.flush || !out.keys.empty();
+}
+
+InvalidationTracker::Stats InvalidationTracker::stats() const {
+    Stats s;
+    s.clients = clientCount_.load(std::memory_order_relaxed);
+    s.entries = entries_.load(std::memory_order_relaxed);
+    return s;
+}
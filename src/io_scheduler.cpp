@@ -0,0 +1,139 @@
+#include "io_scheduler.h"
+#include <algorithm>
+#include <thread>
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+namespace {
+
+constexpr double kLatencySmoothing = 0.2;   // weight of a new fsync sample
+constexpr double kBaselineRise = 1.0 / 64;  // how fast the idle latency may creep up
+constexpr double kTargetFactor = 3.0;
+constexpr double kMinTargetUs = 2000;
+constexpr double kBurstSeconds = 0.1;       // bucket depth, in time at the current rate
+
+} // namespace
+
+IoScheduler::IoScheduler(const Options& options)
+    : options_(options),
+      rate_(static_cast<double>(std::max<uint64_t>(1, options.maxBytesPerSecond))),
+      tokens_(0),
+      refilled_(std::chrono::steady_clock::now()),
+      adjusted_(refilled_),
+      sampled_(refilled_),
+      granted_(refilled_ - options.adjustInterval) {
+    options_.maxBytesPerSecond = std::max<uint64_t>(1, options_.maxBytesPerSecond);
+    options_.minBytesPerSecond = std::clamp<uint64_t>(options_.minBytesPerSecond, 1,
+                                                      options_.maxBytesPerSecond);
+}
+
+void IoScheduler::refillLocked(std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - refilled_).count();
+    refilled_ = now;
+    double burst = std::max(rate_ * kBurstSeconds, static_cast<double>(kMaxGrant));
+    tokens_ = std::min(burst, tokens_ + elapsed * rate_);
+}
+
+void IoScheduler::acquire(uint64_t bytes) {
+    while (bytes > 0) {
+        const uint64_t grant = std::min(bytes, kMaxGrant);
+        bytes -= grant;
+        std::chrono::microseconds wait{0};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = std::chrono::steady_clock::now();
+            refillLocked(now);
+            if (options_.adaptive && now - sampled_ >= 10 * options_.adjustInterval &&
+                now - adjusted_ >= options_.adjustInterval) {
+                adjusted_ = now;
+                increaseLocked();
+            }
+            // Take the tokens now, even into debt, and sleep the debt off:
+            // callers are served in arrival order and a rate cut applies
+            // to the next grant
+            tokens_ -= static_cast<double>(grant);
+            bytes_ += grant;
+            granted_ = now;
+            if (tokens_ < 0) {
+                wait = std::chrono::microseconds(static_cast<int64_t>(-tokens_ / rate_ * 1e6));
+                throttledMicros_ += static_cast<uint64_t>(wait.count());
+            }
+        }
+        if (wait.count() > 0) {
+            std::this_thread::sleep_for(wait);
+        }
+    }
+}
+
+std::chrono::microseconds IoScheduler::targetLocked() const {
+    if (options_.latencyTarget.count() > 0) {
+        return options_.latencyTarget;
+    }
+    return std::chrono::microseconds(
+        static_cast<int64_t>(std::max(kMinTargetUs, baselineUs_ * kTargetFactor)));
+}
+
+void IoScheduler::recordSyncLatency(std::chrono::microseconds latency) {
+    const double sample = static_cast<double>(latency.count());
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    sampled_ = now;
+    if (latencyUs_ == 0) {
+        latencyUs_ = baselineUs_ = sample;
+    } else {
+        latencyUs_ += kLatencySmoothing * (sample - latencyUs_);
+        if (sample < baselineUs_) {
+            baselineUs_ = sample;
+        } else if (now - granted_ > options_.adjustInterval) {
+            // Only a quiet disk may raise the baseline, or a long
+            // checkpoint would teach it that contended is normal
+            baselineUs_ += kBaselineRise * (sample - baselineUs_);
+        }
+    }
+    if (!options_.adaptive) {
+        return;
+    }
+    if (now - adjusted_ < options_.adjustInterval) {
+        return;
+    }
+    adjusted_ = now;
+    refillLocked(now);
+    const double minRate = static_cast<double>(options_.minBytesPerSecond);
+    if (latencyUs_ <= static_cast<double>(targetLocked().count())) {
+        increaseLocked();
+    } else if (rate_ > minRate) {
+        rate_ = std::max(minRate, rate_ / 2);
+        ++decreases_;
+    }
+}
+
+void IoScheduler::increaseLocked() {
+    const double maxRate = static_cast<double>(options_.maxBytesPerSecond);
+    rate_ = std::min(maxRate, rate_ + maxRate / 16);
+}
+
+IoScheduler::Stats IoScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.bytesPerSecond = static_cast<uint64_t>(rate_);
+    stats.syncLatencyUs = static_cast<uint64_t>(latencyUs_);
+    stats.latencyTargetUs = static_cast<uint64_t>(targetLocked().count());
+    stats.bytes = bytes_;
+    stats.throttledMicros = throttledMicros_;
+    stats.decreases = decreases_;
+    return stats;
+}
+
+void IoScheduler::startWriteback(int fd, uint64_t offset, uint64_t bytes) {
+#if defined(__linux__)
+    if (fd >= 0 && bytes > 0) {
+        ::sync_file_range(fd, static_cast<off64_t>(offset), static_cast<off64_t>(bytes),
+                          SYNC_FILE_RANGE_WRITE);
+    }
+#else
+    (void)fd;
+    (void)offset;
+    (void)bytes;
+#endif
+}
@@ -0,0 +1,251 @@
+#include "keyspace_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// splitmix64 finalizer: spreads std::hash output over all 64 bits, which
+// HyperLogLog needs (it reads the top bits and the leading zeros)
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+}  // namespace
+
+HyperLogLog::HyperLogLog(uint8_t precision)
+    : precision_(std::min<uint8_t>(std::max<uint8_t>(precision, 4), 18)),
+      registers_(size_t(1) << precision_, 0) {}
+
+void HyperLogLog::add(uint64_t hash) {
+    const size_t index = hash >> (64 - precision_);
+    // The guard bit stops the count at 64 - precision leading zeros
+    uint64_t rest = (hash << precision_) | (uint64_t(1) << (precision_ - 1));
+    uint8_t rank = 1;
+    while ((rest & (uint64_t(1) << 63)) == 0) {
+        rest <<= 1;
+        ++rank;
+    }
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision_ != precision_) {
+        return;
+    }
+    for (size_t i = 0; i < registers_.size(); ++i) {
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    const double m = double(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+        sum += std::ldexp(1.0, -int(r));
+        zeros += r == 0;
+    }
+    const double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (raw <= 2.5 * m && zeros != 0) {
+        // Small range: linear counting over the empty registers
+        return m * std::log(m / double(zeros));
+    }
+    // 64-bit hashes don't saturate, so no large-range correction
+    return raw;
+}
+
+TDigest::TDigest(double compression) : compression_(std::max(compression, 10.0)) {}
+
+void TDigest::add(double value, double weight) {
+    if (weight <= 0) {
+        return;
+    }
+    if (total_ == 0) {
+        min_ = max_ = value;
+    } else {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    total_ += weight;
+    buffer_.push_back(Centroid{value, weight});
+    if (buffer_.size() >= size_t(compression_) * 2) {
+        flush();
+    }
+}
+
+void TDigest::merge(const TDigest& other) {
+    if (other.total_ == 0) {
+        return;
+    }
+    other.flush();
+    if (total_ == 0) {
+        min_ = other.min_;
+        max_ = other.max_;
+    } else {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    total_ += other.total_;
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    flush();
+}
+
+void TDigest::flush() const {
+    if (buffer_.empty()) {
+        return;
+    }
+    std::vector<Centroid> all;
+    all.reserve(centroids_.size() + buffer_.size());
+    all.insert(all.end(), centroids_.begin(), centroids_.end());
+    all.insert(all.end(), buffer_.begin(), buffer_.end());
+    buffer_.clear();
+    std::sort(all.begin(), all.end(),
+              [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    // k1 scale: a centroid may span one unit of k, which is narrow in q
+    // near 0 and 1 and wide around the median
+    const double pi = std::acos(-1.0);
+    auto k = [&](double q) { return compression_ / (2 * pi) * std::asin(2 * q - 1); };
+    double total = 0;
+    for (const auto& c : all) {
+        total += c.weight;
+    }
+    centroids_.clear();
+    Centroid current = all.front();
+    double before = 0;
+    double kLeft = k(0);
+    for (size_t i = 1; i < all.size(); ++i) {
+        const double q = std::min(1.0, (before + current.weight + all[i].weight) / total);
+        if (k(q) - kLeft <= 1) {
+            current.weight += all[i].weight;
+            current.mean += (all[i].mean - current.mean) * all[i].weight / current.weight;
+        } else {
+            before += current.weight;
+            kLeft = k(std::min(1.0, before / total));
+            centroids_.push_back(current);
+            current = all[i];
+        }
+    }
+    centroids_.push_back(current);
+}
+
+double TDigest::quantile(double q) const {
+    flush();
+    if (centroids_.empty()) {
+        return 0;
+    }
+    if (centroids_.size() == 1) {
+        return centroids_.front().mean;
+    }
+    q = std::min(1.0, std::max(0.0, q));
+    const double target = q * total_;
+    // Interpolate between centroid centres; min and max anchor the ends
+    const auto& first = centroids_.front();
+    if (target < first.weight / 2) {
+        return min_ + (first.mean - min_) * target / (first.weight / 2);
+    }
+    double cumulative = 0;
+    for (size_t i = 0; i + 1 < centroids_.size(); ++i) {
+        const auto& a = centroids_[i];
+        const auto& b = centroids_[i + 1];
+        const double left = cumulative + a.weight / 2;
+        const double right = cumulative + a.weight + b.weight / 2;
+        if (target <= right) {
+            return a.mean + (b.mean - a.mean) * (target - left) / (right - left);
+        }
+        cumulative += a.weight;
+    }
+    const auto& last = centroids_.back();
+    const double left = total_ - last.weight / 2;
+    if (target <= left || last.weight == 0) {
+        return last.mean;
+    }
+    return last.mean + (max_ - last.mean) * (target - left) / (last.weight / 2);
+}
+
+KeyspaceStats::KeyspaceStats(const Options& options) : options_(options) {
+    options_.maxPrefixes = std::max<size_t>(1, options_.maxPrefixes);
+}
+
+uint64_t KeyspaceStats::hashValue(std::string_view value) {
+    return mix(std::hash<std::string_view>{}(value));
+}
+
+std::string KeyspaceStats::prefixOf(std::string_view key) const {
+    const size_t end = key.find(options_.delimiter);
+    return std::string(end == std::string_view::npos ? std::string_view() : key.substr(0, end));
+}
+
+KeyspaceStats::Group& KeyspaceStats::groupLocked(std::string_view key) {
+    const size_t end = key.find(options_.delimiter);
+    const std::string_view prefix =
+        end == std::string_view::npos ? std::string_view() : key.substr(0, end);
+    auto it = groups_.find(prefix);
+    if (it != groups_.end()) {
+        return it->second;
+    }
+    // "(other)" doesn't count against the limit
+    const size_t named = groups_.size() - groups_.count(std::string_view(kOtherPrefix));
+    if (named >= options_.maxPrefixes) {
+        return groups_[kOtherPrefix];
+    }
+    return groups_.emplace(std::string(prefix), Group()).first->second;
+}
+
+void KeyspaceStats::recordWrite(std::string_view key, uint64_t valueHash, size_t valueBytes,
+                                size_t length, bool added) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Group& group = groupLocked(key);
+    if (added) {
+        group.keys++;
+        group.resident++;
+    }
+    group.writes++;
+    group.distinctValues.add(valueHash);
+    group.valueBytes.add(double(valueBytes));
+    group.historyLength.add(double(length));
+}
+
+void KeyspaceStats::recordResident(std::string_view key, bool resident) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Group& group = groupLocked(key);
+    if (resident) {
+        group.resident++;
+    } else if (group.resident > 0) {
+        group.resident--;
+    }
+}
+
+void KeyspaceStats::recordRemoved(std::string_view key, bool resident) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Group& group = groupLocked(key);
+    if (group.keys > 0) {
+        group.keys--;
+    }
+    if (resident && group.resident > 0) {
+        group.resident--;
+    }
+}
+
+std::map<std::string, KeyspaceStats::Group> KeyspaceStats::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::map<std::string, Group>(groups_.begin(), groups_.end());
+}
+
+KeyspaceStats::Group KeyspaceStats::total(const std::map<std::string, Group>& groups) {
+    Group all;
+    for (const auto& [prefix, group] : groups) {
+        all.keys += group.keys;
+        all.resident += group.resident;
+        all.writes += group.writes;
+        all.distinctValues.merge(group.distinctValues);
+        all.valueBytes.merge(group.valueBytes);
+        all.historyLength.merge(group.historyLength);
+    }
+    return all;
+}
@@ -1,74 +1,427 @@
 #include "kvstore.h"
+#include "spill_store.h"
+#include "blob_store.h"
+#include "keyspace_stats.h"
 #include "logger.h"
 #include <algorithm>
+#include <queue>
+#include <unordered_set>
 #include <sstream>
 #include <mutex>
 #include <shared_mutex>
 
+namespace {
+
+// Minimum spacing between blob collection passes
+constexpr std::chrono::seconds kBlobGcInterval{1};
+
+} // namespace
+
 KVStore::KVStore(std::shared_ptr<WAL> walPtr) 
     : wal(walPtr), walEnabled(true), decisionPolicy(DecisionPolicy::SAFE_DEFAULT) {}
 
+KVStore::~KVStore() {
+    {
+        std::lock_guard<std::mutex> lock(reclaimMutex_);
+        reclaimStop_ = true;
+    }
+    reclaimCv_.notify_one();
+    if (reclaimer_.joinable()) {
+        reclaimer_.join();
+    }
+}
+
 Status KVStore::set(const std::string& key, const std::string& value) {
-    // Thread safety: reader/writer lock
-    std::unique_lock<std::shared_mutex> lock(rwMutex_);
-    return setInternal(key, value);
+    return writeValue(key, value);
 }
 
-Status KVStore::setInternal(const std::string& key, const std::string& value) {
-    // Create version with current timestamp
-    auto timestamp = std::chrono::system_clock::now();
+Status KVStore::writeValue(const std::string& key, const std::string& value) {
+    // Large values go to the blob store before the lock is taken, so copying
+    // them doesn't hold up readers; a failed blob write falls back to inline
+    std::string ref;
+    bool sealed = false;
+    const bool blob = blobs_ && value.size() >= blobs_->threshold() &&
+                      blobs_->put(value, ref, &sealed) == Status::OK;
+    Status status;
+    std::chrono::system_clock::time_point timestamp;
+    {
+        // Thread safety: reader/writer lock
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        status = setInternal(key, value, timestamp, blob ? &ref : nullptr);
+    }
+    if (blob) {
+        blobs_->published(ref);
+    }
+    if (sealed) {
+        wakeBlobCollector();
+    }
+    notifyWatchers(key, false, value, timestamp);
+    return status;
+}
+
+Status KVStore::setInternal(const std::string& key, const std::string& value,
+                            std::chrono::system_clock::time_point& timestamp,
+                            const std::string* blobRef) {
+    // Create version with current timestamp (under the lock, so versions stay ordered)
+    timestamp = nextTimestampLocked();
     
     // Write to WAL first (if enabled)
     if (walEnabled && wal && wal->isEnabled()) {
-        Status walStatus = wal->logSet(key, value, timestamp);
+        Status walStatus = blobRef ? wal->logSetRef(key, *blobRef, timestamp)
+                                   : wal->logSet(key, value, timestamp);
         // Continue even if WAL write fails (warn user but don't crash)
         if (walStatus != Status::OK) {
             // Warning already printed by WAL
         }
     }
     
-    // Append new version to in-memory store
-    store[key].emplace_back(timestamp, value);
+    Version version(timestamp, blobRef ? *blobRef : value);
+    version.blob = blobRef != nullptr;
+    appendLocked(key, std::move(version));
+    return Status::OK;
+}
+
+std::chrono::system_clock::time_point KVStore::nextTimestampLocked() const {
+    auto timestamp = std::chrono::system_clock::now();
+    if (timestamp <= lastTombstone_) {
+        // Stay strictly after the newest prefix delete, or it would hide this write
+        timestamp = lastTombstone_ + std::chrono::system_clock::duration(1);
+    }
+    return timestamp;
+}
+
+void KVStore::appendLocked(const std::string& key, Version version) {
+    // Append new version to in-memory store, after any spilled history
+    loadSpilledLocked(key);
+    auto [it, added] = store.try_emplace(key);
+    if (keyspace_) {
+        recordWriteStats(key, version, it->second.size() + 1, added);
+    }
+    it->second.append(std::move(version));
     
     // Apply retention policy
     applyRetention(key);
 
     touchKey(key);
     evictIfNeeded();
+}
+
+size_t KVStore::setBatch(std::vector<BatchWrite>& writes) {
+    // Large values go to the blob store first, as in writeValue(). One a
+    // guard then refuses is published unreferenced and collected later.
+    std::vector<std::string> refs(writes.size());
+    bool sealed = false;
+    bool anyBlob = false;
+    if (blobs_) {
+        for (size_t i = 0; i < writes.size(); ++i) {
+            if (writes[i].value.size() >= blobs_->threshold()) {
+                bool full = false;
+                if (blobs_->put(writes[i].value, refs[i], &full) != Status::OK) {
+                    refs[i].clear();
+                }
+                sealed = sealed || full;
+                anyBlob = anyBlob || !refs[i].empty();
+            }
+        }
+    }
     
-    return Status::OK;
+    std::vector<std::chrono::system_clock::time_point> timestamps(writes.size());
+    size_t applied = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        const bool logging = walEnabled && wal && wal->isEnabled();
+        std::vector<std::string> records;
+        if (logging) {
+            records.reserve(writes.size());
+        }
+        for (size_t i = 0; i < writes.size(); ++i) {
+            // Guards are checked under the lock that applies the write, so
+            // a guard added or a policy changed meanwhile can't be missed
+            writes[i].status = Status::OK;
+            writes[i].reason.clear();
+            if (!guards.empty()) {
+                auto evaluation = simulateWrite(writes[i].key, writes[i].value);
+                applyDecisionPolicy(evaluation);
+                if (evaluation.result != GuardResult::ACCEPT) {
+                    writes[i].status = Status::INVALID_COMMAND;
+                    writes[i].reason = evaluation.reason.empty() ? evaluation.policyReasoning
+                                                                 : evaluation.reason;
+                    continue;
+                }
+            }
+            const bool blob = !refs[i].empty();
+            timestamps[i] = nextTimestampLocked();
+            Version version(timestamps[i], blob ? refs[i] : writes[i].value);
+            version.blob = blob;
+            if (logging) {
+                records.push_back(WAL::setRecord(writes[i].key, version.value, timestamps[i], blob));
+            }
+            appendLocked(writes[i].key, std::move(version));
+            ++applied;
+        }
+        // One append for the batch, still under the lock, so no reader sees
+        // a write before it is in the log. Failures are reported by the WAL.
+        if (logging) {
+            wal->logRecords(records);
+        }
+    }
+    if (anyBlob) {
+        for (const auto& ref : refs) {
+            if (!ref.empty()) {
+                blobs_->published(ref);
+            }
+        }
+    }
+    if (sealed) {
+        wakeBlobCollector();
+    }
+    for (size_t i = 0; i < writes.size(); ++i) {
+        if (writes[i].status == Status::OK) {
+            notifyWatchers(writes[i].key, false, writes[i].value, timestamps[i]);
+        }
+    }
+    return applied;
 }
 
 Status KVStore::setAtTime(const std::string& key, const std::string& value,
                           std::chrono::system_clock::time_point timestamp) {
-    // Thread safety: reader/writer lock
-    std::unique_lock<std::shared_mutex> lock(rwMutex_);
-    // This is for replay - do NOT log to WAL
-    // Just add the version with the given timestamp
-    store[key].emplace_back(timestamp, value);
-    
-    // Apply retention policy
-    applyRetention(key);
-    
+    {
+        // Thread safety: reader/writer lock
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        // This is for replay - do NOT log to WAL
+        // Just add the version with the given timestamp
+        loadSpilledLocked(key);
+        auto [it, added] = store.try_emplace(key);
+        it->second.append(timestamp, value);
+        if (keyspace_) {
+            recordWriteStats(key, it->second.back(), it->second.size(), added);
+        }
+        
+        // Apply retention policy
+        applyRetention(key);
+        
+        // Replayed keys take part in LRU too, so a restart doesn't bring
+        // back more keys than the limit allows
+        touchKey(key);
+        evictIfNeeded();
+    }
+    notifyWatchers(key, false, value, timestamp);
+    return Status::OK;
+}
+
+Status KVStore::setRefAtTime(const std::string& key, const std::string& ref,
+                             std::chrono::system_clock::time_point timestamp) {
+    if (!blobs_ || !blobs_->available(ref)) {
+        return Status::NOT_FOUND;
+    }
+    {
+        // Thread safety: reader/writer lock
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        // Replay, like setAtTime(): not logged
+        loadSpilledLocked(key);
+        Version version(timestamp, ref);
+        version.blob = true;
+        auto [it, added] = store.try_emplace(key);
+        if (keyspace_) {
+            recordWriteStats(key, version, it->second.size() + 1, added);
+        }
+        it->second.append(std::move(version));
+        applyRetention(key);
+        touchKey(key);
+        evictIfNeeded();
+    }
+    if (watcherCount_.load(std::memory_order_relaxed) != 0 || !listeners_.empty()) {
+        std::string value;
+        if (blobs_->read(ref, value)) {
+            notifyWatchers(key, false, value, timestamp);
+        }
+    }
     return Status::OK;
 }
 
+void KVStore::LoadBatch::reserve(size_t keys) {
+    chains_.reserve(keys);
+    lru_.reserve(keys);
+}
+
+void KVStore::LoadBatch::add(std::string key, std::string value,
+                             std::chrono::system_clock::time_point timestamp) {
+    auto [it, inserted] = chains_.try_emplace(std::move(key));
+    it->second.append(Version(timestamp, std::move(value)));
+    if (inserted) {
+        order_.push_back(it->first);
+        lru_.emplace(it->first, std::prev(order_.end()));
+    }
+}
+
+void KVStore::mergeLoadBatch(LoadBatch& batch) {
+    std::vector<std::pair<std::string, VersionChain>> slow;
+    {
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        if (watcherCount_.load(std::memory_order_relaxed) == 0 && listeners_.empty() &&
+            tombstones_.empty()) {
+            if (keyspace_) {
+                for (const auto& [key, versions] : batch.chains_) {
+                    if (store.count(key) != 0) {
+                        continue;
+                    }
+                    // As if setAtTime() had written them one by one
+                    size_t length = 0;
+                    for (const auto& version : versions) {
+                        ++length;
+                        recordWriteStats(key, version, length, length == 1);
+                    }
+                }
+            }
+            // Nodes whose key is already present stay behind in the batch
+            store.merge(batch.chains_);
+            lruMap_.merge(batch.lru_);
+            for (const auto& [key, versions] : batch.chains_) {
+                auto lru = lruMap_.find(key);
+                if (lru != lruMap_.end() && batch.lru_.count(key) == 0) {
+                    // Merged into the LRU map, but the key's versions weren't
+                    batch.order_.erase(lru->second);
+                    lruMap_.erase(lru);
+                }
+            }
+            for (const auto& [key, position] : batch.lru_) {
+                batch.order_.erase(position);
+            }
+            if (!batch.order_.empty()) {
+                auto merged = batch.order_.begin();
+                lruOrder_.splice(lruOrder_.end(), batch.order_);
+                if (retentionPolicy.mode != RetentionMode::FULL) {
+                    for (; merged != lruOrder_.end(); ++merged) {
+                        applyRetention(*merged);
+                    }
+                }
+            }
+        }
+        for (auto& [key, versions] : batch.chains_) {
+            slow.emplace_back(key, std::move(versions));
+        }
+        evictIfNeeded();
+    }
+    batch.chains_.clear();
+    batch.order_.clear();
+    batch.lru_.clear();
+    for (const auto& [key, versions] : slow) {
+        for (const auto& version : versions) {
+            setAtTime(key, version.value, version.timestamp);
+        }
+    }
+}
+
+std::optional<std::string> KVStore::valueOf(const Version& version) const {
+    if (!version.blob) {
+        return version.value;
+    }
+    std::string value;
+    if (!blobs_ || !blobs_->read(version.value, value)) {
+        return std::nullopt;  // logged by the blob store
+    }
+    return value;
+}
+
+void KVStore::resolveBlobs(std::vector<Version>& versions) const {
+    bool unreadable = false;
+    for (auto& version : versions) {
+        if (!version.blob) {
+            continue;
+        }
+        std::string ref;
+        ref.swap(version.value);
+        version.blob = !blobs_ || !blobs_->read(ref, version.value);
+        unreadable = unreadable || version.blob;
+    }
+    if (unreadable) {
+        versions.erase(std::remove_if(versions.begin(), versions.end(),
+                                      [](const Version& v) { return v.blob; }),
+                       versions.end());
+    }
+}
+
 std::optional<std::string> KVStore::get(const std::string& key) {
     // Thread safety: reader/writer lock
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
-    auto it = store.find(key);
-    if (it != store.end() && !it->second.empty()) {
+    auto it = findLocked(key, lock);
+    if (it != store.end() && firstVisible(key, it->second) < it->second.size()) {
         // Return the latest version (last element)
-        return it->second.back().value;
+        return valueOf(it->second.back());
     }
     return std::nullopt;
 }
 
+std::vector<std::optional<std::string>> KVStore::multiGet(const std::vector<std::string>& keys,
+                                                          size_t group) {
+    constexpr size_t kMaxGroup = 64;
+    group = std::clamp<size_t>(group, 1, kMaxGroup);
+    std::vector<std::optional<std::string>> values(keys.size());
+    std::vector<size_t> absent;  // not in memory, possibly spilled
+    {
+        std::shared_lock<std::shared_mutex> lock(rwMutex_);
+        size_t buckets[kMaxGroup];
+        const VersionChain* chains[kMaxGroup];
+        for (size_t base = 0; base < keys.size(); base += group) {
+            const size_t n = std::min(group, keys.size() - base);
+            const std::string* batch = &keys[base];
+
+            // Hash the whole group first; this touches no table memory
+            for (size_t i = 0; i < n; ++i) {
+                buckets[i] = store.bucket(batch[i]);
+            }
+            // Read every bucket head. The loads don't depend on each other,
+            // so their misses overlap; prefetch the node each one leads to.
+            for (size_t i = 0; i < n; ++i) {
+                auto it = store.begin(buckets[i]);
+                if (it != store.end(buckets[i])) {
+                    prefetchForRead(&*it);
+                }
+            }
+            // Match keys against the (now cached) nodes and start on the
+            // version chains, one pointer hop per pass over the group
+            for (size_t i = 0; i < n; ++i) {
+                chains[i] = nullptr;
+                for (auto it = store.begin(buckets[i]); it != store.end(buckets[i]); ++it) {
+                    if (it->first == batch[i]) {
+                        chains[i] = &it->second;
+                        chains[i]->prefetchBack(0);
+                        break;
+                    }
+                }
+            }
+            for (int step = 1; step <= 3; ++step) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (chains[i] != nullptr) {
+                        chains[i]->prefetchBack(step);
+                    }
+                }
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (chains[i] == nullptr) {
+                    absent.push_back(base + i);
+                } else if (firstVisible(batch[i], *chains[i]) < chains[i]->size()) {
+                    values[base + i] = valueOf(chains[i]->back());
+                }
+            }
+        }
+        if (!spill_) {
+            return values;
+        }
+    }
+    // Reloading takes the write lock; leave it to get()
+    for (size_t index : absent) {
+        values[index] = get(keys[index]);
+    }
+    return values;
+}
+
 Status KVStore::del(const std::string& key) {
     // Thread safety: reader/writer lock
     std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    loadSpilledLocked(key);
     auto it = store.find(key);
-    if (it != store.end()) {
+    if (it != store.end() && firstVisible(key, it->second) < it->second.size()) {
         // Write to WAL first (if enabled)
         if (walEnabled && wal && wal->isEnabled()) {
             Status walStatus = wal->logDel(key);
@@ -79,42 +432,321 @@ Status KVStore::del(const std::string& key) {
         }
         
         // Remove all versions from in-memory store
-        store.erase(it);
-        {
-            auto lruIt = lruMap_.find(key);
-            if (lruIt != lruMap_.end()) {
-                lruOrder_.erase(lruIt->second);
-                lruMap_.erase(lruIt);
-            }
+        eraseKeyInternal(key);
+        lock.unlock();
+        if (blobs_) {
+            wakeBlobCollector();
         }
+        notifyWatchers(key, true, std::string(), std::chrono::system_clock::now());
         return Status::OK;
     }
     return Status::NOT_FOUND;
 }
 
+Status KVStore::delPrefix(const std::string& prefix) {
+    if (prefix.empty()) {
+        return Status::INVALID_COMMAND;
+    }
+    std::chrono::system_clock::time_point timestamp;
+    {
+        // Thread safety: reader/writer lock
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        // Must cover every version already written, including ones stamped
+        // just after the previous tombstone
+        timestamp = std::max(std::chrono::system_clock::now(),
+                             lastTombstone_ + std::chrono::system_clock::duration(1));
+        
+        // Write to WAL first (if enabled)
+        if (walEnabled && wal && wal->isEnabled()) {
+            Status walStatus = wal->logDelPrefix(prefix, timestamp);
+            // Continue even if WAL write fails
+            if (walStatus != Status::OK) {
+                // Warning already printed by WAL
+            }
+        }
+        
+        // Matching keys disappear from reads now; their memory goes later
+        tombstones_.push_back(RangeTombstone{prefix, timestamp});
+        lastTombstone_ = timestamp;
+    }
+    wakeReclaimer(true);
+    notifyPrefixDeleted(prefix, timestamp);
+    return Status::OK;
+}
+
+Status KVStore::delPrefixAtTime(const std::string& prefix,
+                                std::chrono::system_clock::time_point timestamp) {
+    if (prefix.empty()) {
+        return Status::INVALID_COMMAND;
+    }
+    {
+        // Thread safety: reader/writer lock
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        // Replay applies records in log order, so everything currently
+        // stored under the prefix was written before the delete. Snapshot
+        // keys carry their load time rather than their write time, which is
+        // why this cannot be left to a timestamp-based tombstone.
+        std::vector<std::string> matching;
+        for (const auto& entry : store) {
+            if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+                matching.push_back(entry.first);
+            }
+        }
+        for (const auto& key : matching) {
+            eraseKeyInternal(key);
+        }
+        if (spill_) {
+            std::vector<std::string> removed;
+            spill_->removePrefix(prefix, std::chrono::system_clock::time_point::max(), nullptr,
+                                 keyspace_ ? &removed : nullptr);
+            for (const auto& key : removed) {
+                keyspace_->recordRemoved(key, false);
+            }
+        }
+    }
+    notifyPrefixDeleted(prefix, timestamp);
+    return Status::OK;
+}
+
+size_t KVStore::reclaimTombstones() {
+    // One pass at a time, so each pass retires exactly the tombstones it scanned for
+    std::lock_guard<std::mutex> passLock(reclaimPassMutex_);
+    
+    size_t covered;
+    std::vector<RangeTombstone> spillWork;
+    {
+        std::shared_lock<std::shared_mutex> lock(rwMutex_);
+        covered = tombstones_.size();
+        if (covered == 0) {
+            return 0;
+        }
+        if (spill_) {
+            spillWork.assign(tombstones_.begin(), tombstones_.begin() + covered);
+        }
+    }
+    
+    // Spilled keys: drop the fully covered ones from the index, and reload
+    // any that were written after the delete so the pass below trims them
+    size_t removed = 0;
+    for (const auto& tombstone : spillWork) {
+        std::vector<std::string> survivors;
+        std::vector<std::string> dropped;
+        removed += spill_->removePrefix(tombstone.prefix, tombstone.timestamp, &survivors,
+                                        keyspace_ ? &dropped : nullptr);
+        for (const auto& key : dropped) {
+            keyspace_->recordRemoved(key, false);
+        }
+        for (const auto& key : survivors) {
+            reloadSpilled(key);
+        }
+    }
+    
+    std::vector<std::string> keys;
+    {
+        std::shared_lock<std::shared_mutex> lock(rwMutex_);
+        for (const auto& entry : store) {
+            for (size_t i = 0; i < covered; ++i) {
+                const auto& prefix = tombstones_[i].prefix;
+                if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+                    keys.push_back(entry.first);
+                    break;
+                }
+            }
+        }
+    }
+    
+    // Free matching keys in small write-locked batches so foreground writes
+    // interleave with a large reclamation instead of waiting it out
+    constexpr size_t kBatch = 256;
+    for (size_t start = 0; start < keys.size(); start += kBatch) {
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        size_t end = std::min(keys.size(), start + kBatch);
+        for (size_t i = start; i < end; ++i) {
+            auto it = store.find(keys[i]);
+            if (it == store.end()) {
+                continue;
+            }
+            // Versions written after the delete survive
+            dropHidden(keys[i], it->second);
+            if (it->second.empty()) {
+                eraseKeyInternal(keys[i]);
+                ++removed;
+            }
+        }
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    tombstones_.erase(tombstones_.begin(), tombstones_.begin() + covered);
+    return removed;
+}
+
+size_t KVStore::pendingTombstones() const {
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    return tombstones_.size();
+}
+
+void KVStore::wakeReclaimer(bool tombstones) {
+    {
+        std::lock_guard<std::mutex> lock(reclaimMutex_);
+        if (tombstones) {
+            reclaimPending_ = true;
+        } else {
+            evictPending_ = true;
+        }
+        if (!reclaimer_.joinable()) {
+            reclaimer_ = std::thread(&KVStore::reclaimLoop, this);
+        }
+    }
+    reclaimCv_.notify_one();
+}
+
+void KVStore::reclaimLoop() {
+    std::unique_lock<std::mutex> lock(reclaimMutex_);
+    while (true) {
+        if (reclaimStop_) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const bool collect = blobGcPending_ && now >= nextBlobGc_;
+        if (!reclaimPending_ && !evictPending_ && !collect) {
+            // A collection asked for too soon waits out the interval
+            if (blobGcPending_) {
+                reclaimCv_.wait_until(lock, nextBlobGc_);
+            } else {
+                reclaimCv_.wait(lock);
+            }
+            continue;
+        }
+        bool reclaim = reclaimPending_;
+        bool evict = evictPending_;
+        reclaimPending_ = false;
+        evictPending_ = false;
+        if (collect) {
+            blobGcPending_ = false;
+            nextBlobGc_ = now + kBlobGcInterval;
+            blobGcScheduled_.store(false);
+        }
+        lock.unlock();
+        if (reclaim) {
+            size_t removed = reclaimTombstones();
+            spdlog::info("Reclaimed {} keys under range tombstones", removed);
+        }
+        if (evict) {
+            // Writers that cross the high watermark from here on schedule another pass
+            evictScheduled_.store(false);
+            evictToLowWatermark();
+            if (spill_) {
+                spill_->compactIfNeeded();
+            }
+        }
+        if (collect) {
+            collectBlobGarbage();
+        } else if ((reclaim || evict) && blobs_) {
+            // Dropped keys may have been the last references into a file
+            wakeBlobCollector();
+        }
+        lock.lock();
+    }
+}
+
+const RangeTombstone* KVStore::coveringTombstone(const std::string& key) const {
+    // Tombstones are in time order, so the last match is the newest
+    for (auto t = tombstones_.rbegin(); t != tombstones_.rend(); ++t) {
+        if (key.compare(0, t->prefix.size(), t->prefix) == 0) {
+            return &*t;
+        }
+    }
+    return nullptr;
+}
+
+size_t KVStore::firstVisible(const std::string& key, const VersionChain& versions) const {
+    const RangeTombstone* tombstone = coveringTombstone(key);
+    return tombstone ? versions.upperBound(tombstone->timestamp) : 0;
+}
+
+void KVStore::dropHidden(const std::string& key, VersionChain& versions) {
+    // Called only from write-locked context
+    if (tombstones_.empty()) {
+        return;
+    }
+    versions.dropFront(firstVisible(key, versions));
+}
+
+std::unordered_map<std::string, VersionChain>::const_iterator
+KVStore::findLocked(const std::string& key, std::shared_lock<std::shared_mutex>& lock) const {
+    auto it = store.find(key);
+    if (it != store.end() || !spill_ || !spill_->contains(key)) {
+        return it;
+    }
+    // Reloading fills a cache, so it is logically const
+    lock.unlock();
+    const_cast<KVStore*>(this)->reloadSpilled(key);
+    lock.lock();
+    return store.find(key);
+}
+
+bool KVStore::reloadSpilled(const std::string& key) {
+    std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    if (store.find(key) == store.end()) {
+        loadSpilledLocked(key);
+    }
+    return store.find(key) != store.end();
+}
+
+void KVStore::loadSpilledLocked(const std::string& key) {
+    // Called only from write-locked context
+    if (!spill_ || store.find(key) != store.end()) {
+        return;
+    }
+    std::vector<Version> versions;
+    if (!spill_->take(key, versions)) {
+        return;
+    }
+    if (versions.empty()) {
+        if (keyspace_) {
+            keyspace_->recordRemoved(key, false);
+        }
+        return;
+    }
+    store[key] = VersionChain(std::move(versions));
+    if (keyspace_) {
+        keyspace_->recordResident(key, true);
+    }
+    applyRetention(key);
+    touchKey(key);
+    evictIfNeeded();
+}
+
+void KVStore::eraseKeyInternal(const std::string& key) {
+    // Called only from write-locked context
+    if (store.erase(key) != 0 && keyspace_) {
+        keyspace_->recordRemoved(key, true);
+    }
+    auto lruIt = lruMap_.find(key);
+    if (lruIt != lruMap_.end()) {
+        lruOrder_.erase(lruIt->second);
+        lruMap_.erase(lruIt);
+    }
+}
+
 std::optional<std::string> KVStore::getAtTime(const std::string& key, 
                                                std::chrono::system_clock::time_point timestamp) {
     // Thread safety: reader/writer lock
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
-    auto it = store.find(key);
+    auto it = findLocked(key, lock);
     if (it == store.end() || it->second.empty()) {
         return std::nullopt;
     }
     
-    // Find the latest version at or before the given timestamp
+    // Find the latest version at or before the given timestamp. Versions
+    // are in chronological order, so it sits just before the first later one.
     const auto& versions = it->second;
-    std::optional<std::string> result;
-    
-    for (const auto& version : versions) {
-        if (version.timestamp <= timestamp) {
-            result = version.value;
-        } else {
-            // Versions are in chronological order, so we can stop
-            break;
-        }
+    size_t first = firstVisible(key, versions);
+    size_t after = versions.upperBound(timestamp, first);
+    if (after == first) {
+        return std::nullopt;
     }
-    
-    return result;
+    return valueOf(versions[after - 1]);
 }
 
 ExplainResult KVStore::explainGetAtTime(const std::string& key,
@@ -127,26 +759,29 @@ ExplainResult KVStore::explainGetAtTime(const std::string& key,
     result.queryTimestamp = timestamp;
     result.totalVersions = 0;
     
-    auto it = store.find(key);
-    if (it == store.end() || it->second.empty()) {
+    auto it = findLocked(key, lock);
+    if (it == store.end() || firstVisible(key, it->second) >= it->second.size()) {
         result.reasoning = "Key not found in database";
         return result;
     }
     
-    const auto& versions = it->second;
-    result.totalVersions = versions.size();
+    // Versions under a prefix delete are gone as far as readers can tell
+    const auto& allVersions = it->second;
+    const size_t hidden = firstVisible(key, allVersions);
+    result.totalVersions = allVersions.size() - hidden;
+    auto versionAt = [&](size_t i) -> const Version& { return allVersions[hidden + i]; };
     
     // Track which version we select and which we skip
     std::optional<size_t> selectedIndex;
     
-    for (size_t i = 0; i < versions.size(); ++i) {
-        const auto& version = versions[i];
+    for (size_t i = 0; i < result.totalVersions; ++i) {
+        const auto& version = versionAt(i);
         
         if (version.timestamp <= timestamp) {
             // This version is at or before our query time
             if (selectedIndex.has_value()) {
                 // We previously selected a version, now skipping it for this newer one
-                result.skippedVersions.push_back(versions[selectedIndex.value()]);
+                result.skippedVersions.push_back(versionAt(selectedIndex.value()));
             }
             selectedIndex = i;
         } else {
@@ -156,9 +791,14 @@ ExplainResult KVStore::explainGetAtTime(const std::string& key,
         }
     }
     
+    resolveBlobs(result.skippedVersions);
     if (selectedIndex.has_value()) {
         result.found = true;
-        result.selectedVersion = versions[selectedIndex.value()];
+        result.selectedVersion = versionAt(selectedIndex.value());
+        if (result.selectedVersion->blob) {
+            result.selectedVersion->value = valueOf(*result.selectedVersion).value_or("");
+            result.selectedVersion->blob = false;
+        }
         
         // Build reasoning
         std::stringstream reasoning;
@@ -191,38 +831,394 @@ ExplainResult KVStore::explainGetAtTime(const std::string& key,
 std::vector<Version> KVStore::getHistory(const std::string& key) {
     // Thread safety: reader/writer lock
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
-    auto it = store.find(key);
+    auto it = findLocked(key, lock);
     if (it != store.end()) {
-        return it->second;
+        auto versions = it->second.copyOut(firstVisible(key, it->second));
+        resolveBlobs(versions);
+        return versions;
     }
     return std::vector<Version>();
 }
 
+bool KVStore::visitLatest(const std::string& key,
+                          const std::function<void(const std::string&)>& visitor) const {
+    // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    auto it = findLocked(key, lock);
+    if (it == store.end() || firstVisible(key, it->second) >= it->second.size()) {
+        return false;
+    }
+    const Version& latest = it->second.back();
+    if (!latest.blob) {
+        visitor(latest.value);
+        return true;
+    }
+    auto value = valueOf(latest);
+    if (!value) {
+        return false;
+    }
+    visitor(*value);
+    return true;
+}
+
+bool KVStore::visitAtTime(const std::string& key, std::chrono::system_clock::time_point timestamp,
+                          const std::function<void(const Version&)>& visitor) const {
+    // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    auto it = findLocked(key, lock);
+    if (it == store.end() || it->second.empty()) {
+        return false;
+    }
+    
+    // Versions are in chronological order: find the first one after the
+    // query time and step back one
+    const auto& versions = it->second;
+    size_t first = firstVisible(key, versions);
+    size_t after = versions.upperBound(timestamp, first);
+    if (after == first) {
+        return false;
+    }
+    const Version& version = versions[after - 1];
+    if (!version.blob) {
+        visitor(version);
+        return true;
+    }
+    auto value = valueOf(version);
+    if (!value) {
+        return false;
+    }
+    visitor(Version(version.timestamp, std::move(*value)));
+    return true;
+}
+
+size_t KVStore::visitHistory(const std::string& key,
+                             const std::function<void(const Version&)>& visitor) const {
+    // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    auto it = findLocked(key, lock);
+    if (it == store.end()) {
+        return 0;
+    }
+    size_t visited = 0;
+    for (auto v = it->second.at(firstVisible(key, it->second)); v != it->second.end(); ++v) {
+        if (!v->blob) {
+            visitor(*v);
+        } else if (auto value = valueOf(*v)) {
+            visitor(Version(v->timestamp, std::move(*value)));
+        } else {
+            continue;  // unreadable blob, logged
+        }
+        ++visited;
+    }
+    return visited;
+}
+
+uint64_t KVStore::watchKey(const std::string& key, KeyWatcher watcher) {
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    uint64_t id = nextWatchId_++;
+    watchers_[key].emplace_back(id, std::move(watcher));
+    watchKeys_.emplace(id, key);
+    watcherCount_.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+bool KVStore::unwatchKey(uint64_t id) {
+    std::lock_guard<std::mutex> lock(watchMutex_);
+    auto keyIt = watchKeys_.find(id);
+    if (keyIt == watchKeys_.end()) {
+        return false;
+    }
+    auto it = watchers_.find(keyIt->second);
+    if (it != watchers_.end()) {
+        auto& list = it->second;
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [id](const auto& entry) { return entry.first == id; }),
+                   list.end());
+        if (list.empty()) {
+            watchers_.erase(it);
+        }
+    }
+    watchKeys_.erase(keyIt);
+    watcherCount_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void KVStore::addChangeListener(KeyWatcher listener) {
+    listeners_.push_back(std::move(listener));
+}
+
+void KVStore::notifyWatchers(const std::string& key, bool deleted, const std::string& value,
+                             std::chrono::system_clock::time_point timestamp) {
+    // Fast path: writes pay nothing while nobody is watching
+    if (watcherCount_.load(std::memory_order_relaxed) == 0 && listeners_.empty()) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, KeyWatcher>> fired;
+    if (watcherCount_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(watchMutex_);
+        auto it = watchers_.find(key);
+        if (it != watchers_.end()) {
+            fired.swap(it->second);
+            watchers_.erase(it);
+            for (const auto& entry : fired) {
+                watchKeys_.erase(entry.first);
+            }
+            watcherCount_.fetch_sub(fired.size(), std::memory_order_relaxed);
+        }
+    }
+    if (fired.empty() && listeners_.empty()) {
+        return;
+    }
+    KeyChange change{key, deleted, deleted ? std::string() : value, timestamp};
+    for (const auto& listener : listeners_) {
+        listener(change);
+    }
+    for (auto& entry : fired) {
+        entry.second(change);
+    }
+}
+
+void KVStore::notifyPrefixDeleted(const std::string& prefix,
+                                  std::chrono::system_clock::time_point timestamp) {
+    if (watcherCount_.load(std::memory_order_relaxed) == 0 && listeners_.empty()) {
+        return;
+    }
+    // Watchers get a delete of their own key; listeners get the prefix once
+    std::vector<std::pair<std::string, std::vector<std::pair<uint64_t, KeyWatcher>>>> fired;
+    if (watcherCount_.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lock(watchMutex_);
+        for (auto it = watchers_.begin(); it != watchers_.end();) {
+            if (it->first.compare(0, prefix.size(), prefix) != 0) {
+                ++it;
+                continue;
+            }
+            for (const auto& entry : it->second) {
+                watchKeys_.erase(entry.first);
+            }
+            watcherCount_.fetch_sub(it->second.size(), std::memory_order_relaxed);
+            fired.emplace_back(it->first, std::move(it->second));
+            it = watchers_.erase(it);
+        }
+    }
+    KeyChange change{prefix, true, std::string(), timestamp, true};
+    for (const auto& listener : listeners_) {
+        listener(change);
+    }
+    for (auto& [key, entries] : fired) {
+        KeyChange keyChange{key, true, std::string(), timestamp};
+        for (auto& entry : entries) {
+            entry.second(keyChange);
+        }
+    }
+}
+
 bool KVStore::exists(const std::string& key) const {
     // Thread safety: reader/writer lock
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
-    return store.find(key) != store.end();
+    auto it = store.find(key);
+    if (it == store.end()) {
+        if (!spill_ || !spill_->contains(key)) {
+            return false;
+        }
+        if (tombstones_.empty()) {
+            return true;  // checking alone doesn't warm it up
+        }
+        // A pending prefix delete may hide it; only its versions can tell
+        it = findLocked(key, lock);
+        if (it == store.end()) {
+            return false;
+        }
+    }
+    // A key whose every version is under a prefix delete is already gone
+    return tombstones_.empty() || firstVisible(key, it->second) < it->second.size();
 }
 
 size_t KVStore::size() const {
     // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    return store.size() + (spill_ ? spill_->size() : 0);
+}
+
+size_t KVStore::residentKeys() const {
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
     return store.size();
 }
 
-std::unordered_map<std::string, std::string> KVStore::getAllData() const {
+std::unordered_map<std::string, std::string> KVStore::getAllData(
+    std::unordered_map<std::string, std::string>* blobRefs, uint64_t* lsn) const {
     // Thread safety: reader/writer lock
     std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    if (lsn != nullptr) {
+        *lsn = wal && wal->isEnabled() ? wal->lastLsn() : 0;
+    }
     std::unordered_map<std::string, std::string> result;
+    auto add = [&](const std::string& key, const Version& latest) {
+        if (!latest.blob) {
+            result[key] = latest.value;
+        } else if (blobRefs != nullptr) {
+            (*blobRefs)[key] = latest.value;
+        } else if (auto value = valueOf(latest)) {
+            result[key] = std::move(*value);
+        }
+    };
     for (const auto& [key, versions] : store) {
-        if (!versions.empty()) {
+        if (firstVisible(key, versions) < versions.size()) {
             // Get the latest version
-            result[key] = versions.back().value;
+            add(key, versions.back());
         }
     }
+    if (spill_) {
+        // Snapshots must not lose what only the spill file holds
+        spill_->forEach([&](const std::string& key, const std::vector<Version>& versions) {
+            const RangeTombstone* tombstone = coveringTombstone(key);
+            if (!tombstone || versions.back().timestamp > tombstone->timestamp) {
+                add(key, versions.back());
+            }
+        });
+    }
     return result;
 }
 
+std::vector<std::string> KVStore::listKeys(const std::string& prefix) const {
+    // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    std::vector<std::string> keys;
+    for (const auto& [key, versions] : store) {
+        if (key.compare(0, prefix.size(), prefix) == 0 &&
+            firstVisible(key, versions) < versions.size()) {
+            keys.push_back(key);
+        }
+    }
+    if (spill_) {
+        spill_->keys(prefix, keys);
+    }
+    return keys;
+}
+
+size_t KVStore::visitVersions(
+        const std::vector<std::string>& keys, std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point through,
+        const std::function<void(const std::string&, const Version&)>& visitor) const {
+    // Thread safety: reader/writer lock
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    size_t visited = 0;
+    auto visit = [&](const std::string& key, const Version& version) {
+        if (!version.blob) {
+            visitor(key, version);
+        } else if (auto value = valueOf(version)) {
+            visitor(key, Version(version.timestamp, std::move(*value)));
+        } else {
+            return;  // unreadable blob, logged
+        }
+        ++visited;
+    };
+    std::vector<Version> spilled;
+    for (const auto& key : keys) {
+        auto it = store.find(key);
+        if (it != store.end()) {
+            const VersionChain& versions = it->second;
+            size_t first = std::max(firstVisible(key, versions), versions.lowerBound(from));
+            for (auto v = versions.at(first); v != versions.end() && v->timestamp <= through; ++v) {
+                visit(key, *v);
+            }
+        } else if (spill_ && spill_->read(key, spilled)) {
+            const RangeTombstone* tombstone = coveringTombstone(key);
+            for (const auto& version : spilled) {
+                if (version.timestamp >= from && version.timestamp <= through &&
+                    (!tombstone || version.timestamp > tombstone->timestamp)) {
+                    visit(key, version);
+                }
+            }
+        }
+    }
+    return visited;
+}
+
+std::optional<TimelinePosition> KVStore::visitTimeline(
+        std::vector<std::string> keys, std::chrono::system_clock::time_point from,
+        std::chrono::system_clock::time_point through, const TimelinePosition* after, size_t limit,
+        const std::function<void(const std::string&, const Version&)>& visitor) const {
+    // Sorted keys make key order and source order the same
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    const auto start = after ? std::max(from, after->timestamp) : from;
+
+    // One cursor per key: a chain in the store, or a spilled key's versions
+    // in the window, copied
+    struct Source {
+        const VersionChain* chain = nullptr;
+        std::vector<Version> spilled;
+        size_t next = 0;
+        size_t ordinal = 0;  // of the version at next
+        const Version* current() const {
+            return chain ? (next < chain->size() ? &(*chain)[next] : nullptr)
+                         : (next < spilled.size() ? &spilled[next] : nullptr);
+        }
+        void advance() {
+            auto timestamp = current()->timestamp;
+            ++next;
+            const Version* v = current();
+            ordinal = v && v->timestamp == timestamp ? ordinal + 1 : 0;
+        }
+    };
+    using Entry = std::pair<std::chrono::system_clock::time_point, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    std::vector<Source> sources(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        Source& source = sources[i];
+        auto it = store.find(keys[i]);
+        if (it != store.end()) {
+            source.chain = &it->second;
+            source.next = std::max(firstVisible(keys[i], it->second), it->second.lowerBound(start));
+        } else if (spill_ && spill_->read(keys[i], source.spilled)) {
+            const RangeTombstone* tombstone = coveringTombstone(keys[i]);
+            auto outside = [&](const Version& v) {
+                return v.timestamp < start || v.timestamp > through ||
+                       (tombstone && v.timestamp <= tombstone->timestamp);
+            };
+            source.spilled.erase(std::remove_if(source.spilled.begin(), source.spilled.end(), outside),
+                                 source.spilled.end());
+        }
+        // Versions stamped exactly at the resume point were returned for
+        // earlier keys, and for this key up to after->ordinal
+        while (after && source.current() && source.current()->timestamp == after->timestamp &&
+               (keys[i] < after->key || (keys[i] == after->key && source.ordinal <= after->ordinal))) {
+            source.advance();
+        }
+        if (source.current() && source.current()->timestamp <= through) {
+            heap.emplace(source.current()->timestamp, i);
+        }
+    }
+
+    size_t visited = 0;
+    TimelinePosition position;
+    while (!heap.empty()) {
+        if (visited == limit) {
+            return position;
+        }
+        const size_t i = heap.top().second;
+        heap.pop();
+        Source& source = sources[i];
+        const Version& version = *source.current();
+        position.timestamp = version.timestamp;
+        position.key = keys[i];
+        position.ordinal = source.ordinal;
+        if (!version.blob) {
+            visitor(keys[i], version);
+        } else if (auto value = valueOf(version)) {
+            visitor(keys[i], Version(version.timestamp, std::move(*value)));
+        }  // else an unreadable blob, logged; passed over
+        ++visited;
+        source.advance();
+        if (source.current() && source.current()->timestamp <= through) {
+            heap.emplace(source.current()->timestamp, i);
+        }
+    }
+    return std::nullopt;
+}
+
 void KVStore::setWalEnabled(bool enabled) {
     walEnabled = enabled;
 }
@@ -238,6 +1234,10 @@ void KVStore::setRetentionPolicy(const RetentionPolicy& policy) {
             applyRetention(key);
         }
     }
+    lock.unlock();
+    if (blobs_) {
+        wakeBlobCollector();
+    }
 }
 
 const RetentionPolicy& KVStore::getRetentionPolicy() const {
@@ -247,9 +1247,7 @@ const RetentionPolicy& KVStore::getRetentionPolicy() const {
 }
 
 void KVStore::setMaxKeys(size_t maxKeys) {
-    std::unique_lock<std::shared_mutex> lock(rwMutex_);
-    maxKeys_ = maxKeys;
-    evictIfNeeded();
+    setEvictionWatermarks(maxKeys, maxKeys - maxKeys / 10);
 }
 
 size_t KVStore::getMaxKeys() const {
@@ -257,6 +1255,131 @@ size_t KVStore::getMaxKeys() const {
     return maxKeys_;
 }
 
+void KVStore::setSpillStore(std::shared_ptr<SpillStore> spill) {
+    spill_ = std::move(spill);
+}
+
+std::shared_ptr<SpillStore> KVStore::getSpillStore() const {
+    return spill_;
+}
+
+void KVStore::setBlobStore(std::shared_ptr<BlobStore> blobs) {
+    blobs_ = std::move(blobs);
+    if (wal && blobs_) {
+        // A SETREF record must never be durable ahead of its blob
+        std::weak_ptr<BlobStore> weak = blobs_;
+        wal->setPreSync([weak]() {
+            if (auto blobs = weak.lock()) {
+                blobs->sync();
+            }
+        });
+    }
+}
+
+std::shared_ptr<BlobStore> KVStore::getBlobStore() const {
+    return blobs_;
+}
+
+void KVStore::setKeyspaceStats(std::shared_ptr<KeyspaceStats> stats) {
+    keyspace_ = std::move(stats);
+}
+
+std::shared_ptr<KeyspaceStats> KVStore::getKeyspaceStats() const {
+    return keyspace_;
+}
+
+void KVStore::recordWriteStats(const std::string& key, const Version& version, size_t length,
+                               bool added) {
+    // Called only from write-locked context
+    BlobRef ref;
+    if (version.blob && BlobRef::parse(version.value, ref)) {
+        // A blob's length and CRC identify its value without reading it
+        // back, live or in replay
+        const uint64_t identity = (uint64_t(ref.length) << 32) | ref.crc;
+        keyspace_->recordWrite(key, KeyspaceStats::hashValue(std::string_view(
+                                   reinterpret_cast<const char*>(&identity), sizeof(identity))),
+                               ref.length, length, added);
+        return;
+    }
+    keyspace_->recordWrite(key, KeyspaceStats::hashValue(version.value), version.value.size(),
+                           length, added);
+}
+
+uint64_t KVStore::collectBlobGarbage() {
+    if (!blobs_) {
+        return 0;
+    }
+    // Sealed files without unpublished blobs: every reference into them is
+    // already in the store or the spill tier, and no new ones can appear
+    std::vector<uint32_t> candidates = blobs_->collectable();
+    if (candidates.empty()) {
+        return 0;
+    }
+    std::unordered_set<uint32_t> dead(candidates.begin(), candidates.end());
+    {
+        std::shared_lock<std::shared_mutex> lock(rwMutex_);
+        auto mark = [&](const Version& version) {
+            BlobRef ref;
+            if (version.blob && BlobRef::parse(version.value, ref)) {
+                dead.erase(ref.file);
+            }
+        };
+        // Hidden versions awaiting reclamation still count; they go next time
+        for (auto it = store.begin(); it != store.end() && !dead.empty(); ++it) {
+            for (const auto& version : it->second) {
+                mark(version);
+            }
+        }
+        if (spill_ && !dead.empty()) {
+            spill_->forEach([&](const std::string&, const std::vector<Version>& versions) {
+                for (const auto& version : versions) {
+                    mark(version);
+                }
+            });
+        }
+    }
+    if (dead.empty()) {
+        return 0;
+    }
+    uint64_t freed = blobs_->remove(std::vector<uint32_t>(dead.begin(), dead.end()));
+    spdlog::info("Blob GC removed {} files freed_mb={}", dead.size(), freed >> 20);
+    return freed;
+}
+
+void KVStore::wakeBlobCollector() {
+    if (!blobs_ || blobGcScheduled_.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(reclaimMutex_);
+        blobGcPending_ = true;
+        if (!reclaimer_.joinable()) {
+            reclaimer_ = std::thread(&KVStore::reclaimLoop, this);
+        }
+    }
+    reclaimCv_.notify_one();
+}
+
+void KVStore::setEvictionWatermarks(size_t high, size_t low) {
+    std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    maxKeys_ = high;
+    evictLowWatermark_ = std::min(low, high);
+    evictIfNeeded();
+}
+
+size_t KVStore::getEvictionLowWatermark() const {
+    std::shared_lock<std::shared_mutex> lock(rwMutex_);
+    return evictLowWatermark_;
+}
+
+EvictionStats KVStore::evictionStats() const {
+    EvictionStats stats;
+    stats.evictedKeys = evictedKeys_.load(std::memory_order_relaxed);
+    stats.passes = evictionPasses_.load(std::memory_order_relaxed);
+    stats.inlineEvictions = inlineEvictions_.load(std::memory_order_relaxed);
+    return stats;
+}
+
 void KVStore::touchKey(const std::string& key) {
     // Called only from write-locked context
     auto it = lruMap_.find(key);
@@ -268,16 +1391,147 @@ void KVStore::touchKey(const std::string& key) {
 }
 
 void KVStore::evictIfNeeded() {
+    // Called only from write-locked context; never logs, the lock is held
+    if (store.size() <= maxKeys_) {
+        return;
+    }
+    if (!evictScheduled_.exchange(true)) {
+        wakeReclaimer(false);
+    }
+    // Backstop for writers outrunning the background pass
+    size_t hardLimit = maxKeys_ + std::max<size_t>(1, maxKeys_ - evictLowWatermark_);
+    if (store.size() > hardLimit) {
+        std::string sample;
+        size_t evicted = evictLruLocked(store.size() - maxKeys_, sample);
+        inlineEvictions_.fetch_add(evicted, std::memory_order_relaxed);
+    }
+}
+
+size_t KVStore::evictLruLocked(size_t count, std::string& sample) {
     // Called only from write-locked context
-    while (store.size() > maxKeys_ && !lruOrder_.empty()) {
-        const std::string evictKey = lruOrder_.front();
+    size_t evicted = 0;
+    std::vector<std::pair<std::string, std::vector<Version>>> spilled;
+    while (evicted < count && !lruOrder_.empty()) {
+        const std::string& key = lruOrder_.front();
+        if (sample.empty()) {
+            sample = key;
+        }
+        auto it = store.find(key);
+        bool kept = false;
+        if (spill_ && it != store.end()) {
+            dropHidden(key, it->second);
+            if (!it->second.empty()) {
+                spilled.emplace_back(key, it->second.release());
+                kept = true;
+            }
+        }
+        if (it != store.end()) {
+            if (keyspace_) {
+                if (kept) {
+                    keyspace_->recordResident(key, false);
+                } else {
+                    keyspace_->recordRemoved(key, true);
+                }
+            }
+            store.erase(it);
+        }
+        lruMap_.erase(key);
         lruOrder_.pop_front();
-        lruMap_.erase(evictKey);
-        store.erase(evictKey);
-        spdlog::warn("LRU evict key={} store_size={}", evictKey, store.size());
+        ++evicted;
+    }
+    // One buffered append per batch; the page cache absorbs it, so holding
+    // the lock here costs a memcpy rather than a disk write
+    if (!spilled.empty() && spill_->put(spilled) != Status::OK) {
+        spdlog::error("Spill failed; {} evicted keys were dropped", spilled.size());
+        if (keyspace_) {
+            for (const auto& entry : spilled) {
+                keyspace_->recordRemoved(entry.first, false);
+            }
+        }
+    }
+    evictedKeys_.fetch_add(evicted, std::memory_order_relaxed);
+    unloggedEvictions_.fetch_add(evicted, std::memory_order_relaxed);
+    return evicted;
+}
+
+void KVStore::evictToLowWatermark() {
+    // Evict in short write-locked batches so writers interleave with a long pass
+    constexpr size_t kBatch = 1024;
+    std::string sample;
+    size_t storeSize = 0, high = 0, low = 0;
+    while (true) {
+        if (spill_) {
+            // Pay for the last batch's spill writes before taking the lock again
+            spill_->throttle();
+        }
+        std::unique_lock<std::shared_mutex> lock(rwMutex_);
+        storeSize = store.size();
+        high = maxKeys_;
+        low = evictLowWatermark_;
+        if (storeSize <= low) {
+            break;
+        }
+        size_t evicted = evictLruLocked(std::min(kBatch, storeSize - low), sample);
+        storeSize = store.size();
+        if (evicted == 0) {
+            break;
+        }
+        evictionPasses_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // One sampled line per second at most, however many keys went
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastEvictionLog_ >= std::chrono::seconds(1)) {
+        uint64_t evicted = unloggedEvictions_.exchange(0, std::memory_order_relaxed);
+        if (evicted > 0) {
+            lastEvictionLog_ = now;
+            spdlog::warn("LRU evicted {} keys (e.g. key={}) store_size={} watermarks={}/{}",
+                         evicted, sample, storeSize, high, low);
+        }
     }
 }
 
+bool KVStore::defragStep(size_t& cursor, size_t maxKeys, DefragProgress& progress) {
+    std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    // Bucket order is stable between steps unless a write rehashes the map;
+    // then a few keys are skipped or visited twice, which is harmless here
+    const size_t buckets = store.bucket_count();
+    size_t visited = 0;
+    while (cursor < buckets && visited < maxKeys) {
+        for (auto it = store.begin(cursor); it != store.end(cursor); ++it) {
+            uint64_t released = it->second.compact();
+            if (released > 0) {
+                progress.bytesReclaimed += released;
+                ++progress.keysCompacted;
+            }
+            ++visited;
+        }
+        ++cursor;
+    }
+    progress.keysVisited += visited;
+    return cursor < buckets;
+}
+
+uint64_t KVStore::shrinkIndexes() {
+    // Only when mostly empty: rehashing is O(keys) under the write lock
+    constexpr size_t kMinBuckets = 1024;
+    std::unique_lock<std::shared_mutex> lock(rwMutex_);
+    uint64_t released = 0;
+    auto shrink = [&](auto& map) {
+        size_t before = map.bucket_count();
+        if (before < kMinBuckets || before < 4 * map.size()) {
+            return;
+        }
+        map.rehash(0);
+        if (map.bucket_count() < before) {
+            released += (before - map.bucket_count()) * sizeof(void*);
+        }
+    };
+    shrink(store);
+    shrink(lruMap_);
+    return released;
+}
+
 void KVStore::applyRetention(const std::string& key) {
     auto it = store.find(key);
     if (it == store.end() || it->second.empty()) {
@@ -285,6 +1539,8 @@ void KVStore::applyRetention(const std::string& key) {
     }
     
     auto& versions = it->second;
+    // Hidden versions are dead weight; don't let them count against LAST_N
+    dropHidden(key, versions);
     
     switch (retentionPolicy.mode) {
         case RetentionMode::FULL:
@@ -294,9 +1550,8 @@ void KVStore::applyRetention(const std::string& key) {
         case RetentionMode::LAST_N:
             // Keep only the last N versions
             if (retentionPolicy.count > 0 && versions.size() > static_cast<size_t>(retentionPolicy.count)) {
-                // Erase old versions from the beginning
-                versions.erase(versions.begin(), 
-                              versions.end() - retentionPolicy.count);
+                // Drop old versions from the front; whole chunks are freed
+                versions.dropFront(versions.size() - retentionPolicy.count);
             }
             break;
             
@@ -306,14 +1561,8 @@ void KVStore::applyRetention(const std::string& key) {
                 auto now = std::chrono::system_clock::now();
                 auto cutoff = now - std::chrono::seconds(retentionPolicy.seconds);
                 
-                // Find first version to keep (first one >= cutoff)
-                auto firstToKeep = std::find_if(versions.begin(), versions.end(),
-                    [cutoff](const Version& v) { return v.timestamp >= cutoff; });
-                
-                // Erase old versions
-                if (firstToKeep != versions.begin()) {
-                    versions.erase(versions.begin(), firstToKeep);
-                }
+                // Drop every version before the first one >= cutoff
+                versions.dropFront(versions.lowerBound(cutoff));
             }
             break;
     }
@@ -453,10 +1702,8 @@ WriteEvaluation KVStore::proposeSet(const std::string& key, const std::string& v
 }
 
 Status KVStore::commitSet(const std::string& key, const std::string& value) {
-    // Thread safety: reader/writer lock
-    std::unique_lock<std::shared_mutex> lock(rwMutex_);
     // Direct commit (bypasses guards - use for forced writes)
-    return setInternal(key, value);
+    return writeValue(key, value);
 }
 
 void KVStore::addGuard(std::shared_ptr<Guard> guard) {
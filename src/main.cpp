@@ -10,6 +10,9 @@
 #include "command.h"
 #include "status.h"
 #include "wal.h"
+#include "io_scheduler.h"
+#include "recovery.h"
+#include "timestamp.h"
 
 class RedisLikeCLI {
 private:
@@ -24,7 +27,7 @@ public:
     void run() {
         std::cout << "Redis-like Key-Value Database\n";
         std::cout << "Commands: SET key value | GET key | GET key AT <timestamp> | HISTORY key\n";
-        std::cout << "          DEL key | SNAPSHOT | CONFIG RETENTION <mode> | EXIT\n";
+        std::cout << "          DEL key | DELPREFIX prefix | SNAPSHOT | CONFIG RETENTION <mode> | EXIT\n";
         std::cout << "Type 'EXIT' to quit\n\n";
 
         while (running) {
@@ -79,6 +82,10 @@ private:
                     handleDel(cmd);
                     break;
                 
+                case CommandType::DELPREFIX:
+                    handleDelPrefix(cmd);
+                    break;
+                
                 case CommandType::SNAPSHOT:
                     handleSnapshot();
                     break;
@@ -163,6 +170,19 @@ private:
         }
     }
     
+    void handleDelPrefix(const Command& cmd) {
+        if (cmd.args.empty() || cmd.args[0].empty()) {
+            std::cout << "(error) ERR wrong number of arguments for 'DELPREFIX' command\n";
+            return;
+        }
+
+        if (kvstore->delPrefix(cmd.args[0]) == Status::OK) {
+            std::cout << "OK\n";
+        } else {
+            std::cout << "(error) ERR failed to delete prefix\n";
+        }
+    }
+    
     void handleSnapshot() {
         if (!wal || !wal->isEnabled()) {
             std::cout << "(error) ERR WAL not available\n";
@@ -185,7 +205,10 @@ private:
         }
         
         // Create snapshot with current store data and policy
-        Status status = wal->createSnapshot(kvstore->getAllData(), policyName);
+        std::unordered_map<std::string, std::string> blobRefs;
+        uint64_t lsn = 0;
+        auto data = kvstore->getAllData(&blobRefs, &lsn);
+        Status status = wal->createSnapshot(data, policyName, blobRefs, lsn);
         
         if (status == Status::OK) {
             std::cout << "OK\n";
@@ -194,61 +217,14 @@ private:
         }
     }
     
-    // Parse timestamp from string (supports epoch milliseconds or ISO-8601)
+    // Parse timestamp from string (epoch ms/us, local "YYYY-MM-DD HH:MM:SS[.mmm]" or RFC 3339)
     std::optional<std::chrono::system_clock::time_point> parseTimestamp(const std::string& timestampStr) {
-        // Try parsing as epoch milliseconds
-        try {
-            size_t pos;
-            long long epochMs = std::stoll(timestampStr, &pos);
-            // Ensure the entire string was consumed (it's a pure number)
-            if (pos == timestampStr.length()) {
-                return std::chrono::system_clock::time_point(std::chrono::milliseconds(epochMs));
-            }
-        } catch (...) {
-            // Not a number, continue to ISO-8601 parsing
-        }
-        
-        // Try parsing ISO-8601 format: YYYY-MM-DD HH:MM:SS.mmm or YYYY-MM-DD HH:MM:SS
-        std::tm tm = {};
-        std::istringstream ss(timestampStr);
-        ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-        
-        if (!ss.fail()) {
-            // mktime uses local timezone, which matches formatTimestamp behavior
-            tm.tm_isdst = -1;  // Let mktime determine DST
-            auto timeT = std::mktime(&tm);
-            
-            if (timeT != -1) {
-                auto result = std::chrono::system_clock::from_time_t(timeT);
-                
-                // Try to parse milliseconds if present (format: .mmm)
-                char dot;
-                int milliseconds;
-                if (ss >> dot >> milliseconds) {
-                    if (dot == '.') {
-                        result += std::chrono::milliseconds(milliseconds);
-                    }
-                }
-                
-                return result;
-            }
-        }
-        
-        return std::nullopt;
+        return TimestampCodec::parse(timestampStr);
     }
     
     // Format timestamp as human-readable string
     std::string formatTimestamp(const std::chrono::system_clock::time_point& timestamp) {
-        auto timeT = std::chrono::system_clock::to_time_t(timestamp);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            timestamp.time_since_epoch()) % 1000;
-        
-        std::tm tm = *std::localtime(&timeT);
-        std::ostringstream oss;
-        oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-        oss << "." << std::setfill('0') << std::setw(3) << ms.count();
-        
-        return oss.str();
+        return TimestampCodec::format(timestamp);
     }
     
     void handleGetAt(const Command& cmd) {
@@ -720,126 +696,15 @@ int main() {
         // Initialize WAL
         auto wal = std::make_shared<WAL>("data/wal.log");
         Status walStatus = wal->initialize();
+        // SNAPSHOT writes yield disk time to commits
+        wal->setIoScheduler(std::make_shared<IoScheduler>(IoScheduler::Options()));
         
         // Create KVStore with WAL
         auto kvstore = std::make_shared<KVStore>(wal);
         
-        // Load snapshot first (if it exists)
+        // Load snapshot first, then replay WAL (changes since last snapshot)
         if (walStatus == Status::OK) {
-            std::vector<std::string> snapshotCommands = wal->readSnapshot();
-            if (!snapshotCommands.empty()) {
-                std::cout << "Loading snapshot...\n";
-                // Disable WAL during replay to avoid duplicate logging
-                kvstore->setWalEnabled(false);
-                auto snapshotTime = std::chrono::system_clock::now();
-                
-                // First pass: Load policy from snapshot
-                for (const auto& cmdLine : snapshotCommands) {
-                    Command cmd = CommandParser::parse(cmdLine);
-                    
-                    if (cmd.type == CommandType::POLICY && cmd.args.size() >= 2) {
-                        std::string subCmd = cmd.args[0];
-                        std::string policyName = cmd.args[1];
-                        
-                        if (subCmd == "SET") {
-                            DecisionPolicy policy;
-                            if (policyName == "DEV_FRIENDLY") {
-                                policy = DecisionPolicy::DEV_FRIENDLY;
-                            } else if (policyName == "SAFE_DEFAULT") {
-                                policy = DecisionPolicy::SAFE_DEFAULT;
-                            } else if (policyName == "STRICT") {
-                                policy = DecisionPolicy::STRICT;
-                            } else {
-                                continue;
-                            }
-                            kvstore->setDecisionPolicy(policy);
-                        }
-                    }
-                }
-                
-                // Second pass: Load data from snapshot
-                for (const auto& cmdLine : snapshotCommands) {
-                    Command cmd = CommandParser::parse(cmdLine);
-                    
-                    // Only replay SET commands from snapshot
-                    // Use setAtTime to avoid logging, but use current time since snapshot doesn't store timestamps
-                    if (cmd.type == CommandType::SET && cmd.args.size() >= 2) {
-                        kvstore->setAtTime(cmd.args[0], cmd.args[1], snapshotTime);
-                    }
-                }
-                kvstore->setWalEnabled(true);
-                std::cout << "Snapshot loaded. Restored " << kvstore->size() << " keys\n";
-            }
-            
-            // Then replay WAL (changes since last snapshot)
-            std::vector<std::string> commands = wal->readLog();
-            if (!commands.empty()) {
-                std::cout << "Replaying WAL...\n";
-                // Disable WAL during replay to avoid duplicate logging
-                kvstore->setWalEnabled(false);
-                
-                // PHASE 1: Replay POLICY commands first (before data)
-                for (const auto& cmdLine : commands) {
-                    std::istringstream iss(cmdLine);
-                    std::string cmdType;
-                    iss >> cmdType;
-                    
-                    if (cmdType == "POLICY") {
-                        std::string subCmd, policyName;
-                        iss >> subCmd >> policyName;
-                        
-                        if (subCmd == "SET") {
-                            DecisionPolicy policy;
-                            if (policyName == "DEV_FRIENDLY") {
-                                policy = DecisionPolicy::DEV_FRIENDLY;
-                            } else if (policyName == "SAFE_DEFAULT") {
-                                policy = DecisionPolicy::SAFE_DEFAULT;
-                            } else if (policyName == "STRICT") {
-                                policy = DecisionPolicy::STRICT;
-                            } else {
-                                continue; // Skip invalid policy
-                            }
-                            
-                            // Set policy without logging (we're replaying)
-                            kvstore->setWalEnabled(false);
-                            kvstore->setDecisionPolicy(policy);
-                        }
-                    }
-                }
-                
-                // PHASE 2: Replay data commands
-                for (const auto& cmdLine : commands) {
-                    // Parse command line manually to extract timestamp
-                    std::istringstream iss(cmdLine);
-                    std::string cmdType;
-                    iss >> cmdType;
-                    
-                    if (cmdType == "SET") {
-                        std::string key, value;
-                        long long timestampMs = 0;
-                        iss >> key >> value;
-                        
-                        // Try to read timestamp (may not exist in old format)
-                        if (iss >> timestampMs) {
-                            // New format with timestamp
-                            auto timestamp = std::chrono::system_clock::time_point(
-                                std::chrono::milliseconds(timestampMs));
-                            kvstore->setAtTime(key, value, timestamp);
-                        } else {
-                            // Old format without timestamp - use current time
-                            kvstore->setAtTime(key, value, std::chrono::system_clock::now());
-                        }
-                    } else if (cmdType == "DEL") {
-                        std::string key;
-                        iss >> key;
-                        if (!key.empty()) {
-                            kvstore->del(key);
-                        }
-                    }
-                }
-                kvstore->setWalEnabled(true);
-                std::cout << "WAL replay complete. Restored " << kvstore->size() << " keys\n";
-            }
+            Recovery::replay(*kvstore, *wal);
         }
         
         std::cout << "\n";
@@ -0,0 +1,234 @@
+#include "memory_monitor.h"
+#include "kvstore.h"
+#include "logger.h"
+#include "metrics.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+bool readNumber(const std::string& path, uint64_t& value, bool& unlimited) {
+    std::string text;
+    if (!readFile(path, text)) return false;
+    unlimited = text.compare(0, 3, "max") == 0;
+    value = unlimited ? 0 : std::strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+// cgroup v2 only: the "0::<path>" line of /proc/self/cgroup
+std::string discoverCgroupDir() {
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            std::string dir = "/sys/fs/cgroup" + line.substr(3);
+            if (!dir.empty() && dir.back() == '/') dir.pop_back();
+            std::ifstream probe(dir + "/memory.current");
+            return probe ? dir : std::string();
+        }
+    }
+    return std::string();
+}
+
+} // namespace
+
+uint64_t MemoryMonitor::processRss() {
+    std::ifstream in("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (!(in >> size >> resident)) return 0;
+    return resident * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+}
+
+MemoryMonitor::MemoryMonitor(std::shared_ptr<KVStore> store, const Options& options)
+    : store_(std::move(store)), options_(options) {}
+
+MemoryMonitor::~MemoryMonitor() {
+    stop();
+}
+
+const char* MemoryMonitor::levelName(Level level) {
+    switch (level) {
+        case Level::ELEVATED: return "elevated";
+        case Level::CRITICAL: return "critical";
+        case Level::NORMAL: break;
+    }
+    return "normal";
+}
+
+bool MemoryMonitor::parsePressure(const std::string& text, double& someAvg10, double& fullAvg10) {
+    // some avg10=1.23 avg60=... total=...
+    // full avg10=0.00 avg60=... total=...
+    bool found = false;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t pos = line.find("avg10=");
+        if (pos == std::string::npos) continue;
+        double value = std::strtod(line.c_str() + pos + 6, nullptr);
+        if (line.compare(0, 4, "some") == 0) {
+            someAvg10 = value;
+            found = true;
+        } else if (line.compare(0, 4, "full") == 0) {
+            fullAvg10 = value;
+        }
+    }
+    return found;
+}
+
+bool MemoryMonitor::readSample(Sample& sample) const {
+    sample = Sample{};
+    bool unlimited = true;
+    bool haveUsage = false;
+    std::string pressure;
+    if (!cgroupDir_.empty()) {
+        bool ignored;
+        haveUsage = readNumber(cgroupDir_ + "/memory.current", sample.usage, ignored);
+        readNumber(cgroupDir_ + "/memory.max", sample.limit, unlimited);
+        readFile(cgroupDir_ + "/memory.pressure", pressure);
+    } else {
+        sample.usage = processRss();
+        haveUsage = sample.usage > 0;
+        readFile("/proc/pressure/memory", pressure);
+    }
+    if (options_.limitBytes > 0) {
+        sample.limit = options_.limitBytes;
+    }
+    sample.havePsi = parsePressure(pressure, sample.someAvg10, sample.fullAvg10);
+    return haveUsage || sample.havePsi;
+}
+
+MemoryMonitor::Level MemoryMonitor::classify(const Sample& sample) const {
+    double ratio = sample.limit > 0
+        ? static_cast<double>(sample.usage) / static_cast<double>(sample.limit) : 0.0;
+    if (ratio >= options_.criticalRatio ||
+        (sample.havePsi && sample.someAvg10 >= options_.criticalPsi)) {
+        return Level::CRITICAL;
+    }
+    if (ratio >= options_.elevatedRatio ||
+        (sample.havePsi && sample.someAvg10 >= options_.elevatedPsi)) {
+        return Level::ELEVATED;
+    }
+    return Level::NORMAL;
+}
+
+bool MemoryMonitor::start() {
+    cgroupDir_ = options_.cgroupDir.empty() ? discoverCgroupDir() : options_.cgroupDir;
+    Sample sample;
+    if (!readSample(sample) || (sample.limit == 0 && !sample.havePsi)) {
+        spdlog::info("Memory monitor off: no cgroup v2 limit, PSI or --memory-limit-mb");
+        return false;
+    }
+    baseHigh_ = store_->getMaxKeys();
+    baseLow_ = store_->getEvictionLowWatermark();
+    spdlog::info("Memory monitor cgroup={} limit_mb={} usage_mb={} psi={}",
+                 cgroupDir_.empty() ? "(none, using RSS)" : cgroupDir_,
+                 sample.limit >> 20, sample.usage >> 20, sample.havePsi ? "yes" : "no");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = false;
+    thread_ = std::thread(&MemoryMonitor::run, this);
+    return true;
+}
+
+void MemoryMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void MemoryMonitor::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        lock.unlock();
+        tick();
+        lock.lock();
+        cv_.wait_for(lock, options_.interval, [this] { return stop_; });
+    }
+}
+
+void MemoryMonitor::tick() {
+    Sample sample;
+    if (!readSample(sample)) {
+        return;
+    }
+    Level current = level();
+    Level target = classify(sample);
+    Level next = current;
+    if (target > current) {
+        next = target;
+        calmSamples_ = 0;
+    } else if (target < current) {
+        // Relax only once pressure has stayed low for a while
+        if (++calmSamples_ >= 5) {
+            next = target;
+            calmSamples_ = 0;
+        }
+    } else {
+        calmSamples_ = 0;
+    }
+    if (next != current) {
+        level_.store(static_cast<int>(next), std::memory_order_relaxed);
+        spdlog::warn("Memory pressure {} -> {} usage_mb={} limit_mb={} psi_some_avg10={:.1f}",
+                     levelName(current), levelName(next), sample.usage >> 20,
+                     sample.limit >> 20, sample.someAvg10);
+    }
+    adapt(next);
+    Metrics::instance().setMemoryState(sample.limit, sample.usage, sample.someAvg10,
+                                       sample.fullAvg10, static_cast<int>(next),
+                                       store_->getMaxKeys());
+}
+
+void MemoryMonitor::adapt(Level level) {
+    const size_t high = store_->getMaxKeys();
+    const size_t resident = store_->residentKeys();
+    size_t target = high;
+    switch (level) {
+        case Level::CRITICAL:
+            target = std::min(high, resident - resident / 5);
+            break;
+        case Level::ELEVATED:
+            target = std::min(high, resident - resident / 20);
+            break;
+        case Level::NORMAL:
+            target = std::min(baseHigh_, high + std::max<size_t>(1, baseHigh_ / 10));
+            break;
+    }
+    target = std::max(target, std::min(options_.minKeys, baseHigh_));
+
+    if (target != high) {
+        // Keep the configured low/high proportion
+        size_t low = baseHigh_ > 0
+            ? static_cast<size_t>(static_cast<double>(target) * baseLow_ / baseHigh_) : target;
+        store_->setEvictionWatermarks(target, low);
+        Metrics::instance().recordMemoryAdaptation(target < high);
+    }
+
+    size_t maxValue = level == Level::CRITICAL ? options_.criticalMaxValue
+                    : level == Level::ELEVATED ? options_.elevatedMaxValue : 0;
+    maxValueBytes_.store(maxValue, std::memory_order_relaxed);
+}
+
+bool MemoryMonitor::admitWrite(size_t valueBytes) {
+    size_t limit = maxValueBytes_.load(std::memory_order_relaxed);
+    if (limit == 0 || valueBytes <= limit) {
+        return true;
+    }
+    Metrics::instance().recordMemoryRejectedWrite();
+    return false;
+}
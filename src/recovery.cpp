@@ -0,0 +1,357 @@
+#include "recovery.h"
+#include "logger.h"
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// A snapshot partition, parsed: values ready to merge into the store and
+// blob references, which are checked against the blob store one by one
+struct LoadedPart {
+    KVStore::LoadBatch batch;
+    std::vector<std::pair<std::string, std::string>> refs;
+};
+
+// Next space-separated field of a line from pos, as `>>` would read it
+std::string nextField(const std::string& text, size_t& pos, size_t end) {
+    while (pos < end && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) ++pos;
+    size_t start = pos;
+    while (pos < end && text[pos] != ' ' && text[pos] != '\t' && text[pos] != '\r') ++pos;
+    return text.substr(start, pos - start);
+}
+
+void parseSnapshotPart(const std::string& contents, std::chrono::system_clock::time_point time,
+                       LoadedPart& part) {
+    size_t pos = 0;
+    while (pos < contents.size()) {
+        size_t eol = contents.find('\n', pos);
+        if (eol == std::string::npos) eol = contents.size();
+        std::string command = nextField(contents, pos, eol);
+        if (command == "SET") {
+            std::string key = nextField(contents, pos, eol);
+            part.batch.add(std::move(key), nextField(contents, pos, eol), time);
+        } else if (command == "SETREF") {
+            std::string key = nextField(contents, pos, eol);
+            part.refs.emplace_back(std::move(key), nextField(contents, pos, eol));
+        }
+        pos = eol + 1;
+    }
+}
+
+} // namespace
+
+std::shared_ptr<Guard> Recovery::parseGuardRecord(const std::string& record) {
+    std::istringstream iss(record);
+    std::string cmdType, subCmd, guardType, name, keyPattern;
+    iss >> cmdType >> subCmd >> guardType >> name >> keyPattern;
+
+    if (cmdType != "GUARD" || subCmd != "ADD" || name.empty() || keyPattern.empty()) {
+        return nullptr;
+    }
+
+    if (guardType == "RANGE_INT" || guardType == "RANGE") {
+        int min, max;
+        if (!(iss >> min >> max)) return nullptr;
+        return std::make_shared<RangeIntGuard>(name, keyPattern, min, max);
+    } else if (guardType == "ENUM") {
+        std::vector<std::string> values;
+        std::string value;
+        while (iss >> value) {
+            values.push_back(value);
+        }
+        if (values.empty()) return nullptr;
+        return std::make_shared<EnumGuard>(name, keyPattern, values);
+    } else if (guardType == "LENGTH") {
+        size_t min, max;
+        if (!(iss >> min >> max)) return nullptr;
+        return std::make_shared<LengthGuard>(name, keyPattern, min, max);
+    }
+
+    return nullptr;
+}
+
+size_t Recovery::loadSnapshotParts(KVStore& store, WAL& wal, const SnapshotManifest& manifest,
+                                   std::chrono::system_clock::time_point snapshotTime) {
+    auto start = std::chrono::steady_clock::now();
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<LoadedPart> ready;
+    size_t damaged = 0;
+    std::atomic<size_t> nextPart{0};
+    const size_t workers = std::max<size_t>(1, std::min<size_t>(manifest.parts.size(),
+                                                                std::thread::hardware_concurrency()));
+
+    // Reading, checking and parsing a partition, and building its index
+    // nodes, all happen here in parallel. A worker holds off while as many
+    // parsed partitions as there are workers wait, bounding the memory
+    // held twice.
+    auto worker = [&]() {
+        std::string contents;
+        for (size_t i = nextPart++; i < manifest.parts.size(); i = nextPart++) {
+            LoadedPart part;
+            bool ok = wal.readSnapshotPart(manifest.parts[i], contents);
+            if (ok) {
+                part.batch.reserve(manifest.parts[i].keys);
+                parseSnapshotPart(contents, snapshotTime, part);
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return ready.size() < workers; });
+            damaged += ok ? 0 : 1;
+            ready.push_back(std::move(part));
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; ++i) {
+        pool.emplace_back(worker);
+    }
+
+    // Merging is serial, but only relinks nodes the workers built
+    size_t collected = 0;
+    for (size_t i = 0; i < manifest.parts.size(); ++i) {
+        LoadedPart part;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return !ready.empty(); });
+            part = std::move(ready.front());
+            ready.pop_front();
+            cv.notify_all();
+        }
+        store.mergeLoadBatch(part.batch);
+        for (const auto& [key, ref] : part.refs) {
+            if (store.setRefAtTime(key, ref, snapshotTime) != Status::OK) {
+                ++collected;
+            }
+        }
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    // Starting without those keys would let the next checkpoint make the
+    // loss permanent, and clear the WAL records that could still replay them
+    if (damaged > 0) {
+        throw std::runtime_error(std::to_string(damaged) + " of " +
+                                 std::to_string(manifest.parts.size()) +
+                                 " snapshot partitions failed their checksum");
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Snapshot loaded. Restored {} keys from {} partitions with {} threads in {}ms",
+                 store.size(), manifest.parts.size(), workers, ms);
+    return collected;
+}
+
+void Recovery::applyPolicyRecord(KVStore& store, const std::string& policyName) {
+    if (policyName == "DEV_FRIENDLY") {
+        store.setDecisionPolicy(DecisionPolicy::DEV_FRIENDLY);
+    } else if (policyName == "SAFE_DEFAULT") {
+        store.setDecisionPolicy(DecisionPolicy::SAFE_DEFAULT);
+    } else if (policyName == "STRICT") {
+        store.setDecisionPolicy(DecisionPolicy::STRICT);
+    }
+}
+
+void Recovery::applyGuardRecord(KVStore& store, const std::string& record) {
+    try {
+        auto guard = parseGuardRecord(record);
+        if (!guard) {
+            spdlog::warn("[WAL Replay] Skipped malformed guard record: {}", record);
+            return;
+        }
+        if (store.hasGuard(guard->getName())) {
+            spdlog::info("[WAL Replay] Skipped duplicate guard: {}", guard->getName());
+            return;
+        }
+        store.addGuard(guard);
+        spdlog::info("[WAL Replay] Restored guard: {}", guard->getName());
+    } catch (const std::exception& e) {
+        spdlog::warn("[WAL Replay] Failed to restore guard from '{}': {}", record, e.what());
+    }
+}
+
+Status Recovery::applyRecord(KVStore& store, const std::string& record) {
+    std::istringstream iss(record);
+    std::string cmdType;
+    iss >> cmdType;
+
+    if (cmdType == "SET") {
+        std::string key, value;
+        long long timestampMs = 0;
+        iss >> key >> value;
+
+        // Old records may not carry a timestamp
+        if (iss >> timestampMs) {
+            auto timestamp = std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(timestampMs));
+            return store.setAtTime(key, value, timestamp);
+        }
+        return store.setAtTime(key, value, std::chrono::system_clock::now());
+    } else if (cmdType == "SETREF") {
+        std::string key, ref;
+        long long timestampMs = 0;
+        iss >> key >> ref >> timestampMs;
+        auto timestamp = std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(timestampMs));
+        return store.setRefAtTime(key, ref, timestamp);
+    } else if (cmdType == "DEL") {
+        std::string key;
+        iss >> key;
+        if (!key.empty()) {
+            store.del(key);
+        }
+        return Status::OK;
+    } else if (cmdType == "DELPREFIX") {
+        std::string prefix;
+        long long timestampMs = 0;
+        iss >> prefix >> timestampMs;
+        if (!prefix.empty()) {
+            store.delPrefixAtTime(prefix, std::chrono::system_clock::time_point(
+                std::chrono::milliseconds(timestampMs)));
+        }
+        return Status::OK;
+    } else if (cmdType == "POLICY") {
+        std::string subCmd, policyName;
+        iss >> subCmd >> policyName;
+        if (subCmd == "SET") {
+            applyPolicyRecord(store, policyName);
+        }
+        return Status::OK;
+    } else if (cmdType == "GUARD") {
+        applyGuardRecord(store, record);
+        return Status::OK;
+    }
+    return Status::INVALID_COMMAND;
+}
+
+size_t Recovery::replay(KVStore& store, WAL& wal) {
+    if (!wal.isEnabled()) {
+        return store.size();
+    }
+
+    // Disable WAL during replay to avoid duplicate logging
+    store.setWalEnabled(false);
+
+    // Replay snapshot first. Snapshots don't store timestamps, so every
+    // restored key gets the same load time.
+    uint64_t snapshotLsn = 0;
+    // References into blob files that were collected: versions retention or
+    // deletes had already dropped
+    size_t collectedBlobs = 0;
+    SnapshotManifest manifest;
+    std::vector<std::string> snapshotCommands;
+    Status manifestStatus = wal.readSnapshotManifest(manifest);
+    if (manifestStatus == Status::ERROR) {
+        // Not a reason to try the single-file format: that would start empty
+        throw std::runtime_error("snapshot manifest is damaged");
+    }
+    if (manifestStatus == Status::OK) {
+        if (!manifest.policy.empty()) {
+            applyPolicyRecord(store, manifest.policy);
+        }
+        snapshotLsn = manifest.lsn;
+        collectedBlobs += loadSnapshotParts(store, wal, manifest, std::chrono::system_clock::now());
+    } else {
+        // A snapshot written as one file
+        snapshotCommands = wal.readSnapshot();
+    }
+    if (!snapshotCommands.empty()) {
+        auto snapshotTime = std::chrono::system_clock::now();
+        for (const auto& cmdLine : snapshotCommands) {
+            std::istringstream iss(cmdLine);
+            std::string cmdType;
+            iss >> cmdType;
+
+            if (cmdType == "LSN") {
+                iss >> snapshotLsn;
+            } else if (cmdType == "POLICY") {
+                std::string subCmd, policyName;
+                iss >> subCmd >> policyName;
+                if (subCmd == "SET") {
+                    applyPolicyRecord(store, policyName);
+                }
+            } else if (cmdType == "GUARD") {
+                applyGuardRecord(store, cmdLine);
+            } else if (cmdType == "SET") {
+                std::string key, value;
+                iss >> key >> value;
+                store.setAtTime(key, value, snapshotTime);
+            } else if (cmdType == "SETREF") {
+                std::string key, ref;
+                iss >> key >> ref;
+                if (store.setRefAtTime(key, ref, snapshotTime) != Status::OK) {
+                    ++collectedBlobs;
+                }
+            }
+        }
+        spdlog::info("Snapshot loaded. Restored {} keys", store.size());
+    }
+
+    // Then replay WAL (changes since last snapshot)
+    // A log without a BASE header is assumed to start after the snapshot
+    uint64_t logBase = snapshotLsn;
+    std::vector<std::string> commands = wal.readLog(&logBase);
+    if (logBase > snapshotLsn) {
+        spdlog::error("WAL starts after LSN {} but the snapshot ends at LSN {}; records in between are lost",
+                      logBase, snapshotLsn);
+    }
+    // The log still holds records the snapshot covers if the server stopped
+    // between installing the snapshot and clearing the log
+    const size_t covered = static_cast<size_t>(
+        std::min<uint64_t>(snapshotLsn - std::min(logBase, snapshotLsn), commands.size()));
+    if (covered > 0) {
+        spdlog::info("Skipping {} WAL records already in the snapshot", covered);
+        commands.erase(commands.begin(), commands.begin() + static_cast<std::ptrdiff_t>(covered));
+        logBase += covered;
+    }
+    // Each WAL record took one LSN
+    wal.setBaseLsn(std::max(snapshotLsn, logBase + commands.size()));
+    if (!commands.empty()) {
+        spdlog::info("Replaying WAL and snapshot");
+
+        // Phase 1: Replay POLICY and GUARD commands before data
+        for (const auto& cmdLine : commands) {
+            std::istringstream iss(cmdLine);
+            std::string cmdType;
+            iss >> cmdType;
+
+            if (cmdType == "POLICY") {
+                std::string subCmd, policyName;
+                iss >> subCmd >> policyName;
+                if (subCmd == "SET") {
+                    applyPolicyRecord(store, policyName);
+                }
+            } else if (cmdType == "GUARD") {
+                applyGuardRecord(store, cmdLine);
+            }
+        }
+
+        // Phase 2: Replay data commands
+        for (const auto& cmdLine : commands) {
+            if (cmdLine.compare(0, 7, "POLICY ") == 0 || cmdLine.compare(0, 6, "GUARD ") == 0) {
+                continue;
+            }
+            if (applyRecord(store, cmdLine) == Status::NOT_FOUND) {
+                ++collectedBlobs;
+            }
+        }
+        spdlog::info("WAL replay complete. Restored {} keys", store.size());
+    }
+
+    if (collectedBlobs > 0) {
+        spdlog::info("Skipped {} records whose blobs were already collected", collectedBlobs);
+    }
+    // Files left behind by versions that are gone now (or by a crash before
+    // a collection) are only known once everything is loaded
+    store.collectBlobGarbage();
+
+    store.setWalEnabled(true);
+    return store.size();
+}
@@ -0,0 +1,361 @@
+#include "replication.h"
+#include "blob_store.h"
+#include "external/httplib.h"
+#include "kvstore.h"
+#include "logger.h"
+#include "metrics.h"
+#include "recovery.h"
+#include "wal.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+// The "lsn" field of a replica's reply
+bool parseLsn(const std::string& body, uint64_t& lsn) {
+    size_t at = body.find("\"lsn\":");
+    if (at == std::string::npos) {
+        return false;
+    }
+    char* end = nullptr;
+    const char* start = body.c_str() + at + 6;
+    lsn = std::strtoull(start, &end, 10);
+    return end != start;
+}
+
+} // namespace
+
+// ---------- Replicator ----------
+
+Replicator::Replicator(std::shared_ptr<WAL> wal, std::shared_ptr<KVStore> store, Options options)
+    : wal_(std::move(wal)), store_(std::move(store)), options_(std::move(options)) {
+    for (const auto& address : options_.replicas) {
+        auto replica = std::make_unique<Replica>();
+        replica->address = address;
+        size_t colon = address.find_last_of(':');
+        replica->host = colon == std::string::npos ? address : address.substr(0, colon);
+        replica->port = colon == std::string::npos ? 8080 : std::atoi(address.c_str() + colon + 1);
+        replicas_.push_back(std::move(replica));
+    }
+    if (options_.syncReplicas > replicas_.size()) {
+        spdlog::warn("Replication: {} sync replicas requested but only {} configured",
+                     options_.syncReplicas, replicas_.size());
+        options_.syncReplicas = replicas_.size();
+    }
+}
+
+Replicator::~Replicator() {
+    stop();
+}
+
+void Replicator::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (started_ || replicas_.empty()) {
+            return;
+        }
+        started_ = true;
+        lastLsn_ = wal_->lastLsn();
+        firstLsn_ = lastLsn_ + 1;
+    }
+    // Records appended between the two locks are numbered after lastLsn_
+    // and queued by the hook, so none is missed
+    wal_->setRecordHook([this](uint64_t lsn, const std::string& record) { append(lsn, record); });
+    for (auto& replica : replicas_) {
+        Replica* r = replica.get();
+        r->thread = std::thread([this, r]() { ship(*r); });
+    }
+    spdlog::info("Replicating to {} replicas sync_replicas={} sync_timeout_ms={}",
+                 replicas_.size(), options_.syncReplicas, options_.syncTimeout.count());
+}
+
+void Replicator::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!started_ || stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    wal_->setRecordHook(nullptr);
+    recordsCV_.notify_all();
+    ackCV_.notify_all();
+    for (auto& replica : replicas_) {
+        if (replica->thread.joinable()) {
+            replica->thread.join();
+        }
+    }
+}
+
+void Replicator::append(uint64_t lsn, const std::string& record) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffer_.empty()) {
+            firstLsn_ = lsn;
+        }
+        buffer_.emplace_back(lsn, record);
+        bufferBytes_ += record.size();
+        lastLsn_ = lsn;
+        if (bufferBytes_ > options_.maxBufferBytes) {
+            trimLocked();
+        }
+    }
+    recordsCV_.notify_all();
+}
+
+Replicator::Ack Replicator::waitReplicated(uint64_t lsn) {
+    if (options_.syncReplicas == 0) {
+        return Ack::ASYNC;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (degraded_ || stopping_ || !started_) {
+        return Ack::ASYNC;
+    }
+    ++syncWaits_;
+    bool acked = ackCV_.wait_for(lock, options_.syncTimeout,
+                                 [&] { return stopping_ || quorumLsnLocked() >= lsn; });
+    if (acked) {
+        return stopping_ ? Ack::ASYNC : Ack::REPLICATED;
+    }
+    ++syncTimeouts_;
+    Metrics::instance().recordReplicationTimeout();
+    if (!degraded_) {
+        degraded_ = true;
+        spdlog::warn("Replication: no quorum of {} within {}ms at lsn={}; falling back to async",
+                     options_.syncReplicas, options_.syncTimeout.count(), lsn);
+    }
+    return Ack::TIMED_OUT;
+}
+
+uint64_t Replicator::quorumLsnLocked() const {
+    std::vector<uint64_t> acked;
+    for (const auto& replica : replicas_) {
+        if (replica->known && !replica->lost) {
+            acked.push_back(replica->acked);
+        }
+    }
+    if (options_.syncReplicas == 0 || acked.size() < options_.syncReplicas) {
+        return 0;
+    }
+    std::nth_element(acked.begin(), acked.begin() + (options_.syncReplicas - 1), acked.end(),
+                     std::greater<uint64_t>());
+    return acked[options_.syncReplicas - 1];
+}
+
+void Replicator::trimLocked() {
+    // A replica not yet heard from might need anything still queued
+    uint64_t keepFrom = lastLsn_ + 1;
+    for (const auto& replica : replicas_) {
+        if (!replica->lost) {
+            keepFrom = std::min(keepFrom, replica->known ? replica->acked + 1 : firstLsn_);
+        }
+    }
+    while (!buffer_.empty() &&
+           (buffer_.front().first < keepFrom || bufferBytes_ > options_.maxBufferBytes)) {
+        bufferBytes_ -= buffer_.front().second.size();
+        buffer_.pop_front();
+    }
+    firstLsn_ = buffer_.empty() ? lastLsn_ + 1 : buffer_.front().first;
+}
+
+std::string Replicator::resolve(const std::string& record) const {
+    if (record.compare(0, 7, "SETREF ") != 0) {
+        return record;
+    }
+    std::istringstream iss(record.substr(7));
+    std::string key, ref, timestamp;
+    iss >> key >> ref >> timestamp;
+    std::string value;
+    auto blobs = store_->getBlobStore();
+    if (blobs && blobs->read(ref, value)) {
+        return "SET " + key + " " + value + " " + timestamp;
+    }
+    // Collected already, so replay would skip it too; keeps the LSN
+    return "NOP";
+}
+
+void Replicator::ship(Replica& replica) {
+    httplib::Client client(replica.host, replica.port);
+    client.set_keep_alive(true);
+    client.set_connection_timeout(std::chrono::seconds(1));
+    // The replica answers after its fsync, which it waits up to 5s for
+    client.set_read_timeout(std::chrono::seconds(10));
+    httplib::Headers headers;
+    if (!options_.apiKey.empty()) {
+        headers.emplace("X-API-Key", options_.apiKey);
+    }
+
+    std::vector<std::string> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (replica.known && replica.connected && !replica.lost) {
+            recordsCV_.wait_for(lock, options_.heartbeat,
+                                [&] { return stopping_ || lastLsn_ > replica.acked; });
+        }
+        if (stopping_) {
+            break;
+        }
+
+        // Until the replica's position is known, an empty batch asks for it
+        uint64_t from = replica.known ? replica.acked + 1 : lastLsn_ + 1;
+        batch.clear();
+        if (replica.known && from < firstLsn_) {
+            if (!replica.lost) {
+                spdlog::error("Replication: replica {} is at lsn={} but records before {} are no "
+                              "longer queued; seed it again from a backup",
+                              replica.address, replica.acked, firstLsn_);
+            }
+            replica.lost = true;
+            replica.known = false;
+            recordsCV_.wait_for(lock, options_.heartbeat, [&] { return stopping_; });
+            continue;
+        }
+        size_t bytes = 0;
+        for (size_t i = from - firstLsn_; i < buffer_.size() && replica.known; ++i) {
+            if (!batch.empty() && bytes + buffer_[i].second.size() > options_.maxBatchBytes) {
+                break;
+            }
+            batch.push_back(buffer_[i].second);
+            bytes += buffer_[i].second.size();
+        }
+        lock.unlock();
+
+        std::string body;
+        body.reserve(bytes + batch.size());
+        for (const auto& record : batch) {
+            body += resolve(record);
+            body += '\n';
+        }
+        auto res = client.Post("/replication/apply?from=" + std::to_string(from), headers, body,
+                               "text/plain");
+        uint64_t lsn = 0;
+        const bool answered = res && (res->status == 200 || res->status == 409) &&
+                              parseLsn(res->body, lsn);
+
+        lock.lock();
+        if (!answered) {
+            if (replica.connected || !replica.known) {
+                spdlog::warn("Replication: replica {} unreachable ({})", replica.address,
+                             res ? "status " + std::to_string(res->status) : httplib::to_string(res.error()));
+            }
+            replica.connected = false;
+            recordsCV_.wait_for(lock, options_.heartbeat, [&] { return stopping_; });
+            continue;
+        }
+        if (!replica.connected) {
+            spdlog::info("Replication: replica {} connected at lsn={}", replica.address, lsn);
+        }
+        replica.connected = true;
+        const bool behind = lsn + 1 < firstLsn_;
+        const bool ahead = lsn > lastLsn_;
+        if (behind || ahead) {
+            if (!replica.lost) {
+                spdlog::error("Replication: replica {} is at lsn={}, {} records queued here "
+                              "({}..{}); seed it again from a backup", replica.address, lsn,
+                              ahead ? "past the" : "before the", firstLsn_, lastLsn_);
+            }
+            replica.lost = true;
+            replica.known = false;
+            recordsCV_.wait_for(lock, options_.heartbeat, [&] { return stopping_; });
+            continue;
+        }
+        if (replica.lost) {
+            spdlog::info("Replication: replica {} is back at lsn={}", replica.address, lsn);
+        }
+        replica.lost = false;
+        if (replica.known && lsn > replica.acked) {
+            replica.batches++;
+            replica.records += lsn - replica.acked;
+        }
+        replica.known = true;
+        replica.acked = lsn;
+        if (degraded_ && quorumLsnLocked() >= lastLsn_) {
+            degraded_ = false;
+            spdlog::info("Replication: {} replicas caught up at lsn={}; semi-sync resumed",
+                         options_.syncReplicas, lastLsn_);
+        }
+        trimLocked();
+        ackCV_.notify_all();
+    }
+}
+
+Replicator::Stats Replicator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.lastLsn = lastLsn_;
+    stats.syncReplicas = options_.syncReplicas;
+    stats.semiSync = options_.syncReplicas > 0 && !degraded_;
+    stats.syncWaits = syncWaits_;
+    stats.syncTimeouts = syncTimeouts_;
+    for (const auto& replica : replicas_) {
+        ReplicaStats r;
+        r.address = replica->address;
+        r.ackedLsn = replica->known ? replica->acked : 0;
+        r.connected = replica->connected;
+        r.lost = replica->lost;
+        r.batches = replica->batches;
+        r.records = replica->records;
+        stats.replicas.push_back(std::move(r));
+    }
+    return stats;
+}
+
+// ---------- ReplicaSink ----------
+
+ReplicaSink::ReplicaSink(std::shared_ptr<WAL> wal, std::shared_ptr<KVStore> store)
+    : wal_(std::move(wal)), store_(std::move(store)) {
+    store_->setWalEnabled(false);
+    applied_ = wal_->lastLsn();
+}
+
+Status ReplicaSink::apply(uint64_t from, const std::string& records, uint64_t& lsn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const uint64_t last = wal_->lastLsn();
+        if (from > last + 1) {
+            lsn = last;
+            return Status::NOT_FOUND;
+        }
+        uint64_t recordLsn = from;
+        size_t pos = 0;
+        while (pos < records.size()) {
+            size_t end = records.find('\n', pos);
+            if (end == std::string::npos) {
+                end = records.size();
+            }
+            std::string record = records.substr(pos, end - pos);
+            pos = end + 1;
+            if (recordLsn++ <= last) {
+                continue;  // resent after a lost reply
+            }
+            if (wal_->logRecord(record) != Status::OK) {
+                lsn = wal_->lastLsn();
+                return Status::ERROR;
+            }
+            Recovery::applyRecord(*store_, record);
+        }
+        lsn = wal_->lastLsn();
+        {
+            std::lock_guard<std::mutex> appliedLock(appliedMutex_);
+            applied_ = lsn;
+        }
+        appliedCV_.notify_all();
+    }
+    // Outside the lock, so the next batch is applied while this one syncs
+    return wal_->waitDurable(lsn, std::chrono::seconds(5)) ? Status::OK : Status::ERROR;
+}
+
+uint64_t ReplicaSink::lsn() const {
+    return wal_->lastLsn();
+}
+
+uint64_t ReplicaSink::appliedLsn() const {
+    std::lock_guard<std::mutex> lock(appliedMutex_);
+    return applied_;
+}
+
+bool ReplicaSink::waitApplied(uint64_t lsn, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(appliedMutex_);
+    return appliedCV_.wait_for(lock, timeout, [&] { return applied_ >= lsn; });
+}
@@ -0,0 +1,296 @@
+// Answers temporal queries from history export files (POST /export) without
+// a server or a load: each file is mapped and only its footer is read at
+// startup, so opening takes the same few milliseconds whatever its size.
+// Lookups binary-search the footer's key ranges and then one row group's
+// key dictionary, decoding nothing but that group's timestamps and the
+// key's own values.
+//
+// Usage: sentinel_query <file|dir>... <command> [args]
+//
+//   info                      what each file covers
+//   get <key>                 latest version
+//   getAt <key> <timestamp>   version in effect at timestamp
+//   history <key>             every version
+//   explain <key>             where the key's rows are and what was read
+//   scan [prefix] [--at <timestamp>] [--limit <n>]
+//                             each key under prefix with its latest (or
+//                             getAt) value; 100 keys unless --limit, 0 = all
+//   verify                    check every column chunk's CRC-32
+//
+// A directory stands for the *.sdbcol files in it (e.g. data/exports).
+// Several files are read as one: a key's versions are merged by time.
+//
+//   ./build/sentinel_query data/exports getAt sensor:7 "2024-01-01 12:00:00"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "history_export.h"
+#include "timestamp.h"
+
+namespace {
+
+using Files = std::vector<std::pair<std::string, std::unique_ptr<HistoryFile>>>;
+
+bool isCommand(const std::string& arg) {
+    static const char* const commands[] = {"info", "get", "getAt", "history", "explain", "scan", "verify"};
+    return std::find(std::begin(commands), std::end(commands), arg) != std::end(commands);
+}
+
+// Expand directories to the exports in them, sorted by name
+std::vector<std::string> expand(const std::string& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return {path};
+    }
+    std::vector<std::string> paths;
+    if (DIR* dir = ::opendir(path.c_str())) {
+        while (dirent* entry = ::readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 7 && name.compare(name.size() - 7, 7, ".sdbcol") == 0) {
+                paths.push_back(path + "/" + name);
+            }
+        }
+        ::closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Every file's versions of key, in time order; a version exported more
+// than once appears once
+bool history(const Files& files, const std::string& key, std::vector<Version>& versions) {
+    versions.clear();
+    bool found = false;
+    std::vector<Version> part;
+    for (const auto& [path, file] : files) {
+        if (file->history(key, part)) {
+            found = true;
+            versions.insert(versions.end(), part.begin(), part.end());
+        }
+    }
+    if (files.size() > 1) {
+        std::stable_sort(versions.begin(), versions.end(),
+                         [](const Version& a, const Version& b) { return a.timestamp < b.timestamp; });
+        versions.erase(std::unique(versions.begin(), versions.end(),
+                                   [](const Version& a, const Version& b) {
+                                       return a.timestamp == b.timestamp && a.value == b.value;
+                                   }), versions.end());
+    }
+    return found;
+}
+
+// The version in effect at `at`, or nullptr if none is yet
+const Version* versionAt(const std::vector<Version>& versions, std::chrono::system_clock::time_point at) {
+    auto it = std::upper_bound(versions.begin(), versions.end(), at,
+                               [](std::chrono::system_clock::time_point t, const Version& v) {
+                                   return t < v.timestamp;
+                               });
+    return it == versions.begin() ? nullptr : &*(it - 1);
+}
+
+void printVersion(const std::string& key, const Version& version) {
+    std::cout << key << '\t' << TimestampCodec::format(version.timestamp) << '\t' << version.value << '\n';
+}
+
+std::chrono::system_clock::time_point timestampArg(const std::string& text) {
+    auto tp = TimestampCodec::parse(text);
+    if (!tp) {
+        std::cerr << "Unrecognized timestamp '" << text << "'\n";
+        std::exit(2);
+    }
+    return *tp;
+}
+
+int explain(const Files& files, const std::string& key) {
+    bool found = false;
+    for (const auto& [path, file] : files) {
+        auto start = std::chrono::steady_clock::now();
+        HistoryFile::Position position;
+        bool here = file->find(key, position);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << path << ": ";
+        if (!here) {
+            std::cout << "not present (" << file->groups().size() << " row groups searched by key range, "
+                      << us << " us)\n";
+            continue;
+        }
+        found = true;
+        const HistoryFile::Group& group = file->groups()[position.group];
+        static const char* const names[] = {"keys", "runs", "times", "values"};
+        std::cout << "row group " << position.group << " of " << file->groups().size()
+                  << " (keys " << group.firstKey << " .. " << group.lastKey << ", " << group.rows
+                  << " rows)\n"
+                  << "  dictionary index " << position.key << " of " << group.keys
+                  << ", rows " << position.firstRow << " .. " << position.firstRow + position.rows - 1
+                  << " (" << position.rows << " versions), found in " << us << " us\n";
+        for (int column = 0; column < 4; ++column) {
+            const HistoryFile::Chunk& chunk = group.chunks[column];
+            std::cout << "  " << names[column] << " chunk at offset " << chunk.offset << ", "
+                      << chunk.bytes << " bytes\n";
+        }
+        std::cout << "  reads: dictionary binary search, " << 4ull * position.key
+                  << " bytes of run lengths, timestamps of rows 0 .. "
+                  << position.firstRow + position.rows - 1 << ", " << position.rows << " values\n";
+    }
+    return found ? 0 : 1;
+}
+
+int scan(const Files& files, const std::string& prefix, bool hasAt,
+         std::chrono::system_clock::time_point at, size_t limit) {
+    size_t printed = 0;
+    auto emit = [&](const std::string& key, const std::vector<Version>& versions) {
+        const Version* version = hasAt ? versionAt(versions, at)
+                                       : (versions.empty() ? nullptr : &versions.back());
+        if (version) {
+            printVersion(key, *version);
+            ++printed;
+        }
+        return limit == 0 || printed < limit;
+    };
+    auto underPrefix = [&](const std::string& key) { return key.compare(0, prefix.size(), prefix) == 0; };
+
+    if (files.size() == 1) {
+        // Streams straight off the mapping
+        files[0].second->scan(prefix, [&](const std::string& key, const std::vector<Version>& versions) {
+            return underPrefix(key) && emit(key, versions);
+        });
+        return 0;
+    }
+
+    // Several files: gather the first keys of each, then merge them. Each
+    // file can contribute at most `limit` keys to the result.
+    std::set<std::string> keys;
+    for (const auto& [path, file] : files) {
+        size_t taken = 0;
+        file->scan(prefix, [&](const std::string& key, const std::vector<Version>&) {
+            if (!underPrefix(key)) return false;
+            keys.insert(key);
+            return limit == 0 || ++taken < limit;
+        });
+    }
+    std::vector<Version> versions;
+    for (const auto& key : keys) {
+        history(files, key, versions);
+        if (!emit(key, versions)) break;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int commandAt = 1;
+    while (commandAt < argc && !isCommand(argv[commandAt])) {
+        ++commandAt;
+    }
+    if (commandAt == 1 || commandAt == argc) {
+        std::cerr << "Usage: " << argv[0] << " <file|dir>... <command> [args]\n"
+                  << "Commands: info | get <key> | getAt <key> <timestamp> | history <key> |\n"
+                  << "          explain <key> | scan [prefix] [--at <timestamp>] [--limit <n>] | verify\n";
+        return 2;
+    }
+    const std::string command = argv[commandAt];
+    std::vector<std::string> args(argv + commandAt + 1, argv + argc);
+
+    auto start = std::chrono::steady_clock::now();
+    Files files;
+    for (int i = 1; i < commandAt; ++i) {
+        for (const auto& path : expand(argv[i])) {
+            auto file = std::make_unique<HistoryFile>();
+            std::string error;
+            if (!file->open(path, error)) {
+                std::cerr << error << "\n";
+                return 1;
+            }
+            files.emplace_back(path, std::move(file));
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "No export files found\n";
+        return 1;
+    }
+    double openMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto needKey = [&](size_t count) {
+        if (args.size() < count) {
+            std::cerr << command << ": missing argument\n";
+            std::exit(2);
+        }
+    };
+
+    std::vector<Version> versions;
+    if (command == "info") {
+        uint64_t rows = 0;
+        for (const auto& [path, file] : files) {
+            std::cout << path << ": " << file->keys() << " keys, " << file->rows() << " versions in "
+                      << file->groups().size() << " row groups, prefix '" << file->prefix() << "', "
+                      << TimestampCodec::format(file->from()) << " .. "
+                      << TimestampCodec::format(file->through()) << ", exported "
+                      << TimestampCodec::format(file->created()) << "\n";
+            rows += file->rows();
+        }
+        std::cout << files.size() << " files, " << rows << " versions, opened in " << openMs << " ms\n";
+    } else if (command == "get" || command == "history") {
+        needKey(1);
+        if (!history(files, args[0], versions) || versions.empty()) {
+            std::cerr << "Key not found: " << args[0] << "\n";
+            return 1;
+        }
+        if (command == "get") {
+            printVersion(args[0], versions.back());
+        } else {
+            for (const auto& version : versions) {
+                printVersion(args[0], version);
+            }
+        }
+    } else if (command == "getAt") {
+        needKey(2);
+        auto at = timestampArg(args[1]);
+        const Version* version = history(files, args[0], versions) ? versionAt(versions, at) : nullptr;
+        if (!version) {
+            std::cerr << "No version of " << args[0] << " at or before " << args[1] << "\n";
+            return 1;
+        }
+        printVersion(args[0], *version);
+    } else if (command == "explain") {
+        needKey(1);
+        std::cout << "opened " << files.size() << " files in " << openMs << " ms\n";
+        return explain(files, args[0]);
+    } else if (command == "scan") {
+        std::string prefix;
+        bool hasAt = false;
+        std::chrono::system_clock::time_point at{};
+        size_t limit = 100;
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] == "--at" && i + 1 < args.size()) {
+                hasAt = true;
+                at = timestampArg(args[++i]);
+            } else if (args[i] == "--limit" && i + 1 < args.size()) {
+                limit = std::stoull(args[++i]);
+            } else if (prefix.empty() && args[i].compare(0, 2, "--") != 0) {
+                prefix = args[i];
+            } else {
+                std::cerr << "Unknown option: " << args[i] << "\n";
+                return 2;
+            }
+        }
+        return scan(files, prefix, hasAt, at, limit);
+    } else if (command == "verify") {
+        bool ok = true;
+        for (const auto& [path, file] : files) {
+            std::string error;
+            bool good = file->verify(error);
+            std::cout << path << ": " << (good ? "OK" : error) << "\n";
+            ok = ok && good;
+        }
+        return ok ? 0 : 1;
+    }
+    return 0;
+}
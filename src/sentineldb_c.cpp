@@ -0,0 +1,384 @@
+#include "sentineldb.h"
+#include "kvstore.h"
+#include "wal.h"
+#include "guard.h"
+#include "recovery.h"
+#include "spill_store.h"
+#include "blob_store.h"
+#include "io_scheduler.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct sdb_db {
+    std::shared_ptr<WAL> wal;
+    std::shared_ptr<KVStore> store;
+};
+
+namespace {
+
+int64_t toEpochMs(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        tp.time_since_epoch()).count();
+}
+
+// WAL records are space-delimited, so a key with whitespace in it would be
+// split apart on replay
+bool validKey(const char* key, size_t keyLen) {
+    if (key == nullptr || keyLen == 0) {
+        return false;
+    }
+    return std::none_of(key, key + keyLen, [](char c) {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    });
+}
+
+const char* policyName(DecisionPolicy policy) {
+    switch (policy) {
+        case DecisionPolicy::DEV_FRIENDLY: return "DEV_FRIENDLY";
+        case DecisionPolicy::SAFE_DEFAULT: return "SAFE_DEFAULT";
+        case DecisionPolicy::STRICT: return "STRICT";
+    }
+    return "SAFE_DEFAULT";
+}
+
+sdb_status fromStatus(Status status) {
+    switch (status) {
+        case Status::OK: return SDB_OK;
+        case Status::NOT_FOUND: return SDB_NOT_FOUND;
+        case Status::INVALID_COMMAND: return SDB_INVALID_ARGUMENT;
+        case Status::ERROR: return SDB_ERROR;
+    }
+    return SDB_ERROR;
+}
+
+sdb_status addGuard(sdb_db* db, std::shared_ptr<Guard> guard,
+                    const std::string& type, const std::string& params) {
+    if (db->store->hasGuard(guard->getName())) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    db->store->addGuard(guard);
+    if (db->wal && db->wal->isEnabled()) {
+        db->wal->logGuardAdd(type, guard->getName(), guard->getKeyPattern(), params);
+    }
+    return SDB_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+int sdb_abi_version(void) {
+    return SENTINELDB_ABI_VERSION;
+}
+
+const char* sdb_status_string(sdb_status status) {
+    switch (status) {
+        case SDB_OK: return "OK";
+        case SDB_NOT_FOUND: return "NOT_FOUND";
+        case SDB_INVALID_ARGUMENT: return "INVALID_ARGUMENT";
+        case SDB_ERROR: return "ERROR";
+    }
+    return "UNKNOWN";
+}
+
+sdb_status sdb_open(const char* data_dir, sdb_db** out_db) {
+    if (data_dir == nullptr || out_db == nullptr) return SDB_INVALID_ARGUMENT;
+    *out_db = nullptr;
+    try {
+        std::string dir(data_dir);
+        while (dir.size() > 1 && dir.back() == '/') dir.pop_back();
+
+        auto db = std::make_unique<sdb_db>();
+        db->wal = std::make_shared<WAL>(dir + "/wal.log");
+        if (db->wal->initialize() != Status::OK) {
+            return SDB_ERROR;
+        }
+        // Snapshots and spill writes yield disk time to commits
+        auto io = std::make_shared<IoScheduler>(IoScheduler::Options());
+        db->wal->setIoScheduler(io);
+        db->store = std::make_shared<KVStore>(db->wal);
+        // Evicted keys go to disk rather than away; optional if it can't open
+        auto spill = std::make_shared<SpillStore>(dir + "/spill.dat");
+        spill->setIoScheduler(io);
+        if (spill->initialize() == Status::OK) {
+            db->store->setSpillStore(spill);
+        }
+        // Values of 64KB and up are stored once in blob logs, by reference
+        auto blobs = std::make_shared<BlobStore>(dir + "/blobs", BlobStore::Options());
+        if (blobs->initialize() == Status::OK) {
+            db->store->setBlobStore(blobs);
+        }
+        Recovery::replay(*db->store, *db->wal);
+
+        *out_db = db.release();
+        return SDB_OK;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+void sdb_close(sdb_db* db) {
+    if (db == nullptr) return;
+    try {
+        if (db->wal && db->wal->isEnabled()) {
+            db->wal->flush();
+        }
+    } catch (...) {
+        // Nothing useful to report from a destructor-like call
+    }
+    delete db;
+}
+
+sdb_status sdb_set(sdb_db* db, const char* key, size_t key_len,
+                   const char* value, size_t value_len) {
+    if (db == nullptr || !validKey(key, key_len) || value == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        return fromStatus(db->store->set(std::string(key, key_len), std::string(value, value_len)));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_set_durable(sdb_db* db, const char* key, size_t key_len,
+                           const char* value, size_t value_len,
+                           sdb_done_fn done, void* ctx) {
+    if (db == nullptr || !validKey(key, key_len) || value == nullptr || done == nullptr) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    try {
+        Status status = db->store->set(std::string(key, key_len), std::string(value, value_len));
+        if (status != Status::OK) return fromStatus(status);
+        // Our record's LSN is at most lastLsn(), so waiting for that is enough
+        db->wal->onDurable(db->wal->lastLsn(), [done, ctx](bool durable) {
+            done(ctx, durable ? SDB_OK : SDB_ERROR);
+        });
+        return SDB_OK;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_del(sdb_db* db, const char* key, size_t key_len) {
+    if (db == nullptr || !validKey(key, key_len)) return SDB_INVALID_ARGUMENT;
+    try {
+        return fromStatus(db->store->del(std::string(key, key_len)));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_del_prefix(sdb_db* db, const char* prefix, size_t prefix_len) {
+    if (db == nullptr || !validKey(prefix, prefix_len)) return SDB_INVALID_ARGUMENT;
+    try {
+        return fromStatus(db->store->delPrefix(std::string(prefix, prefix_len)));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_watch(sdb_db* db, const char* key, size_t key_len,
+                     sdb_watch_fn fn, void* ctx, uint64_t* out_id) {
+    if (db == nullptr || !validKey(key, key_len) || fn == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        uint64_t id = db->store->watchKey(std::string(key, key_len),
+            [fn, ctx](const KeyChange& change) {
+                fn(ctx, change.key.data(), change.key.size(), change.deleted ? 1 : 0,
+                   change.deleted ? nullptr : change.value.data(), change.value.size(),
+                   toEpochMs(change.timestamp));
+            });
+        if (out_id != nullptr) *out_id = id;
+        return SDB_OK;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_unwatch(sdb_db* db, uint64_t id) {
+    if (db == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        return db->store->unwatchKey(id) ? SDB_OK : SDB_NOT_FOUND;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_get(sdb_db* db, const char* key, size_t key_len,
+                   sdb_value_fn fn, void* ctx) {
+    if (db == nullptr || !validKey(key, key_len) || fn == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        // The latest version is the last one at or before time_point::max(),
+        // which also hands the caller its timestamp
+        bool found = db->store->visitAtTime(std::string(key, key_len),
+            std::chrono::system_clock::time_point::max(),
+            [fn, ctx](const Version& v) {
+                fn(ctx, v.value.data(), v.value.size(), toEpochMs(v.timestamp));
+            });
+        return found ? SDB_OK : SDB_NOT_FOUND;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_get_at(sdb_db* db, const char* key, size_t key_len,
+                      int64_t timestamp_ms, sdb_value_fn fn, void* ctx) {
+    if (db == nullptr || !validKey(key, key_len) || fn == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        auto ts = std::chrono::system_clock::time_point(std::chrono::milliseconds(timestamp_ms));
+        bool found = db->store->visitAtTime(std::string(key, key_len), ts,
+            [fn, ctx](const Version& v) {
+                fn(ctx, v.value.data(), v.value.size(), toEpochMs(v.timestamp));
+            });
+        return found ? SDB_OK : SDB_NOT_FOUND;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_history(sdb_db* db, const char* key, size_t key_len,
+                       sdb_value_fn fn, void* ctx, size_t* out_count) {
+    if (db == nullptr || !validKey(key, key_len) || fn == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        size_t count = db->store->visitHistory(std::string(key, key_len),
+            [fn, ctx](const Version& v) {
+                fn(ctx, v.value.data(), v.value.size(), toEpochMs(v.timestamp));
+            });
+        if (out_count != nullptr) *out_count = count;
+        return count > 0 ? SDB_OK : SDB_NOT_FOUND;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_snapshot(sdb_db* db) {
+    if (db == nullptr) return SDB_INVALID_ARGUMENT;
+    if (!db->wal || !db->wal->isEnabled()) return SDB_ERROR;
+    try {
+        // Large values stay in the blob logs; the snapshot refers to them
+        std::unordered_map<std::string, std::string> blobRefs;
+        uint64_t lsn = 0;
+        auto data = db->store->getAllData(&blobRefs, &lsn);
+        return fromStatus(db->wal->createSnapshot(data, policyName(db->store->getDecisionPolicy()),
+                                                  blobRefs, lsn));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+size_t sdb_size(sdb_db* db) {
+    if (db == nullptr) return 0;
+    return db->store->size();
+}
+
+sdb_status sdb_propose(sdb_db* db, const char* key, size_t key_len,
+                       const char* value, size_t value_len,
+                       sdb_guard_result* out_result,
+                       sdb_alternative_fn alt_fn, void* ctx) {
+    if (db == nullptr || !validKey(key, key_len) || value == nullptr || out_result == nullptr) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    try {
+        auto evaluation = db->store->proposeSet(std::string(key, key_len),
+                                                std::string(value, value_len));
+        switch (evaluation.result) {
+            case GuardResult::ACCEPT: *out_result = SDB_GUARD_ACCEPT; break;
+            case GuardResult::REJECT: *out_result = SDB_GUARD_REJECT; break;
+            case GuardResult::COUNTER_OFFER: *out_result = SDB_GUARD_COUNTER_OFFER; break;
+        }
+        if (alt_fn != nullptr) {
+            for (const auto& alt : evaluation.alternatives) {
+                alt_fn(ctx, alt.value.data(), alt.value.size(), alt.explanation.c_str());
+            }
+        }
+        return SDB_OK;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_guard_add_range_int(sdb_db* db, const char* name,
+                                   const char* key_pattern, int min, int max) {
+    if (db == nullptr || name == nullptr || key_pattern == nullptr || min > max) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    try {
+        return addGuard(db, std::make_shared<RangeIntGuard>(name, key_pattern, min, max),
+                        "RANGE_INT", std::to_string(min) + " " + std::to_string(max));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_guard_add_length(sdb_db* db, const char* name,
+                                const char* key_pattern, size_t min, size_t max) {
+    if (db == nullptr || name == nullptr || key_pattern == nullptr || min > max) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    try {
+        return addGuard(db, std::make_shared<LengthGuard>(name, key_pattern, min, max),
+                        "LENGTH", std::to_string(min) + " " + std::to_string(max));
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_guard_add_enum(sdb_db* db, const char* name, const char* key_pattern,
+                              const char* const* values, size_t value_count) {
+    if (db == nullptr || name == nullptr || key_pattern == nullptr ||
+        values == nullptr || value_count == 0) {
+        return SDB_INVALID_ARGUMENT;
+    }
+    try {
+        std::vector<std::string> allowed;
+        std::string params;
+        for (size_t i = 0; i < value_count; ++i) {
+            if (values[i] == nullptr) return SDB_INVALID_ARGUMENT;
+            allowed.emplace_back(values[i]);
+            if (i > 0) params += " ";
+            params += values[i];
+        }
+        return addGuard(db, std::make_shared<EnumGuard>(name, key_pattern, allowed),
+                        "ENUM", params);
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_guard_remove(sdb_db* db, const char* name) {
+    if (db == nullptr || name == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        return db->store->removeGuard(name) ? SDB_OK : SDB_NOT_FOUND;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_status sdb_set_policy(sdb_db* db, sdb_policy policy) {
+    if (db == nullptr) return SDB_INVALID_ARGUMENT;
+    try {
+        switch (policy) {
+            case SDB_POLICY_DEV_FRIENDLY: db->store->setDecisionPolicy(DecisionPolicy::DEV_FRIENDLY); break;
+            case SDB_POLICY_SAFE_DEFAULT: db->store->setDecisionPolicy(DecisionPolicy::SAFE_DEFAULT); break;
+            case SDB_POLICY_STRICT: db->store->setDecisionPolicy(DecisionPolicy::STRICT); break;
+            default: return SDB_INVALID_ARGUMENT;
+        }
+        return SDB_OK;
+    } catch (...) {
+        return SDB_ERROR;
+    }
+}
+
+sdb_policy sdb_get_policy(sdb_db* db) {
+    if (db == nullptr) return SDB_POLICY_SAFE_DEFAULT;
+    switch (db->store->getDecisionPolicy()) {
+        case DecisionPolicy::DEV_FRIENDLY: return SDB_POLICY_DEV_FRIENDLY;
+        case DecisionPolicy::SAFE_DEFAULT: return SDB_POLICY_SAFE_DEFAULT;
+        case DecisionPolicy::STRICT: return SDB_POLICY_STRICT;
+    }
+    return SDB_POLICY_SAFE_DEFAULT;
+}
+
+} // extern "C"
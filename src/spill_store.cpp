@@ -0,0 +1,429 @@
+#include "spill_store.h"
+#include "backup.h"
+#include "io_scheduler.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Top bit of value_len: the value is a blob reference (Version::blob)
+constexpr uint32_t kBlobFlag = 0x80000000u;
+
+template <typename T>
+void putRaw(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool getRaw(const std::string& in, size_t& pos, T& value) {
+    if (in.size() - pos < sizeof(value)) return false;
+    std::memcpy(&value, in.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+bool preadFull(int fd, char* buf, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buf + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeFull(int fd, const char* buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::write(fd, buf + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int64_t toNs(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+} // namespace
+
+SpillStore::SpillStore(const std::string& path) : path_(path) {}
+
+SpillStore::~SpillStore() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+Status SpillStore::initialize() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        spdlog::error("Spill file {} unavailable: {}", path_, std::strerror(errno));
+        return Status::ERROR;
+    }
+    return Status::OK;
+}
+
+void SpillStore::encode(const std::string& key, const std::vector<Version>& versions,
+                        std::string& out) {
+    size_t start = out.size();
+    putRaw<uint32_t>(out, 0);  // length, patched below
+    putRaw<uint32_t>(out, static_cast<uint32_t>(key.size()));
+    out.append(key);
+    putRaw<uint32_t>(out, static_cast<uint32_t>(versions.size()));
+    for (const auto& version : versions) {
+        putRaw<int64_t>(out, toNs(version.timestamp));
+        putRaw<uint32_t>(out, static_cast<uint32_t>(version.value.size()) |
+                                  (version.blob ? kBlobFlag : 0));
+        out.append(version.value);
+    }
+    uint32_t crc = BackupRestore::crc32(out.data() + start + 4, out.size() - start - 4);
+    putRaw<uint32_t>(out, crc);
+    uint32_t length = static_cast<uint32_t>(out.size() - start);
+    std::memcpy(&out[start], &length, sizeof(length));
+}
+
+Status SpillStore::put(const std::vector<std::pair<std::string, std::vector<Version>>>& batch) {
+    if (batch.empty()) {
+        return Status::OK;
+    }
+    std::string buf;
+    std::vector<Entry> entries;
+    entries.reserve(batch.size());
+    for (const auto& [key, versions] : batch) {
+        size_t start = buf.size();
+        encode(key, versions, buf);
+        int64_t newest = versions.empty() ? 0 : toNs(versions.back().timestamp);
+        entries.push_back(Entry{start, static_cast<uint32_t>(buf.size() - start), newest});
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) {
+        return Status::ERROR;
+    }
+    // O_APPEND: one write lands the whole batch at the current end
+    if (!writeFull(fd_, buf.data(), buf.size())) {
+        spdlog::error("Spill write to {} failed: {}", path_, std::strerror(errno));
+        // Don't index a partial batch; the garbage is dropped by compaction
+        fileBytes_ = static_cast<uint64_t>(::lseek(fd_, 0, SEEK_END));
+        return Status::ERROR;
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        entries[i].offset += fileBytes_;
+        auto it = index_.find(batch[i].first);
+        if (it != index_.end()) {
+            dropEntry(it);
+        }
+        index_.emplace(batch[i].first, entries[i]);
+        liveBytes_ += entries[i].length;
+    }
+    fileBytes_ += buf.size();
+    spilled_ += batch.size();
+    return Status::OK;
+}
+
+bool SpillStore::readRecord(const Entry& entry, std::string& key,
+                            std::vector<Version>& versions) const {
+    std::string buf(entry.length, '\0');
+    if (!preadFull(fd_, &buf[0], buf.size(), entry.offset)) {
+        return false;
+    }
+    size_t pos = 0;
+    uint32_t length, keyLen, count, crc;
+    if (!getRaw(buf, pos, length) || length != entry.length || length < 16) {
+        return false;
+    }
+    std::memcpy(&crc, buf.data() + length - 4, sizeof(crc));
+    if (BackupRestore::crc32(buf.data() + 4, length - 8) != crc) {
+        return false;
+    }
+    if (!getRaw(buf, pos, keyLen) || buf.size() - pos < keyLen) {
+        return false;
+    }
+    key.assign(buf, pos, keyLen);
+    pos += keyLen;
+    if (!getRaw(buf, pos, count)) {
+        return false;
+    }
+    versions.clear();
+    versions.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        int64_t ns;
+        uint32_t valueLen;
+        if (!getRaw(buf, pos, ns) || !getRaw(buf, pos, valueLen)) {
+            return false;
+        }
+        bool blob = (valueLen & kBlobFlag) != 0;
+        valueLen &= ~kBlobFlag;
+        if (buf.size() - pos < valueLen) {
+            return false;
+        }
+        versions.emplace_back(std::chrono::system_clock::time_point(
+                                  std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                                      std::chrono::nanoseconds(ns))),
+                              buf.substr(pos, valueLen));
+        versions.back().blob = blob;
+        pos += valueLen;
+    }
+    return true;
+}
+
+void SpillStore::dropEntry(std::unordered_map<std::string, Entry>::iterator it) {
+    liveBytes_ -= it->second.length;
+    index_.erase(it);
+}
+
+bool SpillStore::take(const std::string& key, std::vector<Version>& versions) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    std::string storedKey;
+    bool ok = readRecord(it->second, storedKey, versions) && storedKey == key;
+    if (!ok) {
+        spdlog::error("Spill record for key={} is corrupt; dropping it", key);
+        versions.clear();
+    } else {
+        ++reloaded_;
+    }
+    dropEntry(it);
+    return ok;
+}
+
+bool SpillStore::read(const std::string& key, std::vector<Version>& versions) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    std::string storedKey;
+    if (!readRecord(it->second, storedKey, versions) || storedKey != key) {
+        spdlog::error("Spill record for key={} is corrupt; skipping it", key);
+        versions.clear();
+        return false;
+    }
+    return true;
+}
+
+void SpillStore::keys(const std::string& prefix, std::vector<std::string>& keys) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [key, entry] : index_) {
+        if (key.compare(0, prefix.size(), prefix) == 0) {
+            keys.push_back(key);
+        }
+    }
+}
+
+bool SpillStore::contains(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.find(key) != index_.end();
+}
+
+bool SpillStore::remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    dropEntry(it);
+    return true;
+}
+
+size_t SpillStore::removePrefix(const std::string& prefix,
+                                std::chrono::system_clock::time_point through,
+                                std::vector<std::string>* survivors,
+                                std::vector<std::string>* removed) {
+    const int64_t throughNs = toNs(through);
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (auto it = index_.begin(); it != index_.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) {
+            ++it;
+        } else if (it->second.newestNs <= throughNs) {
+            if (removed) removed->push_back(it->first);
+            auto next = std::next(it);
+            dropEntry(it);
+            it = next;
+            ++count;
+        } else {
+            if (survivors) survivors->push_back(it->first);
+            ++it;
+        }
+    }
+    return count;
+}
+
+void SpillStore::forEach(
+        const std::function<void(const std::string&, const std::vector<Version>&)>& fn) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key;
+    std::vector<Version> versions;
+    for (const auto& [indexKey, entry] : index_) {
+        if (readRecord(entry, key, versions) && key == indexKey) {
+            fn(key, versions);
+        } else {
+            spdlog::error("Spill record for key={} is corrupt; skipping it", indexKey);
+        }
+    }
+}
+
+bool SpillStore::compactIfNeeded(uint64_t minDeadBytes) {
+    std::lock_guard<std::mutex> compactLock(compactMutex_);
+    // Records below copyEnd never change (the file is append-only), so
+    // they can be copied from a snapshot of the index without the lock
+    std::vector<std::pair<std::string, Entry>> live;
+    uint64_t copyEnd;
+    int in;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t dead = fileBytes_ - liveBytes_;
+        if (fd_ < 0 || dead < minDeadBytes || dead < liveBytes_) {
+            return false;
+        }
+        live.assign(index_.begin(), index_.end());
+        copyEnd = fileBytes_;
+        in = fd_;
+    }
+
+    const std::string tmpPath = path_ + ".tmp";
+    int out = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        spdlog::error("Spill compaction: cannot create {}: {}", tmpPath, std::strerror(errno));
+        return false;
+    }
+    auto fail = [&] {
+        spdlog::error("Spill compaction of {} failed: {}", path_, std::strerror(errno));
+        ::close(out);
+        ::unlink(tmpPath.c_str());
+        return false;
+    };
+
+    // Old offset -> new entry for every record copied
+    std::unordered_map<uint64_t, Entry> moved;
+    moved.reserve(live.size());
+    uint64_t offset = 0;
+    uint64_t flushed = 0;
+    std::string buf;
+    auto flush = [&] {
+        if (io_) {
+            io_->acquire(buf.size());
+        }
+        if (!writeFull(out, buf.data(), buf.size())) {
+            return false;
+        }
+        IoScheduler::startWriteback(out, flushed, buf.size());
+        flushed += buf.size();
+        buf.clear();
+        return true;
+    };
+    for (const auto& [key, entry] : live) {
+        size_t start = buf.size();
+        buf.resize(start + entry.length);
+        if (!preadFull(in, &buf[start], entry.length, entry.offset)) {
+            return fail();
+        }
+        moved.emplace(entry.offset, Entry{offset, entry.length, entry.newestNs});
+        offset += entry.length;
+        if (buf.size() >= IoScheduler::kMaxGrant && !flush()) {
+            return fail();
+        }
+    }
+    if (!buf.empty() && !flush()) {
+        return fail();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Keys taken or replaced during the copy are simply not in the index
+    // any more; records appended meanwhile are moved now
+    std::unordered_map<std::string, Entry> index;
+    index.reserve(index_.size());
+    for (const auto& [key, entry] : index_) {
+        auto it = entry.offset < copyEnd ? moved.find(entry.offset) : moved.end();
+        if (it != moved.end()) {
+            index.emplace(key, it->second);
+            continue;
+        }
+        buf.resize(entry.length);
+        if (!preadFull(fd_, &buf[0], buf.size(), entry.offset) ||
+            !writeFull(out, buf.data(), buf.size())) {
+            return fail();
+        }
+        index.emplace(key, Entry{offset, entry.length, entry.newestNs});
+        offset += entry.length;
+    }
+    ::close(out);
+    if (std::rename(tmpPath.c_str(), path_.c_str()) != 0) {
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    int fd = ::open(path_.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd < 0) {
+        // The renamed file holds exactly the index; without a descriptor the tier is off
+        spdlog::error("Spill file {} unavailable after compaction", path_);
+        ::close(fd_);
+        fd_ = -1;
+        index_.clear();
+        liveBytes_ = fileBytes_ = unpaidFrom_ = 0;
+        return false;
+    }
+    ::close(fd_);
+    fd_ = fd;
+    index_.swap(index);
+    spdlog::info("Spill compaction {} -> {} bytes", fileBytes_, offset);
+    fileBytes_ = liveBytes_ = unpaidFrom_ = offset;
+    return true;
+}
+
+void SpillStore::setIoScheduler(std::shared_ptr<IoScheduler> io) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    io_ = std::move(io);
+}
+
+void SpillStore::throttle() {
+    // Keeps compaction from swapping the descriptor under the writeback hint
+    std::lock_guard<std::mutex> compactLock(compactMutex_);
+    uint64_t from, to;
+    int fd;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        from = std::min(unpaidFrom_, fileBytes_);
+        to = fileBytes_;
+        unpaidFrom_ = to;
+        fd = fd_;
+    }
+    if (!io_ || to <= from) {
+        return;
+    }
+    io_->acquire(to - from);
+    IoScheduler::startWriteback(fd, from, to - from);
+}
+
+size_t SpillStore::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+SpillStore::Stats SpillStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats s;
+    s.keys = index_.size();
+    s.liveBytes = liveBytes_;
+    s.fileBytes = fileBytes_;
+    s.spilled = spilled_;
+    s.reloaded = reloaded_;
+    return s;
+}
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <unistd.h>
+#include "backup.h"
+#include "blob_store.h"
+#include "kvstore.h"
+#include "wal.h"
+#include "test_support.h"
+
+// What GET /backup streams: a backup point with the blob logs pinned,
+// written out chunk by chunk. Returns the archive's LSN, or 0 on failure.
+static uint64_t writeArchive(const Instance& db, const std::string& path, uint64_t bytesPerSecond = 0) {
+    WALBackupPoint point;
+    if (!db.wal->openBackupPoint(point)) return 0;
+    if (db.blobs) {
+        db.blobs->pinFiles(point.files);
+    }
+    BackupStream stream(point, 64 << 10, bytesPerSecond);
+    std::ofstream out(path, std::ios::binary);
+    std::string chunk;
+    bool more = true;
+    while (more) {
+        more = stream.next(chunk);
+        out << chunk;
+    }
+    return stream.ok() ? stream.lsn() : 0;
+}
+
+static std::string valueFor(int i) {
+    return "v" + std::to_string(i);
+}
+
+static std::string big(int i) {
+    return std::string(5000, static_cast<char>('a' + i % 26)) + std::to_string(i);
+}
+
+int main(int, char* argv[]) {
+    std::cout << "=== Backup Test ===\n\n";
+    const ScratchDir scratch("backup");
+    const std::string& dir = scratch.path();
+    // sentinel_restore is built next to this program
+    std::string restoreTool = argv[0];
+    restoreTool = restoreTool.substr(0, restoreTool.find_last_of('/') + 1) + "sentinel_restore";
+
+    BlobStore::Options options;
+    options.threshold = 1024;
+    options.fileBytes = 64 << 10;
+
+    std::cout << "--- Point in time ---\n";
+    uint64_t lsn = 0;
+    {
+        Instance db(dir + "/src", &options);
+        for (int i = 0; i < 200; ++i) {
+            db.store->set("k" + std::to_string(i), valueFor(i));
+        }
+        for (int i = 0; i < 20; ++i) {
+            db.store->set("big" + std::to_string(i), big(i));
+        }
+        std::unordered_map<std::string, std::string> refs;
+        uint64_t snapshotLsn = 0;
+        auto data = db.store->getAllData(&refs, &snapshotLsn);
+        db.wal->createSnapshot(data, "", refs, snapshotLsn);
+        // The WAL tail past the snapshot
+        for (int i = 200; i < 300; ++i) {
+            db.store->set("k" + std::to_string(i), valueFor(i));
+        }
+        db.store->set("big3", big(33));
+        db.store->del("k5");
+        db.wal->flush();
+
+        lsn = writeArchive(db, dir + "/full.backup");
+        // Past the backup point
+        db.store->set("k0", "after");
+        db.store->set("later", "after");
+        check(lsn == db.wal->lastLsn() - 2, "the archive is cut at the LSN it was opened at");
+
+        std::string command = restoreTool + " " + dir + "/full.backup " + dir + "/restored --threads 4 > /dev/null";
+        check(std::system(command.c_str()) == 0, "sentinel_restore restores the archive");
+        Instance restored(dir + "/restored", &options);
+        bool same = restored.store->size() == 319 && !restored.store->get("k5").has_value();
+        for (int i = 200; same && i < 300; ++i) {
+            const std::string key = "k" + std::to_string(i);
+            same = sameHistoryMs(restored.store->getHistory(key), db.store->getHistory(key));
+        }
+        check(same, "restored state matches the source at the archive's LSN");
+        check(restored.store->get("k0") == std::optional<std::string>(valueFor(0)) &&
+              !restored.store->get("later").has_value(), "writes after the backup point are not in it");
+        bool blobs = restored.store->get("big3") == std::optional<std::string>(big(33));
+        for (int i = 0; blobs && i < 20; ++i) {
+            if (i == 3) continue;
+            blobs = restored.store->get("big" + std::to_string(i)) == std::optional<std::string>(big(i));
+        }
+        check(blobs, "blob values come back from the pinned blob logs");
+        check(restored.wal->lastLsn() == lsn, "numbering continues from the archive's LSN");
+    }
+
+    std::cout << "\n--- Verification ---\n";
+    {
+        std::string archive;
+        {
+            std::ifstream in(dir + "/full.backup", std::ios::binary);
+            archive.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        std::string damaged = archive;
+        damaged[damaged.find("\ndata\n") + 100] ^= 0x20;
+        std::ofstream(dir + "/damaged.backup", std::ios::binary) << damaged;
+        std::string error;
+        check(!BackupRestore::restore(dir + "/damaged.backup", dir + "/fresh", 2, false, error) &&
+              !fileExists(dir + "/fresh/wal.log"), "a damaged chunk fails the restore before anything is written");
+        std::ofstream(dir + "/truncated.backup", std::ios::binary) << archive.substr(0, archive.size() - 10);
+        check(!BackupRestore::restore(dir + "/truncated.backup", dir + "/fresh", 2, false, error),
+              "so does an archive without its trailer");
+
+        check(!BackupRestore::restore(dir + "/full.backup", dir + "/restored", 2, false, error),
+              "an existing data directory is not overwritten");
+        uint64_t restoredLsn = 0;
+        check(BackupRestore::restore(dir + "/full.backup", dir + "/restored", 2, true, error, &restoredLsn) &&
+              restoredLsn == lsn, "unless forced");
+    }
+
+    std::cout << "\n--- Rate limit ---\n";
+    {
+        Instance db(dir + "/restored", &options);
+        uint64_t bytes = 0;
+        {
+            WALBackupPoint point;
+            db.wal->openBackupPoint(point);
+            db.blobs->pinFiles(point.files);
+            BackupStream stream(point, 64 << 10, 0);
+            bytes = stream.totalBytes();
+        }
+        auto start = std::chrono::steady_clock::now();
+        check(writeArchive(db, dir + "/paced.backup", bytes * 2) == lsn, "a paced archive completes");
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        check(seconds >= 0.3, "at about the requested rate (" + std::to_string(seconds) + "s for 0.5s)");
+    }
+
+    return finish();
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "compression.h"
+#include "test_support.h"
+
+#ifdef SENTINEL_HAVE_ZLIB
+#include <zlib.h>
+
+// What a client does with the body: inflate it according to its coding.
+// False if the stream is malformed or ends early.
+static bool inflateBody(ContentCoding coding, const std::string& body, std::string& out,
+                        bool complete = true) {
+    z_stream zs{};
+    if (inflateInit2(&zs, coding == ContentCoding::GZIP ? 15 + 16 : 15) != Z_OK) return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    zs.avail_in = static_cast<uInt>(body.size());
+    char buf[16384];
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_SYNC_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK && (zs.avail_in > 0 || zs.avail_out == 0));
+    inflateEnd(&zs);
+    return complete ? ret == Z_STREAM_END : (ret == Z_OK || ret == Z_BUF_ERROR);
+}
+
+// A /history-like JSON document of n versions
+static std::string historyJson(int n) {
+    std::string json = "{\"key\":\"price\",\"versions\":[";
+    for (int i = 0; i < n; ++i) {
+        json += (i ? "," : "") + std::string("{\"timestamp\":\"2026-01-01T00:00:") +
+                std::to_string(10 + i % 50) + ".000Z\",\"value\":\"" + std::to_string(i * 7) + "\"}";
+    }
+    return json + "]}";
+}
+#endif
+
+int main() {
+    std::cout << "=== Response Compression Test ===\n\n";
+
+    std::cout << "--- Accept-Encoding ---\n";
+    {
+        using RC = ResponseCompression;
+        check(RC::parseAcceptEncoding("gzip, deflate, br") == ContentCoding::GZIP, "gzip is preferred");
+        check(RC::parseAcceptEncoding("deflate") == ContentCoding::DEFLATE, "deflate alone is used");
+        check(RC::parseAcceptEncoding("gzip;q=0.5, deflate") == ContentCoding::DEFLATE &&
+              RC::parseAcceptEncoding("GZip;q=0.8, deflate;q=0.2") == ContentCoding::GZIP,
+              "the higher q wins, names ignore case");
+        check(RC::parseAcceptEncoding("*") == ContentCoding::GZIP &&
+              RC::parseAcceptEncoding("gzip;q=0, *") == ContentCoding::IDENTITY,
+              "* allows gzip unless gzip is refused");
+        check(RC::parseAcceptEncoding("identity") == ContentCoding::IDENTITY &&
+              RC::parseAcceptEncoding("br") == ContentCoding::IDENTITY, "unsupported codings fall back to identity");
+
+        ResponseCompression compression(1024, 6, 2);
+        const std::string json = "application/json";
+        check(compression.negotiate("gzip", 100, json) == ContentCoding::IDENTITY,
+              "bodies under the minimum size are sent as they are");
+        check(compression.negotiate("gzip", 4096, "application/octet-stream") == ContentCoding::IDENTITY &&
+              compression.negotiate("", 4096, json) == ContentCoding::IDENTITY,
+              "so are binary types and requests without Accept-Encoding");
+        check(compression.negotiate("deflate", 4096, "application/x-ndjson") ==
+                  (ResponseCompression::available() ? ContentCoding::DEFLATE : ContentCoding::IDENTITY),
+              "streams of JSON lines are compressed when zlib is built in");
+    }
+
+#ifdef SENTINEL_HAVE_ZLIB
+    std::cout << "\n--- Round trip ---\n";
+    {
+        ResponseCompression compression(1024, 6, 2);
+        const std::string original = historyJson(2000);
+        for (ContentCoding coding : {ContentCoding::GZIP, ContentCoding::DEFLATE}) {
+            const std::string name = ResponseCompression::codingName(coding);
+            std::string body = original;
+            std::string inflated;
+            check(compression.compressBody(coding, body) && body.size() < original.size() / 4 &&
+                  inflateBody(coding, body, inflated) && inflated == original,
+                  name + " bodies inflate back to the original");
+        }
+
+        // Chunked responses: each flushed chunk can be decoded on arrival
+        StreamCompressor stream(ContentCoding::GZIP, 6);
+        std::string sent;
+        bool eachChunk = stream.ok();
+        std::string expected;
+        for (int i = 0; eachChunk && i < 20; ++i) {
+            const std::string chunk = historyJson(50 + i);
+            expected += chunk;
+            size_t before = sent.size();
+            eachChunk = stream.write(chunk, sent) && stream.flush(sent) && sent.size() > before;
+            std::string sofar;
+            eachChunk = eachChunk && inflateBody(ContentCoding::GZIP, sent, sofar, false) && sofar == expected;
+        }
+        std::string inflated;
+        check(eachChunk, "every flushed chunk decodes to everything sent so far");
+        check(stream.finish("", sent) && inflateBody(ContentCoding::GZIP, sent, inflated) &&
+              inflated == expected, "and the finished stream is one complete gzip body");
+    }
+
+    std::cout << "\n--- Budget ---\n";
+    {
+        ResponseCompression compression(1024, 6, 1);
+        const std::string original = historyJson(200);
+        check(compression.budget().tryAcquire(), "a slot is taken");
+        std::string body = original;
+        check(!compression.compressBody(ContentCoding::GZIP, body) && body == original,
+              "with every slot busy the body goes out uncompressed, untouched");
+        compression.budget().release();
+        check(compression.compressBody(ContentCoding::GZIP, body) && body != original,
+              "and is compressed once a slot is free");
+    }
+#else
+    std::cout << "\n(built without zlib: round trips skipped)\n";
+#endif
+
+    return finish();
+}
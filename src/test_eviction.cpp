@@ -0,0 +1,93 @@
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include "kvstore.h"
+#include "recovery.h"
+#include "wal.h"
+#include "test_support.h"
+
+static std::string key(int i) {
+    return "k" + std::to_string(i);
+}
+
+// Whether keys [from, to) are all present (or all absent)
+static bool present(KVStore& store, int from, int to, bool expected = true) {
+    for (int i = from; i < to; ++i) {
+        if (store.exists(key(i)) != expected) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== Eviction Test ===\n\n";
+    const ScratchDir scratch("eviction");
+    const std::string& dir = scratch.path();
+
+    std::cout << "--- Watermarks ---\n";
+    {
+        KVStore store;
+        store.setEvictionWatermarks(1000, 800);
+        for (int i = 0; i <= 1000; ++i) {
+            store.set(key(i), "v");
+        }
+        check(waitFor([&] { return store.size() <= 800; }) && store.size() == 800,
+              "crossing the high watermark evicts down to the low one");
+        check(present(store, 0, 201, false) && present(store, 201, 1001),
+              "the least recently written keys go first");
+        auto stats = store.evictionStats();
+        check(stats.evictedKeys == 201 && stats.passes >= 1 && stats.inlineEvictions == 0,
+              "in a background pass, counted");
+
+        // A rewrite moves a key to the back of the line
+        store.set(key(201), "again");
+        for (int i = 1001; i <= 1201; ++i) {
+            store.set(key(i), "v");
+        }
+        check(waitFor([&] { return store.size() <= 800; }) && store.exists(key(201)) &&
+              !store.exists(key(202)), "rewritten keys are kept over older ones");
+    }
+
+    std::cout << "\n--- Writers outrunning the background pass ---\n";
+    {
+        KVStore store;
+        store.setEvictionWatermarks(100, 90);
+        size_t largest = 0;
+        for (int i = 0; i < 10000; ++i) {
+            store.set(key(i), "v");
+            largest = std::max(largest, store.size());
+        }
+        check(largest <= 110, "the store never exceeds high + (high - low) keys");
+        const bool settled = waitFor([&] { return store.size() <= 100; });
+        const int kept = static_cast<int>(store.size());
+        check(settled && present(store, 10000 - kept, 10000),
+              "and settles under the high watermark with the newest keys");
+        auto stats = store.evictionStats();
+        check(stats.evictedKeys == 10000 - store.size(), "every eviction is counted once");
+    }
+
+    std::cout << "\n--- Replay ---\n";
+    {
+        {
+            Instance db(dir);
+            for (int i = 0; i < 500; ++i) {
+                db.store->set(key(i), "v" + std::to_string(i));
+            }
+            db.wal->flush();
+        }
+        // A restart under a key limit, set before replay as the server does
+        auto wal = std::make_shared<WAL>(dir + "/wal.log");
+        wal->initialize();
+        KVStore store(wal);
+        store.setEvictionWatermarks(100, 80);
+        Recovery::replay(store, *wal);
+        check(waitFor([&] { return store.size() <= 100; }) && present(store, 420, 500),
+              "replay into a limited store keeps the most recently written keys");
+        check(store.get(key(499)) == std::optional<std::string>("v499") && !store.exists(key(0)),
+              "with their values");
+    }
+
+    return finish();
+}
@@ -0,0 +1,256 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include "history_export.h"
+#include "io_scheduler.h"
+#include "kvstore.h"
+#include "spill_store.h"
+#include "test_support.h"
+
+using Clock = std::chrono::system_clock;
+
+static Clock::time_point at(int seconds) {
+    return Clock::time_point(std::chrono::seconds(1700000000 + seconds));
+}
+
+int main() {
+    std::cout << "=== History Export Test ===\n\n";
+    const ScratchDir scratch("export");
+    const std::string& dir = scratch.path();
+
+    // user:0..199 with 1 + i % 5 versions each, one second apart; item:0..49
+    KVStore store;
+    store.setMaxKeys(1000000);
+    uint64_t userRows = 0;
+    for (int i = 0; i < 200; ++i) {
+        for (int v = 0; v <= i % 5; ++v) {
+            store.setAtTime("user:" + std::to_string(i), "u" + std::to_string(i) + "." + std::to_string(v),
+                            at(v * 10 + i % 7));
+            ++userRows;
+        }
+    }
+    for (int i = 0; i < 50; ++i) {
+        store.setAtTime("item:" + std::to_string(i), std::string(i * 3, 'x'), at(i));
+    }
+
+    std::cout << "--- Round trip ---\n";
+    {
+        HistoryExport::Options options;
+        options.rowsPerGroup = 64;
+        HistoryExport::Progress progress;
+        std::string error;
+        check(HistoryExport::write(store, dir + "/all.sdbcol", options, progress, error),
+              "export succeeds" + (error.empty() ? std::string() : ": " + error));
+        HistoryFile file;
+        check(file.open(dir + "/all.sdbcol", error), "export opens");
+        check(file.keys() == 250 && file.rows() == userRows + 50, "footer counts keys and rows");
+        check(progress.keys.load() == 250 && progress.rows.load() == userRows + 50 &&
+              progress.rowGroups.load() == file.groups().size(), "progress matches the file");
+        check(file.groups().size() > 4, "rows are split into row groups");
+        check(file.verify(error), "every column chunk passes its checksum");
+
+        bool sorted = true;
+        for (size_t g = 1; g < file.groups().size(); ++g) {
+            sorted = sorted && file.groups()[g - 1].lastKey < file.groups()[g].firstKey;
+        }
+        check(sorted, "groups cover disjoint, ascending key ranges");
+
+        bool all = true;
+        for (int i = 0; i < 200; ++i) {
+            const std::string key = "user:" + std::to_string(i);
+            std::vector<Version> versions;
+            all = all && file.history(key, versions) && sameHistory(versions, store.getHistory(key));
+        }
+        for (int i = 0; i < 50; ++i) {
+            const std::string key = "item:" + std::to_string(i);
+            std::vector<Version> versions;
+            all = all && file.history(key, versions) && sameHistory(versions, store.getHistory(key));
+        }
+        check(all, "every key's history reads back exactly");
+        std::vector<Version> versions;
+        check(!file.history("user:999", versions) && !file.history("a", versions) &&
+              !file.history("zzz", versions), "absent keys are not found");
+
+        uint64_t rows = 0;
+        std::string previous;
+        bool ordered = true;
+        for (size_t g = 0; g < file.groups().size(); ++g) {
+            file.forEachRow(g, [&](const std::string& key, const Version&) {
+                ordered = ordered && previous <= key;
+                previous = key;
+                ++rows;
+            });
+        }
+        check(rows == file.rows() && ordered, "scanning the groups yields every row in key order");
+
+        HistoryFile::Position position;
+        check(file.find("user:42", position) && position.rows == 3 &&
+              file.groups()[position.group].firstKey <= "user:42" &&
+              file.groups()[position.group].lastKey >= "user:42", "find locates a key's group and rows");
+        std::vector<std::string> scanned;
+        file.scan("user:1", [&](const std::string& key, const std::vector<Version>& history) {
+            if (key.compare(0, 6, "user:1") != 0) return false;
+            all = all && sameHistory(history, store.getHistory(key));
+            scanned.push_back(key);
+            return true;
+        });
+        // user:1, user:10..19, user:100..199
+        check(scanned.size() == 111 && scanned.front() == "user:1" && all,
+              "scan from a prefix visits its keys in order, across groups");
+        size_t visited = 0;
+        file.scan("user:5", [&](const std::string&, const std::vector<Version>&) { return ++visited < 3; });
+        check(visited == 3, "scan stops when asked");
+    }
+
+    std::cout << "\n--- Cuts ---\n";
+    {
+        HistoryExport::Options options;
+        options.prefix = "user:";
+        options.from = at(10);
+        options.through = at(29);
+        HistoryExport::Progress progress;
+        std::string error;
+        HistoryExport::write(store, dir + "/range.sdbcol", options, progress, error);
+        HistoryFile file;
+        check(file.open(dir + "/range.sdbcol", error) && file.prefix() == "user:" &&
+              file.from() == at(10) && file.through() == at(29), "footer records the cut");
+        std::vector<Version> versions;
+        check(!file.history("item:1", versions), "keys outside the prefix are left out");
+        bool inRange = true;
+        for (size_t g = 0; g < file.groups().size(); ++g) {
+            file.forEachRow(g, [&](const std::string&, const Version& version) {
+                inRange = inRange && version.timestamp >= at(10) && version.timestamp <= at(29);
+            });
+        }
+        check(inRange, "only versions inside [from, through] are exported");
+        check(file.history("user:4", versions) && versions.size() == 2 &&
+              versions[0].value == "u4.1" && versions[1].value == "u4.2", "a key's versions in the range");
+        check(!file.history("user:0", versions), "keys with no versions in the range are left out");
+    }
+    {
+        // AS OF: everything up to a point, not what was written after it
+        const auto cut = Clock::now();
+        store.set("user:1", "after the cut");
+        store.set("late", "after the cut");
+        HistoryExport::Options options;
+        options.through = cut;
+        HistoryExport::Progress progress;
+        std::string error;
+        HistoryExport::write(store, dir + "/asof.sdbcol", options, progress, error);
+        HistoryFile file;
+        file.open(dir + "/asof.sdbcol", error);
+        std::vector<Version> versions;
+        check(file.history("user:1", versions) && versions.back().value == "u1.1" &&
+              !file.history("late", versions), "writes after `through` are excluded");
+
+        store.del("user:2");
+        HistoryExport::write(store, dir + "/deleted.sdbcol", options, progress, error);
+        HistoryFile after;
+        after.open(dir + "/deleted.sdbcol", error);
+        check(!after.history("user:2", versions), "deleted keys are not exported");
+    }
+
+    std::cout << "\n--- Spilled keys ---\n";
+    {
+        KVStore small;
+        auto spill = std::make_shared<SpillStore>(dir + "/spill.dat");
+        spill->initialize();
+        small.setSpillStore(spill);
+        small.setEvictionWatermarks(20, 10);
+        for (int i = 0; i < 100; ++i) {
+            small.setAtTime("k" + std::to_string(i), "a" + std::to_string(i), at(i));
+            small.setAtTime("k" + std::to_string(i), "b" + std::to_string(i), at(i + 1));
+        }
+        const size_t resident = small.residentKeys();
+        HistoryExport::Options options;
+        HistoryExport::Progress progress;
+        std::string error;
+        HistoryExport::write(small, dir + "/spilled.sdbcol", options, progress, error);
+        HistoryFile file;
+        file.open(dir + "/spilled.sdbcol", error);
+        check(resident < 100 && file.keys() == 100 && file.rows() == 200, "spilled keys are exported");
+        check(small.residentKeys() <= resident, "export doesn't reload spilled keys");
+        std::vector<Version> versions;
+        check(file.history("k3", versions) && versions.size() == 2 && versions[1].value == "b3",
+              "spilled histories read back");
+    }
+
+    std::cout << "\n--- Pacing ---\n";
+    {
+        IoScheduler::Options io;
+        io.maxBytesPerSecond = 1u << 20;
+        io.adaptive = false;
+        KVStore big;
+        big.setMaxKeys(1000000);
+        for (int i = 0; i < 500; ++i) {
+            big.set("b" + std::to_string(i), std::string(1000, 'v'));
+        }
+        HistoryExport::Options options;
+        options.io = std::make_shared<IoScheduler>(io);
+        HistoryExport::Progress progress;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        HistoryExport::write(big, dir + "/paced.sdbcol", options, progress, error);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        check(elapsed > 0.3 && options.io->stats().bytes == progress.bytes.load(),
+              "writes go through the I/O scheduler");
+    }
+
+    std::cout << "\n--- Damage ---\n";
+    {
+        HistoryFile file;
+        std::string error;
+        file.open(dir + "/all.sdbcol", error);
+        const auto chunk = file.groups()[2].chunks[3];
+        {
+            std::fstream f(dir + "/all.sdbcol", std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(static_cast<std::streamoff>(chunk.offset + chunk.bytes - 1));
+            f.put('#');
+        }
+        check(!file.verify(error) && error.find("row group 2") != std::string::npos,
+              "a damaged chunk fails verification");
+
+        std::ofstream(dir + "/short.sdbcol") << "SDBCOL01";
+        HistoryFile truncated;
+        check(!truncated.open(dir + "/short.sdbcol", error), "a truncated file is rejected");
+    }
+
+    std::cout << "\n--- Background job ---\n";
+    {
+        auto shared = std::make_shared<KVStore>();
+        shared->setMaxKeys(1000000);
+        for (int i = 0; i < 1000; ++i) {
+            shared->set("j" + std::to_string(i), std::string(200, 'v'));
+        }
+        IoScheduler::Options io;
+        io.maxBytesPerSecond = 64u << 10;
+        io.adaptive = false;
+        HistoryExportJob job(shared);
+        check(job.status().state == HistoryExportJob::State::IDLE, "job starts idle");
+        HistoryExport::Options options;
+        options.io = std::make_shared<IoScheduler>(io);
+        check(job.start(dir + "/job.sdbcol", options), "job starts");
+        check(!job.start(dir + "/job2.sdbcol", options), "a second export waits for the first");
+        check(shared->set("j1", "during") == Status::OK, "writes carry on during the export");
+        while (job.status().state == HistoryExportJob::State::RUNNING) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        auto status = job.status();
+        check(status.state == HistoryExportJob::State::DONE && status.keys == 1000 &&
+              status.rows == 1000, "job completes");
+        HistoryFile file;
+        std::string error;
+        std::vector<Version> versions;
+        check(file.open(dir + "/job.sdbcol", error) && file.history("j1", versions) &&
+              versions.size() == 1 && versions[0].value == std::string(200, 'v'),
+              "the export is the cut taken when it started");
+        check(job.start(dir + "/job.sdbcol", HistoryExport::Options{}), "another export can follow");
+    }
+
+    return finish();
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <unistd.h>
+#include "guard.h"
+#include "ingest.h"
+#include "kvstore.h"
+#include "recovery.h"
+#include "wal.h"
+#include "test_support.h"
+
+// "key=value" lines; the server parses JSON, which isn't what is tested here
+static bool parseLine(const std::string& line, BatchWrite& write, std::string& error) {
+    const size_t eq = line.find('=');
+    if (eq == std::string::npos || eq == 0) {
+        error = "Missing 'key' or 'value'";
+        return false;
+    }
+    write.key = line.substr(0, eq);
+    write.value = line.substr(eq + 1);
+    return true;
+}
+
+// Feed body in pieces of 1, 2, ... maxPiece bytes, over and over
+static void feedInPieces(IngestStream& stream, const std::string& body, size_t maxPiece) {
+    size_t piece = 1;
+    for (size_t pos = 0; pos < body.size(); pos += piece, piece = piece % maxPiece + 1) {
+        stream.feed(body.data() + pos, std::min(piece, body.size() - pos));
+    }
+}
+
+int main() {
+    std::cout << "=== Ingest Test ===\n\n";
+    const ScratchDir scratch("ingest");
+    const std::string& dir = scratch.path();
+
+    std::cout << "--- Batches ---\n";
+    {
+        auto store = std::make_shared<KVStore>();
+        store->setMaxKeys(1000000);
+        std::string body;
+        for (int i = 0; i < 5000; ++i) {
+            body += "k" + std::to_string(i % 1000) + "=v" + std::to_string(i) + "\n";
+        }
+        IngestStream::Options options;
+        options.batchRecords = 128;
+        IngestStream stream(store, parseLine, options);
+        feedInPieces(stream, body, 97);
+        auto result = stream.finish();
+        check(result.records == 5000 && result.applied == 5000 && result.failed == 0,
+              "every record is applied whatever the pieces");
+        check(result.batches == (5000 + 127) / 128, "in batches of the requested size");
+        check(store->getHistory("k7").size() == 5 && store->get("k7") == std::optional<std::string>("v4007"),
+              "records are applied in order");
+
+        // A batch closes early once its values reach batchBytes
+        IngestStream::Options small;
+        small.batchBytes = 1000;
+        IngestStream sized(store, parseLine, small);
+        std::string big;
+        for (int i = 0; i < 10; ++i) {
+            big += "big" + std::to_string(i) + "=" + std::string(400, 'x') + "\n";
+        }
+        sized.feed(big.data(), big.size());
+        check(sized.finish().batches == 4, "batches are bounded in bytes too");
+    }
+
+    std::cout << "\n--- Errors ---\n";
+    {
+        auto store = std::make_shared<KVStore>();
+        store->setMaxKeys(1000000);
+        store->addGuard(std::make_shared<RangeIntGuard>("age", "age*", 0, 150));
+        IngestStream::Options options;
+        options.batchRecords = 2;
+        options.maxLineBytes = 64;
+        IngestStream stream(store, parseLine, options);
+        const std::string body =
+            "a=1\n"
+            "\n"                                      // blank: skipped
+            "no value here\n"                         // line 3
+            "b=2\r\n"
+            "age:1=42\n"
+            "age:2=400\n"                             // line 6: refused by the guard
+            "c=" + std::string(100, 'c') + "\n" +     // line 7: too long
+            "d=4\n"
+            "e=5";                                    // no final newline
+        feedInPieces(stream, body, 7);
+        auto result = stream.finish();
+        check(result.records == 8 && result.applied == 5 && result.failed == 3,
+              "bad lines fail without stopping the stream");
+        check(result.errors.size() == 3 && result.errors[0].line == 3 && result.errors[1].line == 6 &&
+              result.errors[1].key == "age:2" && result.errors[2].line == 7 &&
+              result.errors[2].message == "Line too long", "each failure reports its line");
+        check(store->get("b") == std::optional<std::string>("2") && store->get("age:1") &&
+              !store->get("age:2") && store->get("d") && store->get("e") == std::optional<std::string>("5"),
+              "the good lines around them are written");
+
+        IngestStream::Options capped;
+        capped.maxErrors = 10;
+        IngestStream many(store, parseLine, capped);
+        std::string junk;
+        for (int i = 0; i < 100; ++i) {
+            junk += "junk\n";
+        }
+        many.feed(junk.data(), junk.size());
+        auto manyResult = many.finish();
+        check(manyResult.failed == 100 && manyResult.errors.size() == 10 && manyResult.errors[9].line == 10,
+              "only maxErrors errors are kept");
+    }
+
+    std::cout << "\n--- WAL ---\n";
+    {
+        auto wal = std::make_shared<WAL>(dir + "/wal.log");
+        wal->initialize();
+        auto store = std::make_shared<KVStore>(wal);
+        store->setMaxKeys(1000000);
+        std::vector<uint64_t> hooked;
+        wal->setRecordHook([&hooked](uint64_t lsn, const std::string&) { hooked.push_back(lsn); });
+        const uint64_t before = wal->lastLsn();
+        IngestStream::Options options;
+        options.batchRecords = 100;
+        IngestStream stream(store, parseLine, options);
+        std::string body;
+        for (int i = 0; i < 1000; ++i) {
+            body += "w" + std::to_string(i) + "=" + std::to_string(i * i) + "\n";
+        }
+        stream.feed(body.data(), body.size());
+        auto result = stream.finish();
+        bool inOrder = hooked.size() == 1000;
+        for (size_t i = 0; inOrder && i < hooked.size(); ++i) {
+            inOrder = hooked[i] == before + i + 1;
+        }
+        check(result.applied == 1000 && wal->lastLsn() == before + 1000 && inOrder,
+              "each record takes its own LSN, in order");
+        check(wal->waitDurable(wal->lastLsn(), std::chrono::seconds(5)), "and becomes durable");
+
+        KVStore replayed;
+        replayed.setMaxKeys(1000000);
+        WAL log(dir + "/wal.log");
+        log.initialize();
+        Recovery::replay(replayed, log);
+        check(replayed.size() == 1000 && replayed.get("w999") == std::optional<std::string>("998001"),
+              "batched records replay like single ones");
+    }
+
+    std::cout << "\n--- Write failures ---\n";
+    if (fileExists("/dev/full")) {
+        // Every write to /dev/full fails with ENOSPC
+        auto wal = std::make_shared<WAL>("/dev/full");
+        wal->initialize();
+        size_t hooked = 0;
+        wal->setRecordHook([&hooked](uint64_t, const std::string&) { ++hooked; });
+        check(wal->logDel("k") != Status::OK && wal->lastLsn() == 0 && hooked == 0,
+              "a record the log can't take gets no LSN and isn't shipped");
+        check(wal->syncFailed() && !wal->waitDurable(1, std::chrono::seconds(1)),
+              "and nothing is acknowledged as durable after it");
+        WAL batchWal("/dev/full");
+        batchWal.initialize();
+        batchWal.setRecordHook([&hooked](uint64_t, const std::string&) { ++hooked; });
+        check(batchWal.logRecords({"DEL a", "DEL b"}) != Status::OK && batchWal.lastLsn() == 0 &&
+              hooked == 0,
+              "a batch neither");
+    }
+
+    return finish();
+}
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "invalidation.h"
+#include "test_support.h"
+
+using std::chrono::milliseconds;
+
+// Whatever the client has queued, without waiting
+static InvalidationTracker::Batch drain(InvalidationTracker& tracker, const std::string& client) {
+    InvalidationTracker::Batch batch;
+    tracker.poll(client, milliseconds(0), batch);
+    return batch;
+}
+
+static bool told(const InvalidationTracker::Batch& batch, const std::vector<std::string>& keys) {
+    return !batch.flush && batch.keys == keys;
+}
+
+static bool quiet(const InvalidationTracker::Batch& batch) {
+    return !batch.flush && batch.keys.empty();
+}
+
+int main() {
+    std::cout << "=== Invalidation Tracking Test ===\n\n";
+
+    std::cout << "--- Keys sharing a slot ---\n";
+    {
+        InvalidationTracker::Options options;
+        options.slots = 1;  // every key collides
+        InvalidationTracker tracker(options);
+        tracker.trackRead("c1", "a");
+        tracker.trackRead("c2", "b");
+        tracker.trackRead("c2", "a");
+        check(tracker.stats().entries == 3, "each client and key is one entry");
+
+        tracker.keyChanged("b");
+        check(told(drain(tracker, "c2"), {"b"}), "the reader of the written key is told");
+        check(quiet(drain(tracker, "c1")), "a client that read another key in the slot is not");
+        tracker.keyChanged("a");
+        check(told(drain(tracker, "c1"), {"a"}) && told(drain(tracker, "c2"), {"a"}),
+              "and is still told when its own key changes");
+        tracker.keyChanged("a");
+        check(quiet(drain(tracker, "c1")) && tracker.stats().entries == 0,
+              "once, until it reads the key again");
+        tracker.trackRead("c1", "a");
+        tracker.trackRead("c1", "a");
+        check(tracker.stats().entries == 1, "reading a key again doesn't add an entry");
+    }
+
+    std::cout << "\n--- Bounds ---\n";
+    {
+        InvalidationTracker::Options options;
+        options.slots = 1;
+        options.maxEntries = 2;
+        InvalidationTracker tracker(options);
+        tracker.trackRead("c1", "x");
+        tracker.trackRead("c1", "y");
+        drain(tracker, "c1");
+        tracker.trackRead("c1", "z");
+        auto batch = drain(tracker, "c1");
+        check(batch.flush && tracker.stats().entries == 0,
+              "past maxEntries a slot is dropped and its clients flushed");
+
+        InvalidationTracker::Options small;
+        small.maxQueued = 2;
+        InvalidationTracker queued(small);
+        for (const char* key : {"k1", "k2", "k3"}) {
+            queued.trackRead("c1", key);
+        }
+        drain(queued, "c1");
+        for (const char* key : {"k1", "k2", "k3"}) {
+            queued.keyChanged(key);
+        }
+        check(drain(queued, "c1").flush, "an overflowing queue becomes a flush");
+
+        InvalidationTracker::Batch first;
+        check(queued.poll("new", milliseconds(0), first) && first.flush,
+              "an unknown client starts with a flush");
+    }
+
+    std::cout << "\n--- Prefixes ---\n";
+    {
+        InvalidationTracker tracker(InvalidationTracker::Options{});
+        tracker.subscribePrefixes("b1", {"user:"});
+        tracker.trackRead("c1", "user:1");
+        drain(tracker, "b1");
+        drain(tracker, "c1");
+        tracker.keyChanged("user:7");
+        tracker.keyChanged("order:1");
+        check(told(drain(tracker, "b1"), {"user:7"}), "broadcast clients hear writes under their prefix");
+        check(quiet(drain(tracker, "c1")), "key-tracking clients only hear their keys");
+        tracker.prefixChanged("order:");
+        check(drain(tracker, "c1").flush && quiet(drain(tracker, "b1")),
+              "a prefix delete flushes key-tracking clients and overlapping subscribers");
+    }
+
+    return finish();
+}
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <unistd.h>
+#include "io_scheduler.h"
+#include "kvstore.h"
+#include "spill_store.h"
+#include "wal.h"
+#include "test_support.h"
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Report fsync latencies, optionally with background I/O running meanwhile
+static void feed(IoScheduler& io, std::chrono::microseconds latency, int samples,
+                 bool busy = false) {
+    for (int i = 0; i < samples; ++i) {
+        if (busy) {
+            io.acquire(1);
+        }
+        io.recordSyncLatency(latency);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+int main() {
+    std::cout << "=== I/O Scheduler Test ===\n\n";
+    const ScratchDir scratch("io");
+    const std::string& dir = scratch.path();
+
+    std::cout << "--- Token bucket ---\n";
+    {
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 8u << 20;
+        options.adaptive = false;
+        IoScheduler io(options);
+        auto start = std::chrono::steady_clock::now();
+        io.acquire(4u << 20);
+        double elapsed = secondsSince(start);
+        check(elapsed > 0.4 && elapsed < 1.0, "4MB at 8MB/s takes about half a second");
+        auto stats = io.stats();
+        check(stats.bytes == (4u << 20) && stats.throttledMicros > 300000,
+              "granted bytes and waiting time are counted");
+
+        // Two writers share the same budget
+        start = std::chrono::steady_clock::now();
+        std::thread other([&] { io.acquire(2u << 20); });
+        io.acquire(2u << 20);
+        other.join();
+        elapsed = secondsSince(start);
+        check(elapsed > 0.4 && elapsed < 1.0, "concurrent writers split one rate");
+    }
+
+    std::cout << "\n--- Adaptation ---\n";
+    {
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 64u << 20;
+        options.minBytesPerSecond = 4u << 20;
+        options.adjustInterval = std::chrono::milliseconds(1);
+        IoScheduler io(options);
+        feed(io, std::chrono::microseconds(100), 5);
+        check(io.stats().latencyTargetUs == 2000, "target has a 2ms floor over a fast idle disk");
+        check(io.stats().bytesPerSecond == (64u << 20), "quiet fsyncs leave the full rate");
+
+        feed(io, std::chrono::milliseconds(20), 30, true);
+        auto stats = io.stats();
+        check(stats.bytesPerSecond == (4u << 20) && stats.decreases >= 4,
+              "slow fsyncs halve the rate down to the floor");
+        check(stats.latencyTargetUs == 2000, "a busy disk doesn't raise the target");
+
+        feed(io, std::chrono::microseconds(100), 60);
+        check(io.stats().bytesPerSecond == (64u << 20), "fast fsyncs bring it back");
+    }
+    {
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 64u << 20;
+        options.minBytesPerSecond = 4u << 20;
+        options.latencyTarget = std::chrono::milliseconds(5);
+        options.adjustInterval = std::chrono::milliseconds(1);
+        IoScheduler io(options);
+        feed(io, std::chrono::milliseconds(20), 20);
+        uint64_t cut = io.stats().bytesPerSecond;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        io.acquire(1);
+        check(cut == (4u << 20) && io.stats().bytesPerSecond > cut,
+              "without commits to protect the rate recovers");
+        check(io.stats().latencyTargetUs == 5000, "explicit target is used as given");
+    }
+
+    std::cout << "\n--- Snapshot pacing ---\n";
+    {
+        WAL wal(dir + "/wal.log");
+        wal.initialize();
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 4u << 20;
+        options.adaptive = false;
+        auto io = std::make_shared<IoScheduler>(options);
+        wal.setIoScheduler(io);
+
+        std::unordered_map<std::string, std::string> data;
+        for (int i = 0; i < 2000; ++i) {
+            data["key" + std::to_string(i)] = std::string(1000, 'a' + i % 26);
+        }
+        auto start = std::chrono::steady_clock::now();
+        check(wal.createSnapshot(data) == Status::OK, "paced snapshot succeeds");
+        double elapsed = secondsSince(start);
+        check(elapsed > 0.3, "2MB snapshot at 4MB/s is spread out");
+        check(io->stats().bytes >= 2000u * 1000, "snapshot bytes go through the scheduler");
+        auto lines = wal.readSnapshot();
+        check(lines.size() == 2001, "every key is in the snapshot");
+    }
+
+    std::cout << "\n--- Spill compaction ---\n";
+    {
+        SpillStore spill(dir + "/spill.dat");
+        spill.initialize();
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 2u << 20;
+        options.adaptive = false;
+        spill.setIoScheduler(std::make_shared<IoScheduler>(options));
+
+        auto versions = [](char c) {
+            return std::vector<Version>{Version(std::chrono::system_clock::now(), std::string(1000, c))};
+        };
+        std::vector<std::pair<std::string, std::vector<Version>>> batch;
+        for (int i = 0; i < 2000; ++i) {
+            batch.emplace_back("k" + std::to_string(i), versions('a'));
+        }
+        spill.put(batch);
+        std::vector<Version> out;
+        for (int i = 0; i < 2000; i += 2) {
+            spill.take("k" + std::to_string(i), out);
+        }
+
+        // Runs for about half a second at 2MB/s; the index stays usable
+        bool compacted = false;
+        std::thread compactor([&] { compacted = spill.compactIfNeeded(0); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        auto start = std::chrono::steady_clock::now();
+        bool taken = spill.take("k1", out) && out.size() == 1;
+        std::vector<std::pair<std::string, std::vector<Version>>> late;
+        late.emplace_back("late", versions('z'));
+        late.emplace_back("k3", versions('y'));
+        spill.put(late);
+        double blocked = secondsSince(start);
+        compactor.join();
+
+        check(compacted, "compaction ran");
+        check(taken && blocked < 0.2, "reloads and puts don't wait for the copy");
+        check(spill.stats().fileBytes == spill.stats().liveBytes, "file holds only live records");
+        bool ok = !spill.contains("k1") && spill.size() == 1000;
+        ok = ok && spill.take("late", out) && out[0].value == std::string(1000, 'z');
+        ok = ok && spill.take("k3", out) && out[0].value == std::string(1000, 'y');
+        ok = ok && spill.take("k1999", out) && out[0].value == std::string(1000, 'a');
+        check(ok, "changes made during the copy survive it");
+    }
+
+    return finish();
+}
@@ -0,0 +1,197 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include "keyspace_stats.h"
+#include "kvstore.h"
+#include "spill_store.h"
+#include "test_support.h"
+
+static bool within(double actual, double expected, double tolerance) {
+    return std::fabs(actual - expected) <= expected * tolerance;
+}
+
+static KeyspaceStats::Group groupOf(const KeyspaceStats& stats, const std::string& prefix) {
+    auto groups = stats.snapshot();
+    auto it = groups.find(prefix);
+    return it == groups.end() ? KeyspaceStats::Group() : it->second;
+}
+
+int main() {
+    std::cout << "=== Keyspace Statistics Test ===\n\n";
+    const ScratchDir scratch("keyspace");
+    const std::string& dir = scratch.path();
+
+    std::cout << "--- HyperLogLog ---\n";
+    {
+        HyperLogLog empty;
+        check(empty.estimate() == 0, "an empty sketch estimates zero");
+        HyperLogLog hll;
+        for (int i = 1; i <= 100; ++i) {
+            hll.add(KeyspaceStats::hashValue("v" + std::to_string(i)));
+        }
+        const long long estimate = std::llround(hll.estimate());
+        check(estimate >= 98 && estimate <= 102, "small sets are counted almost exactly");
+        for (int i = 0; i < 1000; ++i) {
+            hll.add(KeyspaceStats::hashValue("v1"));
+        }
+        check(std::llround(hll.estimate()) <= 102, "repeated values aren't counted again");
+
+        HyperLogLog a, b;
+        for (int i = 0; i < 200000; ++i) {
+            (i < 120000 ? a : b).add(KeyspaceStats::hashValue("value-" + std::to_string(i)));
+            if (i >= 80000 && i < 120000) {
+                b.add(KeyspaceStats::hashValue("value-" + std::to_string(i)));
+            }
+        }
+        std::cout << "  estimates " << std::llround(a.estimate()) << " of 120000\n";
+        check(within(a.estimate(), 120000, 0.05), "large sets are estimated within 5%");
+        a.merge(b);
+        std::cout << "  union estimates " << std::llround(a.estimate()) << " of 200000\n";
+        check(within(a.estimate(), 200000, 0.05), "merged sketches estimate the union");
+    }
+
+    std::cout << "\n--- t-digest ---\n";
+    {
+        TDigest empty;
+        check(empty.quantile(0.5) == 0 && empty.count() == 0, "an empty digest reports zero");
+        TDigest digest;
+        for (int i = 1; i <= 100000; ++i) {
+            digest.add(i);
+        }
+        std::cout << "  p50=" << digest.quantile(0.5) << " p99=" << digest.quantile(0.99)
+                  << " p999=" << digest.quantile(0.999) << "\n";
+        check(within(digest.quantile(0.5), 50000, 0.01) && within(digest.quantile(0.99), 99000, 0.005) &&
+              within(digest.quantile(0.999), 99900, 0.001), "quantiles of a uniform stream");
+        check(digest.quantile(0) == 1 && digest.quantile(1) == 100000 && digest.count() == 100000,
+              "the ends are the minimum and maximum");
+
+        // Skewed: mostly 1, a long tail up to 10000
+        TDigest a, b;
+        for (int i = 0; i < 50000; ++i) {
+            a.add(1);
+            b.add(i % 100 == 0 ? 10000 : 1);
+        }
+        a.merge(b);
+        check(a.count() == 100000 && a.quantile(0.5) == 1 && within(a.quantile(0.999), 10000, 0.01),
+              "merged digests keep a rare tail");
+    }
+
+    std::cout << "\n--- Writes and deletes ---\n";
+    {
+        auto stats = std::make_shared<KeyspaceStats>(KeyspaceStats::Options());
+        KVStore store;
+        store.setMaxKeys(1000000);
+        store.setKeyspaceStats(stats);
+        for (int i = 0; i < 100; ++i) {
+            for (int v = 0; v <= i % 4; ++v) {
+                store.set("user:" + std::to_string(i), std::string(10 + v * 10, 'a' + v));
+            }
+        }
+        for (int i = 0; i < 30; ++i) {
+            store.set("order:" + std::to_string(i), "o" + std::to_string(i));
+        }
+        store.set("plain", "x");
+        auto user = groupOf(*stats, "user");
+        check(user.keys == 100 && user.resident == 100 && user.writes == 250, "keys are counted by prefix");
+        check(std::llround(user.distinctValues.estimate()) == 4, "distinct values are counted");
+        check(user.historyLength.quantile(0) == 1 && user.historyLength.max() == 4 &&
+              user.valueBytes.max() == 40, "history lengths and value sizes are recorded");
+        check(groupOf(*stats, "order").keys == 30 && groupOf(*stats, "").keys == 1,
+              "keys without the delimiter share the empty prefix");
+
+        store.del("user:1");
+        store.del("user:1");
+        check(groupOf(*stats, "user").keys == 99, "deletes are counted once");
+        store.delPrefix("order:");
+        store.reclaimTombstones();
+        check(groupOf(*stats, "order").keys == 0, "prefix deletes are counted once reclaimed");
+        store.set("order:1", "again");
+        check(groupOf(*stats, "order").keys == 1, "a re-created key counts again");
+        auto all = KeyspaceStats::total(stats->snapshot());
+        check(all.keys == 101 && all.writes == 282, "the total adds up the prefixes");
+    }
+
+    std::cout << "\n--- Prefix limit ---\n";
+    {
+        KeyspaceStats::Options options;
+        options.delimiter = '/';
+        options.maxPrefixes = 3;
+        auto stats = std::make_shared<KeyspaceStats>(options);
+        KVStore store;
+        store.setMaxKeys(1000000);
+        store.setKeyspaceStats(stats);
+        for (int p = 0; p < 6; ++p) {
+            store.set("p" + std::to_string(p) + "/k", "v");
+        }
+        auto groups = stats->snapshot();
+        check(groups.size() == 4 && groups.count(KeyspaceStats::kOtherPrefix) &&
+              groups[KeyspaceStats::kOtherPrefix].keys == 3, "prefixes past the limit share a group");
+        store.del("p5/k");
+        check(groupOf(*stats, KeyspaceStats::kOtherPrefix).keys == 2, "and are removed from it");
+    }
+
+    std::cout << "\n--- Eviction and spill ---\n";
+    {
+        auto stats = std::make_shared<KeyspaceStats>(KeyspaceStats::Options());
+        KVStore store;
+        auto spill = std::make_shared<SpillStore>(dir + "/spill.dat");
+        spill->initialize();
+        store.setSpillStore(spill);
+        store.setKeyspaceStats(stats);
+        store.setEvictionWatermarks(20, 10);
+        for (int i = 0; i < 100; ++i) {
+            store.set("k:" + std::to_string(i), "v" + std::to_string(i));
+        }
+        check(waitFor([&] { return store.residentKeys() <= 20; }), "keys are evicted");
+        // The background pass may still be running
+        check(waitFor([&] {
+                  auto group = groupOf(*stats, "k");
+                  return group.keys == 100 && group.resident == store.residentKeys();
+              }), "spilled keys are counted but not resident");
+        store.get("k:0");
+        check(groupOf(*stats, "k").resident == store.residentKeys(), "reloads make keys resident again");
+        store.delPrefix("k:");
+        store.reclaimTombstones();
+        auto group = groupOf(*stats, "k");
+        check(group.keys == 0 && group.resident == 0, "prefix deletes reach spilled keys");
+
+        KVStore dropping;
+        auto dropped = std::make_shared<KeyspaceStats>(KeyspaceStats::Options());
+        dropping.setKeyspaceStats(dropped);
+        dropping.setEvictionWatermarks(20, 10);
+        for (int i = 0; i < 100; ++i) {
+            dropping.set("d:" + std::to_string(i), "v");
+        }
+        check(waitFor([&] { return groupOf(*dropped, "d").keys == dropping.residentKeys() &&
+                                   dropping.residentKeys() <= 20; }),
+              "without a spill file evicted keys are gone");
+    }
+
+    std::cout << "\n--- Replay ---\n";
+    {
+        auto stats = std::make_shared<KeyspaceStats>(KeyspaceStats::Options());
+        KVStore store;
+        store.setMaxKeys(1000000);
+        store.setKeyspaceStats(stats);
+        KVStore::LoadBatch batch;
+        auto now = std::chrono::system_clock::now();
+        for (int i = 0; i < 50; ++i) {
+            batch.add("s:" + std::to_string(i), "a", now);
+            batch.add("s:" + std::to_string(i), "b", now + std::chrono::seconds(1));
+        }
+        store.mergeLoadBatch(batch);
+        store.setAtTime("s:0", "c", now + std::chrono::seconds(2));
+        auto group = groupOf(*stats, "s");
+        check(group.keys == 50 && group.writes == 101 && group.historyLength.max() == 3 &&
+              std::llround(group.distinctValues.estimate()) == 3, "loaded and replayed versions are counted");
+    }
+
+    return finish();
+}
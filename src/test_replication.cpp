@@ -0,0 +1,242 @@
+#include <iostream>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "external/httplib.h"
+#include "kvstore.h"
+#include "recovery.h"
+#include "replication.h"
+#include "wal.h"
+#include "test_support.h"
+
+// A replica process in miniature: its own WAL and store, and the
+// /replication/apply route the server registers
+struct TestReplica {
+    std::string dir;
+    std::shared_ptr<WAL> wal;
+    std::shared_ptr<KVStore> store;
+    std::shared_ptr<ReplicaSink> sink;
+    std::unique_ptr<httplib::Server> server;
+    std::thread thread;
+    int port = 0;
+
+    explicit TestReplica(const std::string& path) : dir(path) {
+        open();
+    }
+
+    ~TestReplica() {
+        stop();
+    }
+
+    void open() {
+        wal = std::make_shared<WAL>(dir + "/wal.log");
+        wal->initialize();
+        store = std::make_shared<KVStore>(wal);
+        Recovery::replay(*store, *wal);
+        sink = std::make_shared<ReplicaSink>(wal, store);
+    }
+
+    void start() {
+        server = std::make_unique<httplib::Server>();
+        auto replica = sink;
+        server->Post("/replication/apply", [replica](const httplib::Request& req, httplib::Response& res) {
+            uint64_t lsn = 0;
+            Status status = replica->apply(std::stoull(req.get_param_value("from")), req.body, lsn);
+            res.status = status == Status::OK ? 200 : (status == Status::NOT_FOUND ? 409 : 500);
+            res.set_content("{\"lsn\":" + std::to_string(lsn) + "}", "application/json");
+        });
+        if (port == 0) {
+            port = server->bind_to_any_port("127.0.0.1");
+        } else {
+            server->bind_to_port("127.0.0.1", port);
+        }
+        thread = std::thread([this]() { server->listen_after_bind(); });
+        server->wait_until_ready();
+    }
+
+    void stop() {
+        if (server) {
+            server->stop();
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+        server.reset();
+    }
+
+    std::string address() const {
+        return "127.0.0.1:" + std::to_string(port);
+    }
+};
+
+int main() {
+    std::cout << "=== Replication Test ===\n\n";
+    const ScratchDir scratch("replication");
+    const std::string& dir = scratch.path();
+    ::mkdir((dir + "/primary").c_str(), 0755);
+    ::mkdir((dir + "/a").c_str(), 0755);
+    ::mkdir((dir + "/b").c_str(), 0755);
+
+    auto wal = std::make_shared<WAL>(dir + "/primary/wal.log");
+    wal->initialize();
+    auto store = std::make_shared<KVStore>(wal);
+    store->setMaxKeys(1000000);
+
+    TestReplica a(dir + "/a");
+    TestReplica b(dir + "/b");
+    a.start();
+    b.start();
+
+    std::cout << "--- Asynchronous ---\n";
+    {
+        Replicator::Options options;
+        options.replicas = {a.address(), b.address()};
+        options.heartbeat = std::chrono::milliseconds(50);
+        Replicator replicator(wal, store, options);
+        replicator.start();
+        check(replicator.waitReplicated(wal->lastLsn()) == Replicator::Ack::ASYNC,
+              "writes don't wait without sync replicas");
+        for (int i = 0; i < 50; ++i) {
+            store->set("k" + std::to_string(i % 10), "v" + std::to_string(i));
+        }
+        store->del("k9");
+        store->delPrefix("k8");
+        const uint64_t lsn = wal->lastLsn();
+        check(waitFor([&] {
+                  auto stats = replicator.stats();
+                  return stats.replicas[0].ackedLsn == lsn && stats.replicas[1].ackedLsn == lsn;
+              }) && a.sink->lsn() == lsn && b.sink->lsn() == lsn,
+              "replicas reach the primary's LSN");
+        bool same = true;
+        for (int i = 0; i < 10; ++i) {
+            const std::string key = "k" + std::to_string(i);
+            same = same && sameHistoryMs(store->getHistory(key), a.store->getHistory(key)) &&
+                   sameHistoryMs(store->getHistory(key), b.store->getHistory(key));
+        }
+        check(same, "replicas hold the same versions with the same timestamps");
+        check(!a.store->get("k9") && !b.store->get("k8"), "deletes are replicated");
+        auto stats = replicator.stats();
+        check(stats.replicas.size() == 2 && stats.replicas[0].connected && stats.lastLsn == lsn &&
+              stats.replicas[1].records > 0 && !stats.semiSync, "stats report each replica's position");
+
+        // Read-your-writes: a replica read waits for the writer's LSN
+        check(a.sink->appliedLsn() == lsn && !a.sink->waitApplied(lsn + 1, std::chrono::milliseconds(50)),
+              "a replica reports the LSN it has applied");
+        store->set("session", "mine");
+        const uint64_t token = wal->lastLsn();
+        check(a.sink->waitApplied(token, std::chrono::seconds(5)) && a.store->get("session") &&
+              *a.store->get("session") == "mine", "once the token's LSN is applied the write is visible");
+        replicator.stop();
+    }
+
+    std::cout << "\n--- Semi-synchronous ---\n";
+    {
+        Replicator::Options options;
+        options.replicas = {a.address(), b.address()};
+        options.syncReplicas = 2;
+        options.heartbeat = std::chrono::milliseconds(50);
+        Replicator replicator(wal, store, options);
+        replicator.start();
+        bool replicated = true;
+        bool visible = true;
+        for (int i = 0; i < 20; ++i) {
+            const std::string key = "s" + std::to_string(i);
+            store->set(key, "x" + std::to_string(i));
+            replicated = replicated &&
+                         replicator.waitReplicated(wal->lastLsn()) == Replicator::Ack::REPLICATED;
+            visible = visible && a.store->get(key) && b.store->get(key);
+        }
+        check(replicated, "every write is acknowledged by both replicas");
+        check(visible, "an acknowledged write is already on the replicas");
+        check(a.wal->durableLsn() >= wal->lastLsn(), "and on their disks");
+
+        // Concurrent writers: each round trip carries what queued meanwhile
+        const auto before = replicator.stats().replicas[0];
+        std::vector<std::thread> writers;
+        std::atomic<int> acked{0};
+        for (int t = 0; t < 8; ++t) {
+            writers.emplace_back([&, t]() {
+                for (int i = 0; i < 50; ++i) {
+                    store->set("w" + std::to_string(t) + ":" + std::to_string(i), "v");
+                    if (replicator.waitReplicated(wal->lastLsn()) == Replicator::Ack::REPLICATED) {
+                        acked++;
+                    }
+                }
+            });
+        }
+        for (auto& writer : writers) writer.join();
+        const auto after = replicator.stats().replicas[0];
+        check(acked.load() == 400, "concurrent writes are all acknowledged");
+        std::cout << "  " << after.records - before.records << " records in "
+                  << after.batches - before.batches << " batches\n";
+        check(after.records - before.records == 400 && after.batches - before.batches < 400,
+              "concurrent writes are shipped in batches");
+
+        std::cout << "\n--- Timeout and fallback ---\n";
+        b.stop();
+        store->set("t1", "one");
+        auto start = std::chrono::steady_clock::now();
+        Replicator::Ack ack = replicator.waitReplicated(wal->lastLsn());
+        auto waited = std::chrono::steady_clock::now() - start;
+        check(ack == Replicator::Ack::TIMED_OUT && waited >= std::chrono::milliseconds(900),
+              "a write times out after sync_timeout with a replica down");
+        auto stats = replicator.stats();
+        check(stats.syncTimeouts == 1 && !stats.semiSync, "the timeout is counted and semi-sync is off");
+        store->set("t2", "two");
+        start = std::chrono::steady_clock::now();
+        check(replicator.waitReplicated(wal->lastLsn()) == Replicator::Ack::ASYNC &&
+              std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100),
+              "later writes don't wait while degraded");
+        check(waitFor([&] { return a.sink->lsn() == wal->lastLsn(); }),
+              "the remaining replica keeps up");
+
+        b.start();
+        check(waitFor([&] { return replicator.stats().semiSync; }),
+              "semi-sync resumes once the replica catches up");
+        check(b.store->get("t2") && *b.store->get("t2") == "two", "the replica got what it missed");
+        store->set("t3", "three");
+        check(replicator.waitReplicated(wal->lastLsn()) == Replicator::Ack::REPLICATED,
+              "writes wait for both replicas again");
+        replicator.stop();
+    }
+
+    std::cout << "\n--- Replica restart ---\n";
+    {
+        const uint64_t lsn = b.sink->lsn();
+        b.stop();
+        b.sink.reset();
+        b.store.reset();
+        b.wal.reset();
+        b.open();
+        check(b.sink->lsn() == lsn, "a restarted replica resumes at its LSN");
+        check(b.store->get("t3") && *b.store->get("t3") == "three" &&
+              sameHistoryMs(store->getHistory("k1"), b.store->getHistory("k1")),
+              "and its data is replayed from its WAL");
+    }
+
+    std::cout << "\n--- Lost replica ---\n";
+    {
+        // Written while no replicator runs, so never shipped
+        store->set("gap", "unshipped");
+        Replicator::Options options;
+        options.replicas = {a.address()};
+        options.heartbeat = std::chrono::milliseconds(50);
+        Replicator replicator(wal, store, options);
+        replicator.start();
+        store->set("after", "gap");
+        check(waitFor([&] { return replicator.stats().replicas[0].lost; }),
+              "a replica behind what is queued is reported lost");
+        check(!a.store->get("after"), "and nothing is applied past the gap");
+        replicator.stop();
+    }
+
+    a.stop();
+    return finish();
+}
@@ -0,0 +1,264 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "backup.h"
+#include "kvstore.h"
+#include "recovery.h"
+#include "wal.h"
+#include "test_support.h"
+
+static std::string valueFor(int i) {
+    return "v" + std::to_string(i * 7);
+}
+
+// Whether db holds key<i> = valueFor(i) for every i in [from, to)
+// Whether recovery accepts what is on disk in dir
+static bool opens(const std::string& dir) {
+    try {
+        Instance db(dir);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+static bool holds(const Instance& db, int from, int to) {
+    for (int i = from; i < to; ++i) {
+        if (db.store->get("key" + std::to_string(i)) != std::optional<std::string>(valueFor(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== Partitioned Snapshot Test ===\n\n";
+    const ScratchDir scratch("snapshot");
+    const std::string& dir = scratch.path();
+    const int kKeys = 20000;
+
+    std::cout << "--- Write ---\n";
+    SnapshotManifest first;
+    {
+        WAL wal(dir + "/a/wal.log");
+        wal.initialize();
+        wal.setSnapshotPartitions(4);
+        check(wal.snapshotPartitions() == 4, "partition count is configurable");
+        std::unordered_map<std::string, std::string> data;
+        for (int i = 0; i < kKeys; ++i) {
+            data["key" + std::to_string(i)] = valueFor(i);
+        }
+        for (int i = 0; i < 5; ++i) {
+            wal.logSet("key0", "unused", std::chrono::system_clock::now());
+        }
+        check(wal.createSnapshot(data, "STRICT") == Status::OK, "snapshot succeeds");
+        check(wal.readSnapshotManifest(first) == Status::OK, "snapshot.db is a manifest");
+        uint64_t keys = 0;
+        bool allThere = true;
+        for (const auto& part : first.parts) {
+            keys += part.keys;
+            allThere = allThere && fileExists(dir + "/a/" + part.name);
+        }
+        check(first.parts.size() == 4 && allThere, "one file per partition");
+        check(keys == kKeys && first.parts[0].keys > kKeys / 8 && first.parts[3].keys > kKeys / 8,
+              "keys are spread over the partitions");
+        check(first.lsn == 5 && first.policy == "STRICT", "manifest carries the LSN and policy");
+        check(wal.readSnapshot().size() == kKeys + 2, "readSnapshot() sees one snapshot's lines");
+    }
+
+    std::cout << "\n--- Load ---\n";
+    {
+        Instance db(dir + "/a");
+        check(db.store->size() == kKeys && holds(db, 0, kKeys), "every key is restored");
+        check(db.store->getDecisionPolicy() == DecisionPolicy::STRICT, "policy is restored");
+        check(db.wal->lastLsn() == 5, "LSN numbering continues");
+        db.store->set("key1", "changed");
+        check(db.store->getHistory("key1").size() == 2, "loaded keys take new versions");
+        db.store->del("key2");
+        check(!db.store->get("key2").has_value(), "loaded keys can be deleted");
+        db.wal->flush();
+    }
+    {
+        Instance db(dir + "/a");
+        check(db.store->get("key1") == std::optional<std::string>("changed") &&
+              !db.store->get("key2").has_value(), "WAL replays on top of the partitions");
+
+        // Keys loaded into a store that already holds some of them
+        KVStore store;
+        store.set("key5", "old");
+        KVStore::LoadBatch batch;
+        auto now = std::chrono::system_clock::now();
+        batch.add("key5", "new", now);
+        batch.add("key6", "six", now);
+        store.mergeLoadBatch(batch);
+        check(store.getHistory("key5").size() == 2 && store.get("key5") == std::optional<std::string>("new") &&
+              store.get("key6") == std::optional<std::string>("six") && batch.size() == 0,
+              "merging keeps existing keys' history");
+        store.del("key6");
+        check(store.size() == 1 && !store.get("key6").has_value(), "merged keys can be deleted");
+    }
+
+    std::cout << "\n--- Next generation ---\n";
+    SnapshotManifest second;
+    {
+        Instance db(dir + "/a");
+        db.wal->setSnapshotPartitions(3);
+        // Left behind by a snapshot that crashed before its manifest
+        std::ofstream(dir + "/a/" + WAL::snapshotPartName(first.generation + 7, 0)) << "SET junk 1\n";
+        check(db.wal->createSnapshot(db.store->getAllData()) == Status::OK, "second snapshot succeeds");
+        db.wal->readSnapshotManifest(second);
+        bool oldGone = true;
+        for (const auto& part : first.parts) {
+            oldGone = oldGone && !fileExists(dir + "/a/" + part.name);
+        }
+        check(second.generation == first.generation + 1 && second.parts.size() == 3,
+              "a new generation of files");
+        check(oldGone && !fileExists(dir + "/a/" + WAL::snapshotPartName(first.generation + 7, 0)),
+              "files of earlier and unfinished snapshots are removed");
+    }
+    {
+        Instance db(dir + "/a");
+        check(db.store->size() == kKeys - 1 && holds(db, 3, kKeys), "second snapshot loads");
+    }
+
+    std::cout << "\n--- Backup ---\n";
+    {
+        WAL wal(dir + "/a/wal.log");
+        wal.initialize();
+        WALBackupPoint point;
+        check(wal.openBackupPoint(point) && point.files.size() == 3, "backup pins the partitions");
+        {
+            BackupStream stream(point, 1 << 16, 0);
+            std::ofstream out(dir + "/a.backup", std::ios::binary);
+            std::string chunk;
+            bool more = true;
+            while (more) {
+                more = stream.next(chunk);
+                out << chunk;
+            }
+        }
+        std::string error;
+        bool restored = BackupRestore::restore(dir + "/a.backup", dir + "/r", 2, false, error);
+        check(restored, "archive restores" + (error.empty() ? std::string() : ": " + error));
+        Instance db(dir + "/r");
+        check(db.store->size() == kKeys - 1 && holds(db, 3, kKeys), "restored directory loads");
+    }
+
+    std::cout << "\n--- Damage ---\n";
+    {
+        SnapshotManifest manifest;
+        {
+            WAL wal(dir + "/a/wal.log");
+            wal.initialize();
+            wal.readSnapshotManifest(manifest);
+        }
+        const std::string part = dir + "/a/" + manifest.parts[1].name;
+        char original = 0;
+        {
+            std::fstream f(part, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekg(10);
+            f.get(original);
+            f.seekp(10);
+            f.put('#');
+        }
+        check(!opens(dir + "/a"), "a partition failing its checksum stops recovery");
+        {
+            std::fstream f(part, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(10);
+            f.put(original);
+        }
+        check(opens(dir + "/a"), "and the same snapshot loads once it is repaired");
+
+        std::string text;
+        {
+            std::ifstream in(dir + "/a/snapshot.db");
+            text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        text.replace(text.find("LSN "), 5, "LSN 9");
+        std::ofstream(dir + "/a/snapshot.db") << text;
+        WAL wal(dir + "/a/wal.log");
+        wal.initialize();
+        check(wal.readSnapshotManifest(manifest) == Status::ERROR, "an edited manifest is rejected");
+        check(!opens(dir + "/a"), "and stops recovery rather than starting empty");
+    }
+
+    std::cout << "\n--- Single-file snapshots ---\n";
+    {
+        ::mkdir((dir + "/b").c_str(), 0755);
+        std::ofstream(dir + "/b/snapshot.db") << "LSN 12\nPOLICY SET DEV_FRIENDLY\nSET key0 "
+                                              << valueFor(0) << "\nSET key1 " << valueFor(1) << "\n";
+        Instance db(dir + "/b");
+        SnapshotManifest manifest;
+        check(db.wal->readSnapshotManifest(manifest) == Status::NOT_FOUND, "not a manifest");
+        check(db.store->size() == 2 && holds(db, 0, 2) && db.wal->lastLsn() == 12,
+              "an older single-file snapshot still loads");
+        check(db.wal->createSnapshot(db.store->getAllData()) == Status::OK &&
+              db.wal->readSnapshotManifest(manifest) == Status::OK && manifest.lsn == 12,
+              "and is replaced by a partitioned one");
+    }
+
+    std::cout << "\n--- Writes during a snapshot ---\n";
+    {
+        uint64_t lsn = 0;
+        {
+            Instance db(dir + "/c");
+            for (int i = 0; i < 100; ++i) {
+                db.store->set("key" + std::to_string(i), valueFor(i));
+            }
+            auto data = db.store->getAllData(nullptr, &lsn);
+            // Written after the copy, before the WAL is cleared
+            for (int i = 100; i < 150; ++i) {
+                db.store->set("key" + std::to_string(i), valueFor(i));
+            }
+            SnapshotManifest manifest;
+            check(lsn == 100 && db.wal->createSnapshot(data, "", {}, lsn) == Status::OK &&
+                  db.wal->readSnapshotManifest(manifest) == Status::OK && manifest.lsn == 100,
+                  "the manifest carries the LSN the data was read at");
+            check(db.wal->readLog().size() == 50, "later records stay in the WAL");
+            db.store->set("key150", valueFor(150));
+        }
+        Instance db(dir + "/c");
+        check(db.store->size() == 151 && holds(db, 0, 151) && db.wal->lastLsn() == 151,
+              "none of them is lost on recovery");
+    }
+
+    std::cout << "\n--- Crash before the WAL is cleared ---\n";
+    {
+        std::string before;
+        {
+            Instance db(dir + "/d");
+            for (int i = 0; i < 100; ++i) {
+                db.store->set("key" + std::to_string(i), valueFor(i));
+            }
+            db.wal->flush();
+            std::ifstream in(dir + "/d/wal.log", std::ios::binary);
+            before.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            uint64_t lsn = 0;
+            auto data = db.store->getAllData(nullptr, &lsn);
+            uint64_t base = 0;
+            check(db.wal->createSnapshot(data, "", {}, lsn) == Status::OK &&
+                  db.wal->readLog(&base).empty() && base == 100,
+                  "a cleared WAL records the LSN it starts after");
+        }
+        // The snapshot is installed but the log still holds what it covers
+        std::ofstream(dir + "/d/wal.log", std::ios::binary | std::ios::trunc) << before;
+        {
+            Instance db(dir + "/d");
+            check(db.store->size() == 100 && holds(db, 0, 100) &&
+                  db.store->getHistory("key7").size() == 1,
+                  "records the snapshot covers are not replayed again");
+            check(db.wal->lastLsn() == 100, "and don't advance the LSN");
+            db.store->set("key100", valueFor(100));
+        }
+        Instance db(dir + "/d");
+        check(db.store->size() == 101 && db.wal->lastLsn() == 101, "later records still replay");
+    }
+
+    return finish();
+}
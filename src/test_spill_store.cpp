@@ -0,0 +1,281 @@
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include "io_scheduler.h"
+#include "kvstore.h"
+#include "spill_store.h"
+#include "wal.h"
+#include "test_support.h"
+
+using Batch = std::vector<std::pair<std::string, std::vector<Version>>>;
+
+static std::vector<Version> history(char c, size_t versions = 1, size_t bytes = 1000) {
+    std::vector<Version> out;
+    auto now = std::chrono::system_clock::now();
+    for (size_t i = 0; i < versions; ++i) {
+        out.emplace_back(now + std::chrono::milliseconds(i), std::string(bytes, static_cast<char>(c + i)));
+    }
+    return out;
+}
+
+// The key's record is there and its newest value is bytes x c
+static bool holds(const SpillStore& spill, const std::string& key, char c, size_t bytes = 1000) {
+    std::vector<Version> versions;
+    return spill.read(key, versions) && versions.back().value == std::string(bytes, c);
+}
+
+static std::string valueFor(int i) {
+    return "value-" + std::to_string(i) + std::string(200, 'v');
+}
+
+// A store over dir that spills to dir/spill.dat past `high` resident keys
+struct SpillingInstance : Instance {
+    std::shared_ptr<SpillStore> spill;
+
+    SpillingInstance(const std::string& dir, size_t high, size_t low) : Instance(dir) {
+        spill = std::make_shared<SpillStore>(dir + "/spill.dat");
+        spill->initialize();
+        store->setSpillStore(spill);
+        store->setEvictionWatermarks(high, low);
+    }
+
+    // Write keys prefix0..prefix<n-1>, then wait for eviction to catch up
+    void fill(const std::string& prefix, int n) {
+        for (int i = 0; i < n; ++i) {
+            store->set(prefix + std::to_string(i), valueFor(i));
+        }
+        const size_t high = store->getMaxKeys();
+        waitFor([&] { return store->residentKeys() <= high; });
+    }
+};
+
+int main() {
+    std::cout << "=== Spill Store Test ===\n\n";
+    const ScratchDir scratch("spill");
+    const std::string& dir = scratch.path();
+
+    std::cout << "--- Records ---\n";
+    {
+        SpillStore spill(dir + "/records.dat");
+        check(spill.initialize() == Status::OK && spill.isEnabled(), "spill file opens");
+        Batch batch;
+        batch.emplace_back("a", history('a', 3));
+        batch.emplace_back("b", history('x'));
+        check(spill.put(batch) == Status::OK && spill.size() == 2 && spill.contains("a"),
+              "a batch is appended and indexed");
+
+        std::vector<Version> versions;
+        check(spill.read("a", versions) && versions.size() == 3 && spill.contains("a"),
+              "read leaves the key spilled");
+        auto expected = history('a', 3);
+        bool same = spill.take("a", versions) && versions.size() == 3;
+        for (size_t i = 0; same && i < 3; ++i) {
+            same = versions[i].value == expected[i].value;
+        }
+        check(same && !spill.contains("a") && !spill.take("a", versions),
+              "take returns the whole history once");
+
+        Batch again;
+        again.emplace_back("b", history('y'));
+        spill.put(again);
+        check(spill.size() == 1 && holds(spill, "b", 'y') &&
+              spill.stats().liveBytes < spill.stats().fileBytes,
+              "a key put again is replaced and its old record is dead");
+
+        std::vector<std::string> keys;
+        spill.keys("b", keys);
+        check(keys == std::vector<std::string>{"b"} && spill.remove("b") && spill.size() == 0,
+              "keys are listed by prefix and removed");
+
+        Batch damaged;
+        damaged.emplace_back("c", history('c'));
+        spill.put(damaged);
+        {
+            std::fstream f(dir + "/records.dat", std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(static_cast<std::streamoff>(spill.stats().fileBytes - 100));
+            f.put('#');
+        }
+        check(!spill.take("c", versions), "a record failing its checksum is not returned");
+    }
+
+    std::cout << "\n--- Compaction during puts and takes ---\n";
+    {
+        SpillStore spill(dir + "/compact.dat");
+        spill.initialize();
+        // Slow enough that the copy is still running while the index changes
+        IoScheduler::Options options;
+        options.maxBytesPerSecond = 2u << 20;
+        options.adaptive = false;
+        spill.setIoScheduler(std::make_shared<IoScheduler>(options));
+        Batch batch;
+        for (int i = 0; i < 2000; ++i) {
+            batch.emplace_back("k" + std::to_string(i), history('a'));
+        }
+        spill.put(batch);
+        std::vector<Version> out;
+        for (int i = 0; i < 2000; i += 2) {
+            spill.take("k" + std::to_string(i), out);
+        }
+
+        bool compacted = false;
+        std::thread compactor([&] { compacted = spill.compactIfNeeded(0); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        // Each of these leaves an index entry the copy's offsets don't cover
+        Batch late;
+        late.emplace_back("k1", history('r'));    // replaced: old record copied, new one not
+        late.emplace_back("new", history('n'));   // appended after the copy began
+        spill.put(late);
+        spill.take("k3", out);                    // copied, but gone from the index
+        spill.take("k5", out);
+        Batch back;
+        back.emplace_back("k5", history('p'));    // taken and spilled again
+        spill.put(back);
+        compactor.join();
+
+        check(compacted && spill.stats().fileBytes == spill.stats().liveBytes,
+              "compaction leaves only live records");
+        bool copied = true;
+        for (int i = 7; i < 2000; i += 2) {
+            copied = copied && holds(spill, "k" + std::to_string(i), 'a');
+        }
+        check(copied, "copied records are found at their new offsets");
+        check(holds(spill, "k1", 'r') && holds(spill, "k5", 'p') && holds(spill, "new", 'n'),
+              "records written during the copy are moved to the end");
+        check(!spill.contains("k3") && spill.size() == 1000, "keys taken during the copy stay gone");
+    }
+    {
+        SpillStore spill(dir + "/race.dat");
+        spill.initialize();
+        std::map<std::string, char> expected;  // owned by the writer until it is joined
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            std::mt19937 rng(7);
+            std::vector<Version> out;
+            for (int op = 0; op < 20000; ++op) {
+                std::string key = "r" + std::to_string(rng() % 200);
+                if (rng() % 3 == 0) {
+                    spill.take(key, out);
+                    expected.erase(key);
+                } else {
+                    char c = static_cast<char>('a' + rng() % 26);
+                    Batch batch;
+                    batch.emplace_back(key, history(c, 1, 100));
+                    spill.put(batch);
+                    expected[key] = c;
+                }
+            }
+            done = true;
+        });
+        size_t compactions = 0;
+        while (!done) {
+            compactions += spill.compactIfNeeded(0) ? 1 : 0;
+        }
+        writer.join();
+        bool same = spill.size() == expected.size();
+        for (const auto& [key, c] : expected) {
+            same = same && holds(spill, key, c, 100);
+        }
+        check(compactions > 0, "compactions ran alongside puts and takes");
+        check(same, "and the index matches every put and take");
+    }
+
+    std::cout << "\n--- Reload ---\n";
+    {
+        SpillingInstance db(dir + "/reload", 20, 10);
+        db.fill("k", 100);
+        // A second version for every key, spilled or not
+        for (int i = 0; i < 100; ++i) {
+            db.store->set("k" + std::to_string(i), valueFor(i + 1000));
+        }
+        waitFor([&] { return db.store->residentKeys() <= 20; });
+        std::string spilled;
+        for (int i = 0; spilled.empty() && i < 100; ++i) {
+            if (db.spill->contains("k" + std::to_string(i))) spilled = "k" + std::to_string(i);
+        }
+        check(!spilled.empty() && db.store->size() == 100, "keys past the watermark are spilled");
+
+        const uint64_t reloaded = db.spill->stats().reloaded;
+        const int n = std::stoi(spilled.substr(1));
+        check(db.store->get(spilled) == std::optional<std::string>(valueFor(n + 1000)) &&
+              db.store->getHistory(spilled).size() == 2,
+              "get reloads a spilled key with its history");
+        check(!db.spill->contains(spilled) && db.spill->stats().reloaded == reloaded + 1,
+              "and takes it out of the spill file");
+
+        waitFor([&] { return db.store->residentKeys() <= 20; });
+        std::vector<std::string> keys;
+        for (int i = 99; i >= 0; --i) {
+            keys.push_back("k" + std::to_string(i));
+        }
+        auto values = db.store->multiGet(keys);
+        bool all = values.size() == 100;
+        for (int i = 0; all && i < 100; ++i) {
+            all = values[i] == std::optional<std::string>(valueFor(99 - i + 1000));
+        }
+        check(all, "multiGet returns spilled keys in order");
+        check(db.store->size() == 100, "reloading neither loses nor duplicates keys");
+    }
+
+    std::cout << "\n--- Range tombstones ---\n";
+    {
+        SpillingInstance db(dir + "/tombstones", 20, 10);
+        db.fill("user:", 50);
+        db.fill("order:", 50);
+        std::vector<std::string> spilledUsers;
+        db.spill->keys("user:", spilledUsers);
+        check(!spilledUsers.empty(), "keys under the prefix are spilled");
+
+        db.store->delPrefix("user:");
+        bool hidden = true;
+        for (int i = 0; i < 50; ++i) {
+            hidden = hidden && !db.store->get("user:" + std::to_string(i)).has_value();
+        }
+        check(hidden, "a prefix delete hides spilled keys at once");
+
+        // Written after the delete, then spilled before it is reclaimed
+        db.store->set("user:late", "kept");
+        for (int round = 0; round < 10 && !db.spill->contains("user:late"); ++round) {
+            db.fill("later" + std::to_string(round) + ":", 30);
+        }
+        check(db.spill->contains("user:late"), "a newer key under the prefix is spilled");
+        db.store->reclaimTombstones();
+        std::vector<std::string> left;
+        db.spill->keys("user:", left);
+        // user:late may have been reloaded by the pass or still be spilled
+        check((left.empty() || left == std::vector<std::string>{"user:late"}) &&
+              db.store->listKeys("user:") == std::vector<std::string>{"user:late"} &&
+              db.store->pendingTombstones() == 0,
+              "reclaiming drops the covered spilled keys");
+        check(db.store->get("user:late") == std::optional<std::string>("kept") &&
+              db.store->get("order:7") == std::optional<std::string>(valueFor(7)),
+              "and keeps newer and unrelated ones");
+    }
+
+    std::cout << "\n--- Snapshots ---\n";
+    {
+        {
+            SpillingInstance db(dir + "/snapshot", 20, 10);
+            db.fill("k", 200);
+            check(db.spill->size() >= 180, "most keys are only in the spill file");
+            auto data = db.store->getAllData();
+            check(data.size() == 200 && data["k3"] == valueFor(3), "getAllData includes spilled keys");
+            check(db.wal->createSnapshot(data) == Status::OK && db.wal->readLog().empty(),
+                  "the snapshot replaces the log");
+        }
+        // The spill file is truncated on open; the snapshot alone restores them
+        SpillingInstance db(dir + "/snapshot", 1000, 900);
+        bool all = db.store->size() == 200;
+        for (int i = 0; all && i < 200; ++i) {
+            all = db.store->get("k" + std::to_string(i)) == std::optional<std::string>(valueFor(i));
+        }
+        check(all, "spilled keys come back from the snapshot");
+    }
+
+    return finish();
+}
@@ -0,0 +1,118 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+// Helpers shared by the test_* programs: ✓/✗ checks counted into the exit
+// status, a scratch directory, polling for background work, and a store
+// recovered from a data directory the way the server opens one.
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "blob_store.h"
+#include "kvstore.h"
+#include "recovery.h"
+#include "wal.h"
+
+inline int failures = 0;
+
+inline void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "✓ " : "✗ ") << what << "\n";
+    if (!ok) failures++;
+}
+
+// Print the verdict; main() returns this
+inline int finish() {
+    std::cout << "\n=== " << (failures == 0 ? "All tests passed" : "FAILED") << " ===\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Poll done every 10ms for up to ms; background passes finish in their own time
+inline bool waitFor(const std::function<bool()>& done, int ms = 5000) {
+    for (int waited = 0; waited < ms; waited += 10) {
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+inline bool fileExists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// Same values at the same timestamps
+inline bool sameHistory(const std::vector<Version>& a, const std::vector<Version>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].timestamp != b[i].timestamp || a[i].value != b[i].value) return false;
+    }
+    return true;
+}
+
+// WAL records carry millisecond timestamps, so a store rebuilt from the log
+// (a recovered primary, a replica) matches the original at that resolution
+inline bool sameHistoryMs(const std::vector<Version>& a, const std::vector<Version>& b) {
+    using std::chrono::milliseconds;
+    using std::chrono::duration_cast;
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (duration_cast<milliseconds>(a[i].timestamp.time_since_epoch()) !=
+                duration_cast<milliseconds>(b[i].timestamp.time_since_epoch()) ||
+            a[i].value != b[i].value) return false;
+    }
+    return true;
+}
+
+// /tmp/sentinel_<name>_XXXXXX, removed with everything in it at scope exit
+class ScratchDir {
+public:
+    explicit ScratchDir(const std::string& name) {
+        std::string tmpl = "/tmp/sentinel_" + name + "_XXXXXX";
+        path_ = ::mkdtemp(&tmpl[0]);
+    }
+
+    ~ScratchDir() {
+        std::string cleanup = "rm -rf " + path_;
+        if (std::system(cleanup.c_str()) != 0) {
+            std::cout << "(could not remove " << path_ << ")\n";
+        }
+    }
+
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// A store with its WAL in dir, and blob store if blobOptions is given,
+// recovered from whatever is there
+struct Instance {
+    std::shared_ptr<WAL> wal;
+    std::shared_ptr<BlobStore> blobs;
+    std::shared_ptr<KVStore> store;
+
+    explicit Instance(const std::string& dir, const BlobStore::Options* blobOptions = nullptr) {
+        wal = std::make_shared<WAL>(dir + "/wal.log");
+        wal->initialize();
+        store = std::make_shared<KVStore>(wal);
+        store->setMaxKeys(1000000);
+        if (blobOptions != nullptr) {
+            blobs = std::make_shared<BlobStore>(dir + "/blobs", *blobOptions);
+            blobs->initialize();
+            store->setBlobStore(blobs);
+        }
+        Recovery::replay(*store, *wal);
+    }
+};
+
+#endif // TEST_SUPPORT_H
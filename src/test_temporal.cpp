@@ -2,6 +2,8 @@
 #include <thread>
 #include <chrono>
 #include <iomanip>
+#include <algorithm>
+#include <tuple>
 #include "kvstore.h"
 
 void printTimestamp(const std::chrono::system_clock::time_point& tp) {
@@ -80,6 +82,104 @@ int main() {
         std::cout << "  - \"" << v.value << "\"\n";
     }
     
+    std::cout << "\n=== Prefix Delete ===\n";
+    kvstore->set("tenant:1:name", "acme");
+    kvstore->set("tenant:1:plan", "pro");
+    kvstore->set("tenant:2:name", "globex");
+    auto beforeDelete = std::chrono::system_clock::now();
+    kvstore->delPrefix("tenant:1:");
+    kvstore->set("tenant:1:plan", "free");
+    
+    bool prefixOk = !kvstore->get("tenant:1:name") &&
+                    !kvstore->getAtTime("tenant:1:name", beforeDelete) &&
+                    kvstore->get("tenant:2:name") == std::optional<std::string>("globex") &&
+                    kvstore->getHistory("tenant:1:plan").size() == 1;
+    kvstore->reclaimTombstones();
+    prefixOk = prefixOk && kvstore->pendingTombstones() == 0 &&
+               !kvstore->exists("tenant:1:name") &&
+               kvstore->get("tenant:1:plan") == std::optional<std::string>("free");
+    std::cout << (prefixOk ? "✓ tenant:1:* hidden, rewrite and tenant:2 kept\n"
+                           : "✗ prefix delete visibility mismatch\n");
+    
+    std::cout << "\n=== Batched Reads ===\n";
+    for (int i = 0; i < 100; ++i) {
+        kvstore->set("batch:" + std::to_string(i), "v" + std::to_string(i));
+    }
+    kvstore->set("batch:7", "v7b");
+    kvstore->delPrefix("batch:9");  // batch:9, batch:90..99 hidden until reclaimed
+    std::vector<std::string> batchKeys = {"batch:7", "batch:nope", "batch:95", "batch:7"};
+    for (int i = 0; i < 100; i += 3) {
+        batchKeys.push_back("batch:" + std::to_string(i));
+    }
+    bool batchOk = true;
+    for (size_t group : {size_t(1), size_t(5), KVStore::kProbeGroup, size_t(1000)}) {
+        auto values = kvstore->multiGet(batchKeys, group);
+        batchOk = batchOk && values.size() == batchKeys.size();
+        for (size_t i = 0; batchOk && i < batchKeys.size(); ++i) {
+            batchOk = values[i] == kvstore->get(batchKeys[i]);
+        }
+    }
+    auto batchValues = kvstore->multiGet(batchKeys);
+    batchOk = batchOk && batchValues[0] == std::optional<std::string>("v7b") &&
+              !batchValues[1] && !batchValues[2] && batchValues[3] == batchValues[0] &&
+              kvstore->multiGet({}).empty();
+    std::cout << (batchOk ? "✓ multiGet matches get() for every group size\n"
+                          : "✗ multiGet result mismatch\n");
+    
+    std::cout << "\n=== Merged Timeline ===\n";
+    // 30 keys with up to 8 versions each on a shared grid of seconds, so
+    // keys collide on timestamps and some keys repeat one
+    using Clock = std::chrono::system_clock;
+    const auto base = Clock::time_point(std::chrono::seconds(1700000000));
+    std::vector<std::tuple<Clock::time_point, std::string, std::string>> expected;
+    std::vector<std::string> timelineKeys;
+    for (int k = 0; k < 30; ++k) {
+        const std::string key = "tl:" + std::to_string(k);
+        timelineKeys.push_back(key);
+        int second = k % 4;
+        for (int v = 0; v <= k % 8; ++v) {
+            second += (v % 3 == 2) ? 0 : 1 + (k + v) % 3;
+            const std::string value = key + "." + std::to_string(v);
+            kvstore->setAtTime(key, value, base + std::chrono::seconds(second));
+            expected.emplace_back(base + std::chrono::seconds(second), key, value);
+        }
+    }
+    // Time, then key; a key's own versions stay in the order written
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) {
+        return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+    });
+    auto timeline = [&](Clock::time_point from, Clock::time_point through, size_t limit) {
+        std::vector<std::tuple<Clock::time_point, std::string, std::string>> got;
+        std::optional<TimelinePosition> after;
+        do {
+            after = kvstore->visitTimeline(timelineKeys, from, through, after ? &*after : nullptr, limit,
+                                           [&](const std::string& key, const Version& version) {
+                got.emplace_back(version.timestamp, key, version.value);
+            });
+        } while (after);
+        return got;
+    };
+    bool timelineOk = true;
+    for (size_t limit : {size_t(1), size_t(2), size_t(7), size_t(1000)}) {
+        timelineOk = timelineOk && timeline(Clock::time_point::min(), Clock::time_point::max(), limit) == expected;
+    }
+    std::cout << (timelineOk ? "✓ paged timeline merges every key in time order\n"
+                             : "✗ timeline order or paging mismatch\n");
+    const auto from = base + std::chrono::seconds(3);
+    const auto through = base + std::chrono::seconds(6);
+    std::vector<std::tuple<Clock::time_point, std::string, std::string>> window;
+    for (const auto& entry : expected) {
+        if (std::get<0>(entry) >= from && std::get<0>(entry) <= through) window.push_back(entry);
+    }
+    bool windowOk = !window.empty() && timeline(from, through, 3) == window;
+    kvstore->delPrefix("tl:1");  // tl:1, tl:10..19
+    windowOk = windowOk && timeline(Clock::time_point::min(), Clock::time_point::max(), 5).size() ==
+        static_cast<size_t>(std::count_if(expected.begin(), expected.end(), [](const auto& e) {
+            return std::get<1>(e) != "tl:1" && std::get<1>(e).compare(0, 4, "tl:1") != 0;
+        }));
+    std::cout << (windowOk ? "✓ timeline honours the window and prefix deletes\n"
+                           : "✗ timeline window mismatch\n");
+    
     std::cout << "\n=== Test Complete ===\n";
-    return 0;
+    return prefixOk && batchOk && timelineOk && windowOk ? 0 : 1;
 }
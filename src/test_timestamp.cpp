@@ -0,0 +1,98 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "timestamp.h"
+#include "test_support.h"
+
+using TimePoint = std::chrono::system_clock::time_point;
+
+static long long toMs(TimePoint tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+
+static void expectMs(const std::string& input, long long expected) {
+    auto tp = TimestampCodec::parse(input);
+    check(tp && toMs(*tp) == expected,
+          "parse \"" + input + "\" -> " + std::to_string(expected) +
+          (tp ? " (got " + std::to_string(toMs(*tp)) + ")" : " (got nullopt)"));
+}
+
+static void expectInvalid(const std::string& input) {
+    check(!TimestampCodec::parse(input).has_value(), "reject \"" + input + "\"");
+}
+
+int main() {
+    std::cout << "=== Timestamp Codec Test ===\n\n";
+
+    std::cout << "--- Epoch ---\n";
+    expectMs("1700000000000", 1700000000000LL);
+    expectMs("1700000000000ms", 1700000000000LL);
+    expectMs("1700000000000123us", 1700000000000LL);
+    expectMs("0", 0);
+    {
+        auto tp = TimestampCodec::parse("1700000000000123us");
+        check(tp && std::chrono::duration_cast<std::chrono::microseconds>(
+                  tp->time_since_epoch()).count() == 1700000000000123LL,
+              "epoch-us keeps microsecond precision");
+    }
+
+    std::cout << "\n--- RFC 3339 ---\n";
+    expectMs("2023-11-14T22:13:20Z", 1700000000000LL);
+    expectMs("2023-11-14T22:13:20.123Z", 1700000000123LL);
+    expectMs("2023-11-14T22:13:20.123456789Z", 1700000000123LL);
+    expectMs("2023-11-15T03:43:20+05:30", 1700000000000LL);
+    expectMs("2023-11-14T17:13:20-05:00", 1700000000000LL);
+    expectMs("2024-02-29T00:00:00Z", 1709164800000LL);
+
+    std::cout << "\n--- Malformed ---\n";
+    expectInvalid("");
+    expectInvalid("yesterday");
+    expectInvalid("12ab");
+    expectInvalid("2023-02-29T00:00:00Z");
+    expectInvalid("2023-13-01 00:00:00");
+    expectInvalid("2023-11-14T22:13Z");
+    expectInvalid("2023-11-14T22:13:20.Z");
+    expectInvalid("2023-11-14T22:13:20Zjunk");
+
+    std::cout << "\n--- Local time round trip ---\n";
+    {
+        TimePoint original(std::chrono::milliseconds(1700000000123LL));
+        std::string formatted = TimestampCodec::format(original);
+        auto parsed = TimestampCodec::parse(formatted);
+        check(formatted.size() == 23, "formatted length is 23 (" + formatted + ")");
+        check(parsed && toMs(*parsed) == 1700000000123LL, "format -> parse preserves ms");
+    }
+    {
+        // Pre-epoch instants keep a positive millisecond field
+        TimePoint original(std::chrono::milliseconds(-1));
+        auto parsed = TimestampCodec::parse(TimestampCodec::format(original));
+        check(parsed && toMs(*parsed) == -1, "pre-epoch round trip");
+    }
+
+    std::cout << "\n--- Concurrent formatting ---\n";
+    {
+        // Every thread formats distinct seconds, defeating the per-thread
+        // cache, and checks each result against a parse of itself
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; ++t) {
+            threads.emplace_back([&, t]() {
+                char buf[TimestampCodec::kFormattedSize];
+                for (long long i = 0; i < 20000; ++i) {
+                    long long ms = 1600000000000LL + (t * 20000 + i) * 7919LL;
+                    TimestampCodec::format(TimePoint(std::chrono::milliseconds(ms)), buf);
+                    auto parsed = TimestampCodec::parse(buf);
+                    if (!parsed || toMs(*parsed) != ms) mismatches++;
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+        check(mismatches == 0, "160000 concurrent format/parse round trips (" +
+              std::to_string(mismatches.load()) + " mismatches)");
+    }
+
+    return finish();
+}
@@ -0,0 +1,256 @@
+#include "timestamp.h"
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm)
+long long daysFromCivil(long long y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const long long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long long>(doe) - 719468;
+}
+
+void civilFromDays(long long z, long long& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    const long long era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<long long>(yoe) + era * 400 + (m <= 2);
+}
+
+bool isLeap(long long y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+unsigned daysInMonth(long long y, unsigned m) {
+    static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return (m == 2 && isLeap(y)) ? 29 : days[m - 1];
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Reads exactly `width` digits at pos, advancing it
+bool readFixed(std::string_view s, size_t& pos, size_t width, unsigned& out) {
+    if (pos + width > s.size()) return false;
+    unsigned v = 0;
+    for (size_t i = 0; i < width; ++i) {
+        char c = s[pos + i];
+        if (!isDigit(c)) return false;
+        v = v * 10 + static_cast<unsigned>(c - '0');
+    }
+    out = v;
+    pos += width;
+    return true;
+}
+
+bool expect(std::string_view s, size_t& pos, char c) {
+    if (pos >= s.size() || s[pos] != c) return false;
+    ++pos;
+    return true;
+}
+
+// Two-digit field into a fixed-size buffer
+void put2(char* p, unsigned v) {
+    p[0] = static_cast<char>('0' + v / 10);
+    p[1] = static_cast<char>('0' + v % 10);
+}
+
+} // namespace
+
+long TimestampCodec::utcOffsetSeconds(long long epochSeconds) {
+    struct Cached {
+        long long second = LLONG_MIN;
+        long offset = 0;
+    };
+    thread_local Cached cache;
+
+    if (cache.second != epochSeconds) {
+        std::time_t t = static_cast<std::time_t>(epochSeconds);
+        std::tm tm{};
+        long offset = 0;
+        if (localtime_r(&t, &tm) != nullptr) {
+            offset = tm.tm_gmtoff;
+        }
+        cache.second = epochSeconds;
+        cache.offset = offset;
+    }
+    return cache.offset;
+}
+
+std::optional<TimestampCodec::TimePoint> TimestampCodec::parse(std::string_view text) {
+    while (!text.empty() && text.front() == ' ') text.remove_prefix(1);
+    while (!text.empty() && text.back() == ' ') text.remove_suffix(1);
+    if (text.empty()) return std::nullopt;
+
+    // A calendar date always has '-' after four digits; epoch values never do
+    if (text.size() >= 5 && text[4] == '-') {
+        return parseCalendar(text);
+    }
+    return parseEpoch(text);
+}
+
+std::optional<TimestampCodec::TimePoint> TimestampCodec::parseEpoch(std::string_view text) {
+    bool micros = false;
+    if (text.size() > 2 && text.substr(text.size() - 2) == "us") {
+        micros = true;
+        text.remove_suffix(2);
+    } else if (text.size() > 2 && text.substr(text.size() - 2) == "ms") {
+        text.remove_suffix(2);
+    }
+
+    bool negative = false;
+    if (!text.empty() && text.front() == '-') {
+        negative = true;
+        text.remove_prefix(1);
+    }
+    // 18 digits cannot overflow a signed 64-bit value
+    if (text.empty() || text.size() > 18) return std::nullopt;
+
+    long long value = 0;
+    for (char c : text) {
+        if (!isDigit(c)) return std::nullopt;
+        value = value * 10 + (c - '0');
+    }
+    if (negative) value = -value;
+
+    if (micros) {
+        return TimePoint(std::chrono::duration_cast<TimePoint::duration>(
+            std::chrono::microseconds(value)));
+    }
+    return TimePoint(std::chrono::duration_cast<TimePoint::duration>(
+        std::chrono::milliseconds(value)));
+}
+
+std::optional<TimestampCodec::TimePoint> TimestampCodec::parseCalendar(std::string_view text) {
+    size_t pos = 0;
+    unsigned year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    if (!readFixed(text, pos, 4, year) || !expect(text, pos, '-') ||
+        !readFixed(text, pos, 2, month) || !expect(text, pos, '-') ||
+        !readFixed(text, pos, 2, day)) {
+        return std::nullopt;
+    }
+    if (pos >= text.size() || (text[pos] != ' ' && text[pos] != 'T' && text[pos] != 't')) {
+        return std::nullopt;
+    }
+    ++pos;
+    if (!readFixed(text, pos, 2, hour) || !expect(text, pos, ':') ||
+        !readFixed(text, pos, 2, minute) || !expect(text, pos, ':') ||
+        !readFixed(text, pos, 2, second)) {
+        return std::nullopt;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) ||
+        hour > 23 || minute > 59 || second > 60) {
+        return std::nullopt;
+    }
+
+    // Fractional seconds: any number of digits, kept to nanosecond precision
+    long long nanos = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        size_t digits = 0;
+        long long scale = 100000000;
+        while (pos < text.size() && isDigit(text[pos])) {
+            if (digits < 9) {
+                nanos += (text[pos] - '0') * scale;
+                scale /= 10;
+            }
+            ++digits;
+            ++pos;
+        }
+        if (digits == 0) return std::nullopt;
+    }
+
+    long long local = daysFromCivil(year, month, day) * 86400LL +
+                      hour * 3600LL + minute * 60LL + second;
+    long long utc;
+
+    if (pos == text.size()) {
+        // No zone designator: local wall-clock time. Resolve the offset at the
+        // guessed instant, then once more in case that guess crossed a DST change.
+        long long guess = local - utcOffsetSeconds(local);
+        utc = local - utcOffsetSeconds(guess);
+    } else if (text[pos] == 'Z' || text[pos] == 'z') {
+        ++pos;
+        utc = local;
+    } else if (text[pos] == '+' || text[pos] == '-') {
+        int sign = text[pos] == '-' ? -1 : 1;
+        ++pos;
+        unsigned offHour = 0, offMinute = 0;
+        if (!readFixed(text, pos, 2, offHour)) return std::nullopt;
+        expect(text, pos, ':');
+        if (!readFixed(text, pos, 2, offMinute) || offHour > 23 || offMinute > 59) {
+            return std::nullopt;
+        }
+        utc = local - sign * static_cast<long long>(offHour * 3600 + offMinute * 60);
+    } else {
+        return std::nullopt;
+    }
+    if (pos != text.size()) return std::nullopt;
+
+    return TimePoint(std::chrono::duration_cast<TimePoint::duration>(
+        std::chrono::seconds(utc) + std::chrono::nanoseconds(nanos)));
+}
+
+size_t TimestampCodec::format(TimePoint tp, char (&buf)[kFormattedSize]) {
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        tp.time_since_epoch()).count();
+    // Floor division so pre-1970 instants keep a positive millisecond field
+    long long secs = ms / 1000;
+    long long millis = ms % 1000;
+    if (millis < 0) {
+        millis += 1000;
+        --secs;
+    }
+
+    long long local = secs + utcOffsetSeconds(secs);
+    long long days = local / 86400;
+    long long rem = local % 86400;
+    if (rem < 0) {
+        rem += 86400;
+        --days;
+    }
+
+    long long year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    if (year < 0 || year > 9999) {
+        std::memcpy(buf, "0000-00-00 00:00:00.000", kFormattedSize);
+        return kFormattedSize - 1;
+    }
+
+    unsigned y = static_cast<unsigned>(year);
+    put2(buf, y / 100);
+    put2(buf + 2, y % 100);
+    buf[4] = '-';
+    put2(buf + 5, month);
+    buf[7] = '-';
+    put2(buf + 8, day);
+    buf[10] = ' ';
+    put2(buf + 11, static_cast<unsigned>(rem / 3600));
+    buf[13] = ':';
+    put2(buf + 14, static_cast<unsigned>((rem / 60) % 60));
+    buf[16] = ':';
+    put2(buf + 17, static_cast<unsigned>(rem % 60));
+    buf[19] = '.';
+    buf[20] = static_cast<char>('0' + millis / 100);
+    put2(buf + 21, static_cast<unsigned>(millis % 100));
+    buf[23] = '\0';
+    return kFormattedSize - 1;
+}
+
+std::string TimestampCodec::format(TimePoint tp) {
+    char buf[kFormattedSize];
+    size_t len = format(tp, buf);
+    return std::string(buf, len);
+}
@@ -0,0 +1,228 @@
+#include "version_chain.h"
+#include <algorithm>
+
+VersionChain::VersionChain(std::vector<Version>&& versions) {
+    for (auto& version : versions) {
+        append(std::move(version));
+    }
+    versions.clear();
+}
+
+void VersionChain::Chunk::updateBounds() {
+    if (start >= versions.size()) {
+        return;
+    }
+    minTs = maxTs = versions[start].timestamp;
+    for (size_t i = start + 1; i < versions.size(); ++i) {
+        minTs = std::min(minTs, versions[i].timestamp);
+        maxTs = std::max(maxTs, versions[i].timestamp);
+    }
+}
+
+VersionChain::Chunk& VersionChain::tailForAppend() {
+    if (chunks_.empty() || chunks_.back()->versions.size() == kChunkSize) {
+        auto chunk = std::make_unique<Chunk>();
+        // Later chunks are allocated whole, so they never reallocate
+        chunk->versions.reserve(chunks_.empty() ? 1 : kChunkSize);
+        chunks_.push_back(std::move(chunk));
+        return *chunks_.back();
+    }
+    Chunk& tail = *chunks_.back();
+    if (tail.versions.size() == tail.versions.capacity()) {
+        tail.versions.reserve(std::min(kChunkSize, tail.versions.capacity() * 2));
+    }
+    return tail;
+}
+
+void VersionChain::append(std::chrono::system_clock::time_point timestamp,
+                          const std::string& value) {
+    append(Version(timestamp, value));
+}
+
+void VersionChain::append(Version&& version) {
+    Chunk& tail = tailForAppend();
+    const auto timestamp = version.timestamp;
+    tail.versions.push_back(std::move(version));
+    if (tail.live() == 1) {
+        tail.minTs = tail.maxTs = timestamp;
+    } else {
+        tail.minTs = std::min(tail.minTs, timestamp);
+        tail.maxTs = std::max(tail.maxTs, timestamp);
+    }
+    ++size_;
+}
+
+void VersionChain::locate(size_t index, size_t& chunk, size_t& offset) const {
+    const Chunk& first = *chunks_.front();
+    if (index < first.live()) {
+        chunk = 0;
+        offset = first.start + index;
+        return;
+    }
+    index -= first.live();
+    chunk = 1 + index / kChunkSize;
+    offset = index % kChunkSize;
+}
+
+const Version& VersionChain::operator[](size_t index) const {
+    size_t chunk, offset;
+    locate(index, chunk, offset);
+    return chunks_[chunk]->versions[offset];
+}
+
+const Version& VersionChain::back() const {
+    return chunks_.back()->versions.back();
+}
+
+void VersionChain::prefetchBack(int step) const {
+    if (size_ == 0) {
+        return;
+    }
+    switch (step) {
+    case 0:
+        prefetchForRead(&chunks_.back());
+        break;
+    case 1:
+        prefetchForRead(chunks_.back().get());
+        break;
+    case 2:
+        prefetchForRead(&chunks_.back()->versions.back());
+        break;
+    case 3:
+        prefetchForRead(back().value.data());
+        break;
+    default:
+        break;
+    }
+}
+
+template <typename Before>
+size_t VersionChain::partitionPoint(size_t from, Before before) const {
+    if (from >= size_) {
+        return size_;
+    }
+    size_t firstChunk, firstOffset;
+    locate(from, firstChunk, firstOffset);
+
+    // Skip every chunk whose newest version is still before the bound
+    size_t lo = firstChunk, hi = chunks_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (before(chunks_[mid]->maxTs)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == chunks_.size()) {
+        return size_;
+    }
+
+    const Chunk& chunk = *chunks_[lo];
+    size_t offset = lo == firstChunk ? firstOffset : chunk.start;
+    if (before(chunk.minTs)) {
+        // The bound falls inside this chunk
+        auto it = std::partition_point(chunk.versions.begin() + offset, chunk.versions.end(),
+                                       [&](const Version& v) { return before(v.timestamp); });
+        offset = it - chunk.versions.begin();
+    }
+    if (lo == 0) {
+        return offset - chunk.start;
+    }
+    return chunks_.front()->live() + (lo - 1) * kChunkSize + offset;
+}
+
+size_t VersionChain::upperBound(std::chrono::system_clock::time_point ts, size_t from) const {
+    return partitionPoint(from, [ts](std::chrono::system_clock::time_point t) { return t <= ts; });
+}
+
+size_t VersionChain::lowerBound(std::chrono::system_clock::time_point ts, size_t from) const {
+    return partitionPoint(from, [ts](std::chrono::system_clock::time_point t) { return t < ts; });
+}
+
+void VersionChain::dropFront(size_t count) {
+    count = std::min(count, size_);
+    size_t whole = 0;
+    while (whole < chunks_.size() && count >= chunks_[whole]->live()) {
+        count -= chunks_[whole]->live();
+        size_ -= chunks_[whole]->live();
+        ++whole;
+    }
+    chunks_.erase(chunks_.begin(), chunks_.begin() + whole);
+    if (count == 0) {
+        return;
+    }
+    // Release the trimmed values now rather than when the chunk goes
+    Chunk& first = *chunks_.front();
+    for (size_t i = first.start; i < first.start + count; ++i) {
+        std::string().swap(first.versions[i].value);
+    }
+    first.start += static_cast<uint32_t>(count);
+    size_ -= count;
+    first.updateBounds();
+}
+
+void VersionChain::clear() {
+    chunks_.clear();
+    size_ = 0;
+}
+
+uint64_t VersionChain::compact() {
+    uint64_t released = 0;
+    if (chunks_.empty()) {
+        return 0;
+    }
+    Chunk& first = *chunks_.front();
+    if (first.start > 0) {
+        // Copy rather than move, so live values leave the pages their
+        // trimmed neighbours were freed from. Only the tail chunk is ever
+        // appended to, and it grows back by doubling.
+        std::vector<Version> live;
+        live.reserve(first.live());
+        for (size_t i = first.start; i < first.versions.size(); ++i) {
+            live.emplace_back(first.versions[i].timestamp, std::string(first.versions[i].value));
+            live.back().blob = first.versions[i].blob;
+        }
+        released += (first.versions.capacity() - live.capacity()) * sizeof(Version);
+        first.versions.swap(live);
+        first.start = 0;
+    }
+    Chunk& last = *chunks_.back();
+    if (last.versions.capacity() - last.versions.size() >= kChunkSize / 2) {
+        size_t before = last.versions.capacity();
+        last.versions.shrink_to_fit();
+        released += (before - last.versions.capacity()) * sizeof(Version);
+    }
+    if (chunks_.capacity() > 2 * chunks_.size()) {
+        size_t before = chunks_.capacity();
+        chunks_.shrink_to_fit();
+        released += (before - chunks_.capacity()) * sizeof(chunks_[0]);
+    }
+    return released;
+}
+
+std::vector<Version> VersionChain::copyOut(size_t from) const {
+    std::vector<Version> out;
+    if (from >= size_) {
+        return out;
+    }
+    out.reserve(size_ - from);
+    size_t chunk, offset;
+    locate(from, chunk, offset);
+    for (; chunk < chunks_.size(); ++chunk, offset = 0) {
+        const auto& versions = chunks_[chunk]->versions;
+        out.insert(out.end(), versions.begin() + offset, versions.end());
+    }
+    return out;
+}
+
+std::vector<Version> VersionChain::release() {
+    std::vector<Version> out;
+    out.reserve(size_);
+    for (auto& chunk : chunks_) {
+        std::move(chunk->versions.begin() + chunk->start, chunk->versions.end(),
+                  std::back_inserter(out));
+    }
+    clear();
+    return out;
+}
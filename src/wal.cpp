@@ -1,16 +1,106 @@
 #include "wal.h"
+#include "backup.h"
+#include "io_scheduler.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <unordered_set>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cerrno>
 #include <cstring>
 #include <cctype>
+#include <cstdio>
 #include <iomanip>
 
-WAL::WAL(const std::string& path) : walPath(path), enabled(false) {
+namespace {
+
+const char* const kManifestMagic = "SNAPSHOT 1";
+
+size_t defaultSnapshotPartitions() {
+    return std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 8);
+}
+
+bool readWholeFile(const std::string& path, std::string& contents) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0;
+    if (ok) {
+        contents.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (ok && done < contents.size()) {
+            ssize_t n = ::read(fd, &contents[done], contents.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            if (ok) done += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+std::string hex32(uint32_t value) {
+    char buf[9];
+    std::snprintf(buf, sizeof(buf), "%08x", value);
+    return buf;
+}
+
+// Writes one snapshot file a chunk at a time at the rate the I/O scheduler
+// grants, each chunk's writeback started at once, so the final fsync finds
+// little left to flush and commits keep their disk time
+class SnapshotFileWriter {
+public:
+    SnapshotFileWriter(int fd, IoScheduler* io) : fd_(fd), io_(io) {}
+
+    std::string& buffer() { return buf_; }
+
+    // Write the buffer out once it holds at least atLeast bytes
+    void flush(size_t atLeast) {
+        if (!ok_ || buf_.empty() || buf_.size() < atLeast) {
+            return;
+        }
+        if (io_ != nullptr) {
+            io_->acquire(buf_.size());
+        }
+        size_t done = 0;
+        while (done < buf_.size()) {
+            ssize_t n = ::write(fd_, buf_.data() + done, buf_.size() - done);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok_ = false;
+                return;
+            }
+            done += static_cast<size_t>(n);
+        }
+        IoScheduler::startWriteback(fd_, written_, buf_.size());
+        crc_ = BackupRestore::crc32(buf_.data(), buf_.size(), crc_);
+        written_ += buf_.size();
+        buf_.clear();
+    }
+
+    bool ok() const { return ok_; }
+    uint64_t bytes() const { return written_; }
+    uint32_t crc() const { return crc_; }
+
+private:
+    int fd_;
+    IoScheduler* io_;
+    std::string buf_;
+    uint64_t written_ = 0;
+    uint32_t crc_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace
+
+WAL::WAL(const std::string& path)
+    : walPath(path), enabled(false), snapshotPartitions_(defaultSnapshotPartitions()) {
     // Derive snapshot path from WAL path
     size_t lastSlash = path.find_last_of("/\\");
     if (lastSlash != std::string::npos) {
@@ -30,6 +120,8 @@ WAL::~WAL() {
     if (flushThread_.joinable()) {
         flushThread_.join();
     }
+    // Nothing will fsync after this point; release anyone still waiting
+    runDurableWaiters(UINT64_MAX, !syncFailed_.load(std::memory_order_acquire));
 
     if (logFile.is_open()) {
         try {
@@ -68,12 +160,259 @@ void WAL::flushThreadFunc() {
 
         if (pendingFlush_) {
             pendingFlush_ = false;
+            auto preSync = preSync_;
+            auto io = io_;
             lock.unlock();
+            // Records up to this LSN were already handed to the kernel by
+            // appendRecord(), so one fsync makes all of them durable
+            uint64_t target = lastLsn_.load(std::memory_order_acquire);
+            if (preSync) {
+                preSync();
+            }
+            // If clearLog() swapped the file since target was read, the
+            // records it dropped are covered by the snapshot it installed
+            std::unique_lock<std::mutex> fdLock(logFdMutex_);
             if (logFd_ != -1) {
-                ::fsync(logFd_);
+                auto started = std::chrono::steady_clock::now();
+                if (::fsync(logFd_) != 0) {
+                    const int error = errno;
+                    fdLock.unlock();
+                    // The kernel may have dropped the dirty pages, and a retry
+                    // would prove nothing: stop acknowledging anything as durable
+                    std::cerr << "Error: WAL fsync failed, disabling the WAL: " << strerror(error) << "\n";
+                    syncFailed_.store(true, std::memory_order_release);
+                    runDurableWaiters(UINT64_MAX, false);
+                    continue;
+                }
+                if (io) {
+                    io->recordSyncLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - started));
+                }
+            }
+            fdLock.unlock();
+            if (syncFailed_.load(std::memory_order_acquire)) {
+                continue;
             }
+            durableLsn_.store(target, std::memory_order_release);
+            runDurableWaiters(target, true);
+        }
+    }
+}
+
+void WAL::runDurableWaiters(uint64_t durable, bool synced) {
+    std::vector<std::function<void(bool)>> ready;
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+        auto end = durableWaiters_.upper_bound(durable);
+        for (auto it = durableWaiters_.begin(); it != end; ++it) {
+            ready.push_back(std::move(it->second));
         }
+        durableWaiters_.erase(durableWaiters_.begin(), end);
     }
+    for (auto& callback : ready) {
+        callback(synced);
+    }
+}
+
+uint64_t WAL::lastLsn() const {
+    return lastLsn_.load(std::memory_order_acquire);
+}
+
+uint64_t WAL::durableLsn() const {
+    return durableLsn_.load(std::memory_order_acquire);
+}
+
+bool WAL::syncFailed() const {
+    return syncFailed_.load(std::memory_order_acquire);
+}
+
+void WAL::setBaseLsn(uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    // A log that is still empty gets its header here rather than in
+    // clearLog(), so its first record's LSN is known too
+    if (enabled && logFile.is_open() && logBytes_ == 0) {
+        const std::string header = "BASE " + std::to_string(lsn);
+        logFile << header << " CRC:" << hex32(computeCRC32(header)) << "\n";
+        logFile.flush();
+        if (!logFile.fail()) {
+            logBytes_ += header.size() + 14;
+        }
+    }
+    lastLsn_.store(lsn, std::memory_order_release);
+    durableLsn_.store(lsn, std::memory_order_release);
+}
+
+void WAL::onDurable(uint64_t lsn, std::function<void(bool)> callback) {
+    if (enabled) {
+        std::unique_lock<std::mutex> lock(flushMutex_);
+        if (syncFailed_.load(std::memory_order_acquire)) {
+            lock.unlock();
+            callback(false);
+            return;
+        }
+        if (durableLsn_.load(std::memory_order_acquire) < lsn) {
+            durableWaiters_.emplace(lsn, std::move(callback));
+            pendingFlush_ = true;
+            flushCV_.notify_one();
+            return;
+        }
+    }
+    callback(true);
+}
+
+bool WAL::waitDurable(uint64_t lsn, std::chrono::milliseconds timeout) {
+    auto state = std::make_shared<std::pair<std::mutex, std::condition_variable>>();
+    auto done = std::make_shared<bool>(false);
+    auto synced = std::make_shared<bool>(false);
+    onDurable(lsn, [state, done, synced](bool durable) {
+        std::lock_guard<std::mutex> lock(state->first);
+        *done = true;
+        *synced = durable;
+        state->second.notify_all();
+    });
+    std::unique_lock<std::mutex> lock(state->first);
+    return state->second.wait_for(lock, timeout, [&done] { return *done; }) && *synced;
+}
+
+void WAL::setPreSync(std::function<void()> hook) {
+    std::lock_guard<std::mutex> lock(flushMutex_);
+    preSync_ = std::move(hook);
+}
+
+void WAL::setRecordHook(std::function<void(uint64_t, const std::string&)> hook) {
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    recordHook_ = std::move(hook);
+}
+
+void WAL::setIoScheduler(std::shared_ptr<IoScheduler> io) {
+    std::lock_guard<std::mutex> lock(flushMutex_);
+    io_ = std::move(io);
+}
+
+bool WAL::openBackupPoint(WALBackupPoint& point) {
+    if (!enabled) {
+        return false;
+    }
+    // Snapshot first, then appends: the same order createSnapshot() takes them
+    std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
+
+    point = WALBackupPoint{};
+    point.walFd = ::open(walPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (point.walFd == -1) {
+        return false;
+    }
+    point.walBytes = logBytes_;
+    point.lsn = lastLsn_.load(std::memory_order_acquire);
+
+    point.snapshotFd = ::open(snapshotPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (point.snapshotFd != -1) {
+        struct stat st;
+        if (::fstat(point.snapshotFd, &st) == 0) {
+            point.snapshotBytes = static_cast<uint64_t>(st.st_size);
+        }
+    }
+    // A partitioned snapshot's files travel with its manifest
+    SnapshotManifest manifest;
+    if (readSnapshotManifest(manifest) == Status::OK) {
+        for (const auto& part : manifest.parts) {
+            WALBackupPoint::File file;
+            file.name = part.name;
+            file.fd = ::open(dataPath(part.name).c_str(), O_RDONLY | O_CLOEXEC);
+            file.bytes = part.bytes;
+            if (file.fd != -1) {
+                point.files.push_back(file);
+            }
+        }
+    }
+    return true;
+}
+
+// The log stream could not take a record (ENOSPC, EIO). Part of it may be in
+// the file, where replay drops it on its checksum; nothing appended after it
+// could be trusted, so the WAL stops as after a failed fsync. The record got
+// no LSN and never reached the record hook. Called without appendMutex_, as
+// waiters may append from their callbacks.
+Status WAL::failAppend(int error) {
+    std::cerr << "Error: WAL write failed, disabling the WAL: " << strerror(error) << "\n";
+    runDurableWaiters(UINT64_MAX, false);
+    return Status::ERROR;
+}
+
+Status WAL::appendRecord(const std::string& content) {
+    if (!enabled || !logFile.is_open() || syncFailed_.load(std::memory_order_acquire)) {
+        return Status::ERROR;
+    }
+    uint32_t crc = computeCRC32(content);
+    {
+        std::unique_lock<std::mutex> lock(appendMutex_);
+        logFile << content << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
+            << crc << std::dec << std::setfill(' ') << "\n";
+        logFile.flush(); // Hand the record to the kernel before it gets an LSN
+        if (logFile.fail()) {
+            const int error = errno;
+            syncFailed_.store(true, std::memory_order_release);
+            lock.unlock();
+            return failAppend(error);
+        }
+        logBytes_ += content.size() + 14;  // " CRC:" + 8 hex digits + '\n'
+        uint64_t lsn = lastLsn_.fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (recordHook_) {
+            recordHook_(lsn, content);
+        }
+    }
+    // Group commit: signal background thread to fsync within 5ms
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+        pendingFlush_ = true;
+    }
+    flushCV_.notify_one();
+    return Status::OK;
+}
+
+Status WAL::appendRecords(const std::vector<std::string>& contents) {
+    if (!enabled || !logFile.is_open() || syncFailed_.load(std::memory_order_acquire)) {
+        return Status::ERROR;
+    }
+    if (contents.empty()) {
+        return Status::OK;
+    }
+    // Checksums are computed before the lock, like appendRecord()
+    std::vector<uint32_t> crcs;
+    crcs.reserve(contents.size());
+    for (const auto& content : contents) {
+        crcs.push_back(computeCRC32(content));
+    }
+    {
+        std::unique_lock<std::mutex> lock(appendMutex_);
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < contents.size(); ++i) {
+            logFile << contents[i] << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
+                << crcs[i] << std::dec << std::setfill(' ') << "\n";
+            bytes += contents[i].size() + 14;
+        }
+        logFile.flush(); // The whole batch reaches the kernel before any of it gets an LSN
+        if (logFile.fail()) {
+            const int error = errno;
+            syncFailed_.store(true, std::memory_order_release);
+            lock.unlock();
+            return failAppend(error);
+        }
+        logBytes_ += bytes;
+        uint64_t lsn = lastLsn_.fetch_add(contents.size(), std::memory_order_acq_rel);
+        if (recordHook_) {
+            for (const auto& content : contents) {
+                recordHook_(++lsn, content);
+            }
+        }
+    }
+    // Group commit: signal background thread to fsync within 5ms
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+        pendingFlush_ = true;
+    }
+    flushCV_.notify_one();
+    return Status::OK;
 }
 
 Status WAL::initialize() {
@@ -98,6 +437,10 @@ Status WAL::initialize() {
             return Status::ERROR;
         }
         logFd_ = ::open(walPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        {
+            struct stat st;
+            logBytes_ = ::stat(walPath.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+        }
         flushShutdown_ = false;
         pendingFlush_ = false;
         flushThread_ = std::thread(&WAL::flushThreadFunc, this);
@@ -116,28 +459,18 @@ Status WAL::initialize() {
 
 Status WAL::logSet(const std::string& key, const std::string& value,
                    std::chrono::system_clock::time_point timestamp) {
-    if (!enabled || !logFile.is_open()) {
+    try {
+        return appendRecord(setRecord(key, value, timestamp));
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
     }
-    
+}
+
+Status WAL::logSetRef(const std::string& key, const std::string& ref,
+                      std::chrono::system_clock::time_point timestamp) {
     try {
-        // Convert timestamp to epoch milliseconds
-        auto epochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-            timestamp.time_since_epoch()).count();
-        
-        // Format: SET key value timestamp_ms
-        std::string content = "SET " + key + " " + value + " " + std::to_string(epochMs);
-        uint32_t crc = computeCRC32(content);
-        logFile << content << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
-            << crc << std::dec << std::setfill(' ') << "\n";
-        logFile.flush(); // Ensure it's written to disk
-        // Group commit: signal background thread to fsync within 5ms
-        {
-            std::lock_guard<std::mutex> lock(flushMutex_);
-            pendingFlush_ = true;
-        }
-        flushCV_.notify_one();
-        return Status::OK;
+        return appendRecord(setRecord(key, ref, timestamp, true));
     } catch (const std::exception& e) {
         std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
@@ -145,23 +478,22 @@ Status WAL::logSet(const std::string& key, const std::string& value,
 }
 
 Status WAL::logDel(const std::string& key) {
-    if (!enabled || !logFile.is_open()) {
+    try {
+        return appendRecord("DEL " + key);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
     }
-    
+}
+
+Status WAL::logDelPrefix(const std::string& prefix,
+                         std::chrono::system_clock::time_point timestamp) {
     try {
-        std::string content = "DEL " + key;
-        uint32_t crc = computeCRC32(content);
-        logFile << content << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
-            << crc << std::dec << std::setfill(' ') << "\n";
-        logFile.flush(); // Ensure it's written to disk
-        // Group commit: signal background thread to fsync within 5ms
-        {
-            std::lock_guard<std::mutex> lock(flushMutex_);
-            pendingFlush_ = true;
-        }
-        flushCV_.notify_one();
-        return Status::OK;
+        auto epochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            timestamp.time_since_epoch()).count();
+        
+        // Format: DELPREFIX prefix timestamp_ms
+        return appendRecord("DELPREFIX " + prefix + " " + std::to_string(epochMs));
     } catch (const std::exception& e) {
         std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
@@ -169,23 +501,8 @@ Status WAL::logDel(const std::string& key) {
 }
 
 Status WAL::logPolicy(const std::string& policyName) {
-    if (!enabled || !logFile.is_open()) {
-        return Status::ERROR;
-    }
-    
     try {
-        std::string content = "POLICY SET " + policyName;
-        uint32_t crc = computeCRC32(content);
-        logFile << content << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
-            << crc << std::dec << std::setfill(' ') << "\n";
-        logFile.flush(); // Ensure it's written to disk
-        // Group commit: signal background thread to fsync within 5ms
-        {
-            std::lock_guard<std::mutex> lock(flushMutex_);
-            pendingFlush_ = true;
-        }
-        flushCV_.notify_one();
-        return Status::OK;
+        return appendRecord("POLICY SET " + policyName);
     } catch (const std::exception& e) {
         std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
@@ -194,37 +511,55 @@ Status WAL::logPolicy(const std::string& policyName) {
 
 Status WAL::logGuardAdd(const std::string& guardType, const std::string& guardName,
                         const std::string& keyPattern, const std::string& params) {
-    if (!enabled || !logFile.is_open()) {
+    try {
+        return appendRecord("GUARD ADD " + guardType + " " + guardName + " "
+            + keyPattern + " " + params);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Failed to write guard to WAL: " << e.what() << "\n";
         return Status::ERROR;
     }
-    
+}
+
+Status WAL::logRecord(const std::string& record) {
     try {
-        std::string content = "GUARD ADD " + guardType + " " + guardName + " "
-            + keyPattern + " " + params;
-        uint32_t crc = computeCRC32(content);
-        logFile << content << " CRC:" << std::hex << std::setw(8) << std::setfill('0')
-                << crc << std::dec << std::setfill(' ') << "\n";
-        logFile.flush();
-        // Group commit: signal background thread to fsync within 5ms
-        {
-            std::lock_guard<std::mutex> lock(flushMutex_);
-            pendingFlush_ = true;
-        }
-        flushCV_.notify_one();
-        return Status::OK;
+        return appendRecord(record);
     } catch (const std::exception& e) {
-        std::cerr << "Warning: Failed to write guard to WAL: " << e.what() << "\n";
+        std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
         return Status::ERROR;
     }
 }
 
-std::vector<std::string> WAL::readLog() {
+std::string WAL::setRecord(const std::string& key, const std::string& value,
+                           std::chrono::system_clock::time_point timestamp, bool ref) {
+    auto epochMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        timestamp.time_since_epoch()).count();
+    // Format: SET key value timestamp_ms, or SETREF key file:offset:length:crc timestamp_ms
+    return (ref ? "SETREF " : "SET ") + key + " " + value + " " + std::to_string(epochMs);
+}
+
+Status WAL::logRecords(const std::vector<std::string>& records) {
+    try {
+        return appendRecords(records);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Failed to write to WAL: " << e.what() << "\n";
+        return Status::ERROR;
+    }
+}
+
+std::vector<std::string> WAL::readLog(uint64_t* baseLsn) {
+    return readLogRecords(true, baseLsn);
+}
+
+std::vector<std::string> WAL::readLogRecords(bool report, uint64_t* baseLsn) {
     std::vector<std::string> commands;
     size_t checksumErrors = 0;
+    bool firstRecord = true;
     
     try {
         if (!fileExists(walPath)) {
-            std::cout << "No existing WAL file found (starting fresh)\n";
+            if (report) {
+                std::cout << "No existing WAL file found (starting fresh)\n";
+            }
             return commands;
         }
         
@@ -258,8 +593,18 @@ std::vector<std::string> WAL::readLog() {
                             if (actualCrc != expectedCrc) {
                                 std::cerr << "Warning: WAL checksum mismatch, skipping corrupt record\n";
                                 checksumErrors++;
+                                firstRecord = false;
                                 continue;
                             }
+                            // The header clearLog() and setBaseLsn() write
+                            if (firstRecord && content.compare(0, 5, "BASE ") == 0) {
+                                firstRecord = false;
+                                if (baseLsn != nullptr) {
+                                    *baseLsn = std::stoull(content.substr(5));
+                                }
+                                continue;
+                            }
+                            firstRecord = false;
                             commands.push_back(content);
                             continue;
                         } catch (...) {
@@ -269,6 +614,7 @@ std::vector<std::string> WAL::readLog() {
                 }
 
                 // Legacy record without CRC field (backward compatible)
+                firstRecord = false;
                 commands.push_back(line);
             }
         }
@@ -280,7 +626,7 @@ std::vector<std::string> WAL::readLog() {
                       << " WAL records had checksum errors and were skipped (possible corruption)\n";
         }
         
-        if (!commands.empty()) {
+        if (report && !commands.empty()) {
             std::cout << "Loaded " << commands.size() << " commands from WAL\n";
         }
         
@@ -300,6 +646,36 @@ std::vector<std::string> WAL::readSnapshot() {
             return commands;
         }
         
+        SnapshotManifest manifest;
+        Status format = readSnapshotManifest(manifest);
+        if (format == Status::ERROR) {
+            return commands;
+        }
+        if (format == Status::OK) {
+            commands.push_back("LSN " + std::to_string(manifest.lsn));
+            if (!manifest.policy.empty()) {
+                commands.push_back("POLICY SET " + manifest.policy);
+            }
+            std::string contents;
+            for (const auto& part : manifest.parts) {
+                if (!readSnapshotPart(part, contents)) {
+                    continue;
+                }
+                size_t pos = 0;
+                while (pos < contents.size()) {
+                    size_t eol = contents.find('\n', pos);
+                    if (eol == std::string::npos) eol = contents.size();
+                    if (eol > pos) {
+                        commands.emplace_back(contents, pos, eol - pos);
+                    }
+                    pos = eol + 1;
+                }
+            }
+            std::cout << "Loaded snapshot with " << commands.size() << " keys from "
+                      << manifest.parts.size() << " partitions\n";
+            return commands;
+        }
+        
         std::ifstream inFile(snapshotPath);
         if (!inFile.is_open()) {
             std::cerr << "Warning: Failed to open snapshot for reading: " << snapshotPath << "\n";
@@ -326,40 +702,203 @@ std::vector<std::string> WAL::readSnapshot() {
     return commands;
 }
 
+bool WAL::parseManifest(const std::string& text, SnapshotManifest& manifest) {
+    // Everything before the END line is covered by its checksum
+    size_t endLine = text.rfind("\nEND ");
+    if (endLine == std::string::npos) {
+        return false;
+    }
+    const std::string body = text.substr(0, endLine + 1);
+    uint32_t crc = static_cast<uint32_t>(std::strtoul(text.c_str() + endLine + 5, nullptr, 16));
+    if (BackupRestore::crc32(body.data(), body.size()) != crc) {
+        return false;
+    }
+    
+    manifest = SnapshotManifest{};
+    std::istringstream in(body);
+    std::string line;
+    std::getline(in, line);
+    if (line.compare(0, std::strlen(kManifestMagic), kManifestMagic) != 0 ||
+        !(std::istringstream(line.substr(std::strlen(kManifestMagic))) >> manifest.generation)) {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string tag;
+        fields >> tag;
+        if (tag == "LSN") {
+            fields >> manifest.lsn;
+        } else if (tag == "POLICY") {
+            std::string subCmd;
+            fields >> subCmd >> manifest.policy;
+        } else if (tag == "PART") {
+            SnapshotManifest::Part part;
+            std::string hex;
+            if (!(fields >> part.name >> part.bytes >> part.keys >> hex) ||
+                !isSnapshotPartName(part.name)) {
+                return false;
+            }
+            part.crc = static_cast<uint32_t>(std::strtoul(hex.c_str(), nullptr, 16));
+            manifest.parts.push_back(std::move(part));
+        }
+    }
+    return true;
+}
+
+Status WAL::readSnapshotManifest(SnapshotManifest& manifest) {
+    std::string text;
+    if (!readWholeFile(snapshotPath, text) ||
+        text.compare(0, std::strlen(kManifestMagic), kManifestMagic) != 0) {
+        return Status::NOT_FOUND;
+    }
+    if (!parseManifest(text, manifest)) {
+        std::cerr << "Error: Snapshot manifest is damaged: " << snapshotPath << "\n";
+        return Status::ERROR;
+    }
+    return Status::OK;
+}
+
+bool WAL::readSnapshotPart(const SnapshotManifest::Part& part, std::string& contents) {
+    const std::string path = dataPath(part.name);
+    if (!readWholeFile(path, contents)) {
+        std::cerr << "Error: Failed to read snapshot partition: " << path << "\n";
+        return false;
+    }
+    if (contents.size() != part.bytes ||
+        BackupRestore::crc32(contents.data(), contents.size()) != part.crc) {
+        std::cerr << "Error: Snapshot partition doesn't match its checksum: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
 Status WAL::createSnapshot(const std::unordered_map<std::string, std::string>& data,
-                          const std::string& currentPolicy) {
+                          const std::string& currentPolicy,
+                          const std::unordered_map<std::string, std::string>& blobRefs,
+                          std::optional<uint64_t> lsn) {
+    std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
     try {
-        // Open snapshot file for writing (truncate mode)
-        std::ofstream snapFile(snapshotPath, std::ios::trunc);
-        if (!snapFile.is_open()) {
-            std::cerr << "Error: Failed to create snapshot file: " << snapshotPath << "\n";
+        std::shared_ptr<IoScheduler> io;
+        {
+            std::lock_guard<std::mutex> lock(flushMutex_);
+            io = io_;
+        }
+        
+        // New files under a new generation's names: the installed snapshot,
+        // and readers holding it open (backups), keep theirs until the
+        // manifest is replaced
+        SnapshotManifest previous;
+        readSnapshotManifest(previous);
+        SnapshotManifest manifest;
+        manifest.generation = previous.generation + 1;
+        // LSN the snapshot covers, so numbering survives the WAL truncation
+        manifest.lsn = lsn ? *lsn : lastLsn();
+        manifest.policy = currentPolicy;
+        const size_t partitions = snapshotPartitions_;
+        manifest.parts.resize(partitions);
+        
+        // Partition i takes the i-th share of the buckets of each map, a
+        // split by key hash that costs no extra pass over the keys. Every
+        // writer paces itself against the same I/O budget.
+        std::atomic<bool> failed{false};
+        auto writePart = [&](size_t index) {
+            SnapshotManifest::Part& part = manifest.parts[index];
+            part.name = snapshotPartName(manifest.generation, index);
+            int fd = ::open(dataPath(part.name).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd == -1) {
+                failed = true;
+                return;
+            }
+            SnapshotFileWriter out(fd, io.get());
+            auto writeBuckets = [&](const std::unordered_map<std::string, std::string>& map,
+                                    const char* command) {
+                const size_t buckets = map.bucket_count();
+                const size_t last = buckets * (index + 1) / partitions;
+                for (size_t b = buckets * index / partitions; b < last && out.ok(); ++b) {
+                    for (auto it = map.begin(b); it != map.end(b); ++it) {
+                        out.buffer().append(command).append(it->first).append(" ")
+                            .append(it->second).append("\n");
+                        ++part.keys;
+                        out.flush(IoScheduler::kMaxGrant);
+                    }
+                }
+            };
+            try {
+                writeBuckets(data, "SET ");
+                writeBuckets(blobRefs, "SETREF ");
+                out.flush(1);
+            } catch (const std::exception&) {
+                failed = true;
+            }
+            // fsync: force kernel buffer to physical disk
+            if (!out.ok() || ::fsync(fd) != 0) {
+                failed = true;
+            }
+            ::close(fd);
+            part.bytes = out.bytes();
+            part.crc = out.crc();
+        };
+        std::vector<std::thread> writers;
+        for (size_t i = 1; i < partitions; ++i) {
+            writers.emplace_back(writePart, i);
+        }
+        writePart(0);
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        if (failed) {
+            std::cerr << "Error: Failed to write snapshot partitions\n";
+            for (const auto& part : manifest.parts) {
+                ::unlink(dataPath(part.name).c_str());
+            }
             return Status::ERROR;
         }
         
-        // Write policy first (if provided)
+        // Then the manifest, renamed into place: that installs the snapshot
+        std::string text = std::string(kManifestMagic) + " " +
+                           std::to_string(manifest.generation) + "\n";
+        text += "LSN " + std::to_string(manifest.lsn) + "\n";
         if (!currentPolicy.empty()) {
-            snapFile << "POLICY SET " << currentPolicy << "\n";
+            text += "POLICY SET " + currentPolicy + "\n";
         }
-        
-        // Write all key-value pairs as SET commands
-        for (const auto& [key, value] : data) {
-            snapFile << "SET " << key << " " << value << "\n";
+        for (const auto& part : manifest.parts) {
+            text += "PART " + part.name + " " + std::to_string(part.bytes) + " " +
+                    std::to_string(part.keys) + " " + hex32(part.crc) + "\n";
         }
+        text += "END " + hex32(BackupRestore::crc32(text.data(), text.size())) + "\n";
         
-        snapFile.flush();
-        int snapFd = ::open(snapshotPath.c_str(), O_WRONLY, 0644);
-        // fsync: force kernel buffer to physical disk
-        if (snapFd != -1) { ::fsync(snapFd); ::close(snapFd); }
-        snapFile.close();
+        const std::string tmpPath = snapshotPath + ".tmp";
+        int snapFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (snapFd == -1) {
+            std::cerr << "Error: Failed to create snapshot file: " << snapshotPath << "\n";
+            return Status::ERROR;
+        }
+        SnapshotFileWriter out(snapFd, nullptr);
+        out.buffer() = text;
+        out.flush(1);
+        bool ok = out.ok() && ::fsync(snapFd) == 0;
+        ::close(snapFd);
+        if (!ok) {
+            std::cerr << "Error: Failed to write snapshot: " << strerror(errno) << "\n";
+            ::unlink(tmpPath.c_str());
+            return Status::ERROR;
+        }
+        if (::rename(tmpPath.c_str(), snapshotPath.c_str()) != 0) {
+            std::cerr << "Error: Failed to install snapshot: " << strerror(errno) << "\n";
+            return Status::ERROR;
+        }
+        removeStaleSnapshotParts(manifest);
         
-        // Clear the WAL after successful snapshot
-        Status clearStatus = clearLog();
+        // Clear the WAL after successful snapshot, keeping what was written
+        // after the data was read
+        Status clearStatus = clearLog(manifest.lsn);
         if (clearStatus != Status::OK) {
             std::cerr << "Warning: Snapshot created but failed to clear WAL\n";
             return Status::ERROR;
         }
         
-        std::cout << "Snapshot created with " << data.size() << " keys\n";
+        std::cout << "Snapshot created with " << data.size() + blobRefs.size() << " keys in "
+                  << partitions << " partitions\n";
         return Status::OK;
         
     } catch (const std::exception& e) {
@@ -368,6 +907,69 @@ Status WAL::createSnapshot(const std::unordered_map<std::string, std::string>& d
     }
 }
 
+void WAL::removeStaleSnapshotParts(const SnapshotManifest& live) {
+    std::unordered_set<std::string> keep;
+    for (const auto& part : live.parts) {
+        keep.insert(part.name);
+    }
+    DIR* dir = ::opendir(dataPath(".").c_str());
+    if (dir == nullptr) {
+        return;
+    }
+    std::vector<std::string> stale;
+    while (struct dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (isSnapshotPartName(name) && keep.count(name) == 0) {
+            stale.push_back(std::move(name));
+        }
+    }
+    ::closedir(dir);
+    for (const auto& name : stale) {
+        ::unlink(dataPath(name).c_str());
+    }
+}
+
+void WAL::setSnapshotPartitions(size_t partitions) {
+    std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+    snapshotPartitions_ = partitions == 0 ? defaultSnapshotPartitions()
+                                          : std::min(partitions, kMaxSnapshotPartitions);
+}
+
+size_t WAL::snapshotPartitions() {
+    std::lock_guard<std::mutex> snapshotLock(snapshotMutex_);
+    return snapshotPartitions_;
+}
+
+std::string WAL::snapshotPartName(uint64_t generation, size_t index) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "snapshot-%06llu-%02zu.db",
+                  static_cast<unsigned long long>(generation), index);
+    return buf;
+}
+
+bool WAL::isSnapshotPartName(const std::string& name) {
+    const std::string prefix = "snapshot-";
+    const std::string suffix = ".db";
+    if (name.size() <= prefix.size() + suffix.size() + 2 ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    const std::string middle = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    size_t dash = middle.find('-');
+    return dash != std::string::npos && dash > 0 && dash + 1 < middle.size() &&
+           middle.find_first_not_of("0123456789") == dash &&
+           middle.find_first_not_of("0123456789", dash + 1) == std::string::npos;
+}
+
+std::string WAL::dataPath(const std::string& name) const {
+    size_t lastSlash = snapshotPath.find_last_of("/\\");
+    if (lastSlash == std::string::npos) {
+        return name;
+    }
+    return snapshotPath.substr(0, lastSlash + 1) + name;
+}
+
 bool WAL::isEnabled() const {
     return enabled;
 }
@@ -417,21 +1019,56 @@ bool WAL::fileExists(const std::string& path) {
     return (stat(path.c_str(), &st) == 0);
 }
 
-Status WAL::clearLog() {
+Status WAL::clearLog(uint64_t keepAfter) {
+    // Keep appends out while the file is swapped underneath them
+    std::lock_guard<std::mutex> appendLock(appendMutex_);
     try {
         // Close current log file
         if (logFile.is_open()) {
             logFile.close();
         }
         
-        // Open in truncate mode to clear contents
-        std::ofstream clearFile(walPath, std::ios::trunc);
-        if (!clearFile.is_open()) {
+        // Records after keepAfter are the last ones in the file; with appends
+        // held off, their count is known from the LSNs
+        std::vector<std::string> kept;
+        const uint64_t last = lastLsn_.load(std::memory_order_acquire);
+        if (keepAfter < last) {
+            kept = readLogRecords(false, nullptr);
+            if (kept.size() > last - keepAfter) {
+                kept.erase(kept.begin(), kept.end() - static_cast<std::ptrdiff_t>(last - keepAfter));
+            }
+        }
+        
+        // Replace the file rather than truncating in place, so a backup
+        // still streaming the old log is unaffected
+        const std::string tmpPath = walPath + ".tmp";
+        int clearFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (clearFd == -1) {
             std::cerr << "Error: Failed to clear WAL log\n";
             enabled = false;
             return Status::ERROR;
         }
-        clearFile.close();
+        // The header numbers the records: a crash before this rename leaves
+        // the old log, whose records up to the new snapshot's LSN replay
+        // must skip
+        const std::string header = "BASE " + std::to_string(std::min(keepAfter, last));
+        std::string text = header + " CRC:" + hex32(computeCRC32(header)) + "\n";
+        for (const auto& content : kept) {
+            text += content + " CRC:" + hex32(computeCRC32(content)) + "\n";
+        }
+        // The kept records may already have been acknowledged as durable
+        SnapshotFileWriter out(clearFd, nullptr);
+        out.buffer() = text;
+        out.flush(1);
+        const bool written = out.ok() && ::fsync(clearFd) == 0;
+        ::close(clearFd);
+        if (!written || ::rename(tmpPath.c_str(), walPath.c_str()) != 0) {
+            std::cerr << "Error: Failed to clear WAL log: " << strerror(errno) << "\n";
+            ::unlink(tmpPath.c_str());
+            enabled = false;
+            return Status::ERROR;
+        }
+        logBytes_ = text.size();
         
         // Reopen in append mode
         logFile.open(walPath, std::ios::app);
@@ -440,8 +1077,12 @@ Status WAL::clearLog() {
             enabled = false;
             return Status::ERROR;
         }
-        if (logFd_ != -1) { ::close(logFd_); }
-        logFd_ = ::open(walPath.c_str(), O_WRONLY | O_APPEND, 0644);
+        {
+            // Not while the flush thread is fsyncing the old descriptor
+            std::lock_guard<std::mutex> fdLock(logFdMutex_);
+            if (logFd_ != -1) { ::close(logFd_); }
+            logFd_ = ::open(walPath.c_str(), O_WRONLY | O_APPEND, 0644);
+        }
         
         std::cout << "WAL log cleared\n";
         return Status::OK;
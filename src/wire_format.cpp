@@ -0,0 +1,553 @@
+#include "wire_format.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+void putBE16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+void putBE32(std::string& out, uint32_t v) {
+    out.push_back(static_cast<char>(v >> 24));
+    out.push_back(static_cast<char>(v >> 16));
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+
+void putBE64(std::string& out, uint64_t v) {
+    putBE32(out, static_cast<uint32_t>(v >> 32));
+    putBE32(out, static_cast<uint32_t>(v));
+}
+
+void writeMsgPackInt(std::string& out, int64_t v) {
+    if (v >= 0 && v <= 0x7f) {
+        out.push_back(static_cast<char>(v));
+    } else if (v < 0 && v >= -32) {
+        out.push_back(static_cast<char>(v));
+    } else if (v >= INT32_MIN && v <= INT32_MAX) {
+        out.push_back(static_cast<char>(0xd2));
+        putBE32(out, static_cast<uint32_t>(static_cast<int32_t>(v)));
+    } else {
+        out.push_back(static_cast<char>(0xd3));
+        putBE64(out, static_cast<uint64_t>(v));
+    }
+}
+
+void writeMsgPackString(std::string& out, std::string_view s) {
+    size_t n = s.size();
+    if (WireCodec::isValidUTF8(s)) {
+        if (n < 32) {
+            out.push_back(static_cast<char>(0xa0 | n));
+        } else if (n <= 0xff) {
+            out.push_back(static_cast<char>(0xd9));
+            out.push_back(static_cast<char>(n));
+        } else if (n <= 0xffff) {
+            out.push_back(static_cast<char>(0xda));
+            putBE16(out, static_cast<uint16_t>(n));
+        } else {
+            out.push_back(static_cast<char>(0xdb));
+            putBE32(out, static_cast<uint32_t>(n));
+        }
+    } else {
+        if (n <= 0xff) {
+            out.push_back(static_cast<char>(0xc4));
+            out.push_back(static_cast<char>(n));
+        } else if (n <= 0xffff) {
+            out.push_back(static_cast<char>(0xc5));
+            putBE16(out, static_cast<uint16_t>(n));
+        } else {
+            out.push_back(static_cast<char>(0xc6));
+            putBE32(out, static_cast<uint32_t>(n));
+        }
+    }
+    out.append(s.data(), n);
+}
+
+// ---------- MessagePack reader (request bodies) ----------
+
+struct MsgPackReader {
+    std::string_view data;
+    size_t pos = 0;
+
+    bool need(size_t n) const { return pos + n <= data.size(); }
+
+    uint64_t readBE(size_t n) {
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; ++i) {
+            v = (v << 8) | static_cast<uint8_t>(data[pos++]);
+        }
+        return v;
+    }
+
+    bool readBytes(size_t n, std::string& out) {
+        if (!need(n)) return false;
+        out.assign(data.data() + pos, n);
+        pos += n;
+        return true;
+    }
+
+    // Reads a scalar and renders it as a string parameter
+    bool readScalar(std::string& out) {
+        if (!need(1)) return false;
+        uint8_t b = static_cast<uint8_t>(data[pos++]);
+        if ((b & 0xe0) == 0xa0) return readBytes(b & 0x1f, out);
+        if (b <= 0x7f) { out = std::to_string(b); return true; }
+        if (b >= 0xe0) { out = std::to_string(static_cast<int8_t>(b)); return true; }
+        switch (b) {
+            case 0xc0: out.clear(); return true;
+            case 0xc2: out = "false"; return true;
+            case 0xc3: out = "true"; return true;
+            case 0xc4: case 0xd9:
+                if (!need(1)) return false;
+                return readBytes(readBE(1), out);
+            case 0xc5: case 0xda:
+                if (!need(2)) return false;
+                return readBytes(readBE(2), out);
+            case 0xc6: case 0xdb:
+                if (!need(4)) return false;
+                return readBytes(readBE(4), out);
+            case 0xcc: if (!need(1)) return false; out = std::to_string(readBE(1)); return true;
+            case 0xcd: if (!need(2)) return false; out = std::to_string(readBE(2)); return true;
+            case 0xce: if (!need(4)) return false; out = std::to_string(readBE(4)); return true;
+            case 0xcf: if (!need(8)) return false; out = std::to_string(readBE(8)); return true;
+            case 0xd0: if (!need(1)) return false; out = std::to_string(static_cast<int8_t>(readBE(1))); return true;
+            case 0xd1: if (!need(2)) return false; out = std::to_string(static_cast<int16_t>(readBE(2))); return true;
+            case 0xd2: if (!need(4)) return false; out = std::to_string(static_cast<int32_t>(readBE(4))); return true;
+            case 0xd3: if (!need(8)) return false; out = std::to_string(static_cast<int64_t>(readBE(8))); return true;
+            default: return false;  // floats, nested containers, ext: not used by the API
+        }
+    }
+};
+
+// ---------- JSON -> MessagePack transcoder ----------
+
+struct JSONTranscoder {
+    std::string_view in;
+    size_t pos = 0;
+    int depth = 0;
+
+    void skipWS() {
+        while (pos < in.size() && (in[pos] == ' ' || in[pos] == '\n' ||
+                                   in[pos] == '\r' || in[pos] == '\t')) {
+            ++pos;
+        }
+    }
+
+    bool literal(const char* word) {
+        size_t n = std::strlen(word);
+        if (in.substr(pos, n) != word) return false;
+        pos += n;
+        return true;
+    }
+
+    static void appendUTF8(std::string& s, uint32_t cp) {
+        if (cp < 0x80) {
+            s.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            s.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+            s.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        } else {
+            s.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+            s.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            s.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    bool parseString(std::string& s) {
+        if (pos >= in.size() || in[pos] != '"') return false;
+        ++pos;
+        s.clear();
+        while (pos < in.size()) {
+            char c = in[pos++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                s.push_back(c);
+                continue;
+            }
+            if (pos >= in.size()) return false;
+            char e = in[pos++];
+            switch (e) {
+                case '"': s.push_back('"'); break;
+                case '\\': s.push_back('\\'); break;
+                case '/': s.push_back('/'); break;
+                case 'b': s.push_back('\b'); break;
+                case 'f': s.push_back('\f'); break;
+                case 'n': s.push_back('\n'); break;
+                case 'r': s.push_back('\r'); break;
+                case 't': s.push_back('\t'); break;
+                case 'u': {
+                    if (pos + 4 > in.size()) return false;
+                    uint32_t cp = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        char h = in[pos++];
+                        cp <<= 4;
+                        if (h >= '0' && h <= '9') cp |= static_cast<uint32_t>(h - '0');
+                        else if (h >= 'a' && h <= 'f') cp |= static_cast<uint32_t>(h - 'a' + 10);
+                        else if (h >= 'A' && h <= 'F') cp |= static_cast<uint32_t>(h - 'A' + 10);
+                        else return false;
+                    }
+                    appendUTF8(s, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseValue(std::string& out) {
+        if (++depth > 64) return false;
+        skipWS();
+        if (pos >= in.size()) return false;
+        bool ok = false;
+        char c = in[pos];
+        if (c == '{' || c == '[') {
+            bool isObject = c == '{';
+            char close = isObject ? '}' : ']';
+            ++pos;
+            // Children are encoded first because the header needs their count
+            std::string body;
+            size_t count = 0;
+            skipWS();
+            if (pos < in.size() && in[pos] == close) {
+                ++pos;
+                ok = true;
+            } else {
+                while (true) {
+                    if (isObject) {
+                        std::string k;
+                        skipWS();
+                        if (!parseString(k)) break;
+                        writeMsgPackString(body, k);
+                        skipWS();
+                        if (pos >= in.size() || in[pos] != ':') break;
+                        ++pos;
+                    }
+                    if (!parseValue(body)) break;
+                    ++count;
+                    skipWS();
+                    if (pos < in.size() && in[pos] == ',') { ++pos; continue; }
+                    if (pos < in.size() && in[pos] == close) { ++pos; ok = true; }
+                    break;
+                }
+            }
+            if (ok) {
+                if (isObject) {
+                    if (count < 16) out.push_back(static_cast<char>(0x80 | count));
+                    else if (count <= 0xffff) { out.push_back(static_cast<char>(0xde)); putBE16(out, static_cast<uint16_t>(count)); }
+                    else { out.push_back(static_cast<char>(0xdf)); putBE32(out, static_cast<uint32_t>(count)); }
+                } else {
+                    if (count < 16) out.push_back(static_cast<char>(0x90 | count));
+                    else if (count <= 0xffff) { out.push_back(static_cast<char>(0xdc)); putBE16(out, static_cast<uint16_t>(count)); }
+                    else { out.push_back(static_cast<char>(0xdd)); putBE32(out, static_cast<uint32_t>(count)); }
+                }
+                out += body;
+            }
+        } else if (c == '"') {
+            std::string s;
+            ok = parseString(s);
+            if (ok) writeMsgPackString(out, s);
+        } else if (literal("true")) {
+            out.push_back(static_cast<char>(0xc3));
+            ok = true;
+        } else if (literal("false")) {
+            out.push_back(static_cast<char>(0xc2));
+            ok = true;
+        } else if (literal("null")) {
+            out.push_back(static_cast<char>(0xc0));
+            ok = true;
+        } else {
+            // Numbers: integers stay integers; a fraction or exponent (the
+            // statistics /stats reports) makes a float64
+            size_t start = pos;
+            if (pos < in.size() && in[pos] == '-') ++pos;
+            size_t digits = pos;
+            while (pos < in.size() && in[pos] >= '0' && in[pos] <= '9') ++pos;
+            bool isFloat = false;
+            if (pos > digits && pos < in.size() && in[pos] == '.') {
+                isFloat = true;
+                size_t fraction = ++pos;
+                while (pos < in.size() && in[pos] >= '0' && in[pos] <= '9') ++pos;
+                if (pos == fraction) digits = pos;  // "1." is not a number
+            }
+            if (pos > digits && pos < in.size() && (in[pos] == 'e' || in[pos] == 'E')) {
+                isFloat = true;
+                ++pos;
+                if (pos < in.size() && (in[pos] == '+' || in[pos] == '-')) ++pos;
+                size_t exponent = pos;
+                while (pos < in.size() && in[pos] >= '0' && in[pos] <= '9') ++pos;
+                if (pos == exponent) digits = pos;
+            }
+            if (pos > digits && isFloat) {
+                double d = std::strtod(std::string(in.substr(start, pos - start)).c_str(), nullptr);
+                uint64_t bits;
+                std::memcpy(&bits, &d, sizeof(bits));
+                out.push_back(static_cast<char>(0xcb));
+                putBE64(out, bits);
+                ok = true;
+            } else if (pos > digits) {
+                int64_t v = 0;
+                bool negative = in[start] == '-';
+                for (size_t i = digits; i < pos; ++i) {
+                    v = v * 10 + (in[i] - '0');
+                }
+                writeMsgPackInt(out, negative ? -v : v);
+                ok = true;
+            }
+        }
+        --depth;
+        return ok;
+    }
+};
+
+} // namespace
+
+// ---------- ResponseWriter ----------
+
+ResponseWriter::ResponseWriter(WireFormat format, size_t reserveBytes)
+    : format_(format) {
+    out_.reserve(reserveBytes);
+}
+
+const char* ResponseWriter::contentType(WireFormat format) {
+    return format == WireFormat::MSGPACK ? "application/msgpack" : "application/json";
+}
+
+const char* ResponseWriter::contentType() const {
+    return contentType(format_);
+}
+
+void ResponseWriter::separator() {
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (!hasElement_.empty()) {
+        if (hasElement_.back()) out_.push_back(',');
+        hasElement_.back() = true;
+    }
+}
+
+void ResponseWriter::writeMsgPackHeader(uint8_t fix, uint8_t fixLimit,
+                                        uint8_t op16, uint8_t op32, size_t n) {
+    if (n < fixLimit) {
+        out_.push_back(static_cast<char>(fix | n));
+    } else if (n <= 0xffff) {
+        out_.push_back(static_cast<char>(op16));
+        putBE16(out_, static_cast<uint16_t>(n));
+    } else {
+        out_.push_back(static_cast<char>(op32));
+        putBE32(out_, static_cast<uint32_t>(n));
+    }
+}
+
+void ResponseWriter::beginObject(size_t fields) {
+    if (format_ == WireFormat::MSGPACK) {
+        writeMsgPackHeader(0x80, 16, 0xde, 0xdf, fields);
+        return;
+    }
+    separator();
+    out_.push_back('{');
+    hasElement_.push_back(false);
+}
+
+void ResponseWriter::endObject() {
+    if (format_ == WireFormat::MSGPACK) return;
+    out_.push_back('}');
+    hasElement_.pop_back();
+}
+
+void ResponseWriter::beginArray(size_t elements) {
+    if (format_ == WireFormat::MSGPACK) {
+        writeMsgPackHeader(0x90, 16, 0xdc, 0xdd, elements);
+        return;
+    }
+    separator();
+    out_.push_back('[');
+    hasElement_.push_back(false);
+}
+
+void ResponseWriter::endArray() {
+    if (format_ == WireFormat::MSGPACK) return;
+    out_.push_back(']');
+    hasElement_.pop_back();
+}
+
+size_t ResponseWriter::beginArrayUnsized() {
+    if (format_ == WireFormat::MSGPACK) {
+        size_t token = out_.size();
+        out_.push_back(static_cast<char>(0xdd));
+        out_.append(4, '\0');
+        return token;
+    }
+    beginArray(0);
+    return 0;
+}
+
+void ResponseWriter::endArrayUnsized(size_t token, size_t elements) {
+    if (format_ == WireFormat::MSGPACK) {
+        uint32_t n = static_cast<uint32_t>(elements);
+        out_[token + 1] = static_cast<char>(n >> 24);
+        out_[token + 2] = static_cast<char>(n >> 16);
+        out_[token + 3] = static_cast<char>(n >> 8);
+        out_[token + 4] = static_cast<char>(n);
+        return;
+    }
+    endArray();
+}
+
+void ResponseWriter::key(std::string_view name) {
+    if (format_ == WireFormat::MSGPACK) {
+        writeMsgPackString(out_, name);
+        return;
+    }
+    separator();
+    writeJSONString(name);
+    out_.push_back(':');
+    afterKey_ = true;
+}
+
+void ResponseWriter::string(std::string_view value) {
+    if (format_ == WireFormat::MSGPACK) {
+        writeMsgPackString(out_, value);
+        return;
+    }
+    separator();
+    writeJSONString(value);
+}
+
+void ResponseWriter::integer(int64_t value) {
+    if (format_ == WireFormat::MSGPACK) {
+        writeMsgPackInt(out_, value);
+        return;
+    }
+    separator();
+    char buf[24];
+    int len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(value));
+    out_.append(buf, static_cast<size_t>(len));
+}
+
+void ResponseWriter::boolean(bool value) {
+    if (format_ == WireFormat::MSGPACK) {
+        out_.push_back(static_cast<char>(value ? 0xc3 : 0xc2));
+        return;
+    }
+    separator();
+    out_ += value ? "true" : "false";
+}
+
+void ResponseWriter::null() {
+    if (format_ == WireFormat::MSGPACK) {
+        out_.push_back(static_cast<char>(0xc0));
+        return;
+    }
+    separator();
+    out_ += "null";
+}
+
+void ResponseWriter::writeJSONString(std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out_.push_back('"');
+    // Copy unescaped runs in one append instead of byte by byte
+    size_t runStart = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        out_.append(value.data() + runStart, i - runStart);
+        runStart = i + 1;
+        switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                out_ += "\\u00";
+                out_.push_back(hex[c >> 4]);
+                out_.push_back(hex[c & 0xf]);
+                break;
+        }
+    }
+    out_.append(value.data() + runStart, value.size() - runStart);
+    out_.push_back('"');
+}
+
+// ---------- WireCodec ----------
+
+bool WireCodec::isValidUTF8(std::string_view s) {
+    size_t i = 0;
+    const size_t n = s.size();
+    while (i < n) {
+        // ASCII fast path, eight bytes at a time
+        if (i + 8 <= n) {
+            uint64_t word;
+            std::memcpy(&word, s.data() + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t len;
+        uint32_t cp;
+        if ((c & 0xe0) == 0xc0) { len = 2; cp = c & 0x1f; }
+        else if ((c & 0xf0) == 0xe0) { len = 3; cp = c & 0x0f; }
+        else if ((c & 0xf8) == 0xf0) { len = 4; cp = c & 0x07; }
+        else return false;
+        if (i + len > n) return false;
+        for (size_t k = 1; k < len; ++k) {
+            unsigned char cc = static_cast<unsigned char>(s[i + k]);
+            if ((cc & 0xc0) != 0x80) return false;
+            cp = (cp << 6) | (cc & 0x3f);
+        }
+        // Reject overlong forms, surrogates and out-of-range code points
+        if ((len == 2 && cp < 0x80) || (len == 3 && cp < 0x800) ||
+            (len == 4 && (cp < 0x10000 || cp > 0x10ffff)) ||
+            (cp >= 0xd800 && cp <= 0xdfff)) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+}
+
+bool WireCodec::parseMsgPackParams(std::string_view data,
+                                   std::unordered_map<std::string, std::string>& params) {
+    MsgPackReader r{data};
+    if (!r.need(1)) return false;
+    uint8_t b = static_cast<uint8_t>(data[r.pos++]);
+    size_t count;
+    if ((b & 0xf0) == 0x80) {
+        count = b & 0x0f;
+    } else if (b == 0xde && r.need(2)) {
+        count = r.readBE(2);
+    } else if (b == 0xdf && r.need(4)) {
+        count = r.readBE(4);
+    } else {
+        return false;
+    }
+
+    std::string k, v;
+    for (size_t i = 0; i < count; ++i) {
+        if (!r.readScalar(k) || !r.readScalar(v)) return false;
+        params[k] = v;
+    }
+    return r.pos == data.size();
+}
+
+bool WireCodec::jsonToMsgPack(std::string_view json, std::string& out) {
+    JSONTranscoder t{json};
+    out.clear();
+    if (!t.parseValue(out)) return false;
+    t.skipWS();
+    return t.pos == json.size();
+}